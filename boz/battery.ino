@@ -2,11 +2,6 @@
 
 #include <avr/pgmspace.h>
 
-/* If the voltage at VIN is below this, we'll assume we're running from USB
-   and the battery isn't switched on. The Arduino Nano can run with 7V-12V at
-   VIN. The Bozzard control unit has a 9V supply. */
-#define VIN_MIN_MV 6000
-
 const PROGMEM char s_battery_power[] =   "Power:";
 const PROGMEM char s_battery_battery[] = "battery";
 const PROGMEM char s_battery_usb[] =     "USB    ";
@@ -41,30 +36,32 @@ enum battery_char_codes {
     BATTERY_RIGHT_FULL
 };
 
-/* All these characters are vertically symmetric (symmetric about a horizontal
-   line) so we only need to encode rows 0, 1, 2 and 3. */
-const PROGMEM byte battery_cgram_patterns[] = {
+#define BATTERY_NUM_CHARS 6
+
+/* The characters the battery is drawn with, in the order of enum
+   battery_char_codes */
+const PROGMEM byte battery_cgram_patterns[BATTERY_NUM_CHARS][8] = {
     /* Left end of battery, empty */
-    0x1f, 0x10, 0x10, 0x10,
+    { 0x1f, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },
 
     /* Middle part of battery, empty */
-    0x1f, 0, 0, 0,
+    { 0x1f, 0, 0, 0, 0, 0, 0, 0x1f },
 
     /* Right end of battery, empty */
-    0x1e, 0x02, 0x03, 0x01,
+    { 0x1e, 0x02, 0x03, 0x01, 0x01, 0x03, 0x02, 0x1e },
 
     /* Left end of battery, full */
-    0x1f, 0x10, 0x17, 0x17,
-   
+    { 0x1f, 0x10, 0x17, 0x17, 0x17, 0x17, 0x10, 0x1f },
+
     /* Middle part of battery, full */
-    0x1f, 0x00, 0x1f, 0x1f,
+    { 0x1f, 0x00, 0x1f, 0x1f, 0x1f, 0x1f, 0x00, 0x1f },
 
     /* Right end of battery, full */
-    0x1e, 0x02, 0x1b, 0x19,
-
-    /* No more patterns */
-    0xff
+    { 0x1e, 0x02, 0x1b, 0x19, 0x19, 0x1b, 0x02, 0x1e },
 };
+
+/* The character code boz_display_glyph() gave us for each of those */
+char battery_chars[BATTERY_NUM_CHARS];
 #else
 
 /* This is an empty battery, but we'll edit the pattern to make as many lines
@@ -89,34 +86,46 @@ battery_init(void *dummy) {
 #if BATTERY_PICTURE == BATTERY_PICTURE_BIG
 void
 battery_set_cgram_pattern(void *ptr) {
-    if (pgm_read_byte_near(ptr) == 0xff) {
+    int index = ((byte *) ptr - &battery_cgram_patterns[0][0]) / 8;
+
+    if (index >= BATTERY_NUM_CHARS) {
         /* Finished messing about with CGRAM, start the application proper */
         battery_start(NULL);
     }
     else {
-        /* Set this CGRAM char, then wait for that to be done before moving
-           on to the next character, so as not to overflow the display command
-           queue. These commands should only take a millisecond to run, but
-           we want to give the main loop a chance to actually run them. */
-        int code = ((byte *) ptr - battery_cgram_patterns) / 4;
-        boz_display_set_cgram_address(code << 3);
-        for (byte i = 0; i < 8; ++i) {
-            byte row = (i >= 4 ? (7 - i) : i);
-            boz_display_write_char(pgm_read_byte_near((byte *) ptr + row));
+        /* Get a CGRAM char for this pattern, then wait for that to be done
+           before moving on to the next character, so as not to overflow the
+           display command queue. These commands should only take a
+           millisecond to run, but we want to give the main loop a chance to
+           actually run them. If the queue was too full, try this one again
+           after the wait. */
+        int code = boz_display_glyph((byte *) ptr);
+        if (code < 0) {
+            boz_set_alarm(10, battery_set_cgram_pattern, ptr);
+        }
+        else {
+            battery_chars[index] = (char) code;
+            boz_set_alarm(10, battery_set_cgram_pattern, (byte *) ptr + 8);
         }
-        boz_set_alarm(10, battery_set_cgram_pattern, (byte *) ptr + 4);
     }
 }
 #endif
 
+const PROGMEM struct boz_event_handlers battery_handlers = {
+    NULL,           // buzz
+    battery_exit,   // qm_play
+#if BATTERY_PICTURE != BATTERY_PICTURE_NONE
+    battery_poke,   // qm_yellow
+#else
+    NULL,           // qm_yellow
+#endif
+    battery_exit,   // qm_reset
+};
+
 void
 battery_start(void *dummy) {
     /* Press green or red to exit, or press yellow to change display mode */
-    boz_set_event_handler_qm_reset(battery_exit);
-#if BATTERY_PICTURE != BATTERY_PICTURE_NONE
-    boz_set_event_handler_qm_yellow(battery_poke);
-#endif
-    boz_set_event_handler_qm_play(battery_exit);
+    boz_set_event_handlers(&battery_handlers);
 
 #if BATTERY_PICTURE == BATTERY_PICTURE_NONE
     battery_refresh(NULL);
@@ -149,46 +158,6 @@ battery_refresh(struct battery_app_state *state) {
     battery_refresh_battery(state);
 }
 
-/* Our minimum voltage (0%) is 7 volts because anything less than that is
-   outside the spec for the Arduino.
-   Our maximum voltage (100%) we'll call 9.3 volts, because a brand-new 9V
-   battery usually supplies about that.
-   The voltages corresponding to 20%, 40%, 60%, 80% are guessed from a Duracell
-   datasheet. */
-
-const PROGMEM int voltage_per_20_percent[] = {
-    //   0%  20%  40%  60%  80%  100%
-        700, 730, 755, 770, 825, 930
-};
-
-static byte voltage_to_percent(int centivolts) {
-    int left_threshold, right_threshold;
-    byte left_threshold_percent, right_threshold_percent;
-    byte quintile;
-    
-    left_threshold = 0;
-    for (quintile = 0; quintile < 6; ++quintile) {
-        right_threshold = pgm_read_word_near(&voltage_per_20_percent[(int) quintile]); 
-        if (centivolts < right_threshold) {
-            break;
-        }
-        left_threshold = right_threshold;
-    }
-
-    /* percentage is between the one represented by left_threshold and the one
-       represented by right_threshold - from here we'll linearly interpolate */
-
-    if (quintile == 0)
-        return 0;
-    
-    if (quintile >= 6)
-        return 100;
-    
-    right_threshold_percent = (byte) (quintile * 20);
-    left_threshold_percent = right_threshold_percent - 20;
-    return (byte) map(centivolts, left_threshold, right_threshold, left_threshold_percent, right_threshold_percent);
-}
-
 #if BATTERY_PICTURE != BATTERY_PICTURE_NONE
 void battery_poke(void *cookie) {
     /* Change between displaying a picture of a battery and a precise but
@@ -202,10 +171,11 @@ void battery_poke(void *cookie) {
 void battery_refresh_battery(void *cookie) {
     struct battery_app_state *state = (struct battery_app_state *) cookie;
     int millivolts = boz_get_battery_voltage();
+    int percent = boz_get_battery_percent();
     const char *power_source;
 
     boz_display_set_cursor(1, 0);
-    if (millivolts < VIN_MIN_MV) {
+    if (percent < 0) {
         /* We're probably not running from a battery */
         for (int i = 0; i < 16; ++i) {
             boz_display_write_char(' ');
@@ -215,15 +185,12 @@ void battery_refresh_battery(void *cookie) {
     else {
         /* Voltage format: ##.##V */
         int centivolts = (millivolts + 5) / 10;
-        byte percent;
 
         boz_display_write_long(centivolts / 100, 2, 0);
         boz_display_write_char('.');
         boz_display_write_long(centivolts % 100, 2, BOZ_DISP_NUM_ZERO_PAD);
         boz_display_write_string_P(s_battery_v_space);
 
-        percent = voltage_to_percent(centivolts);
-
 #if BATTERY_PICTURE != BATTERY_PICTURE_NONE
         if (state->battery_picture) {
 #if BATTERY_PICTURE == BATTERY_PICTURE_BIG
@@ -242,7 +209,7 @@ void battery_refresh_battery(void *cookie) {
                         code++;
                     }
                 }
-                boz_display_write_char(code);
+                boz_display_write_char(battery_chars[(int) code]);
             }
 #else
             /* Draw a battery in one character cell, using CGRAM code 0 or 8,
@@ -1,15 +1,23 @@
 #include "boz_api.h"
 #include "boz_util.h"
-#include "boz_queue.h"
+#include "boz_ring.h"
 #include "boz_shiftreg.h"
 #include "boz_lcd.h"
+#include "boz_display.h"
 #include "boz_app.h"
 #include "boz_pins.h"
 #include "boz_notes.h"
 #include "boz_crash.h"
+#include "boz_input_log.h"
+#include "boz_watchdog.h"
+#include "boz_trace.h"
+#include "boz_input.h"
+#include "boz_mirror.h"
+#include "boz_clock_stream.h"
 
 #include <avr/pgmspace.h>
 #include <avr/sleep.h>
+#include <avr/wdt.h>
 #include <EEPROM.h>
 
 #include "boz_app_inits.h"
@@ -23,22 +31,43 @@ const long BOZ_VERSION = ((BOZ_VERSION_MAJOR << 24) |
             (BOZ_VERSION_MINOR << 16) |
             (BOZ_VERSION_RELEASE << 8));
 
+/* Version of the layout of the EEPROM as a whole - that is, where the header
+   and the region version table live. This is NOT the firmware version:
+   upgrading the firmware leaves the EEPROM alone, and each app's region is
+   versioned separately (see boz_app.eeprom_version). Only change this if the
+   header or the version table move, because doing so erases everything.
+   Layout 1.0.0.0 is the one written by firmware 1.0.0. */
+#define BOZ_EEPROM_LAYOUT 0x01000000L
+
 /* If the start of EEPROM doesn't contain this when we turn the unit on, we'll
    write it there and fill the rest of EEPROM with 0xff to initialise it. */
 struct boz_eeprom_header {
     char id[8];
-    long version;
+    long layout;
 };
 const PROGMEM struct boz_eeprom_header boz_eeprom_header = {
     "BOZZARD",
-    BOZ_VERSION
+    BOZ_EEPROM_LAYOUT
 };
 
+/* One byte per app ID, giving the version of the data in that app's EEPROM
+   region. 0xff means the region has never been stamped, which is the case
+   for freshly-erased EEPROM and for data written by firmware older than the
+   version table. App regions start at 0x40. */
+#define BOZ_EEPROM_VERSION_TABLE 0x10
+#define BOZ_EEPROM_VERSION_TABLE_SIZE 16
+#define BOZ_EEPROM_VERSION_NONE 0xff
+
+/* Sizes of the sound and display command queues, which must be powers of
+   two (see boz_ring.h) */
 #define SND_CMD_QUEUE_SIZE 16
-#define DISP_CMD_QUEUE_SIZE 96
+#define SND_HI_QUEUE_SIZE 8
+#define DISP_CMD_QUEUE_SIZE 128
 #define APP_CONTEXT_STACK_SIZE 4
 #define NUM_CLOCKS BOZ_NUM_CLOCKS // must be less than the number of bits in an int
+#ifndef BOZ_DYN_ARENA_SIZE
 #define BOZ_DYN_ARENA_SIZE 512
+#endif
 //#define BOZ_SOUND_RAMP_LOG // better sound-ramp effect, but +2KB code size
 
 /* A single sound command, which is put on the sound queue by an app, and is
@@ -73,11 +102,6 @@ struct disp_cmd {
     unsigned short cmd;
 };
 
-struct snd_cmd_queue {
-    struct snd_cmd q[SND_CMD_QUEUE_SIZE];
-    struct queue_state qstate;
-};
-
 struct snd_cmd_state {
     struct snd_cmd cmd;
     unsigned long start_millis;      // millis() when sound started
@@ -86,11 +110,7 @@ struct snd_cmd_state {
     unsigned short times_done;
     byte running;                    // true if command is in progress
     byte arp_index;                  // which note of an arpeggio we're on
-};
-
-struct disp_cmd_queue {
-    struct disp_cmd q[DISP_CMD_QUEUE_SIZE];
-    struct queue_state qstate;
+    byte high_priority;              // true if it came from snd_hi_queue
 };
 
 struct disp_cmd_state {
@@ -100,50 +120,90 @@ struct disp_cmd_state {
     unsigned char running;
 };
 
-struct button_state {
-    /* Pin for this button */
+/* One of the quizmaster's buttons, which has a bit of its own in each of
+   the debouncer's bit-planes (see struct debouncer). The buzzers don't need
+   one each, because they're all alike. */
+struct button_def {
+    /* Pin for this button. The pins have internal pull-up resistors and
+       the buttons connect them to ground, so LOW means pressed. */
     byte pin;
 
-    /* Function of this button, e.g. FUNC_BUZZER or FUNC_PLAY */
+    /* Function of this button, e.g. FUNC_PLAY */
     byte button_function;
 
-    /* If button_function is FUNC_BUZZER, which buzzer it is: 0 to 3 */
-    byte buzzer_id;
+    /* Number of consecutive samples, 1 to 4, we must see the button held
+       down before we consider it pressed. */
+    byte press_samples;
 
-    /* Number of microseconds we must have a continuous signal on a button's
-       pin before we consider that button pressed. */
-    unsigned int press_threshold_us;
-
-    /* Number of microseconds we must have a continuous no-signal on a button's
-       pin before we consider that button released, after which point a new
-       signal will be interpreted as a new press. */
-    unsigned int release_threshold_us;
+    /* Number of debounce ticks (DEBOUNCE_TICK_MS), 1 to 4, we must see the
+       button continuously released before we consider it released, after
+       which a new signal will be interpreted as a new press. */
+    byte release_ticks;
+};
 
-    /* If is_pressed, pressed_since_micros is the value of micros() since when
-       the button has been continuously pressed.
-       If not is_pressed, released_since_micros is the value of micros()
-       since when the button has been continuously not pressed. */
-    unsigned long pressed_since_micros, released_since_micros;
+/* Debounced state of all the buttons, one bit per button, in the order
+   given in boz_input.h: the buzzers, then qm_button_defs. Each button has
+   a two-bit counter, whose low bits are in count0 and high bits in count1,
+   so we can update every button at once with a handful of bitwise
+   operations (see debounce_sample()). A button's counter counts how long
+   its raw input has disagreed with its debounced state, and is zero if they
+   agree. */
+struct debouncer {
+    /* Debounced state: 1 means pressed */
+    boz_button_mask state;
+
+    /* Vertical counter */
+    boz_button_mask count0, count1;
+
+    /* Raw input from the last sample, 1 means held down */
+    boz_button_mask raw;
+
+    /* For each button, the counter value at which a disagreement counts,
+       that is, press_samples - 1 for a released button and
+       release_ticks - 1 for a pressed one, in the same bit-plane form. */
+    boz_button_mask press_limit0, press_limit1;
+    boz_button_mask release_limit0, release_limit1;
+};
 
-    /* 1 if the button was pressed last time we looked, 0 if not. */
-    unsigned int is_pressed : 1;
-    
-    /* If the button was pressed for long enough that we considered it a
-       valid press, and we called the application's handler to tell it about
-       the press event or we would have called it but there was no handler
-       set, event_delivered is 1, otherwise it's 0. */
-    unsigned int event_delivered : 1;
-
-    /* The input pins have internal pull-up resistors, so are HIGH by
-       default. A button connected between it and ground will pull it
-       low when pressed. So HIGH means the button is not pressed, and
-       LOW means the button is pressed. */
-    unsigned int active_low : 1;
+/* Something the QM or a contestant did, which the main loop has seen but
+   not yet told the app about. */
+struct input_event {
+    /* micros() when we saw it */
+    unsigned long us;
+
+    /* Button index, as in the debouncer, or INPUT_EVENT_ROTARY */
+    byte source;
+
+    /* For INPUT_EVENT_ROTARY, the number of steps turned, clockwise if
+       positive, and how quickly: 0 for slowly, otherwise the multiplier to
+       use if the app wants acceleration. For a buzzer, multiplier is 1 if
+       the buzz lost arbitration, and is only being delivered because the
+       app's policy has BOZ_ARB_TELL_LOSERS. */
+    signed char steps;
+    byte multiplier;
 };
 
 /* The sound and display commands queue. */
-struct snd_cmd_queue snd_cmd_queue;
-struct disp_cmd_queue disp_cmd_queue;
+boz_ring<struct snd_cmd, SND_CMD_QUEUE_SIZE> snd_cmd_queue;
+
+/* Sound commands enqueued at BOZ_SOUND_PRIORITY_HIGH. These interrupt
+   whatever's playing from snd_cmd_queue, which carries on afterwards. */
+boz_ring<struct snd_cmd, SND_HI_QUEUE_SIZE> snd_hi_queue;
+
+/* Which queue the boz_sound_* functions use, one of BOZ_SOUND_PRIORITY_* */
+byte snd_priority = BOZ_SOUND_PRIORITY_NORMAL;
+boz_ring<struct disp_cmd, DISP_CMD_QUEUE_SIZE> disp_cmd_queue;
+
+/* Between boz_display_reserve() and the matching boz_display_commit(),
+   display commands are staged after the end of the queue, where the main
+   loop can't see them yet. disp_txn_depth is how many reservations are
+   still open, and disp_txn_staged is how many commands are staged. */
+byte disp_txn_depth = 0;
+byte disp_txn_staged = 0;
+
+/* The display_queue_space event fires when the queue has this much space,
+   which is the size of the last reservation that failed, or 1. */
+byte disp_space_wanted = 1;
 
 /* The sound and display command currently being executed. Sound and display
    commands often involve an element of waiting around (especially sound
@@ -152,6 +212,13 @@ struct disp_cmd_queue disp_cmd_queue;
 struct snd_cmd_state snd_cmd_state;
 struct disp_cmd_state disp_cmd_state;
 
+/* If a high-priority sound interrupted a sound command from snd_cmd_queue,
+   the state of that command, to carry on with when the high-priority
+   sounds have finished, and the millis() time when it was interrupted.
+   snd_cmd_preempted.running is set if there's anything to carry on with. */
+struct snd_cmd_state snd_cmd_preempted;
+unsigned long snd_preempted_millis;
+
 /* General-purpose clocks for use by applications. There are NUM_CLOCKS clocks,
    to be shared between all applications currently in memory. "clocks" is an
    array of boz_clocks whose memory has been dynamically allocated by
@@ -159,21 +226,27 @@ struct disp_cmd_state disp_cmd_state;
 boz_clock clocks[NUM_CLOCKS];
 unsigned int master_clocks_enabled = 0; // bitmask
 
-/* Press threshold: the number of microseconds we must sense a button held down
-   for before we consider it a press event.
-   Release threshold: the number of microseconds we must sense the button
-   continuously released before we accept another press event.
+/* Press threshold: the number of consecutive samples (passes of the main
+   loop) we must see a button held down for before we consider it a press
+   event. 1 means the first sample.
+   Release threshold: the number of debounce ticks we must see the button
+   continuously released before we accept another press event. The release
+   counter only counts on the first sample after each tick, so four ticks of
+   4ms is between 12ms and 16ms.
 */
-const unsigned int BUTTON_PRESS_THRESHOLD_US = 0;
-const unsigned int BUTTON_RELEASE_THRESHOLD_US = 15000;
-const unsigned int ROTARY_CLOCK_PRESS_THRESHOLD_US = 0;
-const unsigned int ROTARY_CLOCK_RELEASE_THRESHOLD_US = 5000;
-
-/* If the number of milliseconds between two clock pulses from the rotary
-   encoder (with the data pin indicating the same direction) is less than
-   this number of milliseconds, consider the second pulse to be accidental
-   and disregard it. */
-const byte ROTARY_TURN_MIN_GAP_MS = 15;
+const byte BUTTON_PRESS_SAMPLES = 1;
+const byte BUTTON_RELEASE_TICKS = 4;
+const unsigned long DEBOUNCE_TICK_MS = 4;
+
+/* Rotary acceleration. If the rotary knob is turned one step less than
+   ROTARY_FAST_GAP_US after the previous step in the same direction, and the
+   app has asked for acceleration, we count it as ROTARY_FAST_MULTIPLIER
+   steps. Between that and ROTARY_MEDIUM_GAP_US, ROTARY_MEDIUM_MULTIPLIER
+   steps. Any slower than that and a step is a step. */
+const unsigned long ROTARY_FAST_GAP_US = 25000;
+const unsigned long ROTARY_MEDIUM_GAP_US = 60000;
+const byte ROTARY_FAST_MULTIPLIER = 10;
+const byte ROTARY_MEDIUM_MULTIPLIER = 3;
 
 /* Next time we check all the buttons to see which one, if any, was pressed,
    this tells is which button we check first and which way we iterate through
@@ -182,27 +255,92 @@ const byte ROTARY_TURN_MIN_GAP_MS = 15;
 char button_check_start = 0;
 char button_check_direction = 1;
 
-/* The state of each of the buttons (se struct button_state). Here we store
-   the current state of the buzzer buttons, the play, yellow and reset buttons,
-   the rotary encoder's pushbutton, and the rotary encoder's clock input. */
-struct button_state buttons[] = {
-    { PIN_BUZZER_0,  FUNC_BUZZER, 0, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 1 },
-    { PIN_BUZZER_1,  FUNC_BUZZER, 1, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 1, 0, 0, 0, 1 },
-    { PIN_BUZZER_2,  FUNC_BUZZER, 2, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 2, 0, 0, 0, 1 },
-    { PIN_BUZZER_3,  FUNC_BUZZER, 3, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 3, 0, 0, 0, 1 },
-    { PIN_QM_PLAY,   FUNC_PLAY,   0, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 1 },
-    { PIN_QM_YELLOW, FUNC_YELLOW, 0, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 1 },
-    { PIN_QM_RESET,  FUNC_RESET,  0, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 1 },
-    { PIN_QM_RE_KEY, FUNC_RE_KEY, 0, BUTTON_PRESS_THRESHOLD_US, BUTTON_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 1 },
-    { PIN_QM_RE_CLOCK, FUNC_RE_CLOCK, 0, ROTARY_CLOCK_PRESS_THRESHOLD_US, ROTARY_CLOCK_RELEASE_THRESHOLD_US, 0, 0, 0, 0, 0 },
+/* Pins of the buzzers on the Bozzard itself */
+const PROGMEM byte board_buzzer_pins[] = {
+    PIN_BUZZER_0, PIN_BUZZER_1, PIN_BUZZER_2, PIN_BUZZER_3
 };
-const int num_buttons = sizeof(buttons) / sizeof(buttons[0]);
-#define BOZ_FIRST_BUZZER_BUTTON_INDEX 0
-#define BOZ_LAST_BUZZER_BUTTON_INDEX 3
 
-int re_data_value_last_clock = LOW;
-unsigned long re_last_turn_high_ms = 0;
-unsigned long re_last_turn_low_ms = 0;
+/* The play, yellow and reset buttons, and the rotary encoder's pushbutton,
+   in the order of their bits in the debouncer, which is after the buzzers.
+   The rotary encoder's clock and data lines are handled by
+   rotary_clock_int_handler() instead. read_buttons() assumes this order. */
+const PROGMEM struct button_def qm_button_defs[] = {
+    { PIN_QM_PLAY,   FUNC_PLAY,   BUTTON_PRESS_SAMPLES, BUTTON_RELEASE_TICKS },
+    { PIN_QM_YELLOW, FUNC_YELLOW, BUTTON_PRESS_SAMPLES, BUTTON_RELEASE_TICKS },
+    { PIN_QM_RESET,  FUNC_RESET,  BUTTON_PRESS_SAMPLES, BUTTON_RELEASE_TICKS },
+    { PIN_QM_RE_KEY, FUNC_RE_KEY, BUTTON_PRESS_SAMPLES, BUTTON_RELEASE_TICKS },
+};
+const int num_buttons = BOZ_NUM_BUTTONS;
+
+#define BUTTON_BIT(INDEX) ((boz_button_mask) 1 << (INDEX))
+
+#ifdef BOZ_TRACE
+/* Yellow and reset, which held down together send the trace to the serial
+   port. The press that completes the pair isn't passed on to the app. */
+#define TRACE_DUMP_BUTTONS (BUTTON_BIT(BOZ_BUTTON_YELLOW) | BUTTON_BIT(BOZ_BUTTON_RESET))
+#endif
+
+struct debouncer debouncer;
+
+/* When we last saw each button become pressed, as a value of micros() */
+unsigned long button_pressed_since_micros[BOZ_NUM_BUTTONS];
+
+/* millis() at the last debounce tick */
+unsigned long debounce_last_tick_ms = 0;
+
+/* If the buzzers and the play, yellow and reset buttons are on D4-D10, as
+   they are on both hardware revisions, we can read them all at once from the
+   port registers. The rotary encoder's pushbutton always has to be read on
+   its own. */
+#if PIN_BUZZER_0 == 4 && PIN_BUZZER_1 == 5 && PIN_BUZZER_2 == 6 && PIN_BUZZER_3 == 7 && PIN_QM_PLAY == 8 && PIN_QM_YELLOW == 9 && PIN_QM_RESET == 10
+#define BOZ_READ_BUTTON_PORTS
+#endif
+
+/* Events seen by this pass of the main loop, in the order we'll deliver
+   them, which is the order we saw them in. Every button can be pressed in
+   one sample and the knob can be turned, but no more, so this can't fill
+   up. We take all the events before delivering any of them, so however
+   long the app takes to handle one, it doesn't hold up seeing the rest. */
+#define INPUT_EVENT_ROTARY 0xff
+#define INPUT_EVENT_QUEUE_SIZE (BOZ_NUM_BUTTONS + 1)
+struct input_event input_event_queue[INPUT_EVENT_QUEUE_SIZE];
+byte input_event_queue_length = 0;
+
+/* When the event we're delivering happened, in boz_micros(), micros() and
+   millis(), for boz_get_event_time(), boz_get_event_micros() and
+   boz_get_event_millis(). */
+boz_time event_time = 0;
+unsigned long event_us = 0;
+unsigned long event_ms = 0;
+
+/* Whether the buzz we're delivering lost arbitration, for
+   boz_arbitration_won() */
+byte event_lost = 0;
+
+/* Rotary encoder state, updated by rotary_clock_int_handler().
+   re_steps is the number of steps the knob has been turned, clockwise
+   positive, since the main loop last took them. re_step_gap_us is the time
+   between the last two steps, or ~0 if they were in different directions.
+   re_half_steps counts clock edges since the clock was last at rest. */
+volatile signed char re_steps = 0;
+volatile unsigned long re_step_gap_us = ~0UL;
+volatile unsigned long re_last_step_us = 0;
+signed char re_last_step_direction = 0;
+signed char re_half_steps = 0;
+byte re_clock_last = LOW;
+
+#ifdef BOZ_INPUT_LOG
+/* Clock edges the interrupt handler has seen, waiting for the main loop to
+   put them in the input log */
+#define RE_LOG_SIZE 8
+struct re_log_entry {
+    unsigned long us;
+    byte clock, data;
+};
+volatile struct re_log_entry re_log[RE_LOG_SIZE];
+volatile byte re_log_start = 0;
+volatile byte re_log_len = 0;
+#endif
 
 /* A pointer to dynamic memory allocated by boz_mm_main_alloc, this contains
    the stack of app_context structs. There is one for each running app. When
@@ -213,6 +351,10 @@ struct app_context *app_context_stack;
 /* pointer to current app context */
 struct app_context *app_context = NULL;
 
+/* Buzzer arbitration state and alarm for the app in the foreground */
+struct arbitration_state arbitration;
+struct app_alarm current_alarm;
+
 /* dynamic memory pool for boz_mm_* functions */
 char boz_dyn_arena[BOZ_DYN_ARENA_SIZE];
 
@@ -225,6 +367,11 @@ void *app_call_defer_init_cookie = NULL;
 void (*app_call_return)(void *, int) = NULL;
 void *app_call_return_cookie = NULL;
 
+/* If the app was called with boz_app_call_resume(), the handler to resume,
+   and the status of the last app to return to it that way. */
+void (*app_call_resume)(void *) = NULL;
+int app_call_status = 0;
+
 /* Set to 1 by boz_app_exit(). When the main loop regains control, we will
    take care of tearing down the just-exited app and passing its exit status
    to the calling app. */
@@ -235,6 +382,15 @@ int app_exit_status = 0;
 volatile byte serial_data_available = 0;
 #endif
 
+/* EEPROM locations from eeprom_erase_start up to but not including
+   eeprom_erase_pos are waiting to be erased by the main loop, which works
+   downwards from eeprom_erase_pos one byte at a time so that a global reset
+   doesn't hold up the boot. Erasing a location below the size of the header
+   means writing the header byte there, so the header is the last thing
+   written. Until a location has been erased, reads of it return 0xff. */
+unsigned int eeprom_erase_start = 0;
+unsigned int eeprom_erase_pos = 0;
+
 static void memzero(void *p, size_t n) {
     unsigned char *pc = (unsigned char *) p;
     while (n > 0) {
@@ -272,7 +428,7 @@ boz_clock_create(long initial_value_ms, int direction_forwards) {
     clocks[which_clock] = clock;
 
     master_clocks_enabled |= (1 << which_clock);
-    if (app_context)
+    if (!services_clock_created(which_clock) && app_context)
         app_context->clocks_enabled |= (1 << which_clock);
     boz_clock_init(clock, which_clock, initial_value_ms, direction_forwards);
     return clock;
@@ -288,6 +444,7 @@ boz_clock_release(boz_clock clock) {
     boz_clock_cancel_expiry_max(clock);
     if (app_context)
         app_context->clocks_enabled &= ~(1 << which_clock);
+    services_clock_released(which_clock);
     master_clocks_enabled &= ~(1 << which_clock);
     boz_mm_main_free(clock);
     clocks[which_clock] = NULL;
@@ -316,13 +473,41 @@ boz_sound_enqueue(unsigned int freq_start, unsigned int freq_end,
     cmd.duration_ms = duration_ms;
     cmd.num_times = num_times;
 
-    return queue_add(snd_cmd_queue.q,
-            sizeof(snd_cmd_queue.q) / sizeof(snd_cmd_queue.q[0]),
-            sizeof(snd_cmd_queue.q[0]), &snd_cmd_queue.qstate, &cmd);
+    if (snd_priority == BOZ_SOUND_PRIORITY_HIGH) {
+        if (snd_hi_queue.push(cmd)) {
+            BOZ_TRACE_POINT(BOZ_TRACE_SND_PUSH, 255);
+            return -1;
+        }
+        BOZ_TRACE_POINT(BOZ_TRACE_SND_PUSH, snd_hi_queue.count());
+        return 0;
+    }
+
+    if (snd_cmd_queue.push(cmd)) {
+        BOZ_TRACE_POINT(BOZ_TRACE_SND_PUSH, 255);
+        return -1;
+    }
+    BOZ_TRACE_POINT(BOZ_TRACE_SND_PUSH, snd_cmd_queue.count());
+    return 0;
+}
+
+int
+boz_sound_set_priority(int priority) {
+    int previous = snd_priority;
+
+    snd_priority = (priority == BOZ_SOUND_PRIORITY_HIGH) ? BOZ_SOUND_PRIORITY_HIGH : BOZ_SOUND_PRIORITY_NORMAL;
+    return previous;
 }
 
 void
 boz_sound_stop(void) {
+    if ((snd_priority == BOZ_SOUND_PRIORITY_HIGH) != (snd_cmd_state.high_priority != 0)) {
+        /* What's playing isn't from our queue. If it's a high-priority sound
+           which interrupted one of ours, ours won't carry on afterwards. */
+        if (snd_priority == BOZ_SOUND_PRIORITY_NORMAL)
+            snd_cmd_preempted.running = 0;
+        return;
+    }
+
     /* Stop the currently-playing sound command */
     snd_cmd_state.running = 0;
     noTone(PIN_SPEAKER);
@@ -330,10 +515,19 @@ boz_sound_stop(void) {
 
 void
 boz_sound_stop_all(void) {
+    /* At normal priority, silence everything, including high-priority
+       sounds. At high priority, stop only those, and anything they
+       interrupted carries on. */
+    if (snd_priority == BOZ_SOUND_PRIORITY_NORMAL) {
+        snd_cmd_state.high_priority = 0;
+        snd_cmd_preempted.running = 0;
+        snd_cmd_queue.clear();
+    }
+
     /* Stop the currently-playing sound command and throw away all queued
        sound commands */
     boz_sound_stop();
-    queue_clear(&snd_cmd_queue.qstate);
+    snd_hi_queue.clear();
 }
 
 #if BOZ_HW_REVISION == 0
@@ -374,78 +568,123 @@ boz_leds_set(int mask) {
 
 #endif
 
+void
+boz_leds_set_buzzers(boz_buzzer_mask buzzers) {
+    /* Fold each group of four buzzers onto the four LEDs */
+#if BOZ_NUM_BUZZERS > 8
+    buzzers |= buzzers >> 8;
+#endif
+#if BOZ_NUM_BUZZERS > 4
+    buzzers |= buzzers >> 4;
+#endif
+    boz_leds_set(buzzers & 0x0f);
+}
+
 int
 boz_display_enqueue(unsigned int cmd_word) {
     struct disp_cmd cmd;
     cmd.cmd = cmd_word;
-    return queue_add(disp_cmd_queue.q,
-            sizeof(disp_cmd_queue.q) / sizeof(disp_cmd_queue.q[0]),
-            sizeof(disp_cmd_queue.q[0]), &disp_cmd_queue.qstate, &cmd);
+    if (disp_txn_depth) {
+        if (disp_cmd_queue.stage(disp_txn_staged, cmd))
+            return -1;
+        disp_txn_staged++;
+        return 0;
+    }
+    if (disp_cmd_queue.push(cmd)) {
+        BOZ_TRACE_POINT(BOZ_TRACE_DISP_PUSH, 255);
+        return -1;
+    }
+    BOZ_TRACE_POINT(BOZ_TRACE_DISP_PUSH, disp_cmd_queue.count());
+    return 0;
 }
 
-void
-boz_set_event_cookie(void *cookie) {
-    app_context->event_cookie = cookie;
+int
+boz_display_queue_space(void) {
+    return disp_cmd_queue.space() - disp_txn_staged;
 }
 
-void
-boz_set_event_handler_buzz(void (*handler)(void *, int)) {
-    app_context->event_buzz = handler;
+int
+boz_display_reserve(int num_commands) {
+    if (num_commands < 0)
+        return -1;
+    if (num_commands > boz_display_queue_space()) {
+        if (num_commands > DISP_CMD_QUEUE_SIZE)
+            num_commands = DISP_CMD_QUEUE_SIZE;
+        disp_space_wanted = (byte) num_commands;
+        return -1;
+    }
+    disp_txn_depth++;
+    disp_space_wanted = 1;
+    return 0;
 }
 
-void
-boz_set_event_handler_qm_play(void (*handler)(void *)) {
-    app_context->event_qm_play = handler;
+int
+boz_display_commit(void) {
+    if (disp_txn_depth == 0)
+        return -1;
+    if (--disp_txn_depth == 0) {
+        disp_cmd_queue.publish(disp_txn_staged);
+        disp_txn_staged = 0;
+        BOZ_TRACE_POINT(BOZ_TRACE_DISP_PUSH, disp_cmd_queue.count());
+    }
+    return 0;
 }
 
-void
-boz_set_event_handler_qm_yellow(void (*handler)(void *)) {
-    app_context->event_qm_yellow = handler;
+/* Forget any open reservation and whatever was staged in it */
+static void display_txn_reset(void) {
+    disp_txn_depth = 0;
+    disp_txn_staged = 0;
+    disp_space_wanted = 1;
 }
 
 void
-boz_set_event_handler_qm_reset(void (*handler)(void *)) {
-    app_context->event_qm_reset = handler;
+boz_set_event_cookie(void *cookie) {
+    app_context->event_cookie = cookie;
 }
 
 void
-boz_set_event_handler_qm_rotary(void (*handler)(void *, int)) {
-    app_context->event_qm_rotary = handler;
+boz_set_event_handlers(const struct boz_event_handlers *handlers) {
+    app_context->event_handlers = handlers;
+    app_context->event_mask = BOZ_EVENT_ALL &
+        ~(BOZ_EVENT_SOUND_QUEUE_NOT_FULL | BOZ_EVENT_DISPLAY_QUEUE_SPACE);
 }
 
 void
-boz_set_event_handler_qm_rotary_press(void (*handler)(void *)) {
-    app_context->event_qm_rotary_press = handler;
+boz_enable_events(unsigned int events) {
+    app_context->event_mask |= events;
 }
 
 void
-boz_set_event_handler_sound_queue_not_full(void (*handler)(void *)) {
-    app_context->event_sound_queue_not_full = handler;
+boz_disable_events(unsigned int events) {
+    app_context->event_mask &= ~events;
 }
 
-#ifdef BOZ_SERIAL
 void
-boz_set_event_handler_serial_data_available(void (*handler)(void *)) {
-    app_context->event_serial_data_available = handler;
+boz_set_rotary_acceleration(byte enable) {
+    app_context->rotary_acceleration = enable;
 }
-#endif
 
 void
 boz_set_alarm(long ms_from_now, void (*handler)(void *), void *cookie) {
+    /* The alarm is the app's, and a service mustn't take it over */
+    if (app_context == NULL || services_running())
+        return;
     if (ms_from_now >= 0) {
-        app_context->alarm_time_millis = millis() + ms_from_now;
-        app_context->alarm_handler = handler;
-        app_context->alarm_handler_cookie = cookie;
+        current_alarm.time = boz_micros() + (boz_time) ms_from_now * 1000;
+        current_alarm.handler = handler;
+        current_alarm.cookie = cookie;
     }
     else {
         /* Nope */
-        app_context->alarm_handler = NULL;
+        current_alarm.handler = NULL;
     }
 }
 
 void
 boz_cancel_alarm() {
-    app_context->alarm_handler = NULL;
+    if (app_context == NULL || services_running())
+        return;
+    current_alarm.handler = NULL;
 }
 
 int
@@ -459,13 +698,44 @@ boz_app_call(int app_id, void *param, void (*return_callback)(void *, int), void
         // no such app
         return -1;
     }
+
+    /* The called app starts without an alarm or an arbitration policy, so
+       make room to put ours aside until it exits */
+    if (app_context != NULL && (current_alarm.handler || arbitration.active) &&
+            app_context->suspended == NULL) {
+        app_context->suspended = (struct app_suspended *) boz_mm_alloc(sizeof(struct app_suspended));
+        if (app_context->suspended == NULL)
+            return -1;
+    }
     app_call_defer = &app_to_call_data;
     app_call_defer_init_cookie = param;
     app_call_return = return_callback;
     app_call_return_cookie = return_callback_cookie;
+    app_call_resume = NULL;
     return 0;
 }
 
+/* The return callback for boz_app_call_resume() */
+static void resume_after_app_call(void *cookie, int status) {
+    app_call_status = status;
+    app_context->app_call_resume(cookie);
+}
+
+int
+boz_app_call_resume(int app_id, void *param, void (*resume)(void *), void *cookie) {
+    if (boz_app_call(app_id, param, resume_after_app_call, cookie)) {
+        app_call_status = -1;
+        return -1;
+    }
+    app_call_resume = resume;
+    return 0;
+}
+
+int
+boz_app_call_status(void) {
+    return app_call_status;
+}
+
 void
 boz_app_exit(int exit_status) {
     app_exited = 1;
@@ -508,31 +778,190 @@ boz_crash(unsigned int pattern) {
 
 int
 boz_is_button_pressed(int button_func, int buzzer_id, unsigned long *pressed_since_micros_r) {
-    for (int i = 0; i < num_buttons; ++i) {
-        struct button_state *button = &buttons[i];
-        if (button->button_function == button_func && (button_func != FUNC_BUZZER || buzzer_id == button->buzzer_id)) {
-            if (button->is_pressed && button->event_delivered) {
-                /* Button is pressed and event has already been delivered */
-                if (pressed_since_micros_r) {
-                    *pressed_since_micros_r = button->pressed_since_micros;
-                }
-                return 1;
-            }
-            break;
+    int i;
+
+    if (button_func == FUNC_BUZZER) {
+        if (buzzer_id < 0 || buzzer_id >= BOZ_NUM_BUZZERS)
+            return 0;
+        i = buzzer_id;
+    }
+    else {
+        for (i = BOZ_NUM_BUZZERS; i < num_buttons; ++i) {
+            if (pgm_read_byte(&qm_button_defs[i - BOZ_NUM_BUZZERS].button_function) == button_func)
+                break;
         }
+        if (i >= num_buttons)
+            return 0;
+    }
+
+    if (debouncer.state & BUTTON_BIT(i)) {
+        /* Button is pressed and event has already been delivered */
+        if (pressed_since_micros_r) {
+            *pressed_since_micros_r = button_pressed_since_micros[i];
+        }
+        return 1;
     }
     return 0;
 }
 
+boz_buzzer_mask
+boz_buzzers_pressed(void) {
+    return (boz_buzzer_mask) (debouncer.state & BOZ_ALL_BUZZERS);
+}
+
+/* The buzzers on the same side as "buzzer" under the app's policy */
+static boz_buzzer_mask arbitration_side(byte buzzer) {
+    const struct boz_arbitration *policy = &arbitration.policy;
+    boz_buzzer_mask bit = BOZ_BUZZER_BIT(buzzer);
+
+    if (!(policy->flags & BOZ_ARB_TWO_SIDES))
+        return bit;
+    else if (policy->left_side & bit)
+        return policy->left_side;
+    else
+        return (boz_buzzer_mask) (BOZ_ALL_BUZZERS & ~policy->left_side);
+}
+
+/* Decide whether a buzz from "buzzer", pressed at boz_micros() time "now",
+   wins under the app's policy. If it does, do what the policy says to do
+   when someone wins, lighting the LED first because that's what the players
+   are watching. Return 1 if it won, 0 if it lost. */
+static byte arbitrate(byte buzzer, boz_time now) {
+    const struct boz_arbitration *policy = &arbitration.policy;
+    boz_buzzer_mask bit = BOZ_BUZZER_BIT(buzzer);
+
+    if (!arbitration.active)
+        return 1;
+    if (!(bit & policy->enabled & ~arbitration.locked & ~arbitration.spent))
+        return 0;
+
+    if (policy->light_on_buzz & bit)
+        boz_leds_set_buzzers(bit);
+    if (policy->flags & BOZ_ARB_ONE_PER_SIDE)
+        arbitration.spent |= arbitration_side(buzzer);
+    if (policy->lock_on_buzz & bit) {
+        arbitration.locked = BOZ_ALL_BUZZERS;
+        arbitration.unlock_time = now + policy->unlock_ms * 1000UL;
+    }
+    return 1;
+}
+
+/* Return 1 if the buzzers are locked out and the policy says when to unlock
+   them, which is arbitration.unlock_time. */
+static byte arbitration_unlock_pending(void) {
+    return arbitration.locked && arbitration.policy.unlock_ms;
+}
+
+void
+boz_arbitration_set(const struct boz_arbitration *policy) {
+    if (policy)
+        arbitration.policy = *policy;
+    arbitration.active = (policy != NULL);
+}
+
+void
+boz_arbitration_enable(boz_buzzer_mask enabled) {
+    arbitration.policy.enabled = enabled;
+}
+
+void
+boz_arbitration_unlock(void) {
+    if (arbitration.locked && (arbitration.policy.flags & BOZ_ARB_UNLOCK_LEDS_OFF))
+        boz_leds_set(0);
+    arbitration.locked = 0;
+}
+
+void
+boz_arbitration_reset(void) {
+    boz_arbitration_unlock();
+    arbitration.spent = 0;
+}
+
+boz_buzzer_mask
+boz_arbitration_locked(void) {
+    return arbitration.locked;
+}
+
+void
+boz_arbitration_set_locked(boz_buzzer_mask buzzers) {
+    arbitration.locked = buzzers & BOZ_ALL_BUZZERS;
+    arbitration.unlock_time = boz_micros() + arbitration.policy.unlock_ms * 1000UL;
+}
+
 int
-boz_get_battery_voltage(void) {
-    /* analogRead() gives us a value between 0 and 1023, which represents a
-       voltage between 0 and 5V. The voltage on this pin is in the middle of a
-       potential divider between VIN and GND, so it's half the voltage at VIN.
-       So if the analogue value on the pin is 0, the voltage is 0V, and if it's
-       1023, it's 10V. We return the answer in millivolts. */
-    int value = analogRead(A6);
-    return (int) ((10000L * value) / 1023L);
+boz_arbitration_claim(int buzzer) {
+    if (buzzer < 0 || buzzer >= BOZ_NUM_BUZZERS)
+        return 0;
+    return arbitrate((byte) buzzer, boz_micros());
+}
+
+int
+boz_arbitration_won(void) {
+    return !event_lost;
+}
+
+static byte eeprom_erased_value(unsigned int pos) {
+    if (pos < sizeof(boz_eeprom_header))
+        return pgm_read_byte_near(((byte *) &boz_eeprom_header) + pos);
+    else
+        return 0xff;
+}
+
+static byte eeprom_erase_pending(unsigned int pos) {
+    return pos >= eeprom_erase_start && pos < eeprom_erase_pos;
+}
+
+/* Erase one EEPROM location from the pending range, if the EEPROM isn't
+   still busy with the last write. Locations which already hold the right
+   value cost only a read, so we skip over as many of those as we like. */
+static void eeprom_erase_step(void) {
+    while (eeprom_erase_pos > eeprom_erase_start && eeprom_is_ready()) {
+        --eeprom_erase_pos;
+        byte value = eeprom_erased_value(eeprom_erase_pos);
+        if (EEPROM.read(eeprom_erase_pos) != value) {
+            EEPROM.write(eeprom_erase_pos, value);
+            break;
+        }
+    }
+}
+
+/* We're about to write length locations from pos. If any of them are still
+   waiting to be erased, finish the erase down to pos now, or the main loop
+   would later erase what we wrote. Locations which already hold the right
+   value cost only a read, so this is usually quick, but after a global
+   reset it can take a few seconds. */
+static void eeprom_erase_before_write(unsigned int pos, unsigned int length) {
+    if (pos >= eeprom_erase_pos || pos + length <= eeprom_erase_start)
+        return;
+    if (pos < eeprom_erase_start)
+        pos = eeprom_erase_start;
+    while (eeprom_erase_pos > pos) {
+#ifdef BOZ_WATCHDOG
+        wdt_reset();
+#endif
+        --eeprom_erase_pos;
+        EEPROM.update(eeprom_erase_pos, eeprom_erased_value(eeprom_erase_pos));
+    }
+}
+
+/* Compare the version stamped on the current app's EEPROM region with the
+   version the app expects, if we haven't already done so. */
+static void check_eeprom_region_version(void) {
+    byte stamped;
+
+    if (app_context->eeprom_state != BOZ_EEPROM_REGION_UNCHECKED)
+        return;
+
+    stamped = boz_eeprom_get_region_version();
+    if (stamped == BOZ_EEPROM_VERSION_NONE || stamped == app_context->eeprom_version) {
+        app_context->eeprom_state = BOZ_EEPROM_REGION_VALID;
+    }
+    else {
+        /* Written by an older (or newer) version of this app, which the app
+           hasn't offered to migrate. As far as the app is concerned, its
+           region is blank until it writes something. */
+        app_context->eeprom_state = BOZ_EEPROM_REGION_STALE;
+    }
 }
 
 unsigned int
@@ -546,11 +975,33 @@ boz_eeprom_get_region_size() {
     }
 }
 
+int
+boz_eeprom_get_region_version() {
+    unsigned int pos;
+    byte version;
+
+    if (app_context == NULL || app_context->eeprom_length == 0 ||
+            app_context->app_id >= BOZ_EEPROM_VERSION_TABLE_SIZE)
+        return BOZ_EEPROM_VERSION_NONE;
+
+    pos = BOZ_EEPROM_VERSION_TABLE + app_context->app_id;
+    if (eeprom_erase_pending(pos))
+        version = BOZ_EEPROM_VERSION_NONE;
+    else
+        version = EEPROM.read(pos);
+
+    /* The app has now seen the version, so it's responsible for deciding
+       whether it can understand the data. */
+    app_context->eeprom_state = BOZ_EEPROM_REGION_VALID;
+    return version;
+}
+
 static int check_eeprom_pos(unsigned int app_offset, unsigned int length) {
     if (app_context == NULL)
         return -1;
     if (app_offset + length > app_context->eeprom_length)
         return -1;
+    check_eeprom_region_version();
     return 0;
 }
 
@@ -562,9 +1013,39 @@ boz_eeprom_write(unsigned int app_offset, const void *datav, unsigned int length
     if (check_eeprom_pos(app_offset, length))
         return -1;
 
+    if (app_context->eeprom_state == BOZ_EEPROM_REGION_STALE) {
+        /* Get rid of the old data before writing any new data, so the
+           region contains only data in the current format. Regions are
+           small, so this takes at most a few hundred milliseconds. The
+           version stamp is left alone until we've finished, so if we lose
+           power halfway through, the region is still stale on the next
+           boot. */
+        eeprom_erase_before_write(app_context->eeprom_start, app_context->eeprom_length);
+        for (unsigned int pos = app_context->eeprom_start;
+                pos < app_context->eeprom_start + app_context->eeprom_length; ++pos) {
+#ifdef BOZ_WATCHDOG
+            wdt_reset();
+#endif
+            EEPROM.update(pos, 0xff);
+        }
+        app_context->eeprom_state = BOZ_EEPROM_REGION_VALID;
+    }
+
+    if (app_context->app_id < BOZ_EEPROM_VERSION_TABLE_SIZE) {
+        eeprom_erase_before_write(BOZ_EEPROM_VERSION_TABLE + app_context->app_id, 1);
+        EEPROM.update(BOZ_EEPROM_VERSION_TABLE + app_context->app_id,
+                app_context->eeprom_version);
+    }
+
     eeprom_pos = (int) (app_context->eeprom_start + app_offset);
+    eeprom_erase_before_write((unsigned int) eeprom_pos, length);
 
     for (unsigned int i = 0; i < length; ++i) {
+        /* Each location can take 3.3ms, so a long write would otherwise
+           look to the watchdog like a stuck loop */
+#ifdef BOZ_WATCHDOG
+        wdt_reset();
+#endif
         EEPROM.update(eeprom_pos, *data);
         ++eeprom_pos;
         ++data;
@@ -575,15 +1056,19 @@ boz_eeprom_write(unsigned int app_offset, const void *datav, unsigned int length
 
 int
 boz_eeprom_read(unsigned int app_offset, void *destv, unsigned int length) {
-    int eeprom_pos;
+    unsigned int eeprom_pos;
     byte *dest = (byte *) destv;
 
     if (check_eeprom_pos(app_offset, length))
         return -1;
 
-    eeprom_pos = (int) (app_context->eeprom_start + app_offset);
+    eeprom_pos = app_context->eeprom_start + app_offset;
     for (unsigned int i = 0; i < length; ++i) {
-        *dest = EEPROM.read(eeprom_pos);
+        if (app_context->eeprom_state == BOZ_EEPROM_REGION_STALE ||
+                eeprom_erase_pending(eeprom_pos))
+            *dest = 0xff;
+        else
+            *dest = EEPROM.read(eeprom_pos);
         ++eeprom_pos;
         ++dest;
     }
@@ -593,17 +1078,21 @@ boz_eeprom_read(unsigned int app_offset, void *destv, unsigned int length) {
 
 int
 boz_eeprom_global_reset() {
-    int eeprom_length = EEPROM.length();
-    for (int i = 0; i < eeprom_length; ++i) {
-        /* Put our magic identifier header at the start of the EEPROM, and
-           fill the rest of it with 0xff. */
-        if (i < (int) sizeof(boz_eeprom_header)) {
-            EEPROM.update(i, pgm_read_byte_near(((byte *) &boz_eeprom_header) + i));
-        }
-        else {
-            EEPROM.update(i, 0xff);
-        }
-    }
+    /* Spoil the header first, so that if we lose power before the main loop
+       has finished the job, we'll start again on the next boot. */
+    EEPROM.update(0, 0xff);
+
+    eeprom_erase_start = 0;
+#ifdef BOZ_INPUT_LOG_EEPROM
+    /* Leave the input log alone - it's still being written to */
+    eeprom_erase_pos = BOZ_INPUT_LOG_EEPROM_START;
+#else
+    eeprom_erase_pos = EEPROM.length();
+#endif
+
+    /* Any app that has already looked at its region needs to look again */
+    if (app_context)
+        app_context->eeprom_state = BOZ_EEPROM_REGION_UNCHECKED;
     return 0;
 }
 
@@ -614,8 +1103,10 @@ app_context_tear_down(struct app_context *ac) {
             boz_clock_release(clocks[i]);
         }
     }
+    snd_priority = BOZ_SOUND_PRIORITY_NORMAL;
     boz_sound_stop_all();
-    queue_clear(&disp_cmd_queue.qstate);
+    disp_cmd_queue.clear();
+    display_txn_reset();
 }
 
 void
@@ -626,10 +1117,17 @@ app_context_init(struct app_context *ac) {
 void
 boz_env_reset() {
     memzero(&snd_cmd_queue, sizeof(snd_cmd_queue));
+    memzero(&snd_hi_queue, sizeof(snd_hi_queue));
+    memzero(&snd_cmd_preempted, sizeof(snd_cmd_preempted));
+    snd_priority = BOZ_SOUND_PRIORITY_NORMAL;
     memzero(&disp_cmd_queue, sizeof(disp_cmd_queue));
     memzero(&snd_cmd_state, sizeof(snd_cmd_state));
     memzero(&disp_cmd_state, sizeof(disp_cmd_state));
+    display_txn_reset();
+    services_reset();
     memzero(&app_context, sizeof(app_context));
+    memzero(&arbitration, sizeof(arbitration));
+    memzero(&current_alarm, sizeof(current_alarm));
     master_clocks_enabled = 0;
 
     noTone(PIN_SPEAKER);
@@ -637,15 +1135,13 @@ boz_env_reset() {
 #if BOZ_HW_REVISION == 0
     boz_shift_reg_init();
 #endif
-
-    boz_lcd_clear();
-
-    boz_lcd_reset_cgram_patterns();
 }
 
 static void snd_cmd_step(unsigned long now_ms) {
     const int step_ms = 20;
-    
+
+    BOZ_TRACE_POINT(BOZ_TRACE_SND_STEP, snd_cmd_state.times_done);
+
     /* If the duration is zero, then if the frequency is set, switch on the
        tone and run away. If the frequency is zero, switch off the tone and
        run away. */
@@ -754,8 +1250,69 @@ static void snd_cmd_step(unsigned long now_ms) {
     }
 }
 
+/* Start the sound command in snd_cmd_state.cmd */
+static void snd_cmd_start(unsigned long now_ms, byte high_priority) {
+    snd_cmd_state.running = 1;
+    snd_cmd_state.high_priority = high_priority;
+    snd_cmd_state.start_millis = now_ms;
+    snd_cmd_state.next_step_millis = now_ms;
+    snd_cmd_state.current_freq = 0;
+    snd_cmd_state.times_done = 0;
+    snd_cmd_state.arp_index = 0;
+    snd_cmd_step(now_ms);
+}
+
+/* Carry on with the sound command a high-priority sound interrupted, from
+   where it was interrupted, as if it had been paused for the meantime */
+static void snd_cmd_resume(unsigned long now_ms) {
+    unsigned long paused_ms = now_ms - snd_preempted_millis;
+    long note_left_ms = (long) (snd_cmd_preempted.next_step_millis - snd_preempted_millis);
+
+    snd_cmd_state = snd_cmd_preempted;
+    snd_cmd_preempted.running = 0;
+    snd_cmd_state.start_millis += paused_ms;
+    snd_cmd_state.next_step_millis += paused_ms;
+
+    /* Finish the note, or the step of a varying sound, it was in the middle
+       of. Its next step is then when it would have been. */
+    if (snd_cmd_state.current_freq > 0 && note_left_ms > 0)
+        tone(PIN_SPEAKER, snd_cmd_state.current_freq, note_left_ms);
+}
+
 static void disp_cmd_step(unsigned long now_us) {
+    if (disp_cmd_state.cmd.cmd == BOZ_LCD_INIT) {
+        /* Take the display through the next step of its initialisation */
+        unsigned int wait_us = boz_lcd_init_step(disp_cmd_state.state++);
+        if (wait_us)
+            disp_cmd_state.next_step_micros = now_us + wait_us;
+        else
+            disp_cmd_state.running = 0;
+        return;
+    }
+
+    if ((disp_cmd_state.cmd.cmd & 0xff00) == BOZ_LCD_RESET_CGRAM) {
+        /* This is a lot of commands, so send one per step, and let loop()
+           get on with other things in between. Skip the characters which
+           are already what they should be. */
+        byte mask = (byte) disp_cmd_state.cmd.cmd;
+        if (disp_cmd_state.state == 0)
+            BOZ_TRACE_POINT(BOZ_TRACE_DISP_STEP, disp_cmd_queue.count());
+        while (disp_cmd_state.state < BOZ_LCD_RESET_CGRAM_LENGTH &&
+                !(mask & (1 << (disp_cmd_state.state / 9))))
+            disp_cmd_state.state += 9;
+        if (disp_cmd_state.state < BOZ_LCD_RESET_CGRAM_LENGTH) {
+            boz_lcd_send(boz_lcd_reset_cgram_cmd(disp_cmd_state.state++));
+            disp_cmd_state.next_step_micros = now_us + 70;
+        }
+        else {
+            disp_cmd_state.running = 0;
+        }
+        return;
+    }
+
     if (disp_cmd_state.state == 0) {
+        BOZ_TRACE_POINT(BOZ_TRACE_DISP_STEP, disp_cmd_queue.count());
+
         /* Send this command byte to the display */
         boz_lcd_send(disp_cmd_state.cmd.cmd);
 
@@ -780,41 +1337,99 @@ static void disp_cmd_step(unsigned long now_us) {
     }
 }
 
-static void deliver_button_event(struct button_state *button) {
-    switch (button->button_function) {
-        case FUNC_BUZZER:
-            if (app_context->event_buzz) {
-                app_context->event_buzz(app_context->event_cookie, button->buzzer_id);
-            }
-            break;
+#define EVENT_INDEX_QM_ROTARY 5
+#define EVENT_INDEX_QM_ROTARY_STEPS 6
+#define EVENT_INDEX_SOUND_QUEUE_NOT_FULL 7
+#define EVENT_INDEX_SERIAL_DATA_AVAILABLE 8
+#define EVENT_INDEX_DISPLAY_QUEUE_SPACE 9
+#define EVENT_INDEX_BUZZERS_UNLOCKED 10
 
-        case FUNC_PLAY:
-            if (app_context->event_qm_play)
-                app_context->event_qm_play(app_context->event_cookie);
-            break;
+/* Return the current app's handler for event number "index", or NULL if it
+   has none or has disabled it. */
+static boz_event_handler_fn event_handler(byte index) {
+    const boz_event_handler_fn *table = (const boz_event_handler_fn *) app_context->event_handlers;
 
-        case FUNC_YELLOW:
-            if (app_context->event_qm_yellow)
-                app_context->event_qm_yellow(app_context->event_cookie);
-            break;
+    if (table == NULL || !(app_context->event_mask & (1 << index)))
+        return NULL;
+    return (boz_event_handler_fn) pgm_read_ptr(&table[index]);
+}
 
-        case FUNC_RESET:
-            if (app_context->event_qm_reset)
-                app_context->event_qm_reset(app_context->event_cookie);
-            break;
+/* Check the clocks in the bitmask clocks_enabled for alarms, and for
+   reaching their minimum or maximum, and call the handlers. */
+static void check_clock_events(unsigned short clocks_enabled) {
+    for (byte clock_index = 0; clock_index < NUM_CLOCKS; ++clock_index) {
+        if (clocks_enabled & (1 << clock_index)) {
+            boz_clock clock = clocks[clock_index];
+            long value = boz_clock_value(clock);
+
+            if (clock->alarm_enabled) {
+                if (time_passed_aux(value, clock->alarm_ms, clock->direction)) {
+                    BOZ_TRACE_POINT(BOZ_TRACE_CLOCK_ALARM, clock_index);
+                    boz_clock_cancel_alarm(clock);
+                    if (clock->event_alarm) {
+                        clock->event_alarm(clock->event_cookie, clock);
+                    }
+                }
+            }
 
-        case FUNC_RE_KEY:
-            if (app_context->event_qm_rotary_press)
-                app_context->event_qm_rotary_press(app_context->event_cookie);
-            break;
+            if (boz_clock_running(clock)) {
+                if (clock->min_enabled) {
+                    if (value <= clock->min_ms) {
+                        void (*handler)(void *, boz_clock) = clock->event_expiry_min;
+
+                        BOZ_TRACE_POINT(BOZ_TRACE_CLOCK_EXPIRY, clock_index);
+                        /* Stop it when it got there, not now, so if
+                           the app starts another clock from then,
+                           nothing is lost. */
+                        boz_clock_stop_at(clock, boz_clock_time_at_value(clock, clock->min_ms));
+                        //boz_clock_cancel_expiry_min(clock);
+                        if (handler) {
+                            clock->event_expiry_min = NULL;
+                            handler(clock->event_cookie, clock);
+                        }
+                    }
+                }
+
+                if (clock->max_enabled) {
+                    if (value >= clock->max_ms) {
+                        void (*handler)(void *, boz_clock) = clock->event_expiry_max;
+                        BOZ_TRACE_POINT(BOZ_TRACE_CLOCK_EXPIRY, clock_index | 0x80);
+                        //boz_clock_cancel_expiry_max(clock);
+                        boz_clock_stop_at(clock, boz_clock_time_at_value(clock, clock->max_ms));
+                        if (handler) {
+                            clock->event_expiry_max = NULL;
+                            handler(clock->event_cookie, clock);
+                        }
+                    }
+                }
+            }
+        }
     }
-    button->event_delivered = 1;
+}
+
+static void deliver_button_event(byte button_index) {
+    byte function;
+    boz_event_handler_fn handler;
+
+    if (button_index < BOZ_NUM_BUZZERS)
+        function = FUNC_BUZZER;
+    else
+        function = pgm_read_byte(&qm_button_defs[button_index - BOZ_NUM_BUZZERS].button_function);
+    handler = event_handler(function);
+
+    BOZ_TRACE_POINT(BOZ_TRACE_BUTTON, button_index);
+    if (handler == NULL)
+        return;
+    if (function == FUNC_BUZZER)
+        ((void (*)(void *, int)) handler)(app_context->event_cookie, button_index);
+    else
+        ((void (*)(void *)) handler)(app_context->event_cookie);
 }
 
 /* If *next_wake_set is zero, or if *next_wake is after t, then set
    *next_wake_set to 1 and set *next_wake to t. */
-static void update_if_passed(byte *next_wake_set, unsigned long *next_wake, unsigned long t) {
-    if (!*next_wake_set || time_passed(*next_wake, t)) {
+static void update_if_passed(byte *next_wake_set, boz_time *next_wake, boz_time t) {
+    if (!*next_wake_set || *next_wake > t) {
         *next_wake_set = 1;
         *next_wake = t;
     }
@@ -829,11 +1444,156 @@ button_int_handler(void) {
     detachInterrupt(digitalPinToInterrupt(PIN_BUTTON_INT));
 }
 
+/* Called on every edge of the rotary encoder's clock line, asleep or awake.
+   The clock rests LOW between steps. Just after a clock edge, the data line
+   is at the opposite level to the clock if the knob is turning clockwise,
+   and the same level if it's turning anticlockwise, so each edge is half a
+   step one way or the other. We count a step when the clock comes back to
+   rest having gone two half-steps the same way. A bounce on either edge
+   adds a half-step one way and then takes it away again, so it cancels
+   out. */
 void
 rotary_clock_int_handler(void) {
-    boz_wake = 1;
-    sleep_disable();
-    detachInterrupt(digitalPinToInterrupt(PIN_QM_RE_CLOCK));
+    byte clock = digitalRead(PIN_QM_RE_CLOCK);
+    byte data = digitalRead(PIN_QM_RE_DATA);
+    unsigned long us = micros();
+
+    /* If we missed a pair of edges, we've nothing to go on */
+    if (clock == re_clock_last)
+        return;
+    re_clock_last = clock;
+
+#ifdef BOZ_INPUT_LOG
+    if (re_log_len < RE_LOG_SIZE) {
+        volatile struct re_log_entry *e = &re_log[(re_log_start + re_log_len) % RE_LOG_SIZE];
+        e->us = us;
+        e->clock = clock;
+        e->data = data;
+        re_log_len++;
+    }
+#endif
+
+    re_half_steps += (clock != data) ? 1 : -1;
+    if (clock == LOW) {
+        if (re_half_steps >= 2 || re_half_steps <= -2) {
+            signed char direction = (re_half_steps > 0) ? 1 : -1;
+
+            if (direction == re_last_step_direction)
+                re_step_gap_us = time_elapsed(re_last_step_us, us);
+            else
+                re_step_gap_us = ~0UL;
+            re_last_step_us = us;
+            re_last_step_direction = direction;
+            if (re_steps + direction >= -127 && re_steps + direction <= 127)
+                re_steps += direction;
+            boz_wake = 1;
+            sleep_disable();
+        }
+        re_half_steps = 0;
+    }
+}
+
+/* Add an event to input_event_queue, after any events we saw at the same
+   time or earlier. */
+static void input_event_add(byte source, unsigned long us, signed char steps, byte multiplier) {
+    byte pos = input_event_queue_length;
+
+    if (pos >= INPUT_EVENT_QUEUE_SIZE)
+        return;
+    while (pos > 0 && (long) (us - input_event_queue[pos - 1].us) < 0) {
+        input_event_queue[pos] = input_event_queue[pos - 1];
+        --pos;
+    }
+    input_event_queue[pos].us = us;
+    input_event_queue[pos].source = source;
+    input_event_queue[pos].steps = steps;
+    input_event_queue[pos].multiplier = multiplier;
+    input_event_queue_length++;
+}
+
+/* Take the steps the rotary knob has been turned since last time, if any,
+   and queue them as one event, so the app only has to redraw once. */
+static void take_rotary_steps(void) {
+    signed char steps;
+    unsigned long gap_us, step_us;
+    byte multiplier = 0;
+
+    noInterrupts();
+    steps = re_steps;
+    gap_us = re_step_gap_us;
+    step_us = re_last_step_us;
+    re_steps = 0;
+    interrupts();
+
+    if (steps == 0)
+        return;
+
+    if (gap_us < ROTARY_FAST_GAP_US)
+        multiplier = ROTARY_FAST_MULTIPLIER;
+    else if (gap_us < ROTARY_MEDIUM_GAP_US)
+        multiplier = ROTARY_MEDIUM_MULTIPLIER;
+    input_event_add(INPUT_EVENT_ROTARY, step_us, steps, multiplier);
+}
+
+/* Deliver a rotary knob event to the app's rotary event handler */
+static void deliver_rotary_event(const struct input_event *e) {
+    int steps = e->steps;
+    boz_event_handler_fn handler;
+
+    handler = event_handler(EVENT_INDEX_QM_ROTARY_STEPS);
+    if (handler) {
+        if (app_context->rotary_acceleration && e->multiplier)
+            steps *= e->multiplier;
+        ((void (*)(void *, int)) handler)(app_context->event_cookie, steps);
+        return;
+    }
+
+    /* Old-style handler which wants to know about each step. It might
+       disable itself part of the way through. */
+    for (; steps != 0 && (handler = event_handler(EVENT_INDEX_QM_ROTARY)) != NULL;
+            steps += (steps > 0 ? -1 : 1)) {
+        ((void (*)(void *, int)) handler)(app_context->event_cookie, steps > 0);
+    }
+}
+
+boz_time
+boz_get_event_time(void) {
+    return event_time;
+}
+
+unsigned long
+boz_get_event_micros(void) {
+    return event_us;
+}
+
+unsigned long
+boz_get_event_millis(void) {
+    return event_ms;
+}
+
+/* Deliver everything in input_event_queue to the app, in order */
+static void deliver_input_events(void) {
+    boz_time now = boz_micros();
+    unsigned long now_us = (unsigned long) now;
+    unsigned long now_ms = millis();
+
+    for (byte i = 0; i < input_event_queue_length; ++i) {
+        const struct input_event *e = &input_event_queue[i];
+
+        /* millis() isn't exactly micros() / 1000, so work out what millis()
+           was when this happened from how long ago it was, and likewise
+           boz_micros(), in case micros() wrapped round since */
+        event_time = now - (now_us - e->us);
+        event_us = e->us;
+        event_ms = now_ms - (now_us - e->us) / 1000;
+        event_lost = (e->source < BOZ_NUM_BUZZERS && e->multiplier);
+
+        if (e->source == INPUT_EVENT_ROTARY)
+            deliver_rotary_event(e);
+        else
+            deliver_button_event(e->source);
+    }
+    input_event_queue_length = 0;
 }
 
 ISR(TIMER1_OVF_vect) {
@@ -862,13 +1622,119 @@ byte read_turny_push_button(void) {
 #endif
 }
 
-static byte read_button_value(int pin) {
-    if (pin == PIN_QM_RE_KEY)
-        return read_turny_push_button();
-    else
-        return digitalRead(pin);
+/* Sample all the buttons, and return a bitmask of which ones are held down,
+   in the debouncer's order. */
+static boz_button_mask read_buttons(void) {
+    boz_button_mask raw = 0;
+#ifdef BOZ_READ_BUTTON_PORTS
+    /* Buzzers are D4-D7, and play, yellow and reset are D8-D10, which are
+       bits 0-2 of port B. All of them are active low. */
+    raw = ((~PIND >> 4) & ((1 << BOZ_NUM_BOARD_BUZZERS) - 1)) |
+        ((boz_button_mask) (~PINB & 0x07) << BOZ_BUTTON_PLAY);
+#else
+    for (int i = 0; i < BOZ_NUM_BOARD_BUZZERS; ++i) {
+        if (digitalRead(pgm_read_byte(&board_buzzer_pins[i])) == LOW)
+            raw |= BUTTON_BIT(i);
+    }
+    for (int i = BOZ_BUTTON_PLAY; i < BOZ_BUTTON_RE_KEY; ++i) {
+        if (digitalRead(pgm_read_byte(&qm_button_defs[i - BOZ_NUM_BUZZERS].pin)) == LOW)
+            raw |= BUTTON_BIT(i);
+    }
+#endif
+#if BOZ_NUM_BUZZERS > BOZ_NUM_BOARD_BUZZERS
+    raw |= input_sources_read();
+#endif
+    if (read_turny_push_button() == LOW)
+        raw |= BUTTON_BIT(BOZ_BUTTON_RE_KEY);
+    return raw;
 }
 
+/* Set up the debouncer's thresholds, with every button released. */
+static void debounce_init(void) {
+    memset(&debouncer, 0, sizeof(debouncer));
+    for (int i = 0; i < num_buttons; ++i) {
+        byte press_limit = BUTTON_PRESS_SAMPLES - 1;
+        byte release_limit = BUTTON_RELEASE_TICKS - 1;
+        boz_button_mask bit = BUTTON_BIT(i);
+
+        if (i >= BOZ_NUM_BUZZERS) {
+            press_limit = pgm_read_byte(&qm_button_defs[i - BOZ_NUM_BUZZERS].press_samples) - 1;
+            release_limit = pgm_read_byte(&qm_button_defs[i - BOZ_NUM_BUZZERS].release_ticks) - 1;
+        }
+
+        if (press_limit & 1)
+            debouncer.press_limit0 |= bit;
+        if (press_limit & 2)
+            debouncer.press_limit1 |= bit;
+        if (release_limit & 1)
+            debouncer.release_limit0 |= bit;
+        if (release_limit & 2)
+            debouncer.release_limit1 |= bit;
+    }
+}
+
+/* Feed a sample of the raw button inputs to the debouncer, and return a
+   bitmask of which buttons' debounced states have changed. A button which
+   disagrees with its debounced state counts up, if it's held down, on every
+   sample, and if it's released, only on samples where "tick" is nonzero.
+   When its counter has reached its limit and it still disagrees, its state
+   changes and the counter goes back to zero. A button which agrees with its
+   state has its counter cleared. */
+static boz_button_mask debounce_sample(boz_button_mask raw, byte tick) {
+    boz_button_mask state = debouncer.state;
+    boz_button_mask diff = raw ^ state;
+    boz_button_mask count_up = diff & (~state | (tick ? (boz_button_mask) ~0 : 0));
+    boz_button_mask limit0 = (state & debouncer.release_limit0) | (~state & debouncer.press_limit0);
+    boz_button_mask limit1 = (state & debouncer.release_limit1) | (~state & debouncer.press_limit1);
+    boz_button_mask changed = count_up & ~((debouncer.count0 ^ limit0) | (debouncer.count1 ^ limit1));
+
+    debouncer.count1 = (debouncer.count1 ^ (debouncer.count0 & count_up)) & diff & ~changed;
+    debouncer.count0 = (debouncer.count0 ^ count_up) & diff & ~changed;
+    debouncer.state = state ^ changed;
+    debouncer.raw = raw;
+    return changed;
+}
+
+#ifdef BOZ_INPUT_LOG
+/* Record in the input log any buttons whose raw inputs differ from the last
+   sample, as of the time "us" when we sampled them. */
+static void log_button_changes(boz_button_mask raw, unsigned long us) {
+    boz_button_mask changes = raw ^ debouncer.raw;
+
+    for (int i = 0; changes; ++i, changes >>= 1) {
+        byte pin;
+
+        if (!(changes & 1))
+            continue;
+        if (i < BOZ_NUM_BOARD_BUZZERS)
+            pin = pgm_read_byte(&board_buzzer_pins[i]);
+        else if (i < BOZ_NUM_BUZZERS)
+            pin = BOZ_INPUT_VIRTUAL_PIN + i - BOZ_NUM_BOARD_BUZZERS;
+        else
+            pin = pgm_read_byte(&qm_button_defs[i - BOZ_NUM_BUZZERS].pin);
+        boz_input_log_switch(pin, (raw >> i) & 1, us);
+    }
+}
+
+/* Move the rotary encoder clock edges the interrupt handler has seen into
+   the input log */
+static void log_rotary_edges(void) {
+    while (re_log_len > 0) {
+        struct re_log_entry e;
+
+        noInterrupts();
+        e.us = re_log[re_log_start].us;
+        e.clock = re_log[re_log_start].clock;
+        e.data = re_log[re_log_start].data;
+        re_log_start = (re_log_start + 1) % RE_LOG_SIZE;
+        re_log_len--;
+        interrupts();
+
+        boz_input_log_rotary(e.clock == HIGH, e.data == HIGH, e.us);
+    }
+}
+#endif
+
 const byte switch_pins[] = {
     PIN_BUZZER_0,
     PIN_BUZZER_1,
@@ -881,6 +1747,10 @@ const byte switch_pins[] = {
 #define num_switch_pins ((int) (sizeof(switch_pins) / sizeof(switch_pins[0])))
 
 void setup() {
+#ifdef BOZ_WATCHDOG
+    boz_watchdog_init();
+#endif
+
     /* Set our button inputs as inputs */
     for (int i = 0; i < num_switch_pins; ++i) {
         pinMode(switch_pins[i], INPUT_PULLUP);
@@ -888,6 +1758,11 @@ void setup() {
     pinMode(PIN_QM_RE_CLOCK, INPUT_PULLUP);
     pinMode(PIN_QM_RE_DATA, INPUT_PULLUP);
     pinMode(PIN_QM_RE_KEY, INPUT_PULLUP);
+    debounce_init();
+
+    /* The rotary encoder is decoded from its clock line's interrupt */
+    re_clock_last = digitalRead(PIN_QM_RE_CLOCK);
+    attachInterrupt(digitalPinToInterrupt(PIN_QM_RE_CLOCK), rotary_clock_int_handler, CHANGE);
 
 #if BOZ_HW_REVISION == 0
     pinMode(PIN_BUTTON_INT, INPUT_PULLUP);
@@ -903,8 +1778,10 @@ void setup() {
     pinMode(LED_BUILTIN, OUTPUT);
     digitalWrite(LED_BUILTIN, LOW);
 
-    /* Analogue pin on which we sense the battery voltage */
+    /* Analogue pin on which we sense the battery voltage, which the ADC
+       measures in the background from now on */
     pinMode(PIN_BATTERY_SENSOR, INPUT);
+    boz_battery_init();
 
 #if BOZ_HW_REVISION == 1
     pinMode(PIN_LED_R, OUTPUT);
@@ -922,16 +1799,44 @@ void setup() {
     boz_shift_reg_init();
 #endif
 
-    /* Initialise the LCD */
+    /* Get ready to talk to the LCD */
     boz_lcd_init();
 
+#if BOZ_NUM_BUZZERS > BOZ_NUM_BOARD_BUZZERS
+    /* The input expanders are on the same I2C bus */
+    input_sources_init();
+#endif
+
     /* Clear sound and display queue, etc */
     boz_env_reset();
 
+#ifdef BOZ_CLOCK_STREAM
+    /* Start sending the clocks to the serial port */
+    boz_clock_stream_start();
+#endif
+
+    /* The display won't listen to us until it's been powered up for a while,
+       and then it needs to be initialised a step at a time with waits in
+       between. Rather than wait for it here, make that the first display
+       command, which loop() carries out while it gets on with starting the
+       first app. Whatever that app draws is queued behind it. */
+    disp_cmd_state.cmd.cmd = BOZ_LCD_INIT;
+    disp_cmd_state.state = 0;
+    disp_cmd_state.next_step_micros = BOZ_LCD_POWER_ON_MS * 1000UL;
+    disp_cmd_state.running = 1;
+
 #ifdef BOZ_SERIAL
     boz_serial_init();
 #endif
 
+#ifdef BOZ_INPUT_LOG
+    boz_input_log_init();
+#endif
+
+#ifdef BOZ_TRACE
+    boz_trace_init();
+#endif
+
     /* Set app_call_defer to the struct of the first application
        to run. This is the main menu app. I've commented out the logic to
        start with a different app if certain buttons are held down (the test
@@ -963,7 +1868,9 @@ void setup() {
     }
 
     /* Check the header at the start of EEPROM - if it isn't what we expect,
-       or if the version number has changed, do a full EEPROM reset. */
+       or if the EEPROM layout has changed, do a full EEPROM reset. A new
+       firmware version on its own doesn't count: app regions are versioned
+       individually, and checked when the app first reads its region. */
     struct boz_eeprom_header seen_header, correct_header;
     int reset_eeprom = 0;
     for (int i = 0; i < (int) sizeof(seen_header); ++i) {
@@ -973,51 +1880,85 @@ void setup() {
 
     if (strcmp(correct_header.id, seen_header.id))
         reset_eeprom = 1;
-    else if (correct_header.version != seen_header.version)
+    else if (correct_header.layout != seen_header.layout)
         reset_eeprom = 1;
 
     if (reset_eeprom) {
-        /* EEPROM contains unrecognised header, so reinitialise the whole lot */
-        boz_leds_set(15);
+        /* EEPROM contains unrecognised header, so reinitialise the whole lot.
+           This only schedules the erase - the main loop does the actual
+           work a byte at a time while the first app is running. */
         boz_eeprom_global_reset();
-        boz_leds_set(0);
     }
+
+#ifdef BOZ_WATCHDOG
+    /* If the watchdog had to reset us last time, say where the main loop
+       was stuck before doing anything else */
+    static struct boz_crash_arg stall;
+    if (!reset_eeprom && boz_watchdog_take_stall(&stall) &&
+            boz_app_lookup_id(BOZ_APP_ID_CRASH, &app_to_call_data) == 0) {
+        app_call_defer = &app_to_call_data;
+        app_call_defer_init_cookie = &stall;
+    }
+
+    boz_watchdog_arm();
+#endif
 }
 
 void loop() {
     unsigned long ms, us;
-    unsigned long next_wake_ms, next_wake_us;
-    byte next_wake_ms_set = 0, next_wake_us_set = 0;
+    boz_time now;
+    boz_time next_wake = 0;
+    byte next_wake_set = 0;
     byte buttons_busy = 0;
+    unsigned long pass_start_us;
 
     ms = millis();
-    us = micros();
+    now = boz_micros();
+    us = (unsigned long) now;
+    pass_start_us = us;
+
+#ifdef BOZ_WATCHDOG
+    wdt_reset();
+#endif
 
     /* Service the sound queue */
+    boz_set_loop_phase(BOZ_PHASE_SOUND);
+
+    /* A high-priority sound takes over from a normal one straight away.
+       Put the normal one aside to carry on with afterwards. */
+    if (!snd_hi_queue.is_empty() && !snd_cmd_state.high_priority && snd_cmd_state.running) {
+        snd_cmd_preempted = snd_cmd_state;
+        snd_preempted_millis = ms;
+        snd_cmd_state.running = 0;
+        noTone(PIN_SPEAKER);
+    }
+
     do {
         if (snd_cmd_state.running && time_passed(ms, snd_cmd_state.next_step_millis)) {
             snd_cmd_step(ms);
         }
 
-        /* If the sound command has finished, see if we can dequeue another one */
+        /* If the sound command has finished, see if we can dequeue another
+           one, high-priority commands first, then whatever they
+           interrupted */
         if (!snd_cmd_state.running) {
-            if (queue_serve(snd_cmd_queue.q,
-                        sizeof(snd_cmd_queue.q) / sizeof(snd_cmd_queue.q[0]),
-                        sizeof(snd_cmd_queue.q[0]), &snd_cmd_queue.qstate,
-                        &snd_cmd_state.cmd) == 0) {
+            if (snd_hi_queue.pop(&snd_cmd_state.cmd) == 0) {
+                BOZ_TRACE_POINT(BOZ_TRACE_SND_POP, snd_hi_queue.count());
+                snd_cmd_start(ms, 1);
+            }
+            else if (snd_cmd_preempted.running) {
+                snd_cmd_resume(ms);
+            }
+            else if (snd_cmd_queue.pop(&snd_cmd_state.cmd) == 0) {
+                BOZ_TRACE_POINT(BOZ_TRACE_SND_POP, snd_cmd_queue.count());
                 /* If we did dequeue something, make a start on that new command */
-                snd_cmd_state.running = 1;
-                snd_cmd_state.start_millis = ms;
-                snd_cmd_state.next_step_millis = ms;
-                snd_cmd_state.current_freq = 0;
-                snd_cmd_state.times_done = 0;
-                snd_cmd_state.arp_index = 0;
-                snd_cmd_step(ms);
+                snd_cmd_start(ms, 0);
             }
         }
     } while (snd_cmd_state.running && time_passed(ms, snd_cmd_state.next_step_millis));
 
     /* Service the display command queue */
+    boz_set_loop_phase(BOZ_PHASE_DISPLAY);
     do {
         if (disp_cmd_state.running && time_passed(us, disp_cmd_state.next_step_micros)) {
             disp_cmd_step(us);
@@ -1025,10 +1966,7 @@ void loop() {
 
         /* If the display command finished, dequeue the next one if it exists */
         if (!disp_cmd_state.running) {
-            if (queue_serve(disp_cmd_queue.q,
-                        sizeof(disp_cmd_queue.q) / sizeof(disp_cmd_queue.q[0]),
-                        sizeof(disp_cmd_queue.q[0]), &disp_cmd_queue.qstate,
-                        &disp_cmd_state.cmd) == 0) {
+            if (disp_cmd_queue.pop(&disp_cmd_state.cmd) == 0) {
                 disp_cmd_state.running = 1;
                 disp_cmd_state.state = 0;
                 disp_cmd_state.next_step_micros = us;
@@ -1039,180 +1977,144 @@ void loop() {
 
 #ifdef BOZ_SERIAL
     /* If we have serial data to send and we can send it, then do so */
+    boz_set_loop_phase(BOZ_PHASE_SERIAL);
     boz_serial_service_send();
 
+#ifdef BOZ_DISPLAY_MIRROR
+    /* Send what's changed on the display, but only once the display has
+       caught up with everything it's been asked to do */
+    if (!disp_cmd_state.running && disp_cmd_queue.is_empty())
+        boz_mirror_service();
+#endif
+
     /* If we have data available on the serial port, then tell the application
        if it's interested. If it's not interested, then throw away the data. */
     if (serial_data_available) {
-        if (app_context && app_context->event_serial_data_available) {
-            app_context->event_serial_data_available(app_context->event_cookie);
+        boz_event_handler_fn handler = app_context ? event_handler(EVENT_INDEX_SERIAL_DATA_AVAILABLE) : NULL;
+        if (handler) {
+            ((void (*)(void *)) handler)(app_context->event_cookie);
             if (Serial.available() == 0)
                 serial_data_available = 0;
         }
         else {
             while (Serial.available() > 0)
-                Serial.read();
+                boz_serial_read();
             serial_data_available = 0;
         }
     }
 #endif
 
-    /* If the app has any clocks running, check them for any events */
-    if (app_context && app_context->clocks_enabled) {
-        for (byte clock_index = 0; clock_index < NUM_CLOCKS; ++clock_index) {
-            if (app_context->clocks_enabled & (1 << clock_index)) {
-                boz_clock clock = clocks[clock_index];
-                long value = boz_clock_value(clock);
+    /* Carry on with any EEPROM erase that's in progress */
+    boz_set_loop_phase(BOZ_PHASE_EEPROM);
+    if (eeprom_erase_pos > eeprom_erase_start)
+        eeprom_erase_step();
 
-                if (clock->alarm_enabled) {
-                    if (time_passed_aux(value, clock->alarm_ms, clock->direction)) {
-                        boz_clock_cancel_alarm(clock);
-                        if (clock->event_alarm) {
-                            clock->event_alarm(clock->event_cookie, clock);
-                        }
-                    }
-                }
+#ifdef BOZ_INPUT_LOG
+    /* Send the next bit of the input log to wherever it's going */
+    boz_set_loop_phase(BOZ_PHASE_INPUT_LOG);
+    log_rotary_edges();
+    boz_input_log_service();
+#endif
 
-                if (boz_clock_running(clock)) {
-                    if (clock->min_enabled) {
-                        if (value <= clock->min_ms) {
-                            void (*handler)(void *, boz_clock) = clock->event_expiry_min;
-                            boz_clock_stop(clock);
-                            //boz_clock_cancel_expiry_min(clock);
-                            if (handler) {
-                                clock->event_expiry_min = NULL;
-                                handler(clock->event_cookie, clock);
-                            }
-                        }
-                    }
+    /* If the app or any service has any clocks running, check them for any
+       events */
+    boz_set_loop_phase(BOZ_PHASE_CLOCKS);
+    if (app_context && app_context->clocks_enabled)
+        check_clock_events(app_context->clocks_enabled);
+    services_check_clocks();
 
-                    if (clock->max_enabled) {
-                        if (value >= clock->max_ms) {
-                            void (*handler)(void *, boz_clock) = clock->event_expiry_max;
-                            //boz_clock_cancel_expiry_max(clock);
-                            boz_clock_stop(clock);
-                            if (handler) {
-                                clock->event_expiry_max = NULL;
-                                handler(clock->event_cookie, clock);
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    /* Check if the app has set an alarm time which has now passed */
+    boz_set_loop_phase(BOZ_PHASE_ALARM);
+    if (app_context && current_alarm.handler && now >= current_alarm.time) {
+        void (*handler)(void *) = current_alarm.handler;
+        current_alarm.handler = NULL;
+        handler(current_alarm.cookie);
     }
 
-    /* Check if the app has set an alarm time which has now passed */
-    if (app_context && app_context->alarm_handler &&
-            time_passed(ms, app_context->alarm_time_millis)) {
-        void (*handler)(void *) = app_context->alarm_handler;
-        app_context->alarm_handler = NULL;
-        handler(app_context->alarm_handler_cookie);
+    /* If the app's arbitration policy says it's time to unlock the buzzers
+       after a win, do that before we look at the buttons, so a buzz in this
+       pass of the loop can win, then tell the app */
+    if (app_context && arbitration_unlock_pending() &&
+            now >= arbitration.unlock_time) {
+        boz_event_handler_fn handler;
+
+        boz_arbitration_unlock();
+        handler = event_handler(EVENT_INDEX_BUZZERS_UNLOCKED);
+        if (handler)
+            ((void (*)(void *)) handler)(app_context->event_cookie);
     }
 
     if (app_context) {
-        /* Check if any buttons have changed state since we last checked.
+        /* Sample all the buttons at once, and see which have become
+           pressed since we last checked.
 
-           If we always checked the buttons in the same order, then if two
-           buttons were pressed at the same time, or so close together that
-           we couldn't tell which was first, then lower-numbered buzzers
-           would always win.
+           Buttons which become pressed in the same sample were pressed at
+           the same time, or so close together that we couldn't tell which
+           was first. If we always delivered their events in the same
+           order, then lower-numbered buzzers would always win.
 
            So to make it fair, each time round the main loop we vary which
-           button we check first, and whether we iterate through the button
-           list forwards or backwards.
+           button we deliver first, and whether we iterate through the
+           button list forwards or backwards.
+
+           If the app has an arbitration policy, we decide whether each buzz
+           won as we come to it, in that same order, so the first buzzer
+           pressed has won and its LED is lit before any handler runs.
          */
 
-        int button_index = (int) button_check_start;
-        do {
-            struct button_state *button = &buttons[button_index];
-            byte bval = read_button_value(button->pin);
-
-            if (bval == (button->active_low ? HIGH : LOW)) {
-                /* Button is not held down */
-                if (button->is_pressed) {
-                    /* If it was pressed, it no longer is, so record when we
-                       saw the button get released */
-                    button->is_pressed = 0;
-                    button->released_since_micros = us;
-                }
-                if (button->event_delivered) {
-                    if (button->release_threshold_us == 0 ||
-                            time_elapsed(button->released_since_micros, us) >= button->release_threshold_us) {
-                        /* Button has been released long enough that if we see
-                           another press, we should consider it another event */
-                        button->event_delivered = 0;
-                    }
-                }
-            }
-            else {
-                /* Button is held down */
-                if (!button->is_pressed) {
-                    /* Button has changed state to "pressed". */
-                    button->is_pressed = 1;
-                    button->pressed_since_micros = us;
-                    if (button->button_function == FUNC_RE_CLOCK) {
-                        /* If this was the clock for the rotary encoder, read
-                           the data pin now rather than when we're satisfied
-                           this is a real signal. When the pin has been active
-                           for the requisite duration we'll use this value
-                           then. */
-                        re_data_value_last_clock = digitalRead(PIN_QM_RE_DATA);
-                    }
-                }
-                if (!button->event_delivered &&
-                        (button->press_threshold_us == 0 ||
-                         time_elapsed(button->pressed_since_micros, us) >= button->press_threshold_us)) {
-                    /* Button has been continuously pressed long enough that we
-                       can consider it an actual press. */
-                    if (button->button_function == FUNC_RE_CLOCK) {
-                        unsigned long *last_turn_ms;
-                        /* We've seen a rising edge of the rotary encoder's
-                           clock pin. Provided this is at least
-                           ROTARY_TURN_MIN_GAP_MS after the last time we
-                           decided the rotary encoder had been turned the same
-                           way, we're now satisfied it's a real signal rather
-                           than a bounce. re_data_value_last_clock
-                           contains the value on the data pin at the point we
-                           received the clock signal. */
-                        if (re_data_value_last_clock == HIGH)
-                            last_turn_ms = &re_last_turn_high_ms;
-                        else
-                            last_turn_ms = &re_last_turn_low_ms;
-
-                        if (time_elapsed(*last_turn_ms, ms) >= ROTARY_TURN_MIN_GAP_MS) {
-                            if (app_context->event_qm_rotary) {
-                                app_context->event_qm_rotary(app_context->event_cookie, re_data_value_last_clock == LOW);
-                            }
-                            *last_turn_ms = ms;
-                        }
-                        button->event_delivered = 1;
-                    }
-                    else {
-                        /* Call the application's event handler for this
-                           button, if there is one. */
-                        deliver_button_event(button);
-                    }
-                }
-            }
+        unsigned long sample_us = micros();
+        boz_button_mask raw;
+
+        boz_set_loop_phase(BOZ_PHASE_BUTTONS);
+        raw = read_buttons();
+        byte tick = 0;
+        boz_button_mask pressed;
+        int button_index;
+
+        if (time_elapsed(debounce_last_tick_ms, ms) >= DEBOUNCE_TICK_MS) {
+            tick = 1;
+            debounce_last_tick_ms = ms;
+        }
+#ifdef BOZ_INPUT_LOG
+        if (raw != debouncer.raw)
+            log_button_changes(raw, sample_us);
+#endif
+        pressed = debounce_sample(raw, tick) & debouncer.state;
 
-            /* If the button is pressed, or if the button is not pressed but an
-               event has just been delivered (and the required release wait
-               time hasn't elapsed so we haven't cleared event_delivered), then
-               the button is busy (i.e. we're waiting for something to happen
-               shortly on this button) and we shouldn't sleep. */
-            if (button->is_pressed || button->event_delivered) {
-                buttons_busy = 1;
+#ifdef BOZ_TRACE
+        if ((debouncer.state & TRACE_DUMP_BUTTONS) == TRACE_DUMP_BUTTONS &&
+                (pressed & TRACE_DUMP_BUTTONS)) {
+            boz_trace_dump();
+            pressed &= ~TRACE_DUMP_BUTTONS;
+        }
+#endif
+
+        /* If a button is pressed, or released but not for long enough yet,
+           we're waiting for something to happen shortly and we shouldn't
+           sleep. */
+        if (debouncer.state | raw)
+            buttons_busy = 1;
+
+        button_index = (int) button_check_start;
+        while (pressed) {
+            boz_button_mask bit = BUTTON_BIT(button_index);
+
+            if (pressed & bit) {
+                pressed &= ~bit;
+                button_pressed_since_micros[button_index] = sample_us;
+                if (button_index >= BOZ_NUM_BUZZERS || arbitrate(button_index, now))
+                    input_event_add(button_index, sample_us, 0, 0);
+                else if (arbitration.policy.flags & BOZ_ARB_TELL_LOSERS)
+                    input_event_add(button_index, sample_us, 0, 1);
             }
 
-            /* Move on to the next button in the array, and finish if we've
-               reached the button we started on */
+            /* Move on to the next button in the array */
             button_index += button_check_direction;
             if (button_index < 0)
                 button_index = num_buttons - 1;
             else if (button_index >= num_buttons)
                 button_index = 0;
-        } while (button_index != button_check_start);
+        }
 
         if (button_check_direction < 0) {
             /* If we went backwards this time, next time switch to forwards
@@ -1221,28 +2123,51 @@ void loop() {
                operator button like play or reset). */
             button_check_direction = 1;
             button_check_start++;
-            if (button_check_start > BOZ_LAST_BUZZER_BUTTON_INDEX)
-                button_check_start = BOZ_FIRST_BUZZER_BUTTON_INDEX;
+            if (button_check_start >= BOZ_NUM_BUZZERS)
+                button_check_start = 0;
         }
         else {
             /* If we went forwards this time, go backwards next time, starting
                from the same place. */
             button_check_direction = -1;
         }
+
+        take_rotary_steps();
+
+        /* Only now that we've seen everything do we call the app's event
+           handlers. */
+        boz_set_loop_phase(BOZ_PHASE_EVENTS);
+        deliver_input_events();
     }
 
     /* If the sound queue can receive input, see if the app is interested
-       in hearing about this exciting news. */
-    if (app_context && app_context->event_sound_queue_not_full) {
-        if (!snd_cmd_queue.qstate.full) {
-            void (*handler)(void *) = app_context->event_sound_queue_not_full;
-            app_context->event_sound_queue_not_full = NULL;
-            handler(app_context->event_cookie);
+       in hearing about this exciting news. Likewise if the display queue
+       has room for what the app last wanted to draw. */
+    boz_set_loop_phase(BOZ_PHASE_SOUND_QUEUE);
+    if (app_context && !snd_cmd_queue.is_full()) {
+        boz_event_handler_fn handler = event_handler(EVENT_INDEX_SOUND_QUEUE_NOT_FULL);
+        if (handler) {
+            app_context->event_mask &= ~BOZ_EVENT_SOUND_QUEUE_NOT_FULL;
+            ((void (*)(void *)) handler)(app_context->event_cookie);
         }
     }
+    if (app_context && boz_display_queue_space() >= disp_space_wanted) {
+        boz_event_handler_fn handler = event_handler(EVENT_INDEX_DISPLAY_QUEUE_SPACE);
+        if (handler) {
+            app_context->event_mask &= ~BOZ_EVENT_DISPLAY_QUEUE_SPACE;
+            ((void (*)(void *)) handler)(app_context->event_cookie);
+        }
+    }
+
+    /* Give a background service its turn, if one is due */
+    boz_set_loop_phase(BOZ_PHASE_SERVICES);
+    services_run(boz_micros());
 
     /* Has the current app exited? */
+    boz_set_loop_phase(BOZ_PHASE_APP_EXIT);
     while (app_exited) {
+        BOZ_TRACE_POINT(BOZ_TRACE_APP_EXIT, (byte) app_exit_status);
+
         /* It has. First release any resources this app still has */
         app_context_tear_down(app_context);
 
@@ -1256,14 +2181,35 @@ void loop() {
         if (app_context > app_context_stack) {
             /* Pass its return code to the previous app on the stack */
             app_context--;
+
+            /* Put back the alarm and arbitration state it had when it made
+               the call. If the alarm time passed while it was suspended,
+               the alarm goes off now. */
+            if (app_context->suspended) {
+                current_alarm = app_context->suspended->alarm;
+                arbitration = app_context->suspended->arbitration;
+                boz_mm_free(app_context->suspended);
+                app_context->suspended = NULL;
+            }
+            else {
+                memzero(&current_alarm, sizeof(current_alarm));
+                memzero(&arbitration, sizeof(arbitration));
+            }
             app_context->app_call_return_handler(app_context->app_call_return_cookie, app_exit_status);
         }
-        else {
-            /* First app isn't allowed to exit. Sorry. */
+        else if (boz_app_lookup_id(BOZ_APP_ID_INIT, &app_to_call_data) == 0) {
+            /* The first app has exited, which only the crash app does when
+               it's showing a stall from before the last reset. Start the
+               usual first app in its place. */
+            app_context = NULL;
+            app_call_defer = &app_to_call_data;
+            app_call_defer_init_cookie = NULL;
+            break;
         }
     }
 
     /* Has this app, or the app that just exited, called another app? */
+    boz_set_loop_phase(BOZ_PHASE_APP_START);
     if (app_call_defer != NULL) {
         void (*next_app_init)(void *) = app_call_defer->init;
 
@@ -1274,6 +2220,11 @@ void loop() {
         else {
             app_context->app_call_return_handler = app_call_return;
             app_context->app_call_return_cookie = app_call_return_cookie;
+            app_context->app_call_resume = app_call_resume;
+            if (app_context->suspended) {
+                app_context->suspended->alarm = current_alarm;
+                app_context->suspended->arbitration = arbitration;
+            }
 
             /* Call that set app_call_defer_init has already checked we have
                enough space on the app context stack */
@@ -1281,11 +2232,26 @@ void loop() {
         }
 
         /* All apps are allowed to assume that when they're called, CGRAM will
-           contain their default characters and the LEDs will be off. */
-        boz_lcd_reset_cgram_patterns();
+           contain their default characters, the LEDs will be off, and
+           their sounds will go on the normal-priority queue. Put back any
+           default characters which the app before overwrote, through the
+           display queue, so that it happens after anything already queued,
+           which at power on includes initialising the display. If there's
+           no room, do it now. */
+        byte cgram_missing = boz_display_glyphs_missing();
+        if (cgram_missing) {
+            struct disp_cmd reset_cgram;
+            reset_cgram.cmd = BOZ_LCD_RESET_CGRAM | cgram_missing;
+            if (disp_cmd_queue.push(reset_cgram) != 0)
+                boz_lcd_reset_cgram_patterns(cgram_missing);
+        }
+        boz_display_glyphs_reset();
         boz_leds_set(0);
+        snd_priority = BOZ_SOUND_PRIORITY_NORMAL;
 
         app_context_init(app_context);
+        memzero(&current_alarm, sizeof(current_alarm));
+        memzero(&arbitration, sizeof(arbitration));
 
         /* Create a new allocated-chunks list in the memory manager for this
            new app context */
@@ -1300,9 +2266,12 @@ void loop() {
            from the struct boz_app into app_context */
         app_context->eeprom_start = app_call_defer->eeprom_start;
         app_context->eeprom_length = app_call_defer->eeprom_length;
+        app_context->app_id = (byte) app_call_defer->id;
+        app_context->eeprom_version = app_call_defer->eeprom_version;
 
         app_call_defer = NULL;
 
+        BOZ_TRACE_POINT(BOZ_TRACE_APP_CALL, app_context->app_id);
         next_app_init(app_call_defer_init_cookie);
     }
 
@@ -1324,117 +2293,150 @@ void loop() {
          * A clock alarm is triggered, or a clock reaches or passes its min or
            max value.
          * An app's alarm time is reached or passed.
+         * A background service is due to run.
          * A running sound command reaches its next_step_millis time.
          * Any buzzer or button is pressed, or the rotary knob is turned.
     */
 
     byte can_sleep = 1;
 
+    boz_set_loop_phase(BOZ_PHASE_SLEEP);
+    boz_watchdog_pass_done(pass_start_us);
+
     /* In case the many event handlers we might have called above took a long
-       time to run, update ms and us */
+       time to run, update ms, us and now */
     ms = millis();
-    us = micros();
+    now = boz_micros();
+    us = (unsigned long) now;
 
     if (buttons_busy || app_context->forbid_sleep)
         can_sleep = 0;
-    else if (disp_cmd_state.running || !queue_is_empty(&disp_cmd_queue.qstate))
+    else if (eeprom_erase_pos > eeprom_erase_start)
+        can_sleep = 0;
+#ifdef BOZ_INPUT_LOG
+    else if (boz_input_log_busy())
+        can_sleep = 0;
+#endif
+#ifdef BOZ_DISPLAY_MIRROR
+    else if (boz_mirror_busy())
+        can_sleep = 0;
+#endif
+    else if (disp_cmd_state.running || !disp_cmd_queue.is_empty())
+        can_sleep = 0;
+    else if (!snd_cmd_state.running && (!snd_cmd_queue.is_empty() || snd_cmd_preempted.running))
         can_sleep = 0;
-    else if (!snd_cmd_state.running && !queue_is_empty(&snd_cmd_queue.qstate))
+    else if (!snd_hi_queue.is_empty() && !(snd_cmd_state.running && snd_cmd_state.high_priority))
         can_sleep = 0;
 
     if (can_sleep) {
+        /* The sound queue keeps time in millis(), which is near enough
+           the same as boz_micros() over the length of a note */
         if (snd_cmd_state.running) {
-            update_if_passed(&next_wake_ms_set, &next_wake_ms, snd_cmd_state.next_step_millis);
-        }
-        if (disp_cmd_state.running) {
-            update_if_passed(&next_wake_us_set, &next_wake_us, disp_cmd_state.next_step_micros);
+            long ms_to_step = (long) (snd_cmd_state.next_step_millis - ms);
+            update_if_passed(&next_wake_set, &next_wake,
+                    ms_to_step > 0 ? now + ms_to_step * 1000UL : now);
         }
 
-        if (app_context && app_context->clocks_enabled) {
+        unsigned short clocks_enabled = services_clocks_enabled();
+
+        if (app_context)
+            clocks_enabled |= app_context->clocks_enabled;
+        if (clocks_enabled) {
             /* Check each enabled, running clock */
             for (int clock_index = 0; clock_index < NUM_CLOCKS; ++clock_index) {
                 boz_clock clock = clocks[clock_index];
-                if ((app_context->clocks_enabled & (1 << clock_index)) && boz_clock_running(clock)) {
+                if ((clocks_enabled & (1 << clock_index)) && boz_clock_running(clock)) {
 
                     /* If the clock is heading for an alarm, a minimum or a
-                       maximum limit, work out how long it'll take to get
-                       there, and update next_wake_ms if necessary. */
-                    long clock_event_millis;
+                       maximum limit, work out when it'll get there, and
+                       update next_wake if necessary. */
                     if (clock->alarm_enabled) {
-                        clock_event_millis = ms + boz_clock_get_ms_until_alarm(clock);
-                        update_if_passed(&next_wake_ms_set, &next_wake_ms, clock_event_millis);
+                        update_if_passed(&next_wake_set, &next_wake,
+                                boz_clock_time_at_value(clock, clock->alarm_ms));
                     }
 
                     if (clock->min_enabled && !boz_clock_is_direction_forwards(clock)) {
-                        clock_event_millis = ms + (boz_clock_value(clock) - clock->min_ms);
-                        update_if_passed(&next_wake_ms_set, &next_wake_ms, clock_event_millis);
+                        update_if_passed(&next_wake_set, &next_wake,
+                                boz_clock_time_at_value(clock, clock->min_ms));
                     }
 
                     if (clock->max_enabled && boz_clock_is_direction_forwards(clock)) {
-                        clock_event_millis = ms + (clock->max_ms - boz_clock_value(clock));
-                        update_if_passed(&next_wake_ms_set, &next_wake_ms, clock_event_millis);
+                        update_if_passed(&next_wake_set, &next_wake,
+                                boz_clock_time_at_value(clock, clock->max_ms));
                     }
                 }
             }
         }
 
         /* If this app has set a general alarm, take account of that */
-        if (app_context && app_context->alarm_handler) {
-            update_if_passed(&next_wake_ms_set, &next_wake_ms, app_context->alarm_time_millis);
+        if (app_context && current_alarm.handler) {
+            update_if_passed(&next_wake_set, &next_wake, current_alarm.time);
+        }
+
+        /* Likewise if the buzzers are to be unlocked after a win */
+        if (app_context && arbitration_unlock_pending()) {
+            update_if_passed(&next_wake_set, &next_wake, arbitration.unlock_time);
         }
+
+        /* Wake up for the next service that's due */
+        services_next_wake(&next_wake_set, &next_wake);
+
+        /* boz_micros() only notices micros() wrapping round if it's called
+           at least every 71 minutes, so even with nothing to wait for,
+           don't sleep for longer than the timer will let us. */
+        update_if_passed(&next_wake_set, &next_wake, now + 1000000UL);
     }
 
     if (can_sleep) {
-        /* Number of milliseconds to wait for the next timer-based event.
-           If ms_to_wait is 0 and can_sleep is 1, it means there are no
-           timer-based events pending and we should sleep until we get a
-           button press. */
-        unsigned long ms_to_wait = 0;
-
-        if (next_wake_ms_set) {
-            /* Set a timer to give us an interrupt when millis() reaches
-               next_wake_ms. */
-
-            /* Initialise TIMER1 with a 1/256 prescaler, so it counts with a
-               frequency of 16MHz / 256 = 62.5kHz, or one count every
-               1/62500 seconds.
-             */
-            TCCR1A = 0;
-            TCCR1B = 0;
-            TCCR1B |= (1 << CS12);
-
-            if (time_passed(ms, next_wake_ms))
-                ms_to_wait = 0;
-            else
-                ms_to_wait = time_elapsed(ms, next_wake_ms);
+        /* Number of TIMER1 counts to wait for the next timer-based event */
+        unsigned long counts_to_wait = 0;
 
-            if (ms_to_wait == 0) {
-                can_sleep = 0;
-            }
-            else {
-                /* Cap the wait time at 1 second. If we have to wait longer
-                   than that, we'll wake up after a second, realise there's
-                   nothing to do and go back to sleep again. */
-                if (ms_to_wait > 1000)
-                    ms_to_wait = 1000;
-            }
+        /* Set a timer to give us an interrupt when boz_micros() reaches
+           next_wake. */
+
+        /* Initialise TIMER1 with a 1/256 prescaler, so it counts with a
+           frequency of 16MHz / 256 = 62.5kHz, or one count every 16
+           microseconds.
+         */
+        TCCR1A = 0;
+        TCCR1B = 0;
+        TCCR1B |= (1 << CS12);
+
+        if (next_wake > now) {
+            /* Cap the wait time at 1 second. If we have to wait longer
+               than that, we'll wake up after a second, realise there's
+               nothing to do and go back to sleep again. */
+            if (next_wake - now >= 1000000UL)
+                counts_to_wait = 62500;
+            else
+                counts_to_wait = (unsigned long) (next_wake - now) >> 4;
         }
 
+        if (counts_to_wait == 0)
+            can_sleep = 0;
+
         if (can_sleep) {
+#ifdef BOZ_TRACE
+            unsigned long sleep_start_t = micros() >> 4;
+
+            BOZ_TRACE_POINT(BOZ_TRACE_SLEEP, 0);
+#endif
             set_sleep_mode(SLEEP_MODE_IDLE);
             noInterrupts();
-            boz_wake = 0;
+
+            /* If the rotary knob turned since we delivered its steps, the
+               interrupt handler has already been and gone, so don't wait
+               for it. */
+            boz_wake = (re_steps != 0);
             sleep_enable();
 
-            if (ms_to_wait) {
-                /* Initialise TIMER1 counter to 65536 minus the number of
-                   counts we have to wait. When TIMER1 reaches 65536 (0) then
-                   we'll get an interrupt. It's 62.5 counts per millisecond. */
-                TCNT1 = (unsigned short) (65536L - ((ms_to_wait * 125L) / 2));
+            /* Initialise TIMER1 counter to 65536 minus the number of counts
+               we have to wait. When TIMER1 reaches 65536 (0) then we'll get
+               an interrupt. */
+            TCNT1 = (unsigned short) (65536L - counts_to_wait);
 
-                /* Enable TIMER1 overflow interrupt */
-                TIMSK1 |= (1 << TOIE1);
-            }
+            /* Enable TIMER1 overflow interrupt */
+            TIMSK1 |= (1 << TOIE1);
             interrupts();
 
 #if BOZ_HW_REVISION == 1
@@ -1448,10 +2450,10 @@ void loop() {
             }
 #endif
 
-            /* We want interrupts when any button is pressed (pin D2 is low) or
-               the rotary knob is turned (pin D3 falls) */
+            /* We want an interrupt when any button is pressed (pin D2 is
+               low). The rotary knob's interrupt is always attached, and
+               wakes us when the knob has turned a step. */
             attachInterrupt(digitalPinToInterrupt(PIN_BUTTON_INT), button_int_handler, LOW);
-            attachInterrupt(digitalPinToInterrupt(PIN_QM_RE_CLOCK), rotary_clock_int_handler, RISING);
 
             /* If we get an interrupt between enabling interrupts and calling
                sleep_cpu(), the interrupt handler will have disabled sleep mode,
@@ -1461,6 +2463,10 @@ void loop() {
             digitalWrite(LED_BUILTIN, LOW);
 #endif
 
+#ifdef BOZ_WATCHDOG
+            boz_watchdog_disarm();
+#endif
+
             while (!boz_wake) {
                 /* Only carry on with the main loop when boz_wake is 1,
                    otherwise we'll go round the main loop again on every
@@ -1476,10 +2482,21 @@ void loop() {
 
             sleep_disable();
 
+#ifdef BOZ_TRACE
+            {
+                /* Say how many times the trace's timestamp wrapped round */
+                unsigned long wraps = ((micros() >> 4) - sleep_start_t) >> 16;
+                BOZ_TRACE_POINT(BOZ_TRACE_WAKE, wraps > 255 ? 255 : (byte) wraps);
+            }
+#endif
+
+#ifdef BOZ_WATCHDOG
+            boz_watchdog_arm();
+#endif
+
             /* No longer interested in button interrupts - we only want these
                when we're asleep */
             detachInterrupt(digitalPinToInterrupt(PIN_BUTTON_INT));
-            detachInterrupt(digitalPinToInterrupt(PIN_QM_RE_CLOCK));
 
             /* Disable TIMER1 overflow interrupt */
             TIMSK1 &= ~(1 << TOIE1);
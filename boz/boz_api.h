@@ -2,11 +2,15 @@
 #define _BOZ_API_H
 
 #include "boz_hw.h"
+#include "boz_util.h"
 #include "boz_display.h"
 #include "boz_sound.h"
 #include "boz_clock.h"
+#include "boz_clock_display.h"
+#include "boz_events.h"
 #include "boz_serial.h"
 #include "boz_mm.h"
+#include "boz_service.h"
 #include "boz_app_inits.h"
 
 #define FUNC_BUZZER 0
@@ -32,10 +36,18 @@
 #define BOZ_CHAR_WHEEL_C_S "\x06"
 #define BOZ_CHAR_COPYRIGHT_S "\x07"
 
-#define BOZ_NUM_BUZZERS 4
 #define BOZ_NUM_CLOCKS 4
 #define BOZ_NUM_LEDS 4
 
+/* A set of buzzers, bit n being buzzer n. BOZ_NUM_BUZZERS is in boz_hw.h. */
+#if BOZ_NUM_BUZZERS <= 8
+typedef byte boz_buzzer_mask;
+#else
+typedef unsigned short boz_buzzer_mask;
+#endif
+#define BOZ_BUZZER_BIT(BUZZER) ((boz_buzzer_mask) 1 << (BUZZER))
+#define BOZ_ALL_BUZZERS ((boz_buzzer_mask) (BOZ_BUZZER_BIT(BOZ_NUM_BUZZERS - 1) * 2 - 1))
+
 #define BOZ_DISP_NUM_FORCE_SIGN 1
 #define BOZ_DISP_NUM_ZERO_PAD 2
 #define BOZ_DISP_NUM_ARROWS 4
@@ -106,6 +118,14 @@ boz_led_set(int which_led, int on);
 void
 boz_leds_set(int mask);
 
+/* boz_leds_set_buzzers
+ * Switch on the LED for each buzzer in "buzzers", and switch the others off.
+ * If there are more than four buzzers, buzzer n has the same colour LED as
+ * buzzer n - 4, so buzzers 0, 4, 8 and 12 are all red.
+ */
+void
+boz_leds_set_buzzers(boz_buzzer_mask buzzers);
+
 
 /******************************************************************************
  * APP CALLING AND EXITING
@@ -136,10 +156,26 @@ boz_leds_set(int mask);
  * return_callback_cookie: The first parameter to pass to return_callback().
  *                         This has meaning only to the return_callback
  *                         function.
+ *
+ * Returns 0, or -1 if the app can't be called: there's no such app, apps are
+ * already nested as deep as they can go, or there isn't the memory to put
+ * the calling app's alarm and arbitration policy aside.
  */
 int
 boz_app_call(int app_id, void *param, void (*return_callback)(void *, int), void *return_callback_cookie);
 
+/* boz_app_call_resume, boz_app_call_status
+ * The same as boz_app_call(), but when the called app exits, call
+ * resume(cookie), and boz_app_call_status() then returns the exit status.
+ * This is for protothreads (see boz_pt.h), which can be resumed like any
+ * other handler. If the app can't be called, boz_app_call_resume() returns
+ * -1, and boz_app_call_status() returns -1 too. */
+int
+boz_app_call_resume(int app_id, void *param, void (*resume)(void *), void *cookie);
+
+int
+boz_app_call_status(void);
+
 /* boz_app_exit
  * Exit the application.
  * Once the event handler which called boz_app_exit returns:
@@ -172,7 +208,8 @@ boz_app_exit(int status);
  * is freed by boz_mm_free() or until the application exits.
  *
  * When an application exits after a call to boz_app_exit(), all memory it has
- * allocated with boz_mm_alloc() is freed automatically.
+ * allocated with boz_mm_alloc() is freed automatically. Memory a background
+ * service allocates is freed when the service stops.
  * */
 void *boz_mm_alloc(boz_mm_size size);
 
@@ -209,29 +246,41 @@ void boz_mm_free(void *p);
  * If an application needs to wait for a period of time before doing something,
  * consider setting an alarm event instead (see boz_set_alarm()).
  *
+ * An app's event handlers live in flash, in a const PROGMEM struct
+ * boz_event_handlers (see boz_events.h), which it passes to
+ * boz_set_event_handlers(). For example:
+ *
+ *     const PROGMEM struct boz_event_handlers my_app_handlers = {
+ *         my_app_buzz,    // buzz
+ *         my_app_play,    // qm_play
+ *         NULL,           // qm_yellow
+ *         my_app_exit,    // qm_reset
+ *     };
+ *
+ * Each handler can be enabled or disabled without changing the table, with
+ * boz_enable_events() and boz_disable_events(). If an app needs different
+ * handlers for the same event at different times, it can have more than one
+ * table and switch between them.
+ *
  * Event handlers corresponding to button presses, including the buzzers and
  * the QM controls (play, reset, yellow, and the rotary knob), are "sticky" -
  * they will be called once for each time the event happens, and the handler
- * does not need to re-attach itself.
- *
- * An event handler can be detached by setting its handler function to NULL.
- * The application will then not receive any more calls for that event unless
- * and until the event handler is re-attached.
+ * does not need to re-enable itself. A disabled handler won't be called
+ * again unless and until it is enabled again.
  *
  * Other event handlers - those not associated with button presses - are
  * usually one-shot only. This includes the event handler for telling the
  * application that the sound queue is no longer full. These event handlers
- * will be detached by the main loop immediately before being called. If the
+ * will be disabled by the main loop immediately before being called. If the
  * application wants to be called again the next time the event happens, the
- * event handler must manually re-attach itself by calling the appropriate
- * boz_set_event_handler_...() function.
+ * event handler must enable itself again with boz_enable_events().
  *
  * If an application calls another application, each running application has a
- * separate list of event handlers. So you don't need to worry about messing up
- * any event handler settings for a calling application - when your app exits
- * and returns control to the calling app, the calling app will see all the
- * event handler settings exactly the same as they were before your app
- * started.
+ * separate table and set of enabled events. So you don't need to worry about
+ * messing up any event handler settings for a calling application - when your
+ * app exits and returns control to the calling app, the calling app will see
+ * all the event handler settings exactly the same as they were before your
+ * app started.
  *****************************************************************************/
 
 /* boz_set_event_cookie
@@ -242,87 +291,228 @@ void boz_mm_free(void *p);
 void
 boz_set_event_cookie(void *cookie);
 
-/* boz_set_event_handler_buzz
- * Set the event handler which will be called when one of the buzzers is
- * pressed. The first argument of this handler is a void * ("cookie"), which
- * was set with boz_set_event_cookie(). The second argument indicates to the
- * handler which buzzer was pressed - it is an integer 0, 1, 2 or 3. The
- * sockets for these buzzers are numbered 1, 2, 3 and 4 respectively on the
- * control unit.
- * If handler is NULL, the event handler is detached and the application will
- * not receive calls for this event.
+/* boz_set_event_handlers
+ * Set the table of event handlers for this app. "handlers" must point to a
+ * const PROGMEM struct boz_event_handlers, or be NULL for no handlers. All
+ * the events are enabled, except the sound queue one, so every non-NULL
+ * handler in the table will be called when its event happens.
+ *
+ * The handlers are:
+ *
+ * buzz: called when one of the buzzers is pressed. The second argument
+ * indicates to the handler which buzzer was pressed - it is an integer 0, 1,
+ * 2 or 3. The sockets for these buzzers are numbered 1, 2, 3 and 4
+ * respectively on the control unit.
+ *
+ * qm_play, qm_yellow, qm_reset, qm_rotary_press: called when the QM presses
+ * the play button, the yellow button, the reset button or the rotary knob.
+ *
+ * qm_rotary: called for each "step" the QM's rotary knob is turned. The
+ * second argument is 0 if the knob was turned anticlockwise, and 1 if it was
+ * turned clockwise.
+ *
+ * qm_rotary_steps: called instead of qm_rotary, if it's not NULL, when the
+ * rotary knob is turned. The knob is decoded by an interrupt handler, so no
+ * steps are lost however fast it's turned, and the main loop passes on all
+ * the steps turned since it last called this handler in one call. So if the
+ * handler redraws the display, it only redraws once, however many steps
+ * there were. The second argument is the number of steps, positive for
+ * clockwise and negative for anticlockwise. It is never 0.
+ *
+ * sound_queue_not_full: called whenever the sound queue can accept input,
+ * if BOZ_EVENT_SOUND_QUEUE_NOT_FULL is enabled. The boz_sound_*() functions
+ * all put commands on this queue, and if the queue is full those functions
+ * will fail. This event disables itself immediately before the handler is
+ * called. If the application wishes to continue to be notified of this
+ * event after the handler has returned, the handler must enable it again.
+ *
+ * serial_data_available: only called if BOZ_SERIAL is defined, when there
+ * is data to read on the serial port. This event does not disable itself.
+ *
+ * display_queue_space: called when the display queue has room for the last
+ * boz_display_reserve() that failed, or for one command if none has, if
+ * BOZ_EVENT_DISPLAY_QUEUE_SPACE is enabled. An app which can't draw
+ * something now can enable this and draw it from the handler. Like
+ * sound_queue_not_full, it disables itself before the handler is called.
+ *
+ * buzzers_unlocked: called when the main loop unlocks the buzzers because
+ * the app's arbitration policy's unlock_ms has passed since the winning
+ * buzz (see boz_arbitration_set()), so the app can redraw. It isn't called
+ * when the app unlocks them itself.
+ *
+ * Each handler's first argument is the cookie given to the last call to
+ * boz_set_event_cookie().
  */
 void
-boz_set_event_handler_buzz(void (*handler)(void *cookie, int which_buzzer));
+boz_set_event_handlers(const struct boz_event_handlers *handlers);
+
+/* boz_get_event_time, boz_get_event_micros, boz_get_event_millis
+ * Called from a buzz, qm_play, qm_yellow, qm_reset, qm_rotary_press,
+ * qm_rotary or qm_rotary_steps handler, return the value of boz_micros(),
+ * micros() or millis() when the main loop saw the button pressed or the
+ * knob turned. The handler might be called a few milliseconds later than
+ * that, if the main loop was busy, so use boz_get_event_time() to time a
+ * buzz fairly, for example with boz_clock_value_at() or
+ * boz_clock_stop_at().
+ * If called from any other handler, these return the time of the last
+ * button or knob event.
+ */
+boz_time
+boz_get_event_time(void);
 
-/* boz_set_event_handler_qm_play
- * Set the event handler to be called when the QM's "play" button is pressed.
- * If "handler" is NULL, the event handler is detached. The handler takes one
- * argument - a pointer which was set with boz_set_event_cookie().
- * */
-void
-boz_set_event_handler_qm_play(void (*handler)(void *));
+unsigned long
+boz_get_event_micros(void);
+
+unsigned long
+boz_get_event_millis(void);
 
-/* boz_set_event_handler_qm_yellow
- * Set the event handler to be called when the QM's yellow button is pressed.
- * If "handler" is NULL, the event handler is detached. The handler takes one
- * argument - a pointer which was set with boz_set_event_cookie(). */
+/* boz_enable_events, boz_disable_events
+ * Enable or disable the handlers in this app's table for the events in
+ * "events", a bitwise OR of BOZ_EVENT_* values. Events not in "events" are
+ * left as they are. A disabled handler is not called, as if it were NULL in
+ * the table. */
 void
-boz_set_event_handler_qm_yellow(void (*handler)(void *));
+boz_enable_events(unsigned int events);
 
-/* boz_set_event_handler_qm_reset
- * Set the event handler to be called when the QM's "reset" button is pressed.
- * If "handler" is NULL, the event handler is detached. The handler takes one
- * argument - a pointer which was set with boz_set_event_cookie(). */
 void
-boz_set_event_handler_qm_reset(void (*handler)(void *));
+boz_disable_events(unsigned int events);
+
+/* boz_set_rotary_acceleration
+ * If enable is nonzero, then when the knob is turned quickly, each step
+ * counts as several steps when passed to the qm_rotary_steps handler. This
+ * is useful for dialling in a number with a large range, such as a time
+ * limit, but not for moving through a list, where every step should be one
+ * item. Acceleration is off when an app starts. */
+void
+boz_set_rotary_acceleration(byte enable);
+
+/* boz_serial_read
+ * Only available if BOZ_SERIAL is defined.
+ * Read a byte from the serial port. Returns the same as Serial.read(), which
+ * is -1 if there's nothing to read. Use this rather than calling Serial.read()
+ * directly, so that what you read gets into the input log if BOZ_INPUT_LOG is
+ * defined. */
+int
+boz_serial_read(void);
+
+
+/******************************************************************************
+ * BUZZER ARBITRATION
+ *
+ * An app can tell the main loop who is allowed to buzz, and what happens
+ * when someone does, by giving it an arbitration policy. The main loop then
+ * decides who won as it sees each buzzer pressed, before it calls any event
+ * handlers, and lights the winner's LED straight away. Only then is the
+ * app's buzz handler called. So however long the app's handlers take, the
+ * first buzzer pressed wins, and the players see who it was at once.
+ *
+ * Without a policy, which is how an app starts, every buzz goes to the buzz
+ * handler and the app decides for itself.
+ *****************************************************************************/
 
-/* boz_set_event_handler_qm_rotary
- * Set the event handler to be called when the QM's rotary knob is turned.
- * This event handler will be called for each "step" of the knob.
- * If "handler" is NULL, the event handler is detached.
- * The handler takes two arguments - the first is a "cookie" which was set
- * with boz_set_event_cookie(), and the second is an integer: 0 if the
- * knob was turned anticlockwise, and 1 if it was turned clockwise. */
+struct boz_arbitration {
+    /* Buzzers which may buzz at all. */
+    boz_buzzer_mask enabled;
+
+    /* When one of these buzzers wins, every buzzer is locked out until
+     * boz_arbitration_unlock() is called or unlock_ms has passed. */
+    boz_buzzer_mask lock_on_buzz;
+
+    /* When one of these buzzers wins, its LED is switched on and all the
+     * others switched off, as with boz_leds_set_buzzers(). */
+    boz_buzzer_mask light_on_buzz;
+
+    /* If BOZ_ARB_TWO_SIDES is set, the buzzers on the left side. The rest
+     * are on the right. */
+    boz_buzzer_mask left_side;
+
+    /* If nonzero, buzzers locked out by a win are unlocked again this many
+     * milliseconds after the buzzer was pressed, however long the app's
+     * handlers take, and then the app's buzzers_unlocked handler is
+     * called. */
+    unsigned int unlock_ms;
+
+    /* Bitwise OR of zero or more BOZ_ARB_* flags. */
+    byte flags;
+};
+
+/* Once a buzzer has won, its side may not win again until
+ * boz_arbitration_reset(). */
+#define BOZ_ARB_ONE_PER_SIDE 1
+
+/* The players are in two sides, as given by left_side. Otherwise each buzzer
+ * is a side of its own. */
+#define BOZ_ARB_TWO_SIDES 2
+
+/* Call the buzz handler for buzzers which lost as well as for those which
+ * won, so the app can see who was too late. The handler can tell them apart
+ * with boz_arbitration_won(). Otherwise, losing buzzes are dropped. */
+#define BOZ_ARB_TELL_LOSERS 4
+
+/* Switch off all the LEDs when the buzzers are unlocked. */
+#define BOZ_ARB_UNLOCK_LEDS_OFF 8
+
+/* boz_arbitration_set
+ * Give the main loop this app's arbitration policy, which is copied, or
+ * NULL to go back to having no policy. Changing the policy doesn't change
+ * who is locked out or which sides have buzzed, so an app can change its
+ * rules mid-game; call boz_arbitration_reset() to start afresh. The policy
+ * belongs to the app: if the app calls another, the called app starts
+ * without one, and the caller's policy is back in force when the called
+ * app exits.
+ */
 void
-boz_set_event_handler_qm_rotary(void (*handler)(void *, int clockwise));
+boz_arbitration_set(const struct boz_arbitration *policy);
 
-/* boz_set_event_handler_qm_rotary_press
- * Set the event handler to be called when the QM's rotary knob is pressed.
- * If "handler" is NULL, the event handler is detached.
- * The handler takes one argument - a pointer which was set with
- * boz_set_event_cookie().
+/* boz_arbitration_enable
+ * Change which buzzers may buzz, as the "enabled" member of the policy,
+ * without unlocking anyone. For example, a game might enable the buzzers
+ * only while its clock is running.
  */
 void
-boz_set_event_handler_qm_rotary_press(void (*handler)(void *));
+boz_arbitration_enable(boz_buzzer_mask enabled);
 
+/* boz_arbitration_unlock
+ * Unlock all the buzzers locked out by a win, or by
+ * boz_arbitration_set_locked(). Sides which have already buzzed under
+ * BOZ_ARB_ONE_PER_SIDE still may not buzz.
+ */
+void
+boz_arbitration_unlock(void);
 
-/* boz_set_event_handler_sound_queue_not_full
- * Set the event handler to be called whenever the sound queue can accept
- * input. The boz_sound_*() functions all put commands on this queue, and if
- * the queue is full those functions will fail.
- * If "handler" is NULL, the event handler is detached.
- *
- * This event handler also automatically detaches itself immediately before
- * the handler is called. If the application wishes to continue to be notified
- * of this event after the event handler has returned, the event handler must
- * manually re-attach itself.
- *
- * The cookie passed to the handler is, as with the other event handlers, the
- * pointer given to the last call to boz_set_event_cookie().
+/* boz_arbitration_reset
+ * Unlock all the buzzers, and let every side buzz again.
  */
 void
-boz_set_event_handler_sound_queue_not_full(void (*handler)(void *));
+boz_arbitration_reset(void);
+
+/* boz_arbitration_locked, boz_arbitration_set_locked
+ * Get or set the buzzers which are currently locked out. Setting them
+ * starts the policy's unlock_ms again, if it has one.
+ */
+boz_buzzer_mask
+boz_arbitration_locked(void);
 
-/* boz_set_event_handler_serial_data_available
- * Only available if BOZ_SERIAL is defined.
- * Set the event handler to be called when there is data to read on the
- * serial port.
- * This event handler does not detach itself automatically.
- * The cookie passed to the handler is the pointer given to the last call
- * to boz_set_event_cookie(). */
 void
-boz_set_event_handler_serial_data_available(void (*handler)(void *));
+boz_arbitration_set_locked(boz_buzzer_mask buzzers);
+
+/* boz_arbitration_claim
+ * Apply the policy to a buzz the app has found for itself, such as a
+ * buzzer already held down when the app enables the buzzers. Returns 1 if
+ * the buzzer wins, in which case it's treated exactly as if the main loop
+ * had just seen it pressed, or 0 if it loses. Returns 1 if there is no
+ * policy.
+ */
+int
+boz_arbitration_claim(int buzzer);
+
+/* boz_arbitration_won
+ * If called from the buzz handler, return 1 if the buzz won, or 0 if it
+ * lost and is only being delivered because of BOZ_ARB_TELL_LOSERS. Without a
+ * policy, every buzz wins.
+ */
+int
+boz_arbitration_won(void);
 
 
 /******************************************************************************
@@ -406,6 +596,9 @@ boz_display_properties(int display_on, int cursor_on, int cursor_blink_on);
  * Then, to write this smiley face to the top-left corner of the display:
  * display_set_cursor(0, 0);
  * display_write_char(5);
+ *
+ * Unless the character has to change as the app runs, boz_display_glyph() is
+ * easier, and doesn't send anything if the character is already there.
  * */
 int
 boz_display_set_cgram_address(int address);
@@ -425,7 +618,8 @@ boz_display_write_char(char c);
 /* boz_display_write_string
  * Write the characters in the nul-terminated string s to the display, not
  * including the terminating nul. This enqueues a command for every character
- * in the string. */
+ * in the string. If there isn't room for all of them, it enqueues none of
+ * them and returns -1. */
 int
 boz_display_write_string(const char *s);
 
@@ -467,6 +661,35 @@ boz_display_write_string_P(const char *str_pm);
 int
 boz_display_write_long(long num, int min_width, int flags);
 
+/* boz_display_queue_space
+ * Return how many more commands the display queue can take. */
+int
+boz_display_queue_space(void);
+
+/* boz_display_reserve, boz_display_commit
+ * Draw something all at once or not at all. If the display queue has room
+ * for num_commands more commands, boz_display_reserve() returns 0, and the
+ * display commands after it are held back until boz_display_commit(), when
+ * they all go on the queue together. The display won't show half of them,
+ * and as long as there are no more than num_commands of them, none of them
+ * will fail.
+ *
+ * If there isn't room, boz_display_reserve() returns -1 and the app
+ * shouldn't call boz_display_commit(). The app can enable
+ * BOZ_EVENT_DISPLAY_QUEUE_SPACE to find out when there's room, and draw it
+ * then.
+ *
+ * Reservations can be nested, in which case nothing goes on the queue until
+ * the outermost one is committed. Commit before the handler returns, because
+ * the main loop can't see anything held back.
+ *
+ * boz_display_commit() returns -1 if there was no reservation to commit. */
+int
+boz_display_reserve(int num_commands);
+
+int
+boz_display_commit(void);
+
 /* boz_lcd_get_backlight_state
  * Query the state of the LCD's backlight.
  *
@@ -501,17 +724,41 @@ boz_lcd_set_backlight_state(byte state);
  * 6: Clockwise "turn wheel right" symbol.
  * 7: Copyright symbol.
  *
- * This enqueues one special command to the display queue, which when served
- * causes several commands to be sent to the LCD. When the command is served it
- * may take around 11 milliseconds, during which time the main loop will not be
- * able to do anything else such as respond to events.
+ * Only the characters which something has changed since they were last set
+ * to their defaults are sent, so if nothing has, this costs nothing. Otherwise
+ * it enqueues one special command to the display queue, which when served
+ * causes nine commands to be sent to the LCD for each character, one per pass
+ * of the main loop.
  *
- * This function is therefore intended to be called occasionally, for example
- * when an application has called another application which might have modified
- * CGRAM, and that called application has now returned. */
+ * This function is intended to be called when an application has called
+ * another application which might have modified CGRAM, and that called
+ * application has now returned. */
 int
 boz_display_reset_cgram_patterns(void);
 
+/* boz_display_glyph
+ * Make sure one of the eight user-defined characters contains the eight rows
+ * of pixels at "pattern", which must be in PROGMEM, and return its character
+ * code, 0 to 7. Write that code to the display to show the character.
+ *
+ * Characters are remembered by the address of their pattern, so if an app
+ * asks for the same pattern again while it's still there, no commands are
+ * sent. Otherwise the character that was asked for least recently is
+ * replaced, which takes nine display commands. When an app starts, the
+ * Bozzard's default characters (see boz_display_reset_cgram_patterns()) are
+ * replaced in the order 0, 7, 6, 5, 4, 3, 2, 1, so an app which asks for two
+ * characters of its own can still use the arrows.
+ *
+ * An app which asks for more than eight characters will find that some it
+ * asked for earlier have been replaced, including any still on the display.
+ *
+ * Returns -1 if the display queue doesn't have room for the nine commands,
+ * in which case nothing is changed. boz_display_set_cgram_address() makes
+ * this forget what was in the character it points to, and in every
+ * character after it, since writes can run on into those. */
+int
+boz_display_glyph(const byte *pattern);
+
 
 /******************************************************************************
  * SOUND
@@ -531,8 +778,26 @@ boz_display_reset_cgram_patterns(void);
  * Some of these calls take a parameter of type boz_note. The valid values
  * for this parameter are listed in boz_notes.h. For example, middle C is
  * the constant NOTE_C4.
+ *
+ * There are two sound queues: normal priority, which is the one the
+ * boz_sound_* functions use unless told otherwise, and high priority, which
+ * is for sounds that mustn't wait, like a buzzer noise. A high-priority
+ * sound starts on the next pass of the main loop, interrupting any
+ * normal-priority sound, which carries on from where it left off once the
+ * high-priority queue is empty. The high-priority queue is shorter.
  *****************************************************************************/
 
+#define BOZ_SOUND_PRIORITY_NORMAL 0
+#define BOZ_SOUND_PRIORITY_HIGH 1
+
+/* boz_sound_set_priority
+ * Make the boz_sound_* functions use the queue for the given priority,
+ * BOZ_SOUND_PRIORITY_NORMAL or BOZ_SOUND_PRIORITY_HIGH, until this is
+ * called again. Returns the priority they were using before. When an app
+ * is started, it's BOZ_SOUND_PRIORITY_NORMAL. */
+int
+boz_sound_set_priority(int priority);
+
 /* boz_sound_silence
  * Enqueue a command to play nothing for the given duration. */
 int
@@ -560,26 +825,46 @@ boz_sound_arpeggio(byte *notes, int num_notes, int duration_ms, byte num_times);
 /* boz_sound_stop
  * Interrupt the currently-playing sound command. The main loop will stop
  * playing whatever it's playing and move on to the next sound command in
- * the queue. */
+ * the queue. This only stops a sound from the queue for the current
+ * priority. */
 void
 boz_sound_stop(void);
 
 /* boz_sound_stop_all
  * Like sound_stop(), but also removes all pending sound commands from the
- * queue. */
+ * queue. At normal priority, this empties both queues, so it silences
+ * everything. At high priority, it only empties the high-priority queue,
+ * and any normal-priority sound it interrupted carries on. */
 void
 boz_sound_stop_all(void);
 
 /* boz_sound_square_bell
  * Enqueue the necessary command(s) to make a standard buzzer noise that sounds
- * almost, but not quite, entirely unlike a bell. which_buzzer must be between
- * 0 and 3 inclusive. This allows each buzzer noise to have a slightly
- * different pitch. */
+ * almost, but not quite, entirely unlike a bell. which_buzzer must be from 0
+ * to BOZ_NUM_BUZZERS - 1. This allows each buzzer noise to have a slightly
+ * different pitch. Buzzers with the same colour LED (see
+ * boz_leds_set_buzzers()) have the same pitch. */
 void
 boz_sound_square_bell(int which_buzzer);
 
 
 
+/******************************************************************************
+ * TIME
+ *****************************************************************************/
+
+/* boz_micros
+ * Return the number of microseconds since the Bozzard was switched on, as a
+ * boz_time, which is 64 bits and so won't wrap round for over half a million
+ * years. Unlike values of millis() and micros(), which wrap round after 49
+ * days and 71 minutes respectively, two boz_times can be compared with < and
+ * subtracted without worrying about that. The bottom 32 bits are micros().
+ *
+ * Clocks, alarms and the time of a button press are all boz_times. Don't
+ * call this from an interrupt handler. */
+boz_time
+boz_micros(void);
+
 /******************************************************************************
  * CLOCKS
  * 
@@ -588,7 +873,9 @@ boz_sound_square_bell(int which_buzzer);
  *
  * When it is created, it shows an initial value in milliseconds. When the
  * clock is started, its value increases or decreases, depending on which
- * direction the clock has been set to run in.
+ * direction the clock has been set to run in. It keeps time to the
+ * microsecond with boz_micros(), so stopping and starting it doesn't round
+ * its value to the millisecond each time.
  *
  * The clock may be stopped, restarted or reset to its initial value.
  * The clock may be set to deliver events to the application when certain
@@ -625,6 +912,23 @@ boz_clock_release(boz_clock clock);
 void
 boz_clock_run(boz_clock clock);
 
+/* boz_clock_run_at
+ * Like boz_clock_run(), but start the clock as if it had started at the
+ * given value of boz_micros(), which should be in the past, such as the value
+ * of boz_get_event_time() when a button was pressed. If that was before the
+ * clock last stopped, it starts from when it stopped. */
+void
+boz_clock_run_at(boz_clock clock, boz_time t);
+
+/* boz_clock_hand_over
+ * Stop the clock "from" and start the clock "to" at the same instant, which
+ * is the given value of boz_micros(), as with boz_clock_stop_at() and
+ * boz_clock_run_at(). Use this to switch from one player's clock to
+ * another's, so neither is charged for the time between the button press
+ * and its event handler. */
+void
+boz_clock_hand_over(boz_clock from, boz_clock to, boz_time t);
+
 /* boz_clock_running
  * Check whether a clock is currently running.
  * Return 1 if the clock is currently running, and 0 otherwise. */
@@ -637,6 +941,15 @@ boz_clock_running(boz_clock clock);
 void
 boz_clock_stop(boz_clock clock);
 
+/* boz_clock_stop_at
+ * Stop the clock on the value it had at the given value of boz_micros(),
+ * which should be in the past, such as the value of boz_get_event_time()
+ * when a buzzer was pressed. If that was before the clock last started, the
+ * clock stops on the value it started from. This has no effect if the clock
+ * is already stopped. */
+void
+boz_clock_stop_at(boz_clock clock, boz_time t);
+
 /* boz_clock_reset
  * Set the clock's value to its initial value. If the clock is currently
  * running, this call will NOT stop the clock.
@@ -658,6 +971,23 @@ boz_clock_set_direction(boz_clock clock, int direction_forwards);
 long
 boz_clock_value(boz_clock clock);
 
+/* boz_clock_value_at
+ * Return the value the clock had, in milliseconds, at the given value of
+ * boz_micros(), assuming it hasn't been stopped, reset or changed direction
+ * since. If the clock is stopped, return the value it's stopped on. */
+long
+boz_clock_value_at(boz_clock clock, boz_time t);
+
+/* boz_clock_time_at_value
+ * Return the value of boz_micros() at which the clock had, or will have, the
+ * given value, if it runs in its current direction without stopping from
+ * when it was last started, stopped or changed. If it had already reached
+ * that value then, return when that was. So for a clock which has stopped,
+ * boz_clock_time_at_value(clock, boz_clock_value(clock)) is when it
+ * stopped. */
+boz_time
+boz_clock_time_at_value(boz_clock clock, long value_ms);
+
 /* boz_clock_event_cookie
  * Set an arbitrary pointer ("cookie") which will be passed to this clock's
  * event callbacks. This is specific to this clock, and is independent of
@@ -763,6 +1093,86 @@ void
 boz_clock_add(boz_clock clock, long ms_to_add);
 
 
+/******************************************************************************
+ * CLOCK DISPLAYS
+ *
+ * A struct boz_clock_display shows the value of a boz_clock at a fixed place
+ * on the display, laid out according to an array of struct boz_clock_format
+ * (see boz_clock_display.h). It keeps the digits it last displayed, counts
+ * them round as the clock moves, and only sends the display the characters
+ * that have actually changed. So redrawing a running clock five times a
+ * second usually costs one cursor move and one character.
+ *
+ * The app owns the struct boz_clock_display, typically as part of its state.
+ * It remembers what it last wrote to the screen, so if the app clears the
+ * display, or writes over the clock, it must call
+ * boz_clock_display_invalidate() before the next update.
+ *****************************************************************************/
+
+/* boz_clock_display_init
+ * Set up a clock display for the given clock. Nothing is drawn until the
+ * first call to boz_clock_display_update().
+ *     clock: the clock whose value we're showing.
+ *     formats: PROGMEM array of formats. The last one must have an
+ *              abs_value_min of zero.
+ *     row, col: where on the display the clock value starts.
+ *     width: how many cells the clock display owns, which may be more than
+ *            the longest string the formats produce, up to
+ *            BOZ_CLOCK_DISPLAY_MAX_WIDTH. Unused cells are filled with
+ *            spaces.
+ */
+void
+boz_clock_display_init(struct boz_clock_display *disp, boz_clock clock,
+        const struct boz_clock_format *formats, int row, int col, int width);
+
+/* boz_clock_display_set_clock
+ * Show a different clock's value in this clock display. */
+void
+boz_clock_display_set_clock(struct boz_clock_display *disp, boz_clock clock);
+
+/* boz_clock_display_set_formats
+ * Use a different format array from now on. */
+void
+boz_clock_display_set_formats(struct boz_clock_display *disp,
+        const struct boz_clock_format *formats);
+
+/* boz_clock_display_move
+ * Move the clock display to a different position on the display. The whole
+ * value will be drawn at the new position on the next update, but the old
+ * position is not cleared. */
+void
+boz_clock_display_move(struct boz_clock_display *disp, int row, int col);
+
+/* boz_clock_display_invalidate
+ * Forget what's on the screen, so that the next update draws every cell.
+ * Call this after clearing the display. */
+void
+boz_clock_display_invalidate(struct boz_clock_display *disp);
+
+/* boz_clock_display_update
+ * Bring the display up to date with the clock's current value. */
+void
+boz_clock_display_update(struct boz_clock_display *disp);
+
+/* boz_clock_display_show_value
+ * Like boz_clock_display_update(), but show the given value in milliseconds
+ * rather than the clock's current value. */
+void
+boz_clock_display_show_value(struct boz_clock_display *disp, long value_ms);
+
+/* boz_clock_display_next_change
+ * Return the next clock value, after value_ms in the given direction, which
+ * the display would show differently from value_ms. Setting the clock's
+ * alarm for that value (see boz_clock_set_alarm()) redraws the display only
+ * when it would change, so a clock showing minutes and seconds wakes us up
+ * once a second rather than several times. This assumes each format's
+ * abs_value_min is a whole number of the units it shows, as the smallest
+ * unit the display shows changes on the boundary anyway. */
+long
+boz_clock_display_next_change(struct boz_clock_display *disp, long value_ms,
+        int direction_forwards);
+
+
 /******************************************************************************
  * ALARMS
  *
@@ -788,17 +1198,77 @@ boz_clock_add(boz_clock clock, long ms_to_add);
  * event handler is called. If the application wants a repeated alarm,
  * the event handler should manually re-attach itself by calling
  * boz_set_alarm().
+ *
+ * The alarm belongs to the app, so a background service, or a handler for
+ * one of its clocks, may not use it; from there this function does nothing.
+ * A service can use boz_service_set_next_run() instead.
  */
 void
 boz_set_alarm(long ms_from_now, void (*handler)(void *), void *cookie);
 
 /* boz_cancel_alarm
  * Cancel a pending alarm previously set by boz_set_alarm(). If no alarm was
- * set, this function has no effect. */
+ * set, or this is called from a background service, this function has no
+ * effect. */
 void
 boz_cancel_alarm();
 
 
+/******************************************************************************
+ * BACKGROUND SERVICES
+ *
+ * A background service is a function the main loop calls every so often,
+ * whatever app is in the foreground, even after the app that started it
+ * has exited or called another app. Use one for a low-priority job which
+ * should carry on alongside a game, like sending clock values to a PC.
+ *
+ * A service gets no button events. While it runs, any clocks it creates
+ * with boz_clock_create() and any memory it allocates with boz_mm_alloc()
+ * belong to the service, not to the app, and are released when the service
+ * stops. Handlers for a service's clocks are called as the service. So the
+ * service's cookie, and anything else it keeps, shouldn't be memory the app
+ * allocated, which goes when the app exits. The service can allocate its own
+ * the first time it runs.
+ *
+ * A service may not use the app's alarm (see boz_set_alarm()).
+ *
+ * The main loop runs at most one service per pass, after it has dealt with
+ * the buttons, so a service holds up the buttons by as long as it takes to
+ * run. The main loop can't interrupt it, so that's up to the service.
+ *****************************************************************************/
+
+/* boz_service_start
+ * Start a background service, which the main loop will call as
+ * run(cookie) every period_ms milliseconds, starting period_ms from now.
+ * budget_us is how long the service says it takes to run each time, which
+ * may be no more than BOZ_SERVICE_MAX_BUDGET_US (2000). The main loop checks
+ * this after each run, and if the service has taken longer than that
+ * BOZ_SERVICE_MAX_OVERRUNS (3) times in a row, the main loop stops it.
+ *
+ * If the main loop falls behind, it calls run() once, late, rather than
+ * calling it several times to catch up.
+ *
+ * Returns the service's number, for boz_service_stop(), or -1 if
+ * BOZ_MAX_SERVICES (2) services are already running or an argument is out
+ * of range. */
+int
+boz_service_start(void (*run)(void *cookie), void *cookie,
+        unsigned int period_ms, unsigned int budget_us);
+
+/* boz_service_stop
+ * Stop a background service and release its clocks and memory. A service
+ * can stop itself. */
+void
+boz_service_stop(int id);
+
+/* boz_service_set_next_run
+ * Called by a service while it runs, call it again ms_from_now milliseconds
+ * from now, rather than after its usual period. Has no effect if called from
+ * anything other than a service. */
+void
+boz_service_set_next_run(unsigned long ms_from_now);
+
+
 /******************************************************************************
  * NON-VOLATILE STORAGE (EEPROM)
  *
@@ -816,6 +1286,17 @@ boz_cancel_alarm();
  * At any point, an app may assume that its own EEPROM region contains EITHER:
  *     (a) data the app has previously written to that region, or
  *     (b) all 0xff.
+ *
+ * Each app's entry in the app list also gives the version of the layout of
+ * the data it keeps in its region. Whenever an app writes to its region, the
+ * region is stamped with that version. If an app later finds its region
+ * stamped with a different version (because the app has been upgraded and
+ * its layout version bumped), the region reads as all 0xff, and the old data
+ * is wiped when the app first writes to it. An app that knows how to convert
+ * data from an older layout can avoid this by calling
+ * boz_eeprom_get_region_version() before it reads anything.
+ *
+ * Upgrading the firmware does not by itself erase the EEPROM.
  * 
  *****************************************************************************/
 
@@ -826,6 +1307,20 @@ boz_cancel_alarm();
  */
 unsigned int boz_eeprom_get_region_size();
 
+/* boz_eeprom_get_region_version
+ * Return the layout version stamped on the currently-running app's EEPROM
+ * region when it was last written to, or 0xff if it has never been stamped.
+ * Data written by firmware older than the region versioning scheme is
+ * unstamped and is left for the app to validate, as before.
+ *
+ * Calling this tells the core the app will take responsibility for data
+ * stamped with an old version: its region will not then read as erased, and
+ * the app can read the old data, convert it and write it back, which stamps
+ * the region with the current version. An app that doesn't call this never
+ * sees data stamped with a version other than its own.
+ */
+int boz_eeprom_get_region_version();
+
 /* boz_eeprom_write
  * Write the "length" bytes pointed to by "data" to the EEPROM, starting
  * "eeprom_region_offset" bytes from the start of the app's own EEPROM region.
@@ -848,6 +1343,14 @@ unsigned int boz_eeprom_get_region_size();
  * It takes about 3.3ms to write a single EEPROM location (if its value needs
  * to change) so this call may block for a significant amount of time. This may
  * cause events to be missed.
+ *
+ * The first time an app writes to a region stamped with a different
+ * version, the whole region is erased first. After boz_eeprom_global_reset(),
+ * the main loop erases the EEPROM in the background, a location at a time,
+ * and if this function has to write anywhere it hasn't got to yet, it
+ * finishes the erase down to there first. Either way, the call can take
+ * longer still: a few hundred milliseconds for a stale region, and a few
+ * seconds straight after a global reset.
  */
 int boz_eeprom_write(unsigned int eeprom_region_offset, const void *data, unsigned int length);
 
@@ -876,6 +1379,11 @@ int boz_eeprom_read(unsigned int eeprom_region_offset, void *dest, unsigned int
    written.
    Note this resets the entire EEPROM, not just the region belonging to the
    currently-running application.
+   This function returns straight away, and the main loop erases the EEPROM
+   a byte at a time in the background, which takes a few seconds. Until it
+   has finished, every app's region reads as all 0xff. If an app writes to
+   its region before then, the rest of the erase is finished first, so that
+   call will block for a while.
    Return 0 on success and <0 on failure. */
 int boz_eeprom_global_reset();
 
@@ -905,7 +1413,7 @@ boz_get_version(void);
  * 
  * button_func:
  *     FUNC_BUZZER: one of the buzzers. buzzer_id identifies which one. This
- *                  must be an integer between 0 and 3 inclusive.
+ *                  must be an integer from 0 to BOZ_NUM_BUZZERS - 1.
  *     FUNC_PLAY:   the QM's play button.
  *     FUNC_YELLOW: the QM's yellow button.
  *     FUNC_RESET:  the QM's reset button.
@@ -923,22 +1431,73 @@ boz_get_version(void);
 int
 boz_is_button_pressed(int button_func, int buzzer_id, unsigned long *pressed_since_micros_r);
 
+/* boz_buzzers_pressed
+ * Return the set of buzzers which boz_is_button_pressed() would say are
+ * pressed.
+ */
+boz_buzzer_mask
+boz_buzzers_pressed(void);
+
 /* boz_get_battery_voltage
  * Return the voltage currently provided by the battery, in millivolts.
  * This is accomplished by a potential divider between the VIN pin, the A6 pin
  * (analogue input) and ground. The voltage on the A6 pin is half the voltage
- * at VIN. We read the analogue value at A6, double it and reference it to 5V
- * to get the voltage of VIN.
+ * at VIN. The ADC measures A6 about every two milliseconds in the background,
+ * and we keep a moving average of its readings, so this doesn't wait for
+ * the ADC and isn't thrown by momentary dips. We double the average and
+ * reference it to 5V to get the voltage of VIN.
  * Note that while we return the value in millivolts, that doesn't mean it's
- * accurate to the nearest millivolt! The analogRead() function returns a
- * number between 0 and 1023, so the resolution with a 5V reference is about
- * 5mV. We double this to take account of the fact that the voltage at A6 is
- * half that at VIN, so the return value should be considered to be roughly
- * accurate to about 10mV.
+ * accurate to the nearest millivolt! The ADC gives a number between 0 and
+ * 1023, so the resolution with a 5V reference is about 5mV. We double this
+ * to take account of the fact that the voltage at A6 is half that at VIN, so
+ * the return value should be considered to be roughly accurate to about
+ * 10mV.
  */
 int
 boz_get_battery_voltage(void);
 
+/* boz_get_battery_percent
+ * Return roughly how much of its capacity the battery has left, from 0 to
+ * 100, going by its voltage and the discharge curve of a 9V alkaline
+ * battery. If the voltage is too low for us to be running from the battery,
+ * we're probably running from USB, so return -1.
+ */
+int
+boz_get_battery_percent(void);
+
+/* boz_get_battery_minutes_left
+ * Return an estimate of how many minutes the Bozzard can run for before the
+ * battery is flat, from boz_get_battery_percent() and the current we
+ * typically draw. Return -1 if we're not running from the battery.
+ */
+int
+boz_get_battery_minutes_left(void);
+
+/* boz_is_battery_low
+ * Return 1 if we're running from the battery and it probably won't last
+ * another hour, 0 otherwise.
+ */
+int
+boz_is_battery_low(void);
+
+/* boz_get_adc_noise
+ * Return a number made from the noise the ADC picks up on an unconnected
+ * analogue pin, which changes every few milliseconds. It's good for seeding
+ * the random number generator, and not much else. Apps must not call
+ * analogRead(), because the ADC is busy measuring the battery.
+ */
+unsigned int
+boz_get_adc_noise(void);
+
+/* boz_get_worst_pass_us
+ * Return the longest time, in microseconds, any pass of the main loop has
+ * taken since the Bozzard was switched on, not counting time asleep. If a
+ * pass takes longer than BOZ_WATCHDOG_TIMEOUT and BOZ_WATCHDOG is defined,
+ * the watchdog resets the Bozzard (see boz_hw.h).
+ */
+unsigned long
+boz_get_worst_pass_us(void);
+
 /* boz_crash
  * Run the crash application, which displays a message on the screen and
  * sets the LEDs to the bottom four bits of the given pattern. The pattern
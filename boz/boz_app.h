@@ -2,6 +2,8 @@
 #define _APP_H
 
 #include "boz_hw.h"
+#include "boz_api.h"
+#include "boz_events.h"
 
 /* bits for boz_app.flags */
 
@@ -11,6 +13,11 @@
 /* Do not put the MCU to sleep while this app is running */
 #define BOZ_APP_NO_SLEEP 2
 
+/* values for app_context.eeprom_state */
+#define BOZ_EEPROM_REGION_UNCHECKED 0
+#define BOZ_EEPROM_REGION_VALID 1
+#define BOZ_EEPROM_REGION_STALE 2
+
 struct boz_app {
     int id;
     char name[16];
@@ -18,6 +25,51 @@ struct boz_app {
     unsigned int flags;
     unsigned int eeprom_start;
     unsigned int eeprom_length;
+
+    /* Version of the layout of the data this app keeps in its EEPROM region.
+     * Bump this when the app changes what it stores there, and any region
+     * stamped with an older version will be treated as erased the next time
+     * the app reads it, unless the app migrates it (see
+     * boz_eeprom_get_region_version()). Ignored if eeprom_length is zero. */
+    unsigned char eeprom_version;
+};
+
+/* Handler functions as they're stored in struct boz_event_handlers, which
+ * the main loop treats as an array indexed by event number: bit N of the
+ * event mask, and FUNC_* for the button events. */
+typedef void (*boz_event_handler_fn)(void);
+
+/* The main loop's buzzer arbitration state. Only the app at the top of the
+ * stack gets buzzes, so there's one of these, for whichever app that is. */
+struct arbitration_state {
+    /* The app's arbitration policy, if active is set. */
+    struct boz_arbitration policy;
+    char active;
+
+    /* The buzzers locked out by a win, and if the policy has an unlock_ms,
+     * when we'll unlock them. */
+    boz_buzzer_mask locked;
+    boz_time unlock_time;
+
+    /* The sides which have had their buzz, under BOZ_ARB_ONE_PER_SIDE. */
+    boz_buzzer_mask spent;
+};
+
+/* The alarm set with boz_set_alarm(). Like arbitration, only the app at the
+ * top of the stack has one running. If handler is not NULL, then when
+ * boz_micros() is equal or past time, the main loop will call
+ * handler(cookie), having set handler to NULL first. */
+struct app_alarm {
+    void *cookie;
+    boz_time time;
+    void (*handler)(void *cookie);
+};
+
+/* What an app had running in the foreground when it called another app, to
+ * be put back when the called app exits. */
+struct app_suspended {
+    struct app_alarm alarm;
+    struct arbitration_state arbitration;
 };
 
 struct app_context {
@@ -25,13 +77,6 @@ struct app_context {
      * that clock if the app exits without releasing it. */
     unsigned short clocks_enabled;
 
-    /* If alarm_handler is not NULL, then when millis() is equal or past
-     * alarm_time_millis, the main loop will call alarm_handler(alarm_cookie),
-     * having set alarm_handler to NULL first. */
-    void *alarm_handler_cookie;
-    unsigned long alarm_time_millis;
-    void (*alarm_handler)(void *cookie);
-
     /* If true, the MCU will not be put to sleep while this app is running. */
     char forbid_sleep;
 
@@ -40,48 +85,47 @@ struct app_context {
      * EEPROM. */
     unsigned int eeprom_start, eeprom_length;
 
-    /* Opaque pointer passed to all the event_* handlers that handle
-     * button presses. */
-    void *event_cookie;
-
-    /* Event handlers to do with button presses are "sticky" - that is, once
-     * the event handler has returned, the app will continue to receive
-     * events until they are explicitly cancelled by setting the handler to
-     * NULL. */
-
-    /* Contestant presses buzzer */
-    void (*event_buzz)(void *cookie, int which_buzzer);
+    /* This app's ID and the current version of its EEPROM region's layout,
+     * copied from its struct boz_app. */
+    unsigned char app_id;
+    unsigned char eeprom_version;
 
-    /* QM presses PLAY (>) button */
-    void (*event_qm_play)(void *cookie);
+    /* BOZ_EEPROM_REGION_UNCHECKED until the app first touches its EEPROM
+     * region, at which point we compare the version stamped on the region
+     * with eeprom_version and set this to BOZ_EEPROM_REGION_VALID or
+     * BOZ_EEPROM_REGION_STALE. */
+    unsigned char eeprom_state;
 
-    /* QM presses YELLOW button */
-    void (*event_qm_yellow)(void *cookie);
-
-    /* QM presses RESET button */
-    void (*event_qm_reset)(void *cookie);
+    /* Opaque pointer passed to all the event handlers. */
+    void *event_cookie;
 
-    /* QM turns rotary encoder one step clockwise or anticlockwise */
-    void (*event_qm_rotary)(void *cookie, int clockwise);
+    /* The app's event handlers, a PROGMEM table set with
+     * boz_set_event_handlers(), or NULL if it hasn't set one. */
+    const struct boz_event_handlers *event_handlers;
 
-    /* QM presses rotary encoder's pushbutton */
-    void (*event_qm_rotary_press)(void *cookie);
+    /* Which of those handlers are enabled: bit N (BOZ_EVENT_*) is the Nth
+     * handler in the table. Event handlers to do with button presses are
+     * "sticky" - once enabled, the app will continue to receive events until
+     * they are explicitly disabled. */
+    unsigned int event_mask;
 
-    /* Sound queue has space in it. This event handler will detach itself
-     * immediately before being called. If the application wants to continue
-     * to receive events about the sound queue not being full, it must
-     * re-attach itself in the event handler. */
-    void (*event_sound_queue_not_full)(void *cookie);
+    /* If set, rotary steps taken quickly count extra when passed to the
+     * qm_rotary_steps handler. */
+    char rotary_acceleration;
 
-#ifdef BOZ_SERIAL
-    /* Data is available to read on the serial port */
-    void (*event_serial_data_available)(void *cookie);
-#endif
+    /* If this app had an alarm set or an arbitration policy when it called
+     * another app, those as they were then, allocated in this app's memory
+     * context. Otherwise NULL. */
+    struct app_suspended *suspended;
 
     /* If this app has called another one, we'll call this handler when the
      * called app returns. */
     void *app_call_return_cookie;
     void (*app_call_return_handler)(void *, int);
+
+    /* If this app called another with boz_app_call_resume(), the handler
+     * to call, with app_call_return_cookie, when it returns. */
+    void (*app_call_resume)(void *);
 };
 
 #endif
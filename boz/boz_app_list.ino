@@ -12,8 +12,8 @@ const PROGMEM struct boz_app app_list[] = {
 #ifdef BOZ_SERIAL
     { BOZ_APP_ID_PC_CONTROL, "PC control", pcc_init, BOZ_APP_MAIN | BOZ_APP_NO_SLEEP, 0, 0 },
 #else
-    { BOZ_APP_ID_CONUNDRUM, "Conundrum", conundrum_init, BOZ_APP_MAIN, 0x40, 64, },
-    { BOZ_APP_ID_BUZZER_GAME, "Buzzer game", buzzer_game_init, BOZ_APP_MAIN, 0x80, 64 },
+    { BOZ_APP_ID_CONUNDRUM, "Conundrum", conundrum_init, BOZ_APP_MAIN, 0x40, 64, 1 },
+    { BOZ_APP_ID_BUZZER_GAME, "Buzzer game", buzzer_game_init, BOZ_APP_MAIN, 0x80, 64, 1 },
     { BOZ_APP_ID_CHESS_CLOCKS, "Chess clocks", chess_init, BOZ_APP_MAIN, 0, 0 },
 #endif
 
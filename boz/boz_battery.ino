@@ -0,0 +1,162 @@
+#include "boz_api.h"
+#include "boz_pins.h"
+
+#include <avr/pgmspace.h>
+
+/* The battery voltage is measured in the background. The ADC starts a
+   conversion every time timer 0 overflows, which is about once a
+   millisecond, and its interrupt handler folds each reading into a moving
+   average. So reading the battery voltage never waits for the ADC, and
+   the average irons out the dips when the speaker or the LEDs come on.
+
+   Conversions alternate between the battery sensor and A7, which isn't
+   connected to anything. A7's readings are noise, which we keep for seeding
+   the random number generator, since we can't call analogRead() on it while
+   the ADC is running on its own. */
+
+/* ADC channels for the battery sensor and the unconnected pin */
+#define BATTERY_ADC_CHANNEL (PIN_BATTERY_SENSOR - A0)
+#define NOISE_ADC_CHANNEL (A7 - A0)
+
+/* The moving average is kept multiplied by 2^BATTERY_EMA_SHIFT, and each
+   new reading has a weight of 1 / 2^BATTERY_EMA_SHIFT. With one battery
+   reading every two milliseconds, it takes about an eighth of a second to
+   follow a change in voltage. 1023 << 6 still fits in 16 bits. */
+#define BATTERY_EMA_SHIFT 6
+
+/* If the voltage at VIN is below this, we'll assume we're running from USB
+   and the battery isn't switched on. The Arduino Nano can run with 7V-12V at
+   VIN. The Bozzard control unit has a 9V supply. */
+#define BATTERY_MIN_MV 6000
+
+/* What we assume about the battery when working out how long it has left:
+   a 9V alkaline battery, and the current the Nano, the display's backlight
+   and the LEDs draw between them, on average. */
+#define BATTERY_CAPACITY_MAH 550
+#define BATTERY_CURRENT_MA 40
+
+/* If boz_get_battery_minutes_left() is less than this, the battery is low */
+#define BATTERY_LOW_MINUTES 60
+
+volatile unsigned int battery_ema = 0;
+volatile unsigned int adc_noise = 0;
+
+void
+boz_battery_init(void) {
+    /* Start the average from one reading taken the slow way */
+    battery_ema = (unsigned int) analogRead(PIN_BATTERY_SENSOR) << BATTERY_EMA_SHIFT;
+
+    /* AVcc reference, battery sensor first. Trigger on timer 0 overflow,
+       with the interrupt on, and the ADC clock at 16MHz / 128. */
+    ADMUX = (1 << REFS0) | BATTERY_ADC_CHANNEL;
+    ADCSRB = (1 << ADTS2);
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) |
+        (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+ISR(ADC_vect) {
+    unsigned int reading = ADC;
+
+    /* The next conversion won't start until timer 0 next overflows, so we
+       can switch channels for it now. */
+    if ((ADMUX & 0x0f) == BATTERY_ADC_CHANNEL) {
+        battery_ema += reading - (battery_ema >> BATTERY_EMA_SHIFT);
+        ADMUX = (1 << REFS0) | NOISE_ADC_CHANNEL;
+    }
+    else {
+        adc_noise = ((adc_noise << 1) | (adc_noise >> 15)) ^ reading;
+        ADMUX = (1 << REFS0) | BATTERY_ADC_CHANNEL;
+    }
+}
+
+int
+boz_get_battery_voltage(void) {
+    unsigned int ema;
+
+    noInterrupts();
+    ema = battery_ema;
+    interrupts();
+
+    /* The average reading is between 0 and 1023, which represents a voltage
+       between 0 and 5V. The voltage on this pin is in the middle of a
+       potential divider between VIN and GND, so it's half the voltage at VIN.
+       So if the average is 0, the voltage is 0V, and if it's 1023, it's 10V.
+       We return the answer in millivolts. */
+    return (int) ((10000L * ema) / (1023L << BATTERY_EMA_SHIFT));
+}
+
+/* How much of its capacity a battery has left at each voltage, from 0% to
+   100% in steps of 20%, in centivolts.
+   Our minimum voltage (0%) is 7 volts because anything less than that is
+   outside the spec for the Arduino.
+   Our maximum voltage (100%) we'll call 9.3 volts, because a brand-new 9V
+   battery usually supplies about that.
+   The voltages corresponding to 20%, 40%, 60%, 80% are guessed from a Duracell
+   datasheet. */
+const PROGMEM int voltage_per_20_percent[] = {
+    //   0%  20%  40%  60%  80%  100%
+        700, 730, 755, 770, 825, 930
+};
+
+static byte voltage_to_percent(int centivolts) {
+    int left_threshold, right_threshold;
+    byte left_threshold_percent, right_threshold_percent;
+    byte quintile;
+
+    left_threshold = 0;
+    for (quintile = 0; quintile < 6; ++quintile) {
+        right_threshold = pgm_read_word_near(&voltage_per_20_percent[(int) quintile]);
+        if (centivolts < right_threshold) {
+            break;
+        }
+        left_threshold = right_threshold;
+    }
+
+    /* percentage is between the one represented by left_threshold and the one
+       represented by right_threshold - from here we'll linearly interpolate */
+
+    if (quintile == 0)
+        return 0;
+
+    if (quintile >= 6)
+        return 100;
+
+    right_threshold_percent = (byte) (quintile * 20);
+    left_threshold_percent = right_threshold_percent - 20;
+    return (byte) map(centivolts, left_threshold, right_threshold, left_threshold_percent, right_threshold_percent);
+}
+
+int
+boz_get_battery_percent(void) {
+    int millivolts = boz_get_battery_voltage();
+
+    if (millivolts < BATTERY_MIN_MV)
+        return -1;
+    return voltage_to_percent((millivolts + 5) / 10);
+}
+
+int
+boz_get_battery_minutes_left(void) {
+    int percent = boz_get_battery_percent();
+
+    if (percent < 0)
+        return -1;
+    return (int) ((long) percent * BATTERY_CAPACITY_MAH * 60 / (100L * BATTERY_CURRENT_MA));
+}
+
+int
+boz_is_battery_low(void) {
+    int minutes = boz_get_battery_minutes_left();
+
+    return minutes >= 0 && minutes < BATTERY_LOW_MINUTES;
+}
+
+unsigned int
+boz_get_adc_noise(void) {
+    unsigned int noise;
+
+    noInterrupts();
+    noise = adc_noise;
+    interrupts();
+    return noise;
+}
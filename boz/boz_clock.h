@@ -1,6 +1,8 @@
 #ifndef _BOZ_CLOCK_H
 #define _BOZ_CLOCK_H
 
+#include "boz_util.h"
+
 struct boz_clock_s {
     /* id of this clock, for the main loop */
     int id;
@@ -15,14 +17,20 @@ struct boz_clock_s {
     long min_ms;
     long max_ms;
 
-    /* If running, this is the clock's value when millis() returned
-     * last_value_ard_ms.
+    /* If running, this is the clock's value at last_value_time, give or
+     * take last_value_us.
      * If not running, this is the clock's value. */
     long last_value_ms;
 
-    /* If running, the return value of millis() when last_value_ms was the
-     * clock's value. */
-    unsigned long last_value_ard_millis;
+    /* How many microseconds, up to 999, the clock had run past
+     * last_value_ms in its direction, so starting and stopping it doesn't
+     * lose the fraction of a millisecond each time. */
+    unsigned int last_value_us;
+
+    /* If running, the value of boz_micros() when last_value_ms was the
+     * clock's value. If not running, the value of boz_micros() when it
+     * stopped. */
+    boz_time last_value_time;
 
     /* If alarm_enabled is set, then when the current value of the clock has
      * reached or passed alarm_ms ("passed" takes account of whether the clock
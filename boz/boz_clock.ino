@@ -11,6 +11,8 @@ boz_clock_init(boz_clock clock, int id, long initial_value_ms, int direction_for
     clock->id = id;
 
     clock->last_value_ms = initial_value_ms;
+    clock->last_value_us = 0;
+    clock->last_value_time = boz_micros();
     clock->direction = direction_forwards ? FORWARDS : BACKWARDS;
 
     clock->event_cookie = NULL;
@@ -19,14 +21,79 @@ boz_clock_init(boz_clock clock, int id, long initial_value_ms, int direction_for
     clock->event_alarm = NULL;
 }
 
+/* Return the value a running clock has at t, which mustn't be before
+   last_value_time, without applying its minimum or maximum, and put how
+   many microseconds it's run past that in *us. */
+static long
+clock_value_unlimited(boz_clock clock, boz_time t, unsigned int *us) {
+    boz_time run_us = t - clock->last_value_time + clock->last_value_us;
+    unsigned long run_ms;
+
+    if (run_us <= 0xffffffffUL) {
+        /* It's run for less than 71 minutes since it was last started,
+           stopped or changed, which is nearly always, so 32-bit arithmetic
+           will do */
+        unsigned long run_us_32 = (unsigned long) run_us;
+        run_ms = run_us_32 / 1000;
+        *us = (unsigned int) (run_us_32 - run_ms * 1000);
+    }
+    else {
+        run_ms = (unsigned long) (run_us / 1000);
+        *us = (unsigned int) (run_us - (boz_time) run_ms * 1000);
+    }
+
+    if (clock->direction == FORWARDS)
+        return clock->last_value_ms + (long) run_ms;
+    else
+        return clock->last_value_ms - (long) run_ms;
+}
+
+/* Set last_value_ms and last_value_us to the running clock's value at t,
+   and last_value_time to t. If t is before last_value_time, leave it where
+   it was. */
+static void
+clock_settle(boz_clock clock, boz_time t) {
+    unsigned int us;
+    long value_ms;
+
+    if (t < clock->last_value_time)
+        return;
+    value_ms = clock_value_unlimited(clock, t, &us);
+    if (clock->min_enabled && value_ms < clock->min_ms) {
+        value_ms = clock->min_ms;
+        us = 0;
+    }
+    else if (clock->max_enabled && value_ms > clock->max_ms) {
+        value_ms = clock->max_ms;
+        us = 0;
+    }
+    clock->last_value_ms = value_ms;
+    clock->last_value_us = us;
+    clock->last_value_time = t;
+}
+
 void
 boz_clock_run(boz_clock clock) {
+    boz_clock_run_at(clock, boz_micros());
+}
+
+void
+boz_clock_run_at(boz_clock clock, boz_time t) {
     if (!clock->running) {
+        /* Don't let it start before it stopped */
+        if (t < clock->last_value_time)
+            t = clock->last_value_time;
         clock->running = 1;
-        clock->last_value_ard_millis = millis();
+        clock->last_value_time = t;
     }
 }
 
+void
+boz_clock_hand_over(boz_clock from, boz_clock to, boz_time t) {
+    boz_clock_stop_at(from, t);
+    boz_clock_run_at(to, t);
+}
+
 int
 boz_clock_running(boz_clock clock) {
     return clock->running;
@@ -39,44 +106,59 @@ boz_clock_is_direction_forwards(boz_clock clock) {
 
 void
 boz_clock_stop(boz_clock clock) {
+    boz_clock_stop_at(clock, boz_micros());
+}
+
+void
+boz_clock_stop_at(boz_clock clock, boz_time t) {
     if (clock->running) {
-        unsigned long ms = millis();
-        clock->last_value_ms = boz_clock_value_at(clock, ms);
+        /* If t is before the clock last started, stop it where it started */
+        clock_settle(clock, t);
         clock->running = 0;
-        clock->last_value_ard_millis = ms;
     }
 }
 
 void
 boz_clock_reset(boz_clock clock) {
     clock->last_value_ms = clock->initial_value_ms;
-    clock->last_value_ard_millis = millis();
+    clock->last_value_us = 0;
+
+    /* If it's stopped, leave last_value_time as when it stopped, so
+       boz_clock_run_at() can start it again from then */
+    if (clock->running)
+        clock->last_value_time = boz_micros();
 }
 
 void
 boz_clock_set_direction(boz_clock clock, int direction_forwards) {
+    unsigned int direction = direction_forwards ? FORWARDS : BACKWARDS;
+
     /* Update last_value_ms to the current value */
-    unsigned long now_ms = millis();
-    clock->last_value_ms = boz_clock_value_at(clock, now_ms);
-    clock->last_value_ard_millis = now_ms;
+    if (clock->running)
+        clock_settle(clock, boz_micros());
 
-    /* Change direction */
-    clock->direction = direction_forwards ? FORWARDS : BACKWARDS;
+    /* Change direction. If the clock had run part of a millisecond past
+       last_value_ms, count that part back from the millisecond after it
+       instead, so it isn't lost. */
+    if (direction != clock->direction && clock->last_value_us) {
+        clock->last_value_ms += (clock->direction == FORWARDS) ? 1 : -1;
+        clock->last_value_us = 1000 - clock->last_value_us;
+    }
+    clock->direction = direction;
 }
 
 long
-boz_clock_value_at(boz_clock clock, unsigned long now_ms_ard) {
+boz_clock_value_at(boz_clock clock, boz_time t) {
     if (!clock->running) {
         return clock->last_value_ms;
     }
+    else if (t < clock->last_value_time) {
+        /* Asked about a time before the clock last started */
+        return clock->last_value_ms;
+    }
     else {
-        long value_ms = clock->last_value_ms;
-        if (clock->direction == FORWARDS) {
-            value_ms += time_elapsed(clock->last_value_ard_millis, now_ms_ard);
-        }
-        else {
-            value_ms -= time_elapsed(clock->last_value_ard_millis, now_ms_ard);
-        }
+        unsigned int us;
+        long value_ms = clock_value_unlimited(clock, t, &us);
 
         if (clock->min_enabled && value_ms < clock->min_ms)
             return clock->min_ms;
@@ -87,9 +169,25 @@ boz_clock_value_at(boz_clock clock, unsigned long now_ms_ard) {
     }
 }
 
+boz_time
+boz_clock_time_at_value(boz_clock clock, long value_ms) {
+    long elapsed_ms;
+
+    if (clock->direction == FORWARDS)
+        elapsed_ms = value_ms - clock->last_value_ms;
+    else
+        elapsed_ms = clock->last_value_ms - value_ms;
+
+    /* If it was already at or past value_ms when it started, say it got
+       there when it started */
+    if (elapsed_ms <= 0)
+        return clock->last_value_time;
+    return clock->last_value_time + (boz_time) elapsed_ms * 1000 - clock->last_value_us;
+}
+
 long
 boz_clock_value(boz_clock clock) {
-    return boz_clock_value_at(clock, millis());
+    return boz_clock_value_at(clock, boz_micros());
 }
 
 void
@@ -169,7 +267,7 @@ boz_clock_get_ms_until_alarm(boz_clock clock) {
 
 void
 boz_clock_add(boz_clock clock, long ms_to_add) {
-    long mil = millis();
-    clock->last_value_ms = boz_clock_value_at(clock, mil) + ms_to_add;
-    clock->last_value_ard_millis = mil;
+    if (clock->running)
+        clock_settle(clock, boz_micros());
+    clock->last_value_ms += ms_to_add;
 }
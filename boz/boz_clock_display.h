@@ -0,0 +1,66 @@
+#ifndef _BOZ_CLOCK_DISPLAY_H
+#define _BOZ_CLOCK_DISPLAY_H
+
+#include "boz_clock.h"
+
+/* Maximum number of display cells a struct boz_clock_display can look after */
+#define BOZ_CLOCK_DISPLAY_MAX_WIDTH 10
+
+/* How to lay out a clock value on the display. A format array is a PROGMEM
+ * array of these in descending order of abs_value_min, and the format used
+ * for a value is the first one whose abs_value_min is less than or equal to
+ * the absolute value of the clock. The last element must have an
+ * abs_value_min of zero. */
+struct boz_clock_format {
+    long abs_value_min;
+    unsigned int leading_spaces : 4;
+    unsigned int trailing_spaces : 4;
+    unsigned int show_sign : 1;
+    unsigned int show_hours : 1;
+    unsigned int show_hour_colon : 1;
+
+    /* If show_hours is not set, the minutes field shows the total number of
+     * minutes rather than the minutes past the hour. */
+    unsigned int show_minutes : 1;
+    unsigned int minutes_zero_pad : 1;
+    unsigned int minutes_field_width : 2;
+    unsigned int show_minutes_colon : 1;
+
+    /* Likewise, if show_minutes is not set, the seconds field shows the total
+     * number of seconds. */
+    unsigned int show_seconds : 1;
+    unsigned int seconds_zero_pad : 1;
+    unsigned int seconds_field_width : 2;
+    unsigned int show_decimal_point : 1;
+
+    /* Number of digits after the seconds: 1 for tenths, 3 for milliseconds */
+    unsigned int fraction_digits : 2;
+};
+
+/* A clock value on the display, which remembers which digits it last put
+ * there. Apps should treat the contents as private and use the
+ * boz_clock_display_* functions in boz_api.h. */
+struct boz_clock_display {
+    boz_clock clock;
+
+    /* PROGMEM array of formats, and the index of the one in use, or -1 if
+     * the digits need working out from scratch. */
+    const struct boz_clock_format *formats;
+    char format_index;
+
+    /* The absolute value the digits represent, truncated to the smallest
+     * unit the current format shows, and whether the value is negative. */
+    long base_ms;
+    byte negative;
+
+    /* Hours (binary), then one BCD digit each for tens of minutes, minutes,
+     * tens of seconds, seconds, tenths, hundredths and thousandths. */
+    byte digits[8];
+
+    /* Where on the display we are, how many cells we own, and what we last
+     * wrote in each of them. A zero means we don't know. */
+    byte row, col, width;
+    char cells[BOZ_CLOCK_DISPLAY_MAX_WIDTH];
+};
+
+#endif
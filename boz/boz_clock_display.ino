@@ -0,0 +1,328 @@
+#include "boz_api.h"
+#include "boz_clock_display.h"
+
+#include <avr/pgmspace.h>
+
+/* Indices into struct boz_clock_display.digits */
+#define CD_HOURS 0
+#define CD_MIN_TENS 1
+#define CD_MIN_UNITS 2
+#define CD_SEC_TENS 3
+#define CD_SEC_UNITS 4
+#define CD_TENTHS 5
+
+/* If the clock has moved more than this many of the smallest displayed unit
+   since we last looked, don't bother counting the digits round one at a
+   time - work them out from scratch. */
+#define CD_MAX_STEPS 16
+
+/* Value at which each digit carries into the next one up. The hours digit
+   is binary and saturates at 255. */
+const PROGMEM byte cd_digit_limit[] = { 0, 6, 10, 6, 10, 10, 10, 10 };
+
+/* Number of milliseconds represented by one unit of each digit */
+const PROGMEM long cd_digit_unit_ms[] = {
+    3600000L, 600000L, 60000L, 10000L, 1000L, 100L, 10L, 1L
+};
+
+/* Index of the smallest digit this format shows */
+static byte cd_smallest_digit(const struct boz_clock_format *format) {
+    if (format->fraction_digits)
+        return CD_TENTHS - 1 + format->fraction_digits;
+    else if (format->show_seconds)
+        return CD_SEC_UNITS;
+    else if (format->show_minutes)
+        return CD_MIN_UNITS;
+    else
+        return CD_HOURS;
+}
+
+/* Work out all the digits for abs_ms from scratch, truncated to the digit
+   at index "smallest". This is the only place we do any 32-bit division. */
+static void cd_set_digits(struct boz_clock_display *disp, long abs_ms, byte smallest) {
+    byte *d = disp->digits;
+    unsigned long hours = abs_ms / 3600000L;
+    unsigned long rem = abs_ms - hours * 3600000L;
+    byte minutes = (byte) (rem / 60000L);
+    unsigned int ms = (unsigned int) (rem - minutes * 60000L);
+    byte seconds = (byte) (ms / 1000);
+
+    ms -= seconds * 1000U;
+    d[CD_HOURS] = hours > 255 ? 255 : (byte) hours;
+    d[CD_MIN_TENS] = minutes / 10;
+    d[CD_MIN_UNITS] = minutes % 10;
+    d[CD_SEC_TENS] = seconds / 10;
+    d[CD_SEC_UNITS] = seconds % 10;
+    d[CD_TENTHS] = ms / 100;
+    d[CD_TENTHS + 1] = (ms / 10) % 10;
+    d[CD_TENTHS + 2] = ms % 10;
+
+    /* Digits smaller than the format shows are zero, so that base_ms is
+       exactly the value the digits represent. */
+    for (byte i = smallest + 1; i < sizeof(disp->digits); ++i)
+        d[i] = 0;
+    disp->base_ms = d[CD_HOURS] * 3600000L +
+        (d[CD_MIN_TENS] * 10 + d[CD_MIN_UNITS]) * 60000L +
+        (d[CD_SEC_TENS] * 10 + d[CD_SEC_UNITS]) * 1000L +
+        d[CD_TENTHS] * 100 + d[CD_TENTHS + 1] * 10 + d[CD_TENTHS + 2];
+}
+
+/* Add one unit to the digit at index i, carrying as necessary */
+static void cd_increment(byte *d, byte i) {
+    while (i > CD_HOURS) {
+        if (++d[i] < pgm_read_byte_near(&cd_digit_limit[i]))
+            return;
+        d[i] = 0;
+        --i;
+    }
+    if (d[CD_HOURS] < 255)
+        d[CD_HOURS]++;
+}
+
+/* Take one unit off the digit at index i, borrowing as necessary. The value
+   the digits represent must be at least one unit. */
+static void cd_decrement(byte *d, byte i) {
+    while (i > CD_HOURS) {
+        if (d[i] > 0) {
+            d[i]--;
+            return;
+        }
+        d[i] = pgm_read_byte_near(&cd_digit_limit[i]) - 1;
+        --i;
+    }
+    d[CD_HOURS]--;
+}
+
+static void cd_put(char *cells, byte *pos, char c) {
+    if (*pos < BOZ_CLOCK_DISPLAY_MAX_WIDTH)
+        cells[(*pos)++] = c;
+}
+
+/* Put a number in cells, right-aligned in a field at least "width" wide.
+   Used for the hours and for totals, which don't come straight out of a
+   pair of BCD digits. */
+static void cd_put_number(char *cells, byte *pos, unsigned int n, byte width, byte zero_pad) {
+    char str[5];
+    byte len = 0;
+
+    do {
+        str[len++] = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    while (width > len) {
+        cd_put(cells, pos, zero_pad ? '0' : ' ');
+        --width;
+    }
+    while (len > 0)
+        cd_put(cells, pos, str[--len]);
+}
+
+/* Put a two-digit BCD field in cells, padded to "width" */
+static void cd_put_pair(char *cells, byte *pos, byte tens, byte units, byte width, byte zero_pad) {
+    for (; width > 2; --width)
+        cd_put(cells, pos, zero_pad ? '0' : ' ');
+    if (tens != 0)
+        cd_put(cells, pos, '0' + tens);
+    else if (width == 2)
+        cd_put(cells, pos, zero_pad ? '0' : ' ');
+    cd_put(cells, pos, '0' + units);
+}
+
+static byte cd_render(const struct boz_clock_display *disp,
+        const struct boz_clock_format *format, char *cells) {
+    const byte *d = disp->digits;
+    byte pos = 0;
+    unsigned int total_minutes = d[CD_HOURS] * 60 + d[CD_MIN_TENS] * 10 + d[CD_MIN_UNITS];
+
+    for (byte i = 0; i < format->leading_spaces; ++i)
+        cd_put(cells, &pos, ' ');
+    if (format->show_sign)
+        cd_put(cells, &pos, disp->negative ? '-' : ' ');
+    if (format->show_hours)
+        cd_put_number(cells, &pos, d[CD_HOURS], 1, 0);
+    if (format->show_hour_colon)
+        cd_put(cells, &pos, ':');
+    if (format->show_minutes) {
+        if (format->show_hours || d[CD_HOURS] == 0)
+            cd_put_pair(cells, &pos, d[CD_MIN_TENS], d[CD_MIN_UNITS],
+                    format->minutes_field_width, format->minutes_zero_pad);
+        else
+            cd_put_number(cells, &pos, total_minutes,
+                    format->minutes_field_width, format->minutes_zero_pad);
+    }
+    if (format->show_minutes_colon)
+        cd_put(cells, &pos, ':');
+    if (format->show_seconds) {
+        if (format->show_minutes || total_minutes == 0) {
+            cd_put_pair(cells, &pos, d[CD_SEC_TENS], d[CD_SEC_UNITS],
+                    format->seconds_field_width, format->seconds_zero_pad);
+        }
+        else {
+            unsigned long total_seconds = total_minutes * 60UL +
+                d[CD_SEC_TENS] * 10 + d[CD_SEC_UNITS];
+            cd_put_number(cells, &pos,
+                    total_seconds > 65535UL ? 65535U : (unsigned int) total_seconds,
+                    format->seconds_field_width, format->seconds_zero_pad);
+        }
+    }
+    if (format->show_decimal_point)
+        cd_put(cells, &pos, '.');
+    for (byte i = 0; i < format->fraction_digits; ++i)
+        cd_put(cells, &pos, '0' + d[CD_TENTHS + i]);
+    for (byte i = 0; i < format->trailing_spaces; ++i)
+        cd_put(cells, &pos, ' ');
+
+    return pos;
+}
+
+void
+boz_clock_display_init(struct boz_clock_display *disp, boz_clock clock,
+        const struct boz_clock_format *formats, int row, int col, int width) {
+    disp->clock = clock;
+    disp->formats = formats;
+    disp->format_index = -1;
+    disp->row = row;
+    disp->col = col;
+    if (width > BOZ_CLOCK_DISPLAY_MAX_WIDTH)
+        width = BOZ_CLOCK_DISPLAY_MAX_WIDTH;
+    disp->width = width;
+    boz_clock_display_invalidate(disp);
+}
+
+void
+boz_clock_display_set_clock(struct boz_clock_display *disp, boz_clock clock) {
+    disp->clock = clock;
+    disp->format_index = -1;
+}
+
+void
+boz_clock_display_set_formats(struct boz_clock_display *disp,
+        const struct boz_clock_format *formats) {
+    if (disp->formats != formats) {
+        disp->formats = formats;
+        disp->format_index = -1;
+    }
+}
+
+void
+boz_clock_display_move(struct boz_clock_display *disp, int row, int col) {
+    if (disp->row != row || disp->col != col) {
+        disp->row = row;
+        disp->col = col;
+        boz_clock_display_invalidate(disp);
+    }
+}
+
+void
+boz_clock_display_invalidate(struct boz_clock_display *disp) {
+    memset(disp->cells, 0, sizeof(disp->cells));
+}
+
+/* Copy the first format in disp->formats suitable for abs_ms into *format,
+   and return its index */
+static char cd_find_format(const struct boz_clock_display *disp, long abs_ms,
+        struct boz_clock_format *format) {
+    const struct boz_clock_format *formatp = disp->formats;
+    char format_index = 0;
+
+    while (abs_ms < (long) pgm_read_dword_near(&formatp->abs_value_min)) {
+        ++formatp;
+        ++format_index;
+    }
+    memcpy_P(format, formatp, sizeof(*format));
+    return format_index;
+}
+
+void
+boz_clock_display_show_value(struct boz_clock_display *disp, long value_ms) {
+    struct boz_clock_format format;
+    char cells[BOZ_CLOCK_DISPLAY_MAX_WIDTH];
+    byte negative = (value_ms < 0);
+    long abs_ms = negative ? -value_ms : value_ms;
+    char format_index;
+    byte smallest, len, cursor;
+
+    format_index = cd_find_format(disp, abs_ms, &format);
+    smallest = cd_smallest_digit(&format);
+
+    if (format_index != disp->format_index || negative != disp->negative) {
+        cd_set_digits(disp, abs_ms, smallest);
+    }
+    else {
+        /* Count the digits round to the new value, which is usually only
+           one or two units away from where they were. */
+        long unit = pgm_read_dword_near(&cd_digit_unit_ms[smallest]);
+        long rem = abs_ms - disp->base_ms;
+        byte steps = 0;
+
+        while (rem >= unit && steps < CD_MAX_STEPS) {
+            cd_increment(disp->digits, smallest);
+            disp->base_ms += unit;
+            rem -= unit;
+            ++steps;
+        }
+        while (rem < 0 && steps < CD_MAX_STEPS) {
+            cd_decrement(disp->digits, smallest);
+            disp->base_ms -= unit;
+            rem += unit;
+            ++steps;
+        }
+        if (steps >= CD_MAX_STEPS)
+            cd_set_digits(disp, abs_ms, smallest);
+    }
+    disp->format_index = format_index;
+    disp->negative = negative;
+
+    /* Only send the display the cells that have changed */
+    len = cd_render(disp, &format, cells);
+    cursor = 0xff;
+    for (byte i = 0; i < disp->width; ++i) {
+        char c = (i < len) ? cells[i] : ' ';
+        if (disp->cells[i] == c)
+            continue;
+        if (cursor != i && boz_display_set_cursor(disp->row, disp->col + i)) {
+            /* Display queue is full - we'll try again next time */
+            break;
+        }
+        if (boz_display_write_char(c)) {
+            cursor = 0xff;
+            disp->cells[i] = 0;
+            break;
+        }
+        disp->cells[i] = c;
+        cursor = i + 1;
+    }
+}
+
+void
+boz_clock_display_update(struct boz_clock_display *disp) {
+    boz_clock_display_show_value(disp, boz_clock_value(disp->clock));
+}
+
+long
+boz_clock_display_next_change(struct boz_clock_display *disp, long value_ms,
+        int direction_forwards) {
+    struct boz_clock_format format;
+    long abs_ms = value_ms < 0 ? -value_ms : value_ms;
+    long unit, base;
+
+    cd_find_format(disp, abs_ms, &format);
+    unit = pgm_read_dword_near(&cd_digit_unit_ms[cd_smallest_digit(&format)]);
+
+    /* The display shows the absolute value truncated to a whole number of
+       units, and the sign, so it changes when the absolute value reaches the
+       next unit up, or goes below the current one. */
+    base = abs_ms / unit * unit;
+    if (value_ms >= 0) {
+        if (direction_forwards)
+            return base + unit;
+        else
+            return base - 1;
+    }
+    else {
+        if (direction_forwards)
+            return base ? 1 - base : 0;
+        else
+            return -(base + unit);
+    }
+}
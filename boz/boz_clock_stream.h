@@ -0,0 +1,22 @@
+#ifndef _BOZ_CLOCK_STREAM_H
+#define _BOZ_CLOCK_STREAM_H
+
+#include "boz_hw.h"
+
+#ifdef BOZ_CLOCK_STREAM
+
+#ifndef BOZ_SERIAL
+#error "The clock stream goes to the serial port - define BOZ_SERIAL as well"
+#endif
+
+#if defined(BOZ_INPUT_LOG) && !defined(BOZ_INPUT_LOG_EEPROM)
+#error "The clock stream can't share the serial port with the input log - define BOZ_INPUT_LOG_EEPROM as well"
+#endif
+
+/* Start the background service which sends the clocks' values to the
+ * serial port. Called once by setup(). */
+void boz_clock_stream_start(void);
+
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#include "boz_hw.h"
+#include "boz_api.h"
+#include "boz_clock_stream.h"
+#include "boz_serial.h"
+
+#ifdef BOZ_CLOCK_STREAM
+
+/* The clock stream is a background service which sends the value of every
+   clock in use to the serial port, a few times a second, so a PC can show
+   the game's clocks on a big screen while the game goes on as usual. It
+   runs whichever app is in the foreground, so it carries on while a game
+   has called the option menu. Each message is one line:
+
+     !C <n> <ms>
+         Clock <n> (0 to BOZ_NUM_CLOCKS - 1) now reads <ms> milliseconds.
+
+   A clock is only sent if its value has changed since we last sent it, or
+   it has come into use since we last looked. Like the display mirror, it's only sent if the
+   serial port can take it straight away, so it doesn't get in the way of
+   anything an app wants to send. If not, we try again next time. */
+
+/* How often to look at the clocks, and how long that takes at most */
+#define CLOCK_STREAM_PERIOD_MS 200
+#define CLOCK_STREAM_BUDGET_US 1000
+
+/* The value we last sent for each clock, if its bit in clock_stream_sent
+   is set */
+long clock_stream_values[NUM_CLOCKS];
+unsigned int clock_stream_sent = 0;
+
+/* Put "!C <n> <ms>\n" in msg, and return its length */
+static int clock_stream_format(char *msg, byte which_clock, long value) {
+    char digits[10];
+    unsigned long u;
+    int len = 0, n = 0;
+
+    msg[len++] = '!';
+    msg[len++] = 'C';
+    msg[len++] = ' ';
+    msg[len++] = (char) ('0' + which_clock);
+    msg[len++] = ' ';
+    if (value < 0) {
+        msg[len++] = '-';
+        u = (unsigned long) -value;
+    }
+    else {
+        u = (unsigned long) value;
+    }
+    do {
+        digits[n++] = (char) ('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    while (n > 0)
+        msg[len++] = digits[--n];
+    msg[len++] = '\n';
+    return len;
+}
+
+static void clock_stream_run(void *cookie) {
+    for (byte i = 0; i < NUM_CLOCKS; ++i) {
+        unsigned int bit = 1 << i;
+        char msg[20];
+        long value;
+
+        if (!(master_clocks_enabled & bit)) {
+            /* Not in use, so send it when it next is */
+            clock_stream_sent &= ~bit;
+            continue;
+        }
+
+        value = boz_clock_value(clocks[i]);
+        if ((clock_stream_sent & bit) && clock_stream_values[i] == value)
+            continue;
+        if (boz_serial_send_now(msg, clock_stream_format(msg, i, value)))
+            return;
+        clock_stream_values[i] = value;
+        clock_stream_sent |= bit;
+    }
+}
+
+void
+boz_clock_stream_start(void) {
+    clock_stream_sent = 0;
+    boz_service_start(clock_stream_run, NULL, CLOCK_STREAM_PERIOD_MS,
+            CLOCK_STREAM_BUDGET_US);
+}
+
+#endif
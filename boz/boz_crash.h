@@ -5,6 +5,13 @@ struct boz_crash_arg {
     void *addr;
     unsigned int pattern;
     byte light_state;
+
+    /* Nonzero if this is a stall the watchdog caught before the last reset,
+     * rather than a call to boz_crash(). Then addr is where the main loop
+     * was stuck, pattern is the BOZ_PHASE_* it was in, and worst_pass_us is
+     * the longest pass of the main loop before that one. */
+    byte watchdog;
+    unsigned long worst_pass_us;
 };
 
 #endif
@@ -6,6 +6,17 @@
 #define BOZ_DISPLAY_ROWS 2
 #define BOZ_DISPLAY_COLUMNS 16
 
+/* Return a bitmask of the character codes which, once everything on the
+ * display queue has been sent, won't contain their default characters. */
+byte
+boz_display_glyphs_missing(void);
+
+/* Note that all the user-defined characters are now, or will be once the
+ * display queue has caught up, their defaults, and that an app which calls
+ * boz_display_glyph() should lose the least useful of those first. */
+void
+boz_display_glyphs_reset(void);
+
 /* Applications should not need to use boz_display_enqueue() directly -
  * instead, use one of the helper functions declared in boz_api.h. */
 int
@@ -1,7 +1,25 @@
 #include "boz_api.h"
 #include "boz_display.h"
+#include "boz_lcd.h"
 #include <avr/pgmspace.h>
 
+#define BOZ_DISPLAY_GLYPHS 8
+
+/* What each user-defined character will contain once everything on the
+   display queue has been sent: a pointer to its pattern in PROGMEM, or NULL
+   if we don't know, which is what we start with at power on. glyph_lru has
+   the character codes in the order boz_display_glyph() will reuse them,
+   least recently asked for first. */
+static const byte *glyph_slot[BOZ_DISPLAY_GLYPHS];
+static byte glyph_lru[BOZ_DISPLAY_GLYPHS];
+
+/* The order of glyph_lru when all the defaults are there. Apps that ask for
+   their own characters are least likely to want the blank and the
+   copyright symbol, and most likely to want the back and play arrows. */
+static const PROGMEM byte glyph_default_lru[BOZ_DISPLAY_GLYPHS] = {
+    0, 7, 6, 5, 4, 3, 2, 1
+};
+
 int
 boz_display_clear() {
     return boz_display_enqueue(0x01);
@@ -58,6 +76,11 @@ boz_display_function_set(int eight_bit_interface, int two_lines, int eleven_pixe
 
 int
 boz_display_set_cgram_address(int address) {
+    /* We don't know what the app is going to put there, and writes move on
+       through the characters after it, so forget what all of those had in
+       them */
+    for (byte code = (address >> 3) & 7; code < BOZ_DISPLAY_GLYPHS; ++code)
+        glyph_slot[code] = NULL;
     return boz_display_enqueue(0x40 | (address & 0x3f));
 }
 
@@ -78,14 +101,13 @@ boz_display_write_char(char c) {
 
 int
 boz_display_write_string(const char *s) {
-    int ret;
+    if (boz_display_reserve(strlen(s)))
+        return -1;
     while (*s) {
-        ret = boz_display_write_char(*s);
-        if (ret)
-            return ret;
+        boz_display_write_char(*s);
         ++s;
     }
-    return 0;
+    return boz_display_commit();
 }
 
 int
@@ -98,7 +120,69 @@ boz_display_write_string_P(const char *str_pm) {
 
 int
 boz_display_reset_cgram_patterns(void) {
-    return boz_display_enqueue(BOZ_LCD_RESET_CGRAM);
+    byte missing = boz_display_glyphs_missing();
+
+    if (missing && boz_display_enqueue(BOZ_LCD_RESET_CGRAM | missing))
+        return -1;
+    boz_display_glyphs_reset();
+    return 0;
+}
+
+/* Move code to the most recently used end of glyph_lru */
+static void
+glyph_use(byte code) {
+    byte i = 0;
+
+    while (glyph_lru[i] != code)
+        ++i;
+    for (; i < BOZ_DISPLAY_GLYPHS - 1; ++i)
+        glyph_lru[i] = glyph_lru[i + 1];
+    glyph_lru[BOZ_DISPLAY_GLYPHS - 1] = code;
+}
+
+int
+boz_display_glyph(const byte *pattern) {
+    byte code;
+
+    for (code = 0; code < BOZ_DISPLAY_GLYPHS; ++code) {
+        if (glyph_slot[code] == pattern) {
+            glyph_use(code);
+            return code;
+        }
+    }
+
+    /* It's not there, so put it in place of the character nobody's asked
+       for for the longest */
+    if (boz_display_reserve(9))
+        return -1;
+    code = glyph_lru[0];
+    boz_display_enqueue(0x40 | (code << 3));
+    for (byte row = 0; row < 8; ++row)
+        boz_display_write_char(pgm_read_byte_near(pattern + row));
+    boz_display_commit();
+
+    glyph_slot[code] = pattern;
+    glyph_use(code);
+    return code;
+}
+
+byte
+boz_display_glyphs_missing(void) {
+    byte missing = 0;
+
+    for (byte code = 0; code < BOZ_DISPLAY_GLYPHS; ++code) {
+        if (glyph_slot[code] != boz_char_patterns[code])
+            missing |= (1 << code);
+    }
+    return missing;
+}
+
+void
+boz_display_glyphs_reset(void) {
+    for (byte code = 0; code < BOZ_DISPLAY_GLYPHS; ++code) {
+        glyph_slot[code] = boz_char_patterns[code];
+        glyph_lru[code] = pgm_read_byte_near(glyph_default_lru + code);
+    }
 }
 
 
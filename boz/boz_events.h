@@ -0,0 +1,69 @@
+#ifndef _BOZ_EVENTS_H
+#define _BOZ_EVENTS_H
+
+/* An app's event handlers. An app declares one or more of these as const
+ * PROGMEM and passes it to boz_set_event_handlers(). Any handler may be NULL
+ * if the app isn't interested in that event.
+ *
+ * The first five are in the same order as the FUNC_* button functions, so
+ * the main loop can find the handler for a button by its function, and the
+ * order of all of them matches the BOZ_EVENT_* bits below. Don't reorder
+ * them. */
+struct boz_event_handlers {
+    /* Contestant presses buzzer */
+    void (*buzz)(void *cookie, int which_buzzer);
+
+    /* QM presses PLAY (>) button */
+    void (*qm_play)(void *cookie);
+
+    /* QM presses YELLOW button */
+    void (*qm_yellow)(void *cookie);
+
+    /* QM presses RESET button */
+    void (*qm_reset)(void *cookie);
+
+    /* QM presses rotary encoder's pushbutton */
+    void (*qm_rotary_press)(void *cookie);
+
+    /* QM turns rotary encoder one step clockwise or anticlockwise */
+    void (*qm_rotary)(void *cookie, int clockwise);
+
+    /* QM turns rotary encoder any number of steps since the last pass of
+     * the main loop, clockwise if positive. If set, qm_rotary isn't
+     * called. */
+    void (*qm_rotary_steps)(void *cookie, int steps);
+
+    /* Sound queue has space in it. This event disables itself immediately
+     * before the handler is called. */
+    void (*sound_queue_not_full)(void *cookie);
+
+    /* Data is available to read on the serial port. Only called if
+     * BOZ_SERIAL is defined, but always here so the layout doesn't change. */
+    void (*serial_data_available)(void *cookie);
+
+    /* Display queue has room for the last boz_display_reserve() that
+     * failed. This event disables itself immediately before the handler is
+     * called. */
+    void (*display_queue_space)(void *cookie);
+
+    /* The main loop has unlocked the buzzers because the arbitration
+     * policy's unlock_ms has passed since the winning buzz. */
+    void (*buzzers_unlocked)(void *cookie);
+};
+
+/* Bits for boz_enable_events() and boz_disable_events(). Bit N is the Nth
+ * handler in struct boz_event_handlers. */
+#define BOZ_EVENT_BUZZ                  (1 << 0)
+#define BOZ_EVENT_QM_PLAY               (1 << 1)
+#define BOZ_EVENT_QM_YELLOW             (1 << 2)
+#define BOZ_EVENT_QM_RESET              (1 << 3)
+#define BOZ_EVENT_QM_ROTARY_PRESS       (1 << 4)
+#define BOZ_EVENT_QM_ROTARY             (1 << 5)
+#define BOZ_EVENT_QM_ROTARY_STEPS       (1 << 6)
+#define BOZ_EVENT_SOUND_QUEUE_NOT_FULL  (1 << 7)
+#define BOZ_EVENT_SERIAL_DATA_AVAILABLE (1 << 8)
+#define BOZ_EVENT_DISPLAY_QUEUE_SPACE   (1 << 9)
+#define BOZ_EVENT_BUZZERS_UNLOCKED      (1 << 10)
+#define BOZ_EVENT_ALL                   0x7ff
+
+#endif
@@ -12,8 +12,50 @@
 
 #define BOZ_HW_REVISION 1
 
+/* BOZ_NUM_BUZZERS is the number of buzzers, from 1 to 16. Buzzers 0-3 are
+ * on the Bozzard's own pins. Any more than that come from PCF8574 I2C input
+ * expanders, eight buzzers to an expander, at I2C addresses from 0x20
+ * upwards, with their interrupt outputs connected to D2. That needs hardware
+ * revision 1. See boz_input.ino. */
+#ifndef BOZ_NUM_BUZZERS
+#define BOZ_NUM_BUZZERS 4
+#endif
+
 /* Define BOZ_SERIAL to include the PC Control app, and all the various
  * serial port-related code. */
 //#define BOZ_SERIAL
 
+/* Define BOZ_INPUT_LOG to record every button, rotary encoder and serial
+ * input with the time we saw it, so the session can be replayed on a PC with
+ * host/replay. The log goes to the serial port, unless BOZ_INPUT_LOG_EEPROM
+ * is also defined, in which case it goes to the top 256 bytes of EEPROM.
+ * See boz_input_log.ino. */
+//#define BOZ_INPUT_LOG
+//#define BOZ_INPUT_LOG_EEPROM
+
+/* Define BOZ_TRACE to record the last few dozen things the main loop did,
+ * such as delivering a button press or sending a command to the display,
+ * with the time it did them. Hold yellow and reset down together to send
+ * them to the serial port, and decode them with host/trace.py. See
+ * boz_trace.ino. */
+//#define BOZ_TRACE
+
+/* Define BOZ_DISPLAY_MIRROR to send what's on the display to the serial port
+ * whenever it changes, a few cells at a time, so host/mirror.py can show it
+ * on a PC. Needs BOZ_SERIAL. See boz_mirror.ino. */
+//#define BOZ_DISPLAY_MIRROR
+
+/* Define BOZ_CLOCK_STREAM to send the value of every clock in use to the
+ * serial port a few times a second, from a background service, so a PC can
+ * show the game's clocks. Needs BOZ_SERIAL. See boz_clock_stream.ino. */
+//#define BOZ_CLOCK_STREAM
+
+/* Define BOZ_WATCHDOG to have the AVR's watchdog reset the Bozzard if a pass
+ * of the main loop takes longer than BOZ_WATCHDOG_TIMEOUT, which is one of
+ * the WDTO_* values from <avr/wdt.h>. Before it resets, it records where the
+ * main loop was stuck in EEPROM, and the crash app shows it on the next boot.
+ * See boz_watchdog.ino. */
+#define BOZ_WATCHDOG
+#define BOZ_WATCHDOG_TIMEOUT WDTO_500MS
+
 #endif
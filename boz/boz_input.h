@@ -0,0 +1,69 @@
+#ifndef _BOZ_INPUT_H
+#define _BOZ_INPUT_H
+
+#include "boz_hw.h"
+
+#if BOZ_NUM_BUZZERS < 1 || BOZ_NUM_BUZZERS > 16
+#error "BOZ_NUM_BUZZERS must be from 1 to 16"
+#endif
+
+/* How many buzzers are on the Bozzard's own pins, D4-D7. The rest come from
+ * the input sources in boz_input.ino. */
+#if BOZ_NUM_BUZZERS < 4
+#define BOZ_NUM_BOARD_BUZZERS BOZ_NUM_BUZZERS
+#else
+#define BOZ_NUM_BOARD_BUZZERS 4
+#endif
+
+#if BOZ_NUM_BUZZERS > BOZ_NUM_BOARD_BUZZERS && BOZ_HW_REVISION == 0
+#error "More than four buzzers needs the I2C bus, which hardware revision 0 doesn't have"
+#endif
+
+/* The main loop's debouncer has a bit for each button: the buzzers, then
+ * the quizmaster's play, yellow and reset buttons, then the rotary encoder's
+ * pushbutton. */
+#define BOZ_BUTTON_PLAY   (BOZ_NUM_BUZZERS)
+#define BOZ_BUTTON_YELLOW (BOZ_NUM_BUZZERS + 1)
+#define BOZ_BUTTON_RESET  (BOZ_NUM_BUZZERS + 2)
+#define BOZ_BUTTON_RE_KEY (BOZ_NUM_BUZZERS + 3)
+#define BOZ_NUM_BUTTONS   (BOZ_NUM_BUZZERS + 4)
+
+/* A set of buttons, in the debouncer's order */
+#if BOZ_NUM_BUTTONS <= 8
+typedef byte boz_button_mask;
+#elif BOZ_NUM_BUTTONS <= 16
+typedef unsigned short boz_button_mask;
+#else
+typedef unsigned long boz_button_mask;
+#endif
+
+/* Somewhere buzzers beyond the Bozzard's own come from. The main loop reads
+ * every source on every pass, so read() mustn't take long. */
+struct boz_input_source {
+    /* Set up the source. Called once by setup(). */
+    void (*init)(byte arg);
+
+    /* Return which of the source's inputs are held down, bit 0 being its
+     * first buzzer. */
+    byte (*read)(byte arg);
+
+    /* Passed to init() and read(), e.g. the I2C address */
+    byte arg;
+
+    /* How many buzzers it has, up to 8. The first is the buzzer after the
+     * previous source's last, or after the Bozzard's own if it's the first
+     * source. */
+    byte num_buzzers;
+};
+
+/* The input log and host/replay refer to the switches by pin number. Buzzer
+ * n beyond the Bozzard's own has no pin, so it's called pin
+ * BOZ_INPUT_VIRTUAL_PIN + n - BOZ_NUM_BOARD_BUZZERS instead. Pins 20 and 21
+ * are A6 and A7, which can only be analogue inputs, so no switch can really
+ * be on any of these. */
+#define BOZ_INPUT_VIRTUAL_PIN 20
+
+/* First I2C address of the PCF8574 input expanders */
+#define BOZ_INPUT_EXPANDER_ADDRESS 0x20
+
+#endif
@@ -0,0 +1,75 @@
+#include "boz_hw.h"
+#include "boz_api.h"
+#include "boz_input.h"
+
+/* Buzzers beyond the Bozzard's own four. Each comes from an input source,
+   which the main loop reads on every pass along with the Bozzard's own
+   pins, so it sees a buzzer on an input source as soon as one on a pin, and
+   the usual rules about who was first apply to all of them.
+
+   The only kind of source so far is a PCF8574 I2C input expander, with a
+   buzzer connecting each of its pins to ground. Reading one takes about
+   200us of the I2C bus at 100kHz. It pulls its interrupt output low when
+   any of its inputs has changed since we last read it, and that's
+   connected to D2, so pressing a buzzer on an expander wakes the Bozzard
+   just like pressing one of its own. */
+
+#if BOZ_NUM_BUZZERS > BOZ_NUM_BOARD_BUZZERS
+
+#include <Wire.h>
+
+static void pcf8574_init(byte address) {
+    /* Writing 1 to a pin makes it an input with a weak pull-up, which it is
+       after the expander powers on, but not after the AVR alone resets */
+    Wire.beginTransmission(address);
+    Wire.write(0xff);
+    Wire.endTransmission();
+}
+
+static byte pcf8574_read(byte address) {
+    /* A buzzer held down pulls its pin low. If the expander isn't there,
+       none of its buzzers are held down. */
+    if (Wire.requestFrom(address, (byte) 1) != 1)
+        return 0;
+    return (byte) ~Wire.read();
+}
+
+const PROGMEM struct boz_input_source input_sources[] = {
+#if BOZ_NUM_BUZZERS > BOZ_NUM_BOARD_BUZZERS + 8
+    { pcf8574_init, pcf8574_read, BOZ_INPUT_EXPANDER_ADDRESS, 8 },
+    { pcf8574_init, pcf8574_read, BOZ_INPUT_EXPANDER_ADDRESS + 1, BOZ_NUM_BUZZERS - BOZ_NUM_BOARD_BUZZERS - 8 },
+#else
+    { pcf8574_init, pcf8574_read, BOZ_INPUT_EXPANDER_ADDRESS, BOZ_NUM_BUZZERS - BOZ_NUM_BOARD_BUZZERS },
+#endif
+};
+#define NUM_INPUT_SOURCES ((byte) (sizeof(input_sources) / sizeof(input_sources[0])))
+
+/* Called by setup(), after the I2C bus has been set up */
+void
+input_sources_init(void) {
+    for (byte i = 0; i < NUM_INPUT_SOURCES; ++i) {
+        void (*init)(byte) = (void (*)(byte)) pgm_read_ptr(&input_sources[i].init);
+        init(pgm_read_byte(&input_sources[i].arg));
+    }
+}
+
+/* Return which of the buzzers on the input sources are held down */
+boz_buzzer_mask
+input_sources_read(void) {
+    boz_buzzer_mask held = 0;
+    byte first = BOZ_NUM_BOARD_BUZZERS;
+
+    for (byte i = 0; i < NUM_INPUT_SOURCES; ++i) {
+        byte (*read)(byte) = (byte (*)(byte)) pgm_read_ptr(&input_sources[i].read);
+        byte n = pgm_read_byte(&input_sources[i].num_buzzers);
+        byte inputs = read(pgm_read_byte(&input_sources[i].arg));
+
+        if (n < 8)
+            inputs &= (1 << n) - 1;
+        held |= (boz_buzzer_mask) inputs << first;
+        first += n;
+    }
+    return held;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _BOZ_INPUT_LOG_H
+#define _BOZ_INPUT_LOG_H
+
+#include "boz_hw.h"
+
+#ifdef BOZ_INPUT_LOG
+
+/* Record types in the input log. See boz_input_log.ino for the format. */
+#define BOZ_INPUT_LOG_SWITCH    0x00
+#define BOZ_INPUT_LOG_ROTARY    0x40
+#define BOZ_INPUT_LOG_SERIAL    0x80
+#define BOZ_INPUT_LOG_SYNC      0xc0
+#define BOZ_INPUT_LOG_SYNC_LOST 0xc1
+#define BOZ_INPUT_LOG_BOOT      0xc2
+#define BOZ_INPUT_LOG_END       0xff
+
+/* Where the log goes in EEPROM if BOZ_INPUT_LOG_EEPROM is defined. The size
+ * must be a power of two. No app may have an EEPROM region in here. */
+#define BOZ_INPUT_LOG_EEPROM_START 0x300
+#define BOZ_INPUT_LOG_EEPROM_SIZE  0x100
+
+/* Speed of the serial port when the log is sent to it */
+#define BOZ_INPUT_LOG_BAUD 115200
+
+/* Called once by setup(), after the pins and the serial port (if BOZ_SERIAL
+ * is defined) have been set up. */
+void boz_input_log_init(void);
+
+/* Record that the switch on "pin" has closed or opened, as seen at the time
+ * "us". Button presses are switch closures, except for the rotary encoder's
+ * clock, which is logged with boz_input_log_rotary(). */
+void boz_input_log_switch(byte pin, byte closed, unsigned long us);
+
+/* Record a change in the level of the rotary encoder's clock pin, and the
+ * level on the data pin at the time. */
+void boz_input_log_rotary(byte clock, byte data, unsigned long us);
+
+/* Record a byte the firmware has just read from the serial port. */
+void boz_input_log_serial(byte c);
+
+/* Called by the main loop to send some of the log on its way, without
+ * blocking. */
+void boz_input_log_service(void);
+
+/* Returns 1 if there's anything in the log that boz_input_log_service()
+ * still has to deal with, in which case the main loop won't sleep. */
+byte boz_input_log_busy(void);
+
+#endif
+
+#endif
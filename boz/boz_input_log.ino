@@ -0,0 +1,234 @@
+#include "boz_hw.h"
+#include "boz_pins.h"
+#include "boz_input_log.h"
+
+#ifdef BOZ_INPUT_LOG
+
+#include <EEPROM.h>
+
+#if defined(BOZ_SERIAL) && !defined(BOZ_INPUT_LOG_EEPROM)
+#error "The input log can't share the serial port with BOZ_SERIAL - define BOZ_INPUT_LOG_EEPROM as well"
+#endif
+
+/* The input log records every input the firmware sees - switches closing and
+   opening, the rotary encoder's clock and data lines, and bytes read from the
+   serial port - with the value of micros() at which it saw them, so that
+   host/replay can feed exactly the same inputs to the firmware at exactly
+   the same times.
+
+   The log is a stream of records. Each record starts with a header byte:
+
+     00pppppp  SWITCH: bit 5 is 1 if the switch closed, 0 if it opened, and
+               bits 0-4 are the pin number.
+     010000cd  ROTARY: c is the level on the clock pin, d on the data pin.
+     10000000  SERIAL: followed by the byte read from the serial port.
+     11000000  SYNC: followed by micros() as a four-byte little-endian number.
+     11000001  SYNC, and some records before this one were lost because we
+               couldn't send them out as fast as they arrived.
+     11000010  BOOT: a SYNC which starts a new session.
+     11111111  END: where the EEPROM log stops. Never sent to the serial port.
+
+   Every SWITCH, ROTARY or SERIAL record ends with the number of
+   microseconds since the record before it, seven bits to a byte, least
+   significant first, with the top bit set on every byte but the last. A
+   SYNC record goes out at least every LOG_SYNC_INTERVAL records, so anyone
+   reading the EEPROM log after it has wrapped round can find their place.
+
+   The log goes to the serial port at BOZ_INPUT_LOG_BAUD, unless
+   BOZ_INPUT_LOG_EEPROM is defined, in which case it goes round and round a
+   ring in EEPROM. Hold the yellow and reset buttons down while switching on
+   to have the ring sent to the serial port as hex before a new session
+   starts overwriting it. */
+
+/* Size of the RAM buffer between the inputs and the serial port or EEPROM.
+   Must be a power of two. */
+#define LOG_BUF_SIZE 32
+
+#define LOG_SYNC_INTERVAL 16
+
+struct input_log {
+    byte buf[LOG_BUF_SIZE];
+    byte head, len;
+
+    /* Time of the last record, which the next record's delta is from */
+    unsigned long last_us;
+    byte records_since_sync;
+
+    /* Set if we've had to throw away a record since the last SYNC */
+    byte lost;
+
+#ifdef BOZ_INPUT_LOG_EEPROM
+    /* Where the next byte goes in the EEPROM ring, and whether there's an
+       END marker there yet */
+    unsigned int eeprom_pos;
+    byte end_written;
+#endif
+};
+
+struct input_log input_log;
+
+static void log_put(byte b) {
+    input_log.buf[(input_log.head + input_log.len) & (LOG_BUF_SIZE - 1)] = b;
+    input_log.len++;
+}
+
+static byte log_take(void) {
+    byte b = input_log.buf[input_log.head];
+    input_log.head = (input_log.head + 1) & (LOG_BUF_SIZE - 1);
+    input_log.len--;
+    return b;
+}
+
+static void log_put_sync(byte header, unsigned long us) {
+    log_put(header);
+    for (byte i = 0; i < 4; ++i) {
+        log_put((byte) us);
+        us >>= 8;
+    }
+    input_log.records_since_sync = 0;
+}
+
+/* Add a record to the buffer, or throw it away if there isn't room. payload
+   is the byte that follows the header, or -1 if there isn't one. */
+static void log_record(byte header, int payload, unsigned long us) {
+    unsigned long delta;
+    byte need_sync = input_log.lost || input_log.records_since_sync >= LOG_SYNC_INTERVAL;
+    byte len = (payload >= 0) ? 2 : 1;
+
+    /* The rotary encoder's edges are timed in its interrupt handler, so
+       one of them can be logged just after a switch change the main loop
+       sampled slightly earlier. Keep the log in time order. */
+    if ((long) (us - input_log.last_us) < 0)
+        us = input_log.last_us;
+    delta = us - input_log.last_us;
+
+    if (need_sync) {
+        delta = 0;
+        len += 5;
+    }
+    for (unsigned long d = delta; ; d >>= 7) {
+        ++len;
+        if (d < 0x80)
+            break;
+    }
+
+    if (len > LOG_BUF_SIZE - input_log.len) {
+        input_log.lost = 1;
+        return;
+    }
+
+    if (need_sync) {
+        log_put_sync(input_log.lost ? BOZ_INPUT_LOG_SYNC_LOST : BOZ_INPUT_LOG_SYNC, us);
+        input_log.lost = 0;
+    }
+    log_put(header);
+    if (payload >= 0)
+        log_put((byte) payload);
+    while (delta >= 0x80) {
+        log_put(0x80 | (byte) delta);
+        delta >>= 7;
+    }
+    log_put((byte) delta);
+
+    input_log.last_us = us;
+    input_log.records_since_sync++;
+}
+
+void
+boz_input_log_switch(byte pin, byte closed, unsigned long us) {
+    log_record(BOZ_INPUT_LOG_SWITCH | (closed ? 0x20 : 0) | (pin & 0x1f), -1, us);
+}
+
+void
+boz_input_log_rotary(byte clock, byte data, unsigned long us) {
+    log_record(BOZ_INPUT_LOG_ROTARY | (clock ? 2 : 0) | (data ? 1 : 0), -1, us);
+}
+
+void
+boz_input_log_serial(byte c) {
+    log_record(BOZ_INPUT_LOG_SERIAL, c, micros());
+}
+
+#ifdef BOZ_INPUT_LOG_EEPROM
+
+static void log_write_hex(byte b) {
+    const char hex[] = "0123456789abcdef";
+    char str[2];
+    str[0] = hex[b >> 4];
+    str[1] = hex[b & 0x0f];
+    Serial.write(str, 2);
+}
+
+/* Send the whole EEPROM ring to the serial port, sixteen bytes to a line */
+static void log_dump_eeprom(void) {
+    Serial.write("BOZ INPUT LOG\r\n", 15);
+    for (unsigned int i = 0; i < BOZ_INPUT_LOG_EEPROM_SIZE; ++i) {
+        log_write_hex(EEPROM.read(BOZ_INPUT_LOG_EEPROM_START + i));
+        if ((i & 15) == 15)
+            Serial.write("\r\n", 2);
+        else
+            Serial.write(' ');
+    }
+    Serial.write("END\r\n", 5);
+    Serial.flush();
+}
+
+#endif
+
+void
+boz_input_log_init(void) {
+    memset(&input_log, 0, sizeof(input_log));
+
+#ifndef BOZ_SERIAL
+    Serial.begin(BOZ_INPUT_LOG_BAUD);
+#endif
+
+#ifdef BOZ_INPUT_LOG_EEPROM
+    if (digitalRead(PIN_QM_YELLOW) == LOW && digitalRead(PIN_QM_RESET) == LOW) {
+        log_dump_eeprom();
+
+        /* Don't let the first app see these buttons as presses */
+        while (digitalRead(PIN_QM_YELLOW) == LOW || digitalRead(PIN_QM_RESET) == LOW);
+    }
+#endif
+
+    input_log.last_us = micros();
+    log_put_sync(BOZ_INPUT_LOG_BOOT, input_log.last_us);
+}
+
+void
+boz_input_log_service(void) {
+#ifdef BOZ_INPUT_LOG_EEPROM
+    /* One byte per call, and only if the EEPROM has finished the last one,
+       so we never sit waiting for it. Once the buffer's empty, mark where
+       the log ends. */
+    if (!eeprom_is_ready())
+        return;
+    if (input_log.len > 0) {
+        EEPROM.write(BOZ_INPUT_LOG_EEPROM_START + input_log.eeprom_pos, log_take());
+        input_log.eeprom_pos = (input_log.eeprom_pos + 1) & (BOZ_INPUT_LOG_EEPROM_SIZE - 1);
+        input_log.end_written = 0;
+    }
+    else if (!input_log.end_written) {
+        EEPROM.write(BOZ_INPUT_LOG_EEPROM_START + input_log.eeprom_pos, BOZ_INPUT_LOG_END);
+        input_log.end_written = 1;
+    }
+#else
+    int space = Serial.availableForWrite();
+    while (space > 0 && input_log.len > 0) {
+        Serial.write(log_take());
+        --space;
+    }
+#endif
+}
+
+byte
+boz_input_log_busy(void) {
+#ifdef BOZ_INPUT_LOG_EEPROM
+    return input_log.len > 0 || !input_log.end_written;
+#else
+    return input_log.len > 0;
+#endif
+}
+
+#endif
@@ -1,17 +1,54 @@
 #ifndef _BOZ_LCD_H
 #define _BOZ_LCD_H
 
+/* Not commands the display understands, but display queue entries which
+ * stand for a sequence of them, and which disp_cmd_step() sends one at a
+ * time: BOZ_LCD_RESET_CGRAM puts the default user-defined characters back,
+ * and BOZ_LCD_INIT initialises the display after power on. The low eight
+ * bits of BOZ_LCD_RESET_CGRAM say which characters to put back, one bit
+ * for each character code. */
 #define BOZ_LCD_RESET_CGRAM 0x200
+#define BOZ_LCD_INIT 0x300
+
+/* Number of commands BOZ_LCD_RESET_CGRAM stands for if it puts back all
+ * eight characters - nine for each one */
+#define BOZ_LCD_RESET_CGRAM_LENGTH (8 * 9)
+
+/* The default user-defined characters, eight rows each */
+extern const byte boz_char_patterns[][8];
+
+/* The HD44780 needs 40ms after power on before it will take any commands.
+ * This is how long after the processor starts that we send the first. The
+ * I2C display has always been given 100ms, in case its backpack or supply
+ * takes longer to come up than the display itself, so it still is. */
+#if BOZ_HW_REVISION == 0
+#define BOZ_LCD_POWER_ON_MS 50
+#else
+#define BOZ_LCD_POWER_ON_MS 100
+#endif
 
 void
 boz_lcd_send(unsigned int cmd);
 
 void
-boz_lcd_clear();
+boz_lcd_send_nibble(unsigned int data, byte rs);
 
+/* Get ready to talk to the display. This doesn't send it anything:
+ * boz_lcd_init_step() does that. */
 void
 boz_lcd_init();
 
+/* Send the display step number "step" of its initialisation, starting from
+ * 0, and return how many microseconds to wait before the next step. Once
+ * there are no steps left, return 0. */
+unsigned int
+boz_lcd_init_step(byte step);
+
+/* Return command number "index" of the BOZ_LCD_RESET_CGRAM_LENGTH commands
+ * which reset the user-defined characters. */
+unsigned int
+boz_lcd_reset_cgram_cmd(byte index);
+
 void
 boz_lcd_set_cgram_address(byte address);
 
@@ -23,7 +60,9 @@ void
 boz_lcd_set_backlight_state(byte);
 #endif
 
+/* Put back the default user-defined characters whose bits are set in mask,
+ * talking to the display directly. */
 void
-boz_lcd_reset_cgram_patterns(void);
+boz_lcd_reset_cgram_patterns(byte mask);
 
 #endif
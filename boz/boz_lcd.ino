@@ -1,5 +1,6 @@
 #include "boz_lcd.h"
 #include "boz_shiftreg.h"
+#include "boz_mirror.h"
 
 #define BOZ_NUM_CHAR_PATTERNS 8
 const PROGMEM byte boz_char_patterns[][8] = {
@@ -20,29 +21,13 @@ const PROGMEM byte boz_char_patterns[][8] = {
 */
 
 void
-boz_lcd_send(unsigned int cmd) {
-    if (cmd == BOZ_LCD_RESET_CGRAM) {
-        boz_lcd_reset_cgram_patterns();
-        return;
-    }
+boz_lcd_send_nibble(unsigned int data, byte rs) {
+    digitalWrite(PIN_DISP_RS, rs ? HIGH : LOW);
 
-    if (cmd & 0x100) {
-        digitalWrite(PIN_DISP_RS, HIGH);
-    }
-    else {
-        digitalWrite(PIN_DISP_RS, LOW);
-    }
-    
     /* The top nibble of the shift register is what's connected to the
        display. Make sure we only work on that top nibble so as to leave
        everything else how it is. */
-    boz_shift_reg_set_top_nibble((cmd & 0xf0) >> 4);
-    digitalWrite(PIN_DISP_E, HIGH);
-    delayMicroseconds(2);
-    digitalWrite(PIN_DISP_E, LOW);
-    delayMicroseconds(2);
-
-    boz_shift_reg_set_top_nibble(cmd & 0x0f);
+    boz_shift_reg_set_top_nibble(data & 0x0f);
     digitalWrite(PIN_DISP_E, HIGH);
     delayMicroseconds(2);
     digitalWrite(PIN_DISP_E, LOW);
@@ -50,67 +35,20 @@ boz_lcd_send(unsigned int cmd) {
 }
 
 void
-boz_lcd_clear() {
-    boz_lcd_send(0x01);
-    delayMicroseconds(10000);
+boz_lcd_send(unsigned int cmd) {
+    byte rs = (cmd & 0x100) != 0;
+
+    boz_lcd_send_nibble((cmd & 0xf0) >> 4, rs);
+    boz_lcd_send_nibble(cmd & 0x0f, rs);
+#ifdef BOZ_DISPLAY_MIRROR
+    boz_mirror_lcd(cmd);
+#endif
 }
 
 void
 boz_lcd_init() {
     pinMode(PIN_DISP_E, OUTPUT);
     pinMode(PIN_DISP_RS, OUTPUT);
-
-    /* Wait 50 ms */
-    delay(50);
-
-    /* Send initial function set word, which is half a word */
-    digitalWrite(PIN_DISP_RS, LOW);
-
-    boz_shift_reg_set_top_nibble(3);
-    digitalWrite(PIN_DISP_E, HIGH);
-    delayMicroseconds(2);
-    digitalWrite(PIN_DISP_E, LOW);
-
-    delay(10); // "wait for more than 4ms"
-
-    boz_shift_reg_set_top_nibble(3);
-    digitalWrite(PIN_DISP_E, HIGH);
-    delayMicroseconds(2);
-    digitalWrite(PIN_DISP_E, LOW);
-
-    delayMicroseconds(200); // "wait for more than 100us"
-
-    boz_shift_reg_set_top_nibble(3);
-    digitalWrite(PIN_DISP_E, HIGH);
-    delayMicroseconds(2);
-    digitalWrite(PIN_DISP_E, LOW);
-
-    delayMicroseconds(200);
-
-    // now change to 4-bit interface
-    boz_shift_reg_set_top_nibble(2);
-    digitalWrite(PIN_DISP_E, HIGH);
-    delayMicroseconds(2);
-    digitalWrite(PIN_DISP_E, LOW);
-
-    delayMicroseconds(200);
-
-    /* Send function set command, twice, with a delay between */
-    boz_lcd_send(0x28);
-    delayMicroseconds(150);
-    boz_lcd_send(0x28);
-    delayMicroseconds(150);
-
-    /* Initialise display properties */
-    boz_lcd_send(0x0c);
-    delayMicroseconds(150);
-
-    /* Clear display */
-    boz_lcd_clear();
-    
-    /* Entry mode set */
-    boz_lcd_send(0x06);
-    delayMicroseconds(150);
 }
 
 void
@@ -155,14 +93,6 @@ void
 boz_lcd_send(unsigned int cmd) {
     byte rs = 0;
 
-    /* If cmd == BOZ_LCD_RESET_CGRAM, then instead of sending one command,
-       we send a whole load of commands to reset the CGRAM characters to their
-       defaults. */
-    if (cmd == BOZ_LCD_RESET_CGRAM) {
-        boz_lcd_reset_cgram_patterns();
-        return;
-    }
-
     /* If cmd & 0x100 then RS is set, otherwise it's clear. */
     if (cmd & 0x100) {
         rs = 1;
@@ -170,6 +100,9 @@ boz_lcd_send(unsigned int cmd) {
 
     boz_lcd_send_nibble((cmd & 0xf0) >> 4, rs);
     boz_lcd_send_nibble(cmd & 0x0f, rs);
+#ifdef BOZ_DISPLAY_MIRROR
+    boz_mirror_lcd(cmd);
+#endif
 }
 
 static void send_i2c(byte payload) {
@@ -209,45 +142,9 @@ boz_lcd_set_backlight_state(byte value) {
     send_i2c(backlight_on ? PAYLOAD_BACKLIGHT : 0);
 }
 
-void
-boz_lcd_clear() {
-    boz_lcd_send(0x01);
-    delayMicroseconds(10000);
-}
-
 void
 boz_lcd_init() {
     Wire.begin();
-
-    delay(100);
-
-    /* Start convoluted initialisation process */
-    boz_lcd_send_nibble(0x03, 0);
-    delay(10);
-    boz_lcd_send_nibble(0x03, 0);
-    delayMicroseconds(200);
-    boz_lcd_send_nibble(0x03, 0);
-    delayMicroseconds(200);
-    boz_lcd_send_nibble(0x02, 0);
-    delayMicroseconds(200);
-
-    /* Send function set command, twice, with a delay between */
-    boz_lcd_send(0x28);
-    delayMicroseconds(150);
-    boz_lcd_send(0x28);
-    delayMicroseconds(150);
-
-    /* Initialise display properties */
-    boz_lcd_send(0x0c);
-    delayMicroseconds(150);
-
-    /* Clear display */
-    boz_lcd_clear();
-    
-    /* Entry mode set */
-    boz_lcd_send(0x06);
-    delayMicroseconds(150);
-
 }
 
 void
@@ -257,21 +154,67 @@ boz_lcd_set_cgram_address(byte address) {
 
 #endif
 
+/* How to initialise the display once it's powered up, from the HD44780
+   datasheet's "initializing by instruction" for a 4-bit interface. Each step
+   is a command, or just its bottom nibble if BOZ_LCD_NIBBLE is set, and how
+   long to wait after sending it. */
+#define BOZ_LCD_NIBBLE 0x400
+struct boz_lcd_init_step {
+    unsigned short cmd;
+    unsigned short wait_us;
+};
+
+const PROGMEM struct boz_lcd_init_step boz_lcd_init_steps[] = {
+    { BOZ_LCD_NIBBLE | 0x03, 5000 }, // "wait for more than 4.1ms"
+    { BOZ_LCD_NIBBLE | 0x03, 200 },  // "wait for more than 100us"
+    { BOZ_LCD_NIBBLE | 0x03, 200 },
+    { BOZ_LCD_NIBBLE | 0x02, 200 },  // now change to 4-bit interface
+    { 0x28, 150 },                   // function set, twice
+    { 0x28, 150 },
+    { 0x0c, 150 },                   // display on, no cursor
+    { 0x01, 3000 },                  // clear display
+    { 0x06, 150 },                   // entry mode set
+};
+#define BOZ_LCD_NUM_INIT_STEPS (sizeof(boz_lcd_init_steps) / sizeof(boz_lcd_init_steps[0]))
+
+unsigned int
+boz_lcd_init_step(byte step) {
+    unsigned short cmd;
+
+    if (step >= BOZ_LCD_NUM_INIT_STEPS)
+        return 0;
+
+    cmd = pgm_read_word_near(&boz_lcd_init_steps[step].cmd);
+    if (cmd & BOZ_LCD_NIBBLE)
+        boz_lcd_send_nibble(cmd & 0x0f, 0);
+    else
+        boz_lcd_send(cmd);
+    return pgm_read_word_near(&boz_lcd_init_steps[step].wait_us);
+}
+
+unsigned int
+boz_lcd_reset_cgram_cmd(byte index) {
+    /* For each character, set the CGRAM address, then write its eight rows */
+    byte char_index = index / 9;
+    byte row = index % 9;
+
+    if (row == 0)
+        return 0x40 | (char_index << 3);
+    else
+        return 0x100 | pgm_read_byte_near(&boz_char_patterns[char_index][row - 1]);
+}
+
 void
-boz_lcd_reset_cgram_patterns(void) {
-    /* Set up the default character patterns for the eight user-definable
-       character codes. This doesn't use the display command queue, it talks
-       to the display directly with the necessary delays. This is because there
-       are a lot of characters to define, each with eight rows, so we'd be in
-       danger of filling up the queue if we try to enqueue all of this at
-       once. */
-    for (int char_index = 0; char_index < BOZ_NUM_CHAR_PATTERNS; ++char_index) {
-        boz_lcd_set_cgram_address(char_index << 3);
-        delayMicroseconds(150);
-        for (int i = 0; i < 8; ++i) {
-            boz_lcd_send(0x100 | pgm_read_byte_near(&boz_char_patterns[char_index][i]));
+boz_lcd_reset_cgram_patterns(byte mask) {
+    /* Set up the default character patterns for the user-definable
+       character codes in mask, talking to the display directly with the
+       necessary delays. Apps do this through the display command queue
+       instead, where it's sent a command at a time, because there are a lot
+       of characters to define, each with eight rows. */
+    for (byte i = 0; i < BOZ_LCD_RESET_CGRAM_LENGTH; ++i) {
+        if (mask & (1 << (i / 9))) {
+            boz_lcd_send(boz_lcd_reset_cgram_cmd(i));
             delayMicroseconds(150);
         }
     }
 }
-
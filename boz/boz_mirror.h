@@ -0,0 +1,34 @@
+#ifndef _BOZ_MIRROR_H
+#define _BOZ_MIRROR_H
+
+#include "boz_hw.h"
+
+#ifdef BOZ_DISPLAY_MIRROR
+
+#ifndef BOZ_SERIAL
+#error "The display mirror goes to the serial port - define BOZ_SERIAL as well"
+#endif
+
+#if defined(BOZ_INPUT_LOG) && !defined(BOZ_INPUT_LOG_EEPROM)
+#error "The display mirror can't share the serial port with the input log - define BOZ_INPUT_LOG_EEPROM as well"
+#endif
+
+/* Keep track of what this command, as given to boz_lcd_send(), does to what's
+ * on the display. Called by boz_lcd_send() for every command. */
+void boz_mirror_lcd(unsigned int cmd);
+
+/* Send the next part of the display which has changed, if the serial port
+ * has room for it. Called by the main loop when the display queue is
+ * empty, so a redraw goes as one set of changes rather than bit by bit. */
+void boz_mirror_service(void);
+
+/* Return nonzero if there are changes we haven't sent yet. */
+int boz_mirror_busy(void);
+
+/* Send the whole display and all the user-defined characters again, for a
+ * host which has just started listening. */
+void boz_mirror_resend(void);
+
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+#include "boz_hw.h"
+#include "boz_mirror.h"
+#include "boz_serial.h"
+
+#include <avr/pgmspace.h>
+
+#ifdef BOZ_DISPLAY_MIRROR
+
+/* The display mirror keeps a copy of what's on the display, worked out from
+   the commands boz_lcd_send() sends to it, and sends the parts that have
+   changed to the serial port, so a PC can show what the display shows
+   without anyone having to look at the Bozzard.
+
+   Only the cells that actually changed are sent, so redrawing a clock that
+   ticked from 1:59 to 2:00 costs three cells, not a whole screen. Each
+   message is one line, no longer than the serial output queue:
+
+     !M <row> <col> <cells>
+         The cells from <col> onwards on <row> (0 or 1) now contain <cells>.
+         A byte below 0x20 or above 0x7e, or a backslash, is sent as \HH,
+         so a user-defined character appears as \00 to \07.
+
+     !G <n> <16 hex digits>
+         User-defined character <n> (0 to 7) now has these eight rows of
+         pixels, top row first, five pixels to a row in the low bits.
+
+   The changes are sent only when the display queue is empty, so the PC sees
+   each redraw as a whole rather than halfway through, and only if the
+   serial port can take the message straight away, so they don't get in the
+   way of anything an app wants to send. The PC Control app's $M command
+   sends everything again. host/mirror.py shows the display from a capture
+   of these messages. */
+
+#define MIRROR_ROWS 2
+#define MIRROR_COLS 16
+#define MIRROR_GLYPHS 8
+
+/* The longest message we send, which is the size of the serial output
+   queue, so the mirror never gets anything through that an app couldn't */
+#define MIRROR_MSG_MAX 32
+
+struct boz_mirror {
+    /* What's on the display, and the user-defined characters */
+    byte ddram[MIRROR_ROWS][MIRROR_COLS];
+    byte cgram[MIRROR_GLYPHS * 8];
+
+    /* The display's address counter, as the display sees it: 0x00-0x27
+       for the top row, 0x40-0x67 for the bottom, or a CGRAM address if
+       cgram_mode is set. */
+    byte addr;
+    byte cgram_mode;
+
+    /* Which cells and user-defined characters have changed since we last
+       sent them, one bit each */
+    unsigned int row_dirty[MIRROR_ROWS];
+    byte cgram_dirty;
+
+    /* What the message we've just built covers: a glyph number, or -1 and
+       a run of cells. We only mark it as sent if it was. */
+    signed char msg_glyph;
+    byte msg_row;
+    byte msg_col;
+    byte msg_cells;
+};
+
+/* We don't know what's in CGRAM when we start, so the initial reset of the
+   user-defined characters will always be sent. The first thing the display
+   gets is a clear, which marks all the cells as changed. */
+struct boz_mirror mirror = { { { 0 } }, { 0 }, 0, 0, { 0, 0 }, 0xff, -1, 0, 0, 0 };
+
+static const char hex_digits[] PROGMEM = "0123456789abcdef";
+
+static void
+mirror_set_cell(byte row, byte col, byte c) {
+    if (mirror.ddram[row][col] != c) {
+        mirror.ddram[row][col] = c;
+        mirror.row_dirty[row] |= (1U << col);
+    }
+}
+
+void
+boz_mirror_lcd(unsigned int cmd) {
+    if (cmd & 0x100) {
+        byte c = (byte) cmd;
+        if (mirror.cgram_mode) {
+            byte a = mirror.addr & 0x3f;
+            if (mirror.cgram[a] != c) {
+                mirror.cgram[a] = c;
+                mirror.cgram_dirty |= (1 << (a >> 3));
+            }
+            mirror.addr = (a + 1) & 0x3f;
+        }
+        else {
+            byte col = mirror.addr & 0x3f;
+            if (col < MIRROR_COLS)
+                mirror_set_cell((mirror.addr & 0x40) ? 1 : 0, col, c);
+
+            /* The address counter goes from the end of one row to the
+               start of the other */
+            if (++col >= 0x28)
+                mirror.addr = (mirror.addr & 0x40) ^ 0x40;
+            else
+                mirror.addr = (mirror.addr & 0x40) | col;
+        }
+    }
+    else if (cmd & 0x80) {
+        mirror.addr = cmd & 0x7f;
+        mirror.cgram_mode = 0;
+    }
+    else if (cmd & 0x40) {
+        mirror.addr = cmd & 0x3f;
+        mirror.cgram_mode = 1;
+    }
+    else if ((cmd & 0xf8) == 0x10) {
+        /* Cursor shift left or right. Shifting the whole display isn't
+           something we do, so we don't follow it. */
+        if (cmd & 0x04)
+            mirror.addr++;
+        else
+            mirror.addr--;
+    }
+    else if (cmd == 0x01) {
+        for (byte row = 0; row < MIRROR_ROWS; ++row)
+            for (byte col = 0; col < MIRROR_COLS; ++col)
+                mirror_set_cell(row, col, ' ');
+        mirror.addr = 0;
+        mirror.cgram_mode = 0;
+    }
+    else if ((cmd & 0xfe) == 0x02) {
+        mirror.addr = 0;
+        mirror.cgram_mode = 0;
+    }
+}
+
+static byte
+mirror_put_hex(char *buf, byte b) {
+    buf[0] = pgm_read_byte_near(hex_digits + (b >> 4));
+    buf[1] = pgm_read_byte_near(hex_digits + (b & 0x0f));
+    return 2;
+}
+
+/* Build the next message to send in buf, which is MIRROR_MSG_MAX bytes
+   long, and return its length, or 0 if nothing has changed. */
+static int
+mirror_build_message(char *buf) {
+    int len;
+
+    if (mirror.cgram_dirty) {
+        byte n = 0;
+        while (!(mirror.cgram_dirty & (1 << n)))
+            ++n;
+        buf[0] = '!';
+        buf[1] = 'G';
+        buf[2] = ' ';
+        buf[3] = '0' + n;
+        buf[4] = ' ';
+        len = 5;
+        for (byte i = 0; i < 8; ++i)
+            len += mirror_put_hex(buf + len, mirror.cgram[n * 8 + i]);
+        buf[len++] = '\n';
+        mirror.msg_glyph = n;
+        return len;
+    }
+
+    for (byte row = 0; row < MIRROR_ROWS; ++row) {
+        unsigned int dirty = mirror.row_dirty[row];
+        byte col = 0;
+
+        if (dirty == 0)
+            continue;
+        while (!(dirty & (1U << col)))
+            ++col;
+
+        buf[0] = '!';
+        buf[1] = 'M';
+        buf[2] = ' ';
+        buf[3] = '0' + row;
+        buf[4] = ' ';
+        len = 5;
+        if (col >= 10)
+            buf[len++] = '1';
+        buf[len++] = '0' + col % 10;
+        buf[len++] = ' ';
+
+        /* Send the run of changed cells starting at col, leaving room for
+           the newline */
+        mirror.msg_glyph = -1;
+        mirror.msg_row = row;
+        mirror.msg_col = col;
+        mirror.msg_cells = 0;
+        while (col < MIRROR_COLS && (dirty & (1U << col))) {
+            byte c = mirror.ddram[row][col];
+            if (c < 0x20 || c > 0x7e || c == '\\') {
+                if (len + 3 >= MIRROR_MSG_MAX)
+                    break;
+                buf[len++] = '\\';
+                len += mirror_put_hex(buf + len, c);
+            }
+            else {
+                if (len + 1 >= MIRROR_MSG_MAX)
+                    break;
+                buf[len++] = c;
+            }
+            ++mirror.msg_cells;
+            ++col;
+        }
+        buf[len++] = '\n';
+        return len;
+    }
+
+    return 0;
+}
+
+void
+boz_mirror_service(void) {
+    char buf[MIRROR_MSG_MAX];
+    int len;
+
+    while ((len = mirror_build_message(buf)) > 0) {
+        if (boz_serial_send_now(buf, len) < 0)
+            break;
+        if (mirror.msg_glyph >= 0) {
+            mirror.cgram_dirty &= ~(1 << mirror.msg_glyph);
+        }
+        else {
+            for (byte i = 0; i < mirror.msg_cells; ++i)
+                mirror.row_dirty[mirror.msg_row] &= ~(1U << (mirror.msg_col + i));
+        }
+    }
+}
+
+int
+boz_mirror_busy(void) {
+    return mirror.cgram_dirty || mirror.row_dirty[0] || mirror.row_dirty[1];
+}
+
+void
+boz_mirror_resend(void) {
+    mirror.cgram_dirty = 0xff;
+    for (byte row = 0; row < MIRROR_ROWS; ++row)
+        mirror.row_dirty[row] = 0xffff;
+}
+
+#endif
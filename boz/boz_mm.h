@@ -37,6 +37,17 @@ int boz_mm_push_context();
  * loop will free the app's resources. */
 int boz_mm_pop_context();
 
+/* Make "list" the used-chunks-list which boz_mm_alloc() adds to and
+ * boz_mm_free() takes from, and return the list it replaces. The main loop
+ * switches to a background service's own list while the service runs, so
+ * whatever the service allocates isn't freed when an app exits, and vice
+ * versa. */
+struct boz_mm_header *boz_mm_swap_used_list(struct boz_mm_header *list);
+
+/* Free every chunk on "list", a used-chunks-list that isn't the current
+ * one. */
+void boz_mm_free_used_list(struct boz_mm_header *list);
+
 /* Initialise the memory manager with the given arena of memory and size. */
 void boz_mm_init(char *arena, boz_mm_size arena_size);
 
@@ -274,6 +274,20 @@ int boz_mm_pop_context() {
     return 0;
 }
 
+struct boz_mm_header *boz_mm_swap_used_list(struct boz_mm_header *list) {
+    struct boz_mm_header *old_used_list = boz_mm_used_list;
+    boz_mm_used_list = list;
+    return old_used_list;
+}
+
+void boz_mm_free_used_list(struct boz_mm_header *list) {
+    struct boz_mm_header *old_used_list = boz_mm_swap_used_list(list);
+    while (boz_mm_used_list) {
+        boz_mm_free(boz_mm_used_list + 1);
+    }
+    boz_mm_used_list = old_used_list;
+}
+
 boz_mm_size boz_mm_largest_free() {
     struct boz_mm_header *h;
     boz_mm_size largest = 0;
@@ -0,0 +1,80 @@
+#ifndef _BOZ_PT_H
+#define _BOZ_PT_H
+
+/* Protothreads: a way to write an app's multi-stage logic as one function
+ * that waits for things, rather than a chain of handlers.
+ *
+ * A protothread is an ordinary handler, void fn(void *cookie), whose body
+ * is between BOZ_PT_BEGIN() and BOZ_PT_END(). When it has to wait for
+ * something, it arranges for itself to be called when that happens, and
+ * returns, remembering where it got to in a boz_pt. The next time it's
+ * called, it carries on from there. So it can be the handler for an alarm,
+ * an event or a called app's return, and the waiting looks like this:
+ *
+ *     static boz_pt my_pt;
+ *
+ *     void my_thread(void *cookie) {
+ *         BOZ_PT_BEGIN(&my_pt);
+ *         boz_display_write_string("Wait for it");
+ *         BOZ_PT_SLEEP(&my_pt, 1000, my_thread, cookie);
+ *         boz_display_write_string("...now");
+ *         BOZ_PT_END(&my_pt);
+ *     }
+ *
+ * The boz_pt is just the line number to carry on from, so the thread can't
+ * keep anything in local variables while it waits. Keep it in the app's own
+ * state instead. A thread can't wait twice on the same line, or wait from
+ * inside a switch statement of its own.
+ *
+ * Set the boz_pt to 0 before calling the thread to start it from the top.
+ * After BOZ_PT_END() or BOZ_PT_EXIT(), it's 0 again. */
+
+#include "boz_api.h"
+
+typedef unsigned short boz_pt;
+
+#define BOZ_PT_BEGIN(pt) switch (*(pt)) { case 0:
+
+#define BOZ_PT_END(pt) } *(pt) = 0
+
+/* Return, and carry on from here the next time the thread is called */
+#define BOZ_PT_YIELD(pt) \
+    do { *(pt) = __LINE__; return; case __LINE__:; } while (0)
+
+/* Return each time the thread is called until cond is true */
+#define BOZ_PT_WAIT_UNTIL(pt, cond) \
+    do { *(pt) = __LINE__; case __LINE__: if (!(cond)) return; } while (0)
+
+/* Finish the thread now */
+#define BOZ_PT_EXIT(pt) do { *(pt) = 0; return; } while (0)
+
+/* Wait ms milliseconds, using the app's alarm, which calls self(cookie) */
+#define BOZ_PT_SLEEP(pt, ms, self, cookie) \
+    do { boz_set_alarm(ms, self, cookie); BOZ_PT_YIELD(pt); } while (0)
+
+/* Wait for any of the events in "events", whose handlers in the app's event
+ * handler table must be the thread itself. The events are disabled again
+ * when it carries on. */
+#define BOZ_PT_AWAIT_EVENTS(pt, events) \
+    do { \
+        boz_enable_events(events); \
+        BOZ_PT_YIELD(pt); \
+        boz_disable_events(events); \
+    } while (0)
+
+/* Wait until boz_display_reserve(n) succeeds. The thread must be the app's
+ * display_queue_space handler. It must call boz_display_commit() after
+ * drawing. */
+#define BOZ_PT_AWAIT_DISPLAY_SPACE(pt, n) \
+    BOZ_PT_WAIT_UNTIL(pt, boz_display_reserve(n) == 0 || \
+            (boz_enable_events(BOZ_EVENT_DISPLAY_QUEUE_SPACE), 0))
+
+/* Call another app, and carry on when it exits. boz_app_call_status() then
+ * gives its exit status, or -1 if it couldn't be called. */
+#define BOZ_PT_CALL_APP(pt, app_id, param, self, cookie) \
+    do { \
+        if (boz_app_call_resume(app_id, param, self, cookie) == 0) \
+            BOZ_PT_YIELD(pt); \
+    } while (0)
+
+#endif
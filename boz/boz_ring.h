@@ -0,0 +1,132 @@
+#ifndef _BOZ_RING_H
+#define _BOZ_RING_H
+
+/* A ring buffer of up to N elements of type T, where N is a power of two no
+ * bigger than 128.
+ *
+ * head and tail count elements taken and added since the ring was last
+ * cleared, and wrap round at 256. Since N divides 256, the slot for either
+ * is just its bottom bits, and tail - head is always the number of elements
+ * in the ring, so there's no separate "full" flag to keep in step.
+ *
+ * One side adds elements and the other takes them. Only push() and
+ * push_all() change tail, and only pop(), consume() and clear() change head,
+ * and each of them writes its index after it's finished with the element,
+ * so one side can be an interrupt handler and the other loop(), with no
+ * need to disable interrupts. An index is one byte, so reading it can't be
+ * torn. */
+
+/* Stop the compiler moving memory accesses from one side of this to the
+ * other, so an element is written before the index which publishes it. */
+#define BOZ_RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+template <class T, unsigned int N>
+struct boz_ring {
+    static_assert(N >= 2 && N <= 128 && (N & (N - 1)) == 0,
+            "boz_ring size must be a power of two from 2 to 128");
+
+    T buf[N];
+    volatile unsigned char head, tail;
+
+    /* Number of elements in the ring */
+    unsigned char count(void) const {
+        return (unsigned char) (tail - head);
+    }
+
+    unsigned char space(void) const {
+        return (unsigned char) (N - count());
+    }
+
+    bool is_empty(void) const {
+        return tail == head;
+    }
+
+    bool is_full(void) const {
+        return count() == N;
+    }
+
+    /* Add an element. Return 0, or -1 if the ring is full. */
+    int push(const T &element) {
+        unsigned char t = tail;
+
+        if ((unsigned char) (t - head) == N)
+            return -1;
+        buf[t & (N - 1)] = element;
+        BOZ_RING_BARRIER();
+        tail = t + 1;
+        return 0;
+    }
+
+    /* Add all n elements, or if there isn't room for them all, add none of
+     * them and return -1. */
+    int push_all(const T *elements, unsigned char n) {
+        unsigned char t = tail;
+
+        if (n > (unsigned char) (N - (unsigned char) (t - head)))
+            return -1;
+        for (unsigned char i = 0; i < n; ++i)
+            buf[(unsigned char) (t + i) & (N - 1)] = elements[i];
+        BOZ_RING_BARRIER();
+        tail = t + n;
+        return 0;
+    }
+
+    /* Write element into the free slot i places after the newest element,
+     * without adding it yet. Return 0, or -1 if there aren't that many free
+     * slots. Then publish() adds all the staged elements at once. */
+    int stage(unsigned char i, const T &element) {
+        unsigned char t = tail;
+
+        if (i >= (unsigned char) (N - (unsigned char) (t - head)))
+            return -1;
+        buf[(unsigned char) (t + i) & (N - 1)] = element;
+        return 0;
+    }
+
+    /* Add the n elements staged after the newest element */
+    void publish(unsigned char n) {
+        BOZ_RING_BARRIER();
+        tail = tail + n;
+    }
+
+    /* Take the oldest element and put it in *dest. Return 0, or -1 if the
+     * ring is empty. */
+    int pop(T *dest) {
+        unsigned char h = head;
+
+        if (tail == h)
+            return -1;
+        BOZ_RING_BARRIER();
+        *dest = buf[h & (N - 1)];
+        BOZ_RING_BARRIER();
+        head = h + 1;
+        return 0;
+    }
+
+    /* Set *run to the oldest element, and return how many elements follow it
+     * in buf without wrapping round, so they can all be read in place. Then
+     * call consume() with however many of them were used. */
+    unsigned char peek_run(const T **run) const {
+        unsigned char h = head;
+        unsigned char n = (unsigned char) (tail - h);
+        unsigned char to_end = N - (h & (N - 1));
+
+        BOZ_RING_BARRIER();
+        *run = &buf[h & (N - 1)];
+        return n < to_end ? n : to_end;
+    }
+
+    /* Throw away the n oldest elements, which must be in the ring */
+    void consume(unsigned char n) {
+        BOZ_RING_BARRIER();
+        head = head + n;
+    }
+
+    /* Throw away everything in the ring. This counts as taking elements, so
+     * only the side that takes them may call it. */
+    void clear(void) {
+        head = tail;
+    }
+};
+
+#endif
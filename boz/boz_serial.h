@@ -3,6 +3,7 @@
 
 void boz_serial_service_send(void);
 int boz_serial_enqueue_data_out(char *buf, int length);
+int boz_serial_send_now(const char *buf, int length);
 void boz_serial_init(void);
 
 #endif
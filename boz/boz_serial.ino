@@ -1,60 +1,39 @@
 #include "boz_api.h"
+#include "boz_input_log.h"
+#include "boz_ring.h"
 
 #ifdef BOZ_SERIAL
 
 #include <avr/pgmspace.h>
 
-#define QUEUE_SIZE 32
+/* Must be a power of two (see boz_ring.h) */
+#define OUT_QUEUE_SIZE 32
 
-struct queue {
-    char buf[QUEUE_SIZE];
-    byte head, tail, full;
-};
-
-struct queue out_queue;
-
-int boz_serial_queue_space(struct queue *queue) {
-    if (queue->full) {
-        return 0;
-    }
-    else if (queue->head <= queue->tail) {
-        return sizeof(out_queue) - (queue->tail - queue->head);
-    }
-    else {
-        return queue->head - queue->tail;
-    }
-}
+boz_ring<char, OUT_QUEUE_SIZE> out_queue;
 
 /* Send as many bytes as we can from out_queue to the serial port, without
    blocking. This is called by the main loop. */
 void boz_serial_service_send(void) {
-    struct queue *q = &out_queue;
     int max_write;
-    byte queue_end;
-    byte bytes_written = 0;
 
     /* If the queue is empty, there's nothing to send */
-    if (q->head == q->tail && !q->full)
+    if (out_queue.is_empty())
         return;
 
     /* How many bytes can we send without blocking? */
     max_write = Serial.availableForWrite();
 
-    /* Send that many bytes, starting from out_queue_head. */
-    while (bytes_written < max_write && (q->full || q->head != q->tail)) {
-        if (q->head >= q->tail)
-            queue_end = (byte) sizeof(q->buf);
-        else
-            queue_end = q->tail;
-
-        Serial.write(q->buf + q->head, queue_end - q->head);
-        bytes_written += queue_end - q->head;
-        q->head = queue_end;
-        q->full = 0;
-
-        if (q->head >= sizeof(q->buf)) {
-            q->head = 0;
-        }
+    /* Send that many bytes, straight out of the queue, in at most two goes
+       if the bytes wrap round the end of it. */
+    while (max_write > 0 && !out_queue.is_empty()) {
+        const char *run;
+        int n = out_queue.peek_run(&run);
+
+        if (n > max_write)
+            n = max_write;
+        Serial.write(run, n);
+        out_queue.consume(n);
+        max_write -= n;
     }
 }
 
@@ -66,44 +45,37 @@ int boz_serial_enqueue_data_out(char *buf, int length) {
        do so. */
     boz_serial_service_send();
 
-    return boz_serial_enqueue(&out_queue, buf, length);
-}
-
-int boz_serial_enqueue(struct queue *q, char *buf, int length) {
-    if (length <= 0)
-        return 0;
-
     /* If we don't have enough space for this message now, then fail to send
        it, rather than sending only half a message */
-    if (length > boz_serial_queue_space(q))
+    if (length > OUT_QUEUE_SIZE)
         return -1;
+    return out_queue.push_all(buf, (byte) length);
+}
 
-    while (!q->full && length > 0) {
-        int to_copy;
-        if (q->tail < q->head) {
-            to_copy = q->head - q->tail;
-        }
-        else {
-            to_copy = sizeof(q->buf) - q->tail;
-        }
-        if (to_copy > length)
-            to_copy = length;
-        memcpy(q->buf + q->tail, buf, to_copy);
-        q->tail += to_copy;
-        if (q->tail >= sizeof(q->buf))
-            q->tail = 0;
-        buf += to_copy;
-        length -= to_copy;
-        if (q->head == q->tail)
-            q->full = 1;
-    }
-
+/* Send this message straight to the serial port if it can take all of it
+   without blocking, and nothing's waiting in out_queue to go before it.
+   Otherwise send nothing and return -1. This is for things which can wait
+   until the serial port is idle, and shouldn't take up queue space an app
+   might want. */
+int boz_serial_send_now(const char *buf, int length) {
+    if (!out_queue.is_empty() || Serial.availableForWrite() < length)
+        return -1;
+    Serial.write(buf, length);
     return 0;
 }
 
+int boz_serial_read(void) {
+    int c = Serial.read();
+#ifdef BOZ_INPUT_LOG
+    if (c >= 0)
+        boz_input_log_serial((byte) c);
+#endif
+    return c;
+}
+
 void boz_serial_init(void) {
     Serial.begin(9600);
-    memset(&out_queue, 0, sizeof(out_queue));
+    out_queue.clear();
     //memset(&in_queue, 0, sizeof(in_queue));
 }
 
@@ -0,0 +1,46 @@
+#ifndef _BOZ_SERVICE_H
+#define _BOZ_SERVICE_H
+
+#include "boz_hw.h"
+#include "boz_util.h"
+
+/* How many background services can run at once */
+#define BOZ_MAX_SERVICES 2
+
+/* The most time a service may say it needs each time it runs. The budget is
+ * a promise, not a limit: the main loop can't interrupt a service, so it
+ * only finds out afterwards if the service took longer. */
+#define BOZ_SERVICE_MAX_BUDGET_US 2000
+
+/* If a service takes longer than its budget this many times in a row, the
+ * main loop stops it. */
+#define BOZ_SERVICE_MAX_OVERRUNS 3
+
+struct boz_mm_header;
+
+/* A background service started with boz_service_start(). If run is NULL,
+ * the slot is free. */
+struct boz_service {
+    void (*run)(void *cookie);
+    void *cookie;
+
+    /* When to call run() next, in boz_micros(), and how often to call it
+     * after that */
+    boz_time next_run_time;
+    unsigned int period_ms;
+
+    /* How long run() is allowed to take, and how many times in a row it
+     * has taken longer */
+    unsigned int budget_us;
+    byte overruns;
+
+    /* Clocks this service created, which the main loop checks for events
+     * and releases when the service stops, like app_context's */
+    unsigned short clocks_enabled;
+
+    /* Memory this service allocated with boz_mm_alloc(), freed when it
+     * stops */
+    struct boz_mm_header *mm_used_list;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "boz_api.h"
+#include "boz_util.h"
+#include "boz_mm.h"
+#include "boz_service.h"
+
+/* Background services. A service is a function the main loop calls every
+   so often, whichever app is in the foreground, and which carries on after
+   the app that started it exits.
+
+   The main loop can't interrupt a service, so each service says how long
+   it needs each time it runs, which is at most BOZ_SERVICE_MAX_BUDGET_US.
+   The main loop runs at most one service per pass, after it has scanned the
+   buttons and delivered their events, and afterwards checks how long the
+   service took. A service which keeps taking longer than it said is
+   stopped, but until then, it holds up the next scan by however long it
+   takes.
+
+   While a service runs, the clocks it creates and the memory it allocates
+   are its own, not the foreground app's, and they're released when it
+   stops. */
+
+struct boz_service services[BOZ_MAX_SERVICES];
+
+/* The service the main loop is running, or NULL if it's running the app */
+struct boz_service *current_service = NULL;
+
+/* Which service to try first on the next pass, so each gets its turn */
+byte service_next = 0;
+
+/* The app's used-chunks-list, while a service's is swapped in */
+struct boz_mm_header *service_app_mm_used_list;
+
+/* Release everything a stopped service still has */
+static void service_release(struct boz_service *s) {
+    for (byte i = 0; i < NUM_CLOCKS; ++i) {
+        if (s->clocks_enabled & (1 << i))
+            boz_clock_release(clocks[i]);
+    }
+    boz_mm_free_used_list(s->mm_used_list);
+    memzero(s, sizeof(*s));
+}
+
+static void service_enter(struct boz_service *s) {
+    current_service = s;
+    service_app_mm_used_list = boz_mm_swap_used_list(s->mm_used_list);
+}
+
+static void service_leave(void) {
+    struct boz_service *s = current_service;
+
+    s->mm_used_list = boz_mm_swap_used_list(service_app_mm_used_list);
+    current_service = NULL;
+
+    /* If the service stopped itself, we couldn't free its memory while it
+       was still using it. */
+    if (s->run == NULL)
+        service_release(s);
+}
+
+int
+boz_service_start(void (*run)(void *cookie), void *cookie,
+        unsigned int period_ms, unsigned int budget_us) {
+    struct boz_service *s;
+    int id;
+
+    if (run == NULL || period_ms == 0 || budget_us > BOZ_SERVICE_MAX_BUDGET_US)
+        return -1;
+
+    for (id = 0; id < BOZ_MAX_SERVICES; ++id) {
+        if (services[id].run == NULL)
+            break;
+    }
+    if (id >= BOZ_MAX_SERVICES)
+        return -1;
+
+    s = &services[id];
+    memzero(s, sizeof(*s));
+    s->run = run;
+    s->cookie = cookie;
+    s->period_ms = period_ms;
+    s->budget_us = budget_us;
+    s->next_run_time = boz_micros() + period_ms * 1000UL;
+    return id;
+}
+
+void
+boz_service_stop(int id) {
+    struct boz_service *s;
+
+    if (id < 0 || id >= BOZ_MAX_SERVICES || services[id].run == NULL)
+        return;
+
+    s = &services[id];
+    s->run = NULL;
+    if (s != current_service)
+        service_release(s);
+}
+
+void
+boz_service_set_next_run(unsigned long ms_from_now) {
+    if (current_service)
+        current_service->next_run_time = boz_micros() + (boz_time) ms_from_now * 1000;
+}
+
+/* Return 1 if the main loop is running a service, or a handler for one of
+   its clocks, rather than the app */
+byte
+services_running(void) {
+    return current_service != NULL;
+}
+
+/* Called by boz_clock_create() and boz_clock_release(). If a service is
+   running, the clock is its own. Return 1 if so. */
+byte
+services_clock_created(byte which_clock) {
+    if (current_service == NULL)
+        return 0;
+    current_service->clocks_enabled |= (1 << which_clock);
+    return 1;
+}
+
+void
+services_clock_released(byte which_clock) {
+    for (byte id = 0; id < BOZ_MAX_SERVICES; ++id)
+        services[id].clocks_enabled &= ~(1 << which_clock);
+}
+
+/* Bitmask of all the clocks the services own */
+unsigned short
+services_clocks_enabled(void) {
+    unsigned short mask = 0;
+
+    for (byte id = 0; id < BOZ_MAX_SERVICES; ++id)
+        mask |= services[id].clocks_enabled;
+    return mask;
+}
+
+/* Check the services' clocks for alarms and expiry, calling any handlers
+   as the service that owns the clock. */
+void
+services_check_clocks(void) {
+    for (byte id = 0; id < BOZ_MAX_SERVICES; ++id) {
+        struct boz_service *s = &services[id];
+
+        if (s->run && s->clocks_enabled) {
+            service_enter(s);
+            check_clock_events(s->clocks_enabled);
+            service_leave();
+        }
+    }
+}
+
+/* Run the first service, in turn, which is due to run by "now". */
+void
+services_run(boz_time now) {
+    for (byte i = 0; i < BOZ_MAX_SERVICES; ++i) {
+        byte id = (service_next + i) % BOZ_MAX_SERVICES;
+        struct boz_service *s = &services[id];
+        unsigned long start_us, elapsed_us;
+
+        if (s->run == NULL || now < s->next_run_time)
+            continue;
+
+        /* Schedule the next run from when this one should have been, unless
+           we've fallen so far behind that it's due already, in which case
+           don't try to catch up. The service may change it. */
+        s->next_run_time += s->period_ms * 1000UL;
+        if (now >= s->next_run_time)
+            s->next_run_time = now + s->period_ms * 1000UL;
+
+        start_us = micros();
+        service_enter(s);
+        s->run(s->cookie);
+        service_leave();
+        elapsed_us = micros() - start_us;
+
+        if (s->run) {
+            if (elapsed_us > s->budget_us) {
+                if (++s->overruns >= BOZ_SERVICE_MAX_OVERRUNS)
+                    boz_service_stop(id);
+            }
+            else {
+                s->overruns = 0;
+            }
+        }
+
+        service_next = id + 1;
+        break;
+    }
+}
+
+/* If any service is due to run before *next_wake, bring it forward */
+void
+services_next_wake(byte *next_wake_set, boz_time *next_wake) {
+    for (byte id = 0; id < BOZ_MAX_SERVICES; ++id) {
+        if (services[id].run)
+            update_if_passed(next_wake_set, next_wake, services[id].next_run_time);
+    }
+}
+
+/* Stop every service without calling it again */
+void
+services_reset(void) {
+    current_service = NULL;
+    service_next = 0;
+    memzero(services, sizeof(services));
+}
@@ -33,7 +33,7 @@ boz_sound_arpeggio(byte *notes, int num_notes, int duration_ms, byte num_times)
 void
 boz_sound_square_bell(int buzzer, int length_tenths_sec) {
     byte arp[] = { NOTE_B6, NOTE_E3, NOTE_B6, NOTE_E4 };
-    arp[1] += buzzer * 12;
-    arp[3] += buzzer * 12;
+    arp[1] += (buzzer % BOZ_NUM_LEDS) * 12;
+    arp[3] += (buzzer % BOZ_NUM_LEDS) * 12;
     boz_sound_arpeggio(arp, 4, 100, length_tenths_sec);
 }
@@ -0,0 +1,56 @@
+#ifndef _BOZ_TRACE_H
+#define _BOZ_TRACE_H
+
+#include "boz_hw.h"
+
+/* Trace points. Each one records its ID, a one-byte argument and the time
+ * in the trace ring if BOZ_TRACE is defined. See boz_trace.ino. host/trace.py
+ * reads the names from here, so keep to one #define per line.
+ *
+ * A display command is sent as soon as it comes off the queue, so DISP_STEP,
+ * when it's sent, stands for taking it off the queue too. A sound command
+ * can take several steps, so it has SND_POP as well. */
+#define BOZ_TRACE_SND_PUSH      1   /* arg: commands on the sound queue, or 255 if it was full */
+#define BOZ_TRACE_SND_POP       2   /* arg: commands left on the sound queue */
+#define BOZ_TRACE_SND_STEP      3   /* arg: times the sound has played */
+#define BOZ_TRACE_DISP_PUSH     4   /* arg: commands on the display queue, or 255 if it was full */
+#define BOZ_TRACE_DISP_STEP     5   /* arg: commands left on the display queue */
+#define BOZ_TRACE_BUTTON        6   /* arg: button index, buzzers first */
+#define BOZ_TRACE_CLOCK_ALARM   7   /* arg: clock number */
+#define BOZ_TRACE_CLOCK_EXPIRY  8   /* arg: clock number, plus 128 if it reached its maximum */
+#define BOZ_TRACE_SLEEP         9   /* arg: 0 */
+#define BOZ_TRACE_WAKE          10  /* arg: times the timestamp wrapped while asleep */
+#define BOZ_TRACE_APP_CALL      11  /* arg: ID of the app started */
+#define BOZ_TRACE_APP_EXIT      12  /* arg: exit status */
+
+#ifdef BOZ_TRACE
+
+#if defined(BOZ_INPUT_LOG) && !defined(BOZ_INPUT_LOG_EEPROM)
+#error "The trace dump can't share the serial port with the input log - define BOZ_INPUT_LOG_EEPROM as well"
+#endif
+
+/* Number of records the ring holds. Must be a power of two. Each record is
+ * four bytes of RAM. */
+#define BOZ_TRACE_SIZE 64
+
+/* Speed of the serial port for the dump, unless BOZ_SERIAL has set it up */
+#define BOZ_TRACE_BAUD 115200
+
+/* Called once by setup() */
+void boz_trace_init(void);
+
+void boz_trace_add(byte id, byte arg);
+
+/* Send the ring to the serial port as hex, oldest record first. Blocks
+ * until it's all gone. */
+void boz_trace_dump(void);
+
+#define BOZ_TRACE_POINT(id, arg) boz_trace_add(id, arg)
+
+#else
+
+#define BOZ_TRACE_POINT(id, arg)
+
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+#include "boz_hw.h"
+#include "boz_trace.h"
+
+#ifdef BOZ_TRACE
+
+/* The trace ring holds the last BOZ_TRACE_SIZE things that happened at the
+   BOZ_TRACE_POINT()s in the main loop, in order, to show how they lined up
+   with each other - a burst of display commands just before a buzz, say -
+   which the counts and totals in the replay summary can't.
+
+   Each record is the trace point's ID, its argument, and the bottom 16 bits
+   of micros() / 16. That wraps round every 1.05 seconds, which the main loop
+   never goes that long without recording something except when it's
+   asleep, so the WAKE record says how many times it wrapped in its sleep.
+
+   Hold yellow down and press reset to send the ring to the serial port,
+   like this, one record per line, each record being the ID, the argument
+   and the timestamp's low and high bytes:
+
+     BOZ TRACE
+     07 02 3c 81
+     ...
+     END
+
+   host/trace.py turns that into a timeline. */
+
+struct boz_trace_record {
+    byte id;
+    byte arg;
+    unsigned short t;
+};
+
+struct boz_trace {
+    struct boz_trace_record buf[BOZ_TRACE_SIZE];
+
+    /* Where the next record goes, and whether the ring has filled up yet */
+    byte pos;
+    byte full;
+};
+
+struct boz_trace trace;
+
+void
+boz_trace_init(void) {
+    memset(&trace, 0, sizeof(trace));
+#if !defined(BOZ_SERIAL) && !defined(BOZ_INPUT_LOG)
+    Serial.begin(BOZ_TRACE_BAUD);
+#endif
+}
+
+void
+boz_trace_add(byte id, byte arg) {
+    unsigned short t = (unsigned short) (micros() >> 4);
+    struct boz_trace_record *r;
+
+    noInterrupts();
+    r = &trace.buf[trace.pos];
+    r->id = id;
+    r->arg = arg;
+    r->t = t;
+    trace.pos = (trace.pos + 1) & (BOZ_TRACE_SIZE - 1);
+    if (trace.pos == 0)
+        trace.full = 1;
+    interrupts();
+}
+
+static void trace_write_hex(byte b) {
+    const char hex[] = "0123456789abcdef";
+    char str[2];
+    str[0] = hex[b >> 4];
+    str[1] = hex[b & 0x0f];
+    Serial.write(str, 2);
+}
+
+void
+boz_trace_dump(void) {
+    byte start = trace.full ? trace.pos : 0;
+    byte n = trace.full ? BOZ_TRACE_SIZE : trace.pos;
+
+#ifdef BOZ_WATCHDOG
+    /* At 9600 baud this takes most of a second, which is longer than the
+       watchdog would let a pass of the main loop take */
+    boz_watchdog_disarm();
+#endif
+
+    Serial.write("BOZ TRACE\r\n", 11);
+    for (byte i = 0; i < n; ++i) {
+        const struct boz_trace_record *r = &trace.buf[(start + i) & (BOZ_TRACE_SIZE - 1)];
+        trace_write_hex(r->id);
+        Serial.write(' ');
+        trace_write_hex(r->arg);
+        Serial.write(' ');
+        trace_write_hex(r->t & 0xff);
+        Serial.write(' ');
+        trace_write_hex(r->t >> 8);
+        Serial.write("\r\n", 2);
+    }
+    Serial.write("END\r\n", 5);
+    Serial.flush();
+
+#ifdef BOZ_WATCHDOG
+    boz_watchdog_arm();
+#endif
+}
+
+#endif
@@ -1,6 +1,13 @@
 #ifndef _BOZ_UTIL_H
 #define _BOZ_UTIL_H
 
+/* A time from boz_micros(): microseconds since power on, which doesn't wrap
+ * round. See boz_api.h. */
+typedef unsigned long long boz_time;
+
+boz_time
+boz_micros(void);
+
 int
 time_passed(unsigned long now, unsigned long when);
 
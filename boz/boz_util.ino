@@ -27,7 +27,7 @@ time_passed_aux(unsigned long now, unsigned long when, int dir_fwd) {
 
 /* If now is after when, return 1, else return 0.
    If now is more than 2^31 milliseconds after when, you'll get the wrong
-   answer. */
+   answer, so anything which might be that far apart uses boz_micros(). */
 int
 time_passed(unsigned long now, unsigned long when) {
     return time_passed_aux(now, when, 1);
@@ -47,3 +47,20 @@ time_elapsed(unsigned long before, unsigned long after) {
         return (~(0UL) - before) + after + 1;
     }
 }
+
+/* micros() wraps round every 71 minutes or so. time_high counts how many
+   times it has, which we notice when it's gone backwards since the last
+   call, so boz_micros() has to be called at least that often. The main loop
+   calls it on every pass, and wakes at least once a second to do so. */
+static unsigned long time_high = 0;
+static unsigned long time_last_us = 0;
+
+boz_time
+boz_micros(void) {
+    unsigned long us = micros();
+
+    if (us < time_last_us)
+        ++time_high;
+    time_last_us = us;
+    return ((boz_time) time_high << 32) | us;
+}
@@ -0,0 +1,52 @@
+#ifndef _BOZ_WATCHDOG_H
+#define _BOZ_WATCHDOG_H
+
+#include "boz_hw.h"
+
+/* Which part of the main loop is running, for the watchdog to record if
+ * the loop stops making progress. The crash app shows the number. */
+#define BOZ_PHASE_SOUND 1
+#define BOZ_PHASE_DISPLAY 2
+#define BOZ_PHASE_SERIAL 3
+#define BOZ_PHASE_EEPROM 4
+#define BOZ_PHASE_INPUT_LOG 5
+#define BOZ_PHASE_CLOCKS 6
+#define BOZ_PHASE_ALARM 7
+#define BOZ_PHASE_BUTTONS 8
+#define BOZ_PHASE_EVENTS 9
+#define BOZ_PHASE_SOUND_QUEUE 10
+#define BOZ_PHASE_APP_EXIT 11
+#define BOZ_PHASE_APP_START 12
+#define BOZ_PHASE_SLEEP 13
+#define BOZ_PHASE_SERVICES 14
+
+/* Where the watchdog records a stall in EEPROM, between the version table
+ * and the first app region. */
+#define BOZ_EEPROM_STALL_RECORD 0x20
+
+/* If the first byte of the stall record is this, it holds a stall we
+ * haven't shown yet. */
+#define BOZ_STALL_RECORD_MAGIC 0x5a
+
+struct boz_stall_record {
+    byte magic;
+
+    /* BOZ_PHASE_* the main loop was in */
+    byte phase;
+
+    /* Byte address of the instruction the watchdog interrupted */
+    unsigned int pc;
+
+    /* The longest pass of the main loop before the one that stalled, in
+     * microseconds */
+    unsigned long worst_pass_us;
+};
+
+#ifdef BOZ_WATCHDOG
+extern volatile byte boz_loop_phase;
+#define boz_set_loop_phase(p) (boz_loop_phase = (p))
+#else
+#define boz_set_loop_phase(p) ((void) 0)
+#endif
+
+#endif
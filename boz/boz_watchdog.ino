@@ -0,0 +1,111 @@
+#include "boz_hw.h"
+#include "boz_watchdog.h"
+#include "boz_crash.h"
+
+#include <EEPROM.h>
+#include <avr/wdt.h>
+
+/* The watchdog catches a main loop which has stopped making progress: an
+   app's event handler that never returns, say, or the I2C bus hanging in
+   the middle of a display update. Each pass of loop() resets it, so if a
+   pass takes longer than BOZ_WATCHDOG_TIMEOUT, its interrupt goes off. The
+   interrupt handler writes where the loop was to the stall record in
+   EEPROM, then waits for the watchdog to go off again, which resets the
+   MCU. On the next boot, setup() finds the record and starts the crash app
+   to show it.
+
+   It's off while we sleep, because we might sleep indefinitely waiting for
+   a button press. */
+
+/* Longest pass of loop() so far, not counting time asleep */
+unsigned long boz_worst_pass_us = 0;
+
+/* Called at the end of each pass of loop() that started at start_us */
+void
+boz_watchdog_pass_done(unsigned long start_us) {
+    unsigned long pass_us = micros() - start_us;
+
+    if (pass_us > boz_worst_pass_us)
+        boz_worst_pass_us = pass_us;
+}
+
+unsigned long
+boz_get_worst_pass_us(void) {
+    return boz_worst_pass_us;
+}
+
+#ifdef BOZ_WATCHDOG
+
+volatile byte boz_loop_phase = 0;
+
+/* Turn the watchdog off as soon as we can after a reset, because if it
+   reset us, it's still on, with the shortest timeout. */
+void
+boz_watchdog_init(void) {
+    MCUSR &= ~(1 << WDRF);
+    wdt_disable();
+}
+
+/* Start the watchdog, in interrupt-then-reset mode */
+void
+boz_watchdog_arm(void) {
+    wdt_enable(BOZ_WATCHDOG_TIMEOUT);
+    WDTCSR |= (1 << WDIE);
+}
+
+void
+boz_watchdog_disarm(void) {
+    wdt_disable();
+}
+
+/* Record a stall, then wait to be reset. sp is the stack pointer as it was
+   when the interrupt happened, so the next two bytes on the stack are the
+   interrupted instruction's word address, high byte first. */
+static void watchdog_record_stall(const byte *sp) {
+    struct boz_stall_record record;
+
+    record.magic = BOZ_STALL_RECORD_MAGIC;
+    record.phase = boz_loop_phase;
+    record.pc = (((unsigned int) sp[1] << 8) | sp[2]) << 1;
+    record.worst_pass_us = boz_worst_pass_us;
+
+    /* Write the magic number last, so a half-written record isn't valid */
+    for (int i = sizeof(record) - 1; i >= 0; --i)
+        EEPROM.update(BOZ_EEPROM_STALL_RECORD + i, ((byte *) &record)[i]);
+
+    while (1) {
+        /* Wait for the watchdog to reset us */
+    }
+}
+
+/* Naked, so the stack pointer is still where the interrupt left it. We never
+   return, so we don't need to save anything. */
+ISR(WDT_vect, ISR_NAKED) {
+#ifdef __AVR__
+    asm volatile ("clr __zero_reg__");
+#endif
+    watchdog_record_stall((const byte *) SP);
+}
+
+/* If the watchdog recorded a stall before the last reset, fill in *arg for
+   the crash app, clear the record so we only show it once, and return 1.
+   Otherwise return 0. */
+int
+boz_watchdog_take_stall(struct boz_crash_arg *arg) {
+    struct boz_stall_record record;
+
+    for (int i = 0; i < (int) sizeof(record); ++i)
+        ((byte *) &record)[i] = EEPROM.read(BOZ_EEPROM_STALL_RECORD + i);
+    if (record.magic != BOZ_STALL_RECORD_MAGIC)
+        return 0;
+    EEPROM.update(BOZ_EEPROM_STALL_RECORD, 0xff);
+
+    arg->addr = (void *) (unsigned long) record.pc;
+    arg->pattern = record.phase;
+    arg->light_state = 0;
+    arg->watchdog = 1;
+    arg->worst_pass_us = record.worst_pass_us;
+    return 1;
+}
+
+#endif
@@ -276,9 +276,10 @@ struct game_rules {
        If true, all buzzers whose (zero-based) index is less than
        first_c2_buzzer are the "left" team or side, and all buzzers whose
        index is equal to or greater than first_c2_buzzer are on the "right"
-       team or side.
-       If false, there are no teams or sides, each of the four buzzers is its
-       own player. */
+       team or side. If there are more than four buzzers, each is on the
+       same side as the one of the first four with the same colour LED.
+       If false, there are no teams or sides, each buzzer is its own
+       player. */
     unsigned int two_sides : 1;
 
     /* If two_sides is true, first_c2_buzzer is the buzzer index (zero-based)
@@ -348,8 +349,6 @@ const PROGMEM struct game_rules basic_buzzer_rules = {
 #define TIME_UP_NOISE_BRRP_BRRP 0
 #define TIME_UP_NOISE_BEEP_4    1
 
-#define NUM_BUZZERS 4
-
 /* Uncomment to enable random number feature. This adds about 500 bytes of
    program code. */
 //#define BUZZER_GAME_RANDOM_TARGET
@@ -357,19 +356,20 @@ const PROGMEM struct game_rules basic_buzzer_rules = {
 struct buzzer_game_state {
     boz_clock clock;
 
-    /* Whether each side (or player) has buzzed yet. If two_sides is not set,
-       then we use all four elements, otherwise we only use the first two. */
-    byte buzzed[NUM_BUZZERS];
+    /* Buzzers which have buzzed, along with the rest of their side if
+       two_sides is set (see bg_team()). Unless allow_rebuzz is set, these
+       are locked out until the next reset. */
+    boz_buzzer_mask buzzed;
 
-    /* The clock time when each side (or player) buzzed */
-    long buzz_times[NUM_BUZZERS];
+    /* If two_sides is set, the clock time when each side buzzed */
+    long buzz_times[2];
 
-    /* If a player buzzes too late (that is, when the clock is stopped after a
-       buzz or the expiry of the time), how late was it?
-       This is -1 if there is no late buzz since the clock last stopped.
+    /* If two_sides is set and a side buzzes too late (that is, when the
+       clock is stopped after a buzz or the expiry of the time), how late was
+       it? This is -1 if there is no late buzz since the clock last stopped.
        Otherwise it's the number of milliseconds late the buzz was (which
        can be zero!) */
-    long late_buzz_ms[NUM_BUZZERS];
+    long late_buzz_ms[2];
 
     char current_buzzer; // whose light is on?
     char last_buzzer; // who buzzed last?
@@ -383,49 +383,77 @@ struct buzzer_game_state {
        shows it in the top-left corner */
     int generated_target;
 
-    unsigned long last_buzz_at_millis; // millis() when last buzz occurred
-    unsigned long time_expired_at_millis; // millis() time when time ran out
+    boz_time last_buzz_at; // boz_micros() when last buzz occurred
+    boz_time time_expired_at; // boz_micros() time when time ran out
 
     /* If we call the option menu app, we allocate a struct option_menu_context
        and point this to it. The option menu app puts the selected option
        values in here and returns. Our return callback function frees it. */
     struct option_menu_context *bg_options_context;
+
+    /* The clock value at the top of the display */
+    struct boz_clock_display clock_display;
 };
 
 // Pointer to dynamically allocated memory
 static struct buzzer_game_state *bg_state;
 
-#define BUZZER_TO_SIDE(BUZZER) (!rules->two_sides ? (BUZZER) : (((BUZZER) < rules->first_c2_buzzer) ? 0 : 1))
-#define IS_LEFT_SIDE(BUZZER) ((BUZZER) < rules->first_c2_buzzer)
-#define IS_RIGHT_SIDE(BUZZER) ((BUZZER) >= rules->first_c2_buzzer)
-#define IS_SIDE_N(BUZZER, SIDE) ((BUZZER) >= 0 && ((!!(SIDE)) == ((BUZZER) >= rules->first_c2_buzzer)))
+/* Buzzer n has the same colour LED as buzzer n % 4, and in a two-sided
+   game, it's on the same side. */
+#define BUZZER_COLOUR(BUZZER) ((BUZZER) % BOZ_NUM_LEDS)
+#define SAME_COLOUR_BUZZERS ((boz_buzzer_mask) 0x1111)
+
+#define BUZZER_TO_SIDE(BUZZER) (IS_LEFT_SIDE(BUZZER) ? 0 : 1)
+#define IS_LEFT_SIDE(BUZZER) (BUZZER_COLOUR(BUZZER) < rules->first_c2_buzzer)
+#define IS_RIGHT_SIDE(BUZZER) (BUZZER_COLOUR(BUZZER) >= rules->first_c2_buzzer)
+#define IS_SIDE_N(BUZZER, SIDE) ((BUZZER) >= 0 && ((!!(SIDE)) == IS_RIGHT_SIDE(BUZZER)))
+
+/* The buzzers on side 0 (left) or 1 (right) of a two-sided game */
+static boz_buzzer_mask bg_side_buzzers(int side) {
+    boz_buzzer_mask left = (boz_buzzer_mask) (((1 << rules->first_c2_buzzer) - 1) * SAME_COLOUR_BUZZERS) & BOZ_ALL_BUZZERS;
+    return side ? (boz_buzzer_mask) (BOZ_ALL_BUZZERS & ~left) : left;
+}
+
+/* The buzzers on the same side as "buzzer", or if there are no sides, just
+   "buzzer" itself. They buzz as one: once one has buzzed, they're all
+   locked out. */
+static boz_buzzer_mask bg_team(int buzzer) {
+    if (!rules->two_sides)
+        return BOZ_BUZZER_BIT(buzzer);
+    return bg_side_buzzers(BUZZER_TO_SIDE(buzzer));
+}
 
 #ifdef BUZZER_GAME_RANDOM_TARGET
 char prng_seeded = 0;
 #endif
 
+/* Clock formats: "MM:SS.T", " SS.T" for time limits of a minute or less, and
+   the same with milliseconds for when the clock is stopped. */
+const PROGMEM struct boz_clock_format bg_clock_formats_tenths[] = {
+    /* value ls ts  -  h  :  m  0 fw  :  s  0 fw dp frac */
+    { 0L,     0, 2, 0, 0, 0, 1, 0, 2, 1, 1, 1, 2, 1, 1 },
+};
+const PROGMEM struct boz_clock_format bg_clock_formats_tenths_short[] = {
+    { 60000L, 0, 2, 0, 0, 0, 1, 0, 2, 1, 1, 1, 2, 1, 1 },
+    { 0L,     1, 2, 0, 0, 0, 0, 0, 0, 0, 1, 0, 2, 1, 1 },
+};
+const PROGMEM struct boz_clock_format bg_clock_formats_ms[] = {
+    { 0L,     0, 0, 0, 0, 0, 1, 0, 2, 1, 1, 1, 2, 1, 3 },
+};
+const PROGMEM struct boz_clock_format bg_clock_formats_ms_short[] = {
+    { 60000L, 0, 0, 0, 0, 0, 1, 0, 2, 1, 1, 1, 2, 1, 3 },
+    { 0L,     1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 2, 1, 3 },
+};
+
 static void update_clock_value(long ms, int decimal_places) {
-    int divisor = 1;
-    for (int i = decimal_places; i < 3; ++i)
-        divisor *= 10;
-
-    long minutes = ms / 60000L;
-    long seconds = (ms / 1000L) % 60;
-    long frac = (ms % 1000) / divisor;
-    boz_display_set_cursor(0, 4);
-    if (minutes > 0 || rules->time_limit_sec == 0 || rules->time_limit_sec > 60) {
-        boz_display_write_long(minutes, 2, 0);
-        boz_display_write_char(':');
-        boz_display_write_long(seconds, 2, BOZ_DISP_NUM_ZERO_PAD);
-    }
-    else {
-        boz_display_write_long(seconds, 3, 0);
-    }
-    boz_display_write_char('.');
-    boz_display_write_long(frac, decimal_places, BOZ_DISP_NUM_ZERO_PAD);
-    for (int i = decimal_places; i < 3; ++i) {
-        boz_display_write_char(' ');
-    }
+    const struct boz_clock_format *formats;
+    if (rules->time_limit_sec == 0 || rules->time_limit_sec > 60)
+        formats = (decimal_places == 3) ? bg_clock_formats_ms : bg_clock_formats_tenths;
+    else
+        formats = (decimal_places == 3) ? bg_clock_formats_ms_short : bg_clock_formats_tenths_short;
+
+    boz_clock_display_set_formats(&bg_state->clock_display, formats);
+    boz_clock_display_show_value(&bg_state->clock_display, ms);
 }
 
 static void update_clock_value_tenths(long ms) {
@@ -437,20 +465,20 @@ static void update_clock_value_ms(long ms) {
 }
 
 static void bg_set_leds(struct buzzer_game_state *state) {
-    byte leds;
+    boz_buzzer_mask leds;
     if (!state->clock_has_started || state->time_expired)
         leds = 0;
     else if (state->current_buzzer < 0) {
         if (!boz_clock_running(state->clock))
             leds = 0;
         else
-            leds = 0xf;
+            leds = BOZ_ALL_BUZZERS;
     }
     else {
-        leds = 1 << state->current_buzzer;
+        leds = BOZ_BUZZER_BIT(state->current_buzzer);
     }
 
-    boz_leds_set(leds);
+    boz_leds_set_buzzers(leds);
 }
 
 static void update_arrows(int left, int right) {
@@ -472,9 +500,12 @@ static void update_arrows(int left, int right) {
 
 static void update_buzz_indicator(int which_buzzer) {
     boz_display_set_cursor(1, 0);
-    for (int b = 0; b < 4; ++b) {
-        if (b == which_buzzer) {
-            boz_display_write_long(b + 1, 1, 0);
+    for (int b = 0; b < BOZ_NUM_LEDS; ++b) {
+        /* Buzzers with the same colour share a place. A two-digit buzzer
+           number pushes the spaces after it one place right, and the last
+           one goes off the end of the line. */
+        if (which_buzzer >= 0 && BUZZER_COLOUR(which_buzzer) == b) {
+            boz_display_write_long(which_buzzer + 1, 1, 0);
             boz_display_write_string_P(s_bg_up);
         }
         else {
@@ -530,6 +561,7 @@ static void update_late_buzz(int is_right, long ms_late) {
 static void redraw_display(struct buzzer_game_state *state) {
     long ms = boz_clock_value(state->clock);
     boz_display_clear();
+    boz_clock_display_invalidate(&state->clock_display);
 
     if (state->generated_target) {
         boz_display_write_long(state->generated_target, 3, 0);
@@ -577,23 +609,47 @@ static void redraw_display(struct buzzer_game_state *state) {
  
     if (rules->two_sides && rules->show_buzz_time) {
         for (int p = 0; p < 2; ++p) {
-            if (state->buzzed[p] && !IS_SIDE_N(state->current_buzzer, p)) {
+            if ((state->buzzed & bg_side_buzzers(p)) && !IS_SIDE_N(state->current_buzzer, p)) {
                 update_past_buzz_time(p, state->buzz_times[p]);
             }
         }
     }
 }
 
+/* Give the main loop our rules about who may buzz, so it can decide who
+   won and light their LED before our buzz handler is called. The buzzers
+   are only enabled while the clock is running. A buzz locks everyone out
+   until the QM restarts the clock, or for lockout_time_ms if the buzz
+   doesn't stop the clock. Buzzes which lose still come to bg_buzz_handler(),
+   which records how late they were. */
+static void bg_set_arbitration(struct buzzer_game_state *state) {
+    struct boz_arbitration policy;
+
+    memset(&policy, 0, sizeof(policy));
+    policy.enabled = boz_clock_running(state->clock) ? BOZ_ALL_BUZZERS : 0;
+    policy.lock_on_buzz = BOZ_ALL_BUZZERS;
+    policy.light_on_buzz = BOZ_ALL_BUZZERS;
+    if (!rules->buzz_stops_clock)
+        policy.unlock_ms = rules->lockout_time_ms;
+    policy.flags = BOZ_ARB_TELL_LOSERS;
+    if (!rules->allow_rebuzz)
+        policy.flags |= BOZ_ARB_ONE_PER_SIDE;
+    if (rules->two_sides) {
+        policy.flags |= BOZ_ARB_TWO_SIDES;
+        policy.left_side = bg_side_buzzers(0);
+    }
+    boz_arbitration_set(&policy);
+}
+
 void
 bg_reset_state(struct buzzer_game_state *state) {
     boz_clock_stop(state->clock);
     set_up_clock(state);
-    boz_cancel_alarm();
     boz_clock_reset(state->clock);
     boz_clock_cancel_alarm(state->clock);
 
-    for (int i = 0; i < NUM_BUZZERS; ++i) {
-        state->buzzed[i] = 0;
+    state->buzzed = 0;
+    for (int i = 0; i < 2; ++i) {
         state->buzz_times[i] = 0;
         state->late_buzz_ms[i] = -1;
     }
@@ -603,6 +659,8 @@ bg_reset_state(struct buzzer_game_state *state) {
     state->clock_has_started = 0;
     state->most_recent_warning_remain_sec = 0;
     state->generated_target = 0;
+    bg_set_arbitration(state);
+    boz_arbitration_reset();
     redraw_display(state);
 }
 
@@ -701,7 +759,7 @@ static void make_buzzer_noise(int noise, int buzzer) {
             byte beats[] = { 1, 1, 1, 1, 1, 1, 4 };
 
             for (int i = 0; i < (int) (sizeof(notes) / sizeof(notes[0])); ++i) {
-                boz_sound_note((boz_note) (notes[i] == 0 ? 0 : (notes[i] + 3 * buzzer)), beat_ms * beats[i]);
+                boz_sound_note((boz_note) (notes[i] == 0 ? 0 : (notes[i] + 3 * BUZZER_COLOUR(buzzer))), beat_ms * beats[i]);
             }
         }
         break;
@@ -730,8 +788,12 @@ bg_time_expired_handler(void *cookie, boz_clock clock) {
 
     boz_clock_stop(clock);
     boz_clock_cancel_alarm(state->clock);
+    boz_arbitration_enable(0);
     state->time_expired = 1;
-    state->time_expired_at_millis = millis();
+
+    /* The main loop stopped the clock when it ran out, which might have
+       been a little before now */
+    state->time_expired_at = boz_clock_time_at_value(clock, boz_clock_value(clock));
 
     boz_sound_stop_all();
     make_time_up_noise(rules->time_up_noise);
@@ -739,98 +801,132 @@ bg_time_expired_handler(void *cookie, boz_clock clock) {
     redraw_display(state);
 }
 
+/* Yellow button event handler */
 static void bg_unlock_buzzers(void *statev) {
     struct buzzer_game_state *state = (struct buzzer_game_state *) statev;
+
+    boz_arbitration_unlock();
+    state->current_buzzer = -1;
+    redraw_display(state);
+}
+
+/* The main loop has unlocked the buzzers lockout_time_ms after a buzz */
+static void bg_buzzers_unlocked(void *statev) {
+    struct buzzer_game_state *state = (struct buzzer_game_state *) statev;
+
+    /* If the QM paused the clock during the lockout, keep showing who
+       buzzed until they restart it */
+    if (!boz_clock_running(state->clock) && !state->time_expired)
+        return;
     state->current_buzzer = -1;
     redraw_display(state);
 }
 
 static void accept_buzz(struct buzzer_game_state *state, int which_buzzer) {
-    /* If we get here, the clock is running. Stop the clock if the rules
+    /* When the buzzer was pressed, which might be a little before now if
+       the main loop was busy */
+    boz_time buzz_time = boz_get_event_time();
+
+    /* If we get here, the clock is running, or it has just run out and
+       this buzzer was pressed before it did. Stop the clock if the rules
        require it, record the buzz time, then update the display and LEDs
        with the current state. */
     if (rules->buzz_stops_clock) {
-        boz_clock_stop(state->clock);
-    }
-    else {
-        if (rules->lockout_time_ms > 0) {
-            boz_set_alarm((long) rules->lockout_time_ms, bg_unlock_buzzers, state);
-        }
+        boz_clock_stop_at(state->clock, buzz_time);
+        boz_arbitration_enable(0);
     }
     state->current_buzzer = which_buzzer;
     state->last_buzzer = which_buzzer;
-    state->last_buzz_at_millis = millis();
+    state->last_buzz_at = buzz_time;
 
     if (rules->two_sides) {
-        int which_side = BUZZER_TO_SIDE(which_buzzer);
-        state->buzz_times[which_side] = boz_clock_value(state->clock);
-        state->buzzed[which_side] = 1;
-    }
-    else {
-        state->buzzed[which_buzzer] = 1;
+        state->buzz_times[BUZZER_TO_SIDE(which_buzzer)] = boz_clock_value_at(state->clock, buzz_time);
     }
+    state->buzzed |= bg_team(which_buzzer);
 
-    /* Whatever we're bleating out into the world, stop and make a buzzer noise */
+    /* Whatever we're bleating out into the world, interrupt it with a buzzer
+       noise, replacing the noise from any earlier buzz. A warning or time-up
+       noise carries on afterwards. */
+    boz_sound_set_priority(BOZ_SOUND_PRIORITY_HIGH);
     boz_sound_stop_all();
 
     if (rules->buzz_length_tenths > 0) {
         make_buzzer_noise(rules->buzzer_noise, which_buzzer);
     }
+    boz_sound_set_priority(BOZ_SOUND_PRIORITY_NORMAL);
 
     redraw_display(state);
 }
 
-static int is_entitled_to_buzz(struct buzzer_game_state *state, int which_buzzer) {
-    if (!rules->two_sides) {
-        if (which_buzzer < 0 || which_buzzer >= NUM_BUZZERS)
-            return 0;
-        else
-            return rules->allow_rebuzz || !state->buzzed[which_buzzer];
-    }
-    else {
-        int which_side = BUZZER_TO_SIDE(which_buzzer);
-        if (which_side < 0 || which_side > 1)
-            return 0;
-        else
-            return rules->allow_rebuzz || !state->buzzed[which_side];
-    }
+/* The buzzers which may buzz, if the clock is running and nobody else has
+   the floor. The main loop keeps its own record of this, under our
+   arbitration policy, but we need it to tell a late buzz from one by a side
+   which has already had its go. */
+static boz_buzzer_mask entitled_buzzers(struct buzzer_game_state *state) {
+    if (rules->allow_rebuzz)
+        return BOZ_ALL_BUZZERS;
+    else
+        return BOZ_ALL_BUZZERS & ~state->buzzed;
 }
 
 void
 bg_buzz_handler(void *cookie, int which_buzzer) {
     struct buzzer_game_state *state = (struct buzzer_game_state *) cookie;
+    boz_buzzer_mask bit;
     int which_side;
 
-    if (which_buzzer < 0 || which_buzzer >= NUM_BUZZERS) {
+    if (which_buzzer < 0 || which_buzzer >= BOZ_NUM_BUZZERS) {
         // passer-by made a convincing buzzer noise
         return;
     }
+    bit = BOZ_BUZZER_BIT(which_buzzer);
 
-    if (!is_entitled_to_buzz(state, which_buzzer)) {
+    if (!(entitled_buzzers(state) & bit)) {
         // you already had a go and you cocked it up
         return;
     }
 
-    which_side = BUZZER_TO_SIDE(which_buzzer);
-
-    if (state->current_buzzer >= 0 && which_side == BUZZER_TO_SIDE(state->current_buzzer)) {
+    if (state->current_buzzer >= 0 && (bg_team(state->current_buzzer) & bit)) {
         // yes, we heard you, now leave the button alone and answer the QM
         return;
     }
 
-    if (!boz_clock_running(state->clock) || state->current_buzzer >= 0) {
+    if (!boz_arbitration_won()) {
+        boz_time buzz_time = boz_get_event_time();
+
+        /* If it was pressed before time ran out, but the buzzers were
+           disabled by the time we saw it, it was in time, so it counts */
+        if (state->time_expired && state->current_buzzer < 0 &&
+                buzz_time < state->time_expired_at) {
+            byte won;
+
+            boz_arbitration_enable(BOZ_ALL_BUZZERS);
+            won = boz_arbitration_claim(which_buzzer);
+            boz_arbitration_enable(0);
+            if (won) {
+                accept_buzz(state, which_buzzer);
+                return;
+            }
+        }
+
         /* Too late or too early - either way, hop it, but I might
            record the time you did this, just to laugh at you */
-        if (state->clock_has_started && (state->current_buzzer >= 0 || state->time_expired)) {
+        which_side = BUZZER_TO_SIDE(which_buzzer);
+        if (rules->two_sides && state->clock_has_started && (state->current_buzzer >= 0 || state->time_expired)) {
             if (state->late_buzz_ms[which_side] < 0) {
-                unsigned long millis_end;
+                boz_time end;
                 if (state->current_buzzer >= 0)
-                    millis_end = state->last_buzz_at_millis;
+                    end = state->last_buzz_at;
                 else
-                    millis_end = state->time_expired_at_millis;
-
-                state->late_buzz_ms[which_side] = time_elapsed(millis_end, millis());
-                if (rules->two_sides && rules->show_buzz_time) {
+                    end = state->time_expired_at;
+
+                /* A press in the same sample as the winning buzz is a dead
+                   heat, shown as 0ms late. One from before the end wasn't
+                   late at all. */
+                if (buzz_time < end)
+                    return;
+                state->late_buzz_ms[which_side] = (long) ((buzz_time - end) / 1000);
+                if (rules->show_buzz_time) {
                     update_late_buzz(which_side != 0, state->late_buzz_ms[which_side]);
                 }
             }
@@ -858,28 +954,25 @@ bg_play(void *cookie) {
         /* Stop the clock, redraw the display */
         boz_clock_stop(state->clock);
         boz_clock_cancel_alarm(state->clock);
-
-        /* Any pending buzzer-unlock alarm is no longer required */
-        boz_cancel_alarm();
+        boz_arbitration_enable(0);
 
         redraw_display(state);
     }
     else {
-        /* Any pending buzzer-unlock alarm is no longer required */
-        boz_cancel_alarm();
-
         /* QM pressed play to start or resume the clock */
         long current_clock_value = boz_clock_value(state->clock);
 
         /* There is no current buzzing player, unlock the other buzzers */
         state->current_buzzer = -1;
+        boz_arbitration_unlock();
 
         /* Remove "late buzz" notifications */
-        for (int i = 0; i < NUM_BUZZERS; ++i)
+        for (int i = 0; i < 2; ++i)
             state->late_buzz_ms[i] = -1;
 
         /* Resume the clock */
         boz_clock_run(state->clock);
+        boz_arbitration_enable(BOZ_ALL_BUZZERS);
 
         /* Is anyone who is still entitled to buzz currently holding their
            buzzer down? If so, and if the clock has previously been started
@@ -891,9 +984,11 @@ bg_play(void *cookie) {
         int earliest_buzzer = -1;
 
         if (state->clock_has_started) {
-            for (int buzzer = 0; buzzer < NUM_BUZZERS; ++buzzer) {
+            boz_buzzer_mask held = boz_buzzers_pressed() & entitled_buzzers(state);
+
+            for (int buzzer = 0; held; ++buzzer, held >>= 1) {
                 unsigned long pressed_since_micros;
-                if (is_entitled_to_buzz(state, buzzer) && boz_is_button_pressed(FUNC_BUZZER, buzzer, &pressed_since_micros)) {
+                if ((held & 1) && boz_is_button_pressed(FUNC_BUZZER, buzzer, &pressed_since_micros)) {
                     if (earliest_buzzer == -1 || time_passed(earliest_press_micros, pressed_since_micros)) {
                         earliest_buzzer = buzzer;
                         earliest_press_micros = pressed_since_micros;
@@ -905,6 +1000,10 @@ bg_play(void *cookie) {
         /* The clock has started */
         state->clock_has_started = 1;
 
+        /* The main loop decides who has won, even here */
+        if (earliest_buzzer >= 0 && !boz_arbitration_claim(earliest_buzzer))
+            earliest_buzzer = -1;
+
         if (earliest_buzzer >= 0) {
             /* Someone held down the buzzer in anticipation of the clock
                restarting. The clock restarted and they've now buzzed. */
@@ -992,10 +1091,13 @@ bg_options_return_callback(void *cookie, int rc) {
         if (bg_options_return[BG_OPTIONS_INDEX_SAVE_AS_DEFAULT]) {
             /* If the user set "save as default" to Yes, then write the new
                rules out to this app's EEPROM region */
-            boz_eeprom_write(0, rules, sizeof(*rules)); 
+            boz_eeprom_write(0, rules, sizeof(*rules));
         }
     }
 
+    /* The rules about who may buzz might have changed */
+    bg_set_arbitration(state);
+
     /* Free the array of options context structure we created for the options
        menu app. */
     if (omc != NULL) {
@@ -1069,10 +1171,10 @@ bg_generate_target(void *cookie) {
     struct buzzer_game_state *state = (struct buzzer_game_state *) cookie;
 
     if (!prng_seeded) {
-        /* Current time in microseconds plus 1009 times the analog value on an
-           unconnected pin gives us a (somewhat) random initial seed. */
-        pinMode(A7, INPUT);
-        randomSeed(micros() + 1009L * (long) analogRead(A7));
+        /* Current time in microseconds plus 1009 times the noise the ADC has
+           picked up on an unconnected pin gives us a (somewhat) random
+           initial seed. */
+        randomSeed(micros() + 1009L * (long) boz_get_adc_noise());
         prng_seeded = 1;
     }
 
@@ -1084,6 +1186,37 @@ bg_generate_target(void *cookie) {
 }
 #endif
 
+const PROGMEM struct boz_event_handlers bg_handlers = {
+    bg_buzz_handler,    // buzz
+    bg_play,            // qm_play
+    bg_unlock_buzzers,  // qm_yellow
+    bg_reset,           // qm_reset
+    bg_rotary_press,    // qm_rotary_press
+    NULL,               // qm_rotary
+    NULL,               // qm_rotary_steps
+    NULL,               // sound_queue_not_full
+    NULL,               // serial_data_available
+    NULL,               // display_queue_space
+    bg_buzzers_unlocked, // buzzers_unlocked
+};
+
+#ifdef BUZZER_GAME_RANDOM_TARGET
+/* The same, but yellow generates a random target */
+const PROGMEM struct boz_event_handlers bg_target_handlers = {
+    bg_buzz_handler,    // buzz
+    bg_play,            // qm_play
+    bg_generate_target, // qm_yellow
+    bg_reset,           // qm_reset
+    bg_rotary_press,    // qm_rotary_press
+    NULL,               // qm_rotary
+    NULL,               // qm_rotary_steps
+    NULL,               // sound_queue_not_full
+    NULL,               // serial_data_available
+    NULL,               // display_queue_space
+    bg_buzzers_unlocked, // buzzers_unlocked
+};
+#endif
+
 void
 buzzer_game_general_init(const struct game_rules *rules_progmem) {
     rules = (struct game_rules *) boz_mm_alloc(sizeof(*rules));
@@ -1100,19 +1233,17 @@ buzzer_game_general_init(const struct game_rules *rules_progmem) {
     }
 
     bg_state->clock = boz_clock_create(0, 1);
+    boz_clock_display_init(&bg_state->clock_display, bg_state->clock,
+            bg_clock_formats_tenths, 0, 4, 9);
 
     bg_reset_state(bg_state);
 
-    boz_set_event_handler_buzz(bg_buzz_handler);
-    boz_set_event_handler_qm_play(bg_play);
-    boz_set_event_handler_qm_reset(bg_reset);
 #ifdef BUZZER_GAME_RANDOM_TARGET
     if (rules->yellow_generates_target)
-        boz_set_event_handler_qm_yellow(bg_generate_target);
+        boz_set_event_handlers(&bg_target_handlers);
     else
 #endif
-        boz_set_event_handler_qm_yellow(bg_unlock_buzzers);
-    boz_set_event_handler_qm_rotary_press(bg_rotary_press);
+        boz_set_event_handlers(&bg_handlers);
     boz_set_event_cookie(bg_state);
 
     boz_clock_set_event_cookie(bg_state->clock, bg_state);
@@ -1,4 +1,5 @@
 #include "boz_api.h"
+#include "boz_pt.h"
 #include "options.h"
 #include <avr/pgmspace.h>
 
@@ -191,25 +192,7 @@ const PROGMEM struct option_page clock_settings_menu[] = {
 #define CLOCK_SETTINGS_ALLOW_NEGATIVE 3
 #define CLOCK_SETTINGS_LENGTH 4
 
-struct chess_clock_format {
-    long abs_value_min;
-    unsigned int leading_spaces : 4;
-    unsigned int trailing_spaces : 4;
-    unsigned int show_sign : 1;
-    unsigned int show_hours : 1;
-    unsigned int show_hour_colon : 1;
-    unsigned int show_minutes : 1;
-    unsigned int minutes_zero_pad : 1;
-    unsigned int minutes_field_width : 2;
-    unsigned int show_minutes_colon : 1;
-    unsigned int show_seconds : 1;
-    unsigned int seconds_zero_pad : 1;
-    unsigned int seconds_field_width : 2;
-    unsigned int show_decimal_point : 1;
-    unsigned int show_tenths : 1;
-};
-
-const PROGMEM struct chess_clock_format left_clock_formats[] = {
+const PROGMEM struct boz_clock_format left_clock_formats[] = {
     /* value   ls ts  -  h  :  m  0 fw  :  s  0 fw dp /10  */
 
     /* an hour or more: show as "-H:MM:SS" */
@@ -228,7 +211,7 @@ const PROGMEM struct chess_clock_format left_clock_formats[] = {
     { 0L,       1, 3, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1 },
 };
 
-const PROGMEM struct chess_clock_format right_clock_formats[] = {
+const PROGMEM struct boz_clock_format right_clock_formats[] = {
     /* value   ls ts  -  h  :  m  0 fw  :  s  0 fw dp /10  */
 
     /* an hour or more: show as "-H:MM:SS" */
@@ -247,7 +230,7 @@ const PROGMEM struct chess_clock_format right_clock_formats[] = {
     { 0L,       3, 1, 1, 0, 0, 0, 0, 0, 0, 1, 0, 1, 1, 1 },
 };
 
-const PROGMEM struct chess_clock_format delay_clock_formats[] = {
+const PROGMEM struct boz_clock_format delay_clock_formats[] = {
     /* value   ls ts  -  h  :  m  0 fw  :  s  0 fw dp /10  */
 
     /* An hour or more: show as H:MM */
@@ -272,8 +255,6 @@ const PROGMEM struct chess_clock_format delay_clock_formats[] = {
 #define TURN_ROW 1
 #define TURN_LEFT_COL 0
 #define TURN_RIGHT_COL 15
-#define FLAG_CHAR 0
-#define TURN_CHAR 7
 
 /* Crude drawing of a flag */
 const PROGMEM byte flag_char_pattern[] = {
@@ -296,6 +277,11 @@ struct chess_state {
     /* flags[x] if player x's flag has fallen */
     byte flags[2];
 
+    /* The character codes boz_display_glyph() gave us for our flag and
+       whose-turn-it-is characters */
+    char flag_char;
+    char turn_char;
+
     /* -1 if clocks are stopped, 0 if it's left player, 1 if right player */
     char whose_turn;
 
@@ -308,66 +294,94 @@ struct chess_state {
 
     struct option_menu_context *clock_settings_menu_context;
     struct option_menu_context *preset_menu_context;
+
+    /* Where chess_pick_preset() has got to */
+    boz_pt preset_pt;
+
+    /* What's showing on the display for each player's clock and the delay
+       clock */
+    struct boz_clock_display clock_displays[2];
+    struct boz_clock_display delay_display;
 };
 
 struct chess_state *chess_state;
 
-static void chess_set_cgram() {
-    /* Program display CGRAM with our whose-turn-it-is and flag characters */
-    boz_display_set_cgram_address(TURN_CHAR << 3);
-    for (int i = 0; i < 8; ++i) {
-        boz_display_write_char(pgm_read_byte_near(turn_char_pattern + i));
-    }
-    boz_display_set_cgram_address(FLAG_CHAR << 3);
-    for (int i = 0; i < 8; ++i) {
-        boz_display_write_char(pgm_read_byte_near(flag_char_pattern + i));
+/* Make sure display CGRAM has our flag and whose-turn-it-is characters.
+   If the display queue is too full for them, try again shortly, and return
+   -1. Return 0 if we've got them. */
+static int chess_set_cgram(struct chess_state *state) {
+    int flag_char = boz_display_glyph(flag_char_pattern);
+    int turn_char = boz_display_glyph(turn_char_pattern);
+
+    if (flag_char < 0 || turn_char < 0) {
+        boz_set_alarm(10, chess_set_cgram_retry, state);
+        return -1;
     }
+    state->flag_char = (char) flag_char;
+    state->turn_char = (char) turn_char;
+    return 0;
+}
+
+/* Alarm handler: we didn't get our characters last time, so try again, and
+   redraw the display with them if we get them this time */
+void
+chess_set_cgram_retry(void *cookie) {
+    struct chess_state *state = (struct chess_state *) cookie;
+
+    if (chess_set_cgram(state) == 0)
+        chess_redraw(state);
 }
 
+const PROGMEM struct boz_event_handlers chess_handlers = {
+    chess_buzzer,       // buzz
+    chess_play,         // qm_play
+    NULL,               // qm_yellow
+    chess_reset,        // qm_reset
+    chess_rotary_press, // qm_rotary_press
+};
+
+/* Get the user to pick a preset time control from the options app, then
+   set up the game with it. */
 void
-chess_init_callback(void *cookie, int rc) {
+chess_pick_preset(void *cookie) {
+    struct option_menu_context *omc;
     int preset_picked;
-    struct option_menu_context *omc = chess_state->preset_menu_context;
 
-    if (rc != 0) {
+    BOZ_PT_BEGIN(&chess_state->preset_pt);
+
+    omc = (struct option_menu_context *) boz_mm_alloc(sizeof(struct option_menu_context));
+    chess_state->preset_menu_context = omc;
+    omc->pages = preset_menu;
+    omc->num_pages = 1;
+    omc->results = (long *) boz_mm_alloc(sizeof(long));
+    omc->results[0] = 0;
+    omc->one_shot = 1;
+    omc->page_disable_mask = 0;
+    BOZ_PT_CALL_APP(&chess_state->preset_pt, BOZ_APP_ID_OPTION_MENU, omc,
+            chess_pick_preset, NULL);
+
+    if (boz_app_call_status() != 0) {
         boz_app_exit(1);
-        return;
+        BOZ_PT_EXIT(&chess_state->preset_pt);
     }
 
-    if (omc == NULL) {
-        preset_picked = 0;
-    }
-    else {
-        preset_picked = (int) omc->results[0];
-        boz_mm_free(omc->results);
-        boz_mm_free(omc);
-        chess_state->preset_menu_context = NULL;
-    }
+    omc = chess_state->preset_menu_context;
+    preset_picked = (int) omc->results[0];
+    boz_mm_free(omc->results);
+    boz_mm_free(omc);
+    chess_state->preset_menu_context = NULL;
 
     /* Load the selected time control, whose index is now in preset_picked */
     memcpy_P(&chess_state->rules, &rules_list[preset_picked], sizeof(chess_state->rules));
 
-    chess_set_cgram();
+    chess_set_cgram(chess_state);
 
     chess_game_reset(chess_state);
 
     boz_set_event_cookie(chess_state);
-    boz_set_event_handler_qm_play(chess_play);
-    boz_set_event_handler_qm_reset(chess_reset);
-    boz_set_event_handler_buzz(chess_buzzer);
-    boz_set_event_handler_qm_rotary_press(chess_rotary_press);
-}
+    boz_set_event_handlers(&chess_handlers);
 
-static void start_preset_menu() {
-    struct option_menu_context *omc = (struct option_menu_context *) boz_mm_alloc(sizeof(struct option_menu_context));
-    chess_state->preset_menu_context = omc;
-    omc->pages = preset_menu;
-    omc->num_pages = 1;
-    omc->results = (long *) boz_mm_alloc(sizeof(long));
-    omc->results[0] = 0;
-    omc->one_shot = 1;
-    omc->page_disable_mask = 0;
-    boz_app_call(BOZ_APP_ID_OPTION_MENU, omc, chess_init_callback, NULL);
+    BOZ_PT_END(&chess_state->preset_pt);
 }
 
 void
@@ -380,88 +394,25 @@ chess_init(void *dummy) {
     chess_state->clocks[1] = NULL;
     chess_state->delay_clock = NULL;
 
-    start_preset_menu();
-}
-
-static void print_clock_value(long value_ms, const struct chess_clock_format *format_array) {
-    struct chess_clock_format format;
-    long abs_value_ms = value_ms;
-    if (abs_value_ms < 0)
-        abs_value_ms = -abs_value_ms;
-
-    /* Find the first element of format_array suitable for this value. The
-       last element in the array must have an abs_value_min of zero! */
-    do {
-        memcpy_P(&format, format_array, sizeof(format));
-        ++format_array;
-    } while (abs_value_ms < format.abs_value_min);
-
-    for (int i = 0; i < format.leading_spaces; ++i) {
-        boz_display_write_char(' ');
-    }
-    if (format.show_sign) {
-        boz_display_write_char((value_ms < 0) ? '-' : ' ');
-    }
-
-    value_ms = abs_value_ms;
-
-    if (format.show_hours) {
-        boz_display_write_long(value_ms / 3600000L, 1, 0);
-    }
-    if (format.show_hour_colon) {
-        boz_display_write_char(':');
-    }
-    if (format.show_minutes) {
-        boz_display_write_long((value_ms / 60000L) % 60, format.minutes_field_width, format.minutes_zero_pad ? BOZ_DISP_NUM_ZERO_PAD : 0);
-    }
-    if (format.show_minutes_colon) {
-        boz_display_write_char(':');
-    }
-    if (format.show_seconds) {
-        boz_display_write_long((value_ms / 1000L) % 60, format.seconds_field_width, format.seconds_zero_pad ? BOZ_DISP_NUM_ZERO_PAD : NULL);
-    }
-    if (format.show_decimal_point) {
-        boz_display_write_char('.');
-    }
-    if (format.show_tenths) {
-        boz_display_write_long((value_ms / 100L) % 10, 1, BOZ_DISP_NUM_ZERO_PAD);
-    }
-
-    for (int i = 0; i < format.trailing_spaces; ++i) {
-        boz_display_write_char(' ');
-    }
+    chess_pick_preset(NULL);
 }
 
 static void redraw_clock(struct chess_state *state, int which_clock) {
-    long value_ms = boz_clock_value(state->clocks[which_clock]);
-    const struct chess_clock_format *formatp;
-    long abs_value_ms = value_ms;
-
-    if (abs_value_ms < 0)
-        abs_value_ms = -abs_value_ms;
-
-    if (which_clock)
-        formatp = right_clock_formats;
-    else
-        formatp = left_clock_formats;
-
-    boz_display_set_cursor(0, which_clock ? 8 : 0);
-    print_clock_value(value_ms, formatp);
-
-    attach_clock_update_alarm(state->clocks[which_clock], which_clock);
+    boz_clock_display_update(&state->clock_displays[which_clock]);
+    attach_clock_update_alarm(state, which_clock);
 }
 
 static void redraw_delay_clock(void *cookie, boz_clock clock) {
     struct chess_state *state = (struct chess_state *) cookie;
-    long value_ms = boz_clock_value(clock);
     char turn = state->whose_turn;
     if (turn < 0)
         turn = state->whose_turn_before_stopped;
 
-    boz_display_set_cursor(DELAY_ROW, turn == 0 ? DELAY_LEFT_COL : DELAY_RIGHT_COL);
-    print_clock_value(value_ms, delay_clock_formats);
+    boz_clock_display_move(&state->delay_display, DELAY_ROW,
+            turn == 0 ? DELAY_LEFT_COL : DELAY_RIGHT_COL);
+    boz_clock_display_update(&state->delay_display);
 
-    attach_delay_update_alarm(clock);
+    attach_delay_update_alarm(state);
 }
 
 static void clock_update_alarm(void *cookie, boz_clock clock) {
@@ -481,61 +432,23 @@ static void clock_update_alarm(void *cookie, boz_clock clock) {
     }
 }
 
-static void attach_clock_update_alarm(boz_clock clock, int which_player) {
-    static const int step_ms = 200;
-    long value_ms = boz_clock_value(clock);
-    long alarm_ms;
-    int mod;
-
-    if (value_ms > 0) {
-        mod = value_ms % step_ms;
-        if (mod == 0)
-            mod = step_ms;
-    }
-    else {
-        mod = -value_ms % step_ms;
-        mod = step_ms - mod;
-    }
-
-    /* Set the alarm for when the clock's value is e.g. 123.010 seconds, not
-       123.000, so that if it takes more than 1ms to wake up and be called, we
-       don't end up displaying 122 seconds. If the alarm time is exactly on
-       a multiple of 200ms, it can lead to the seconds appearing to change
-       irregularly, e.g.:
-       2:03 (wait 1000ms) 2:02 (wait 800ms) 2:01 (wait 1200ms) 2:00
-    */
-    alarm_ms = value_ms - mod + 10;
-
-    /* If the alarm time is greater than (i.e. earlier than) the clock value
-       (this can happen if at 123.005 seconds we set the alarm, which will end
-       up being at 123.010 seconds) then we really want the alarm at the next
-       200ms + 10 boundary, so 122.810 seconds. */
-    if (alarm_ms >= value_ms)
-        alarm_ms -= step_ms;
+/* Set an alarm to redraw a player's clock when what it shows next changes,
+   which is once a second for most of the game, and only every 100ms when
+   it's showing tenths. */
+static void attach_clock_update_alarm(struct chess_state *state, int which_player) {
+    boz_clock clock = state->clocks[which_player];
+    long alarm_ms = boz_clock_display_next_change(&state->clock_displays[which_player],
+            boz_clock_value(clock), boz_clock_is_direction_forwards(clock));
 
     boz_clock_set_alarm(clock, alarm_ms, clock_update_alarm);
 }
 
-static void attach_delay_update_alarm(boz_clock clock) {
-    static const int step_ms = 200;
-    long value_ms = boz_clock_value(clock);
-    long alarm_ms;
-    int mod = value_ms % step_ms;
+static void attach_delay_update_alarm(struct chess_state *state) {
+    boz_clock clock = state->delay_clock;
+    long alarm_ms = boz_clock_display_next_change(&state->delay_display,
+            boz_clock_value(clock), boz_clock_is_direction_forwards(clock));
 
-    if (boz_clock_is_direction_forwards(clock)) {
-        mod = step_ms - mod;
-        alarm_ms = value_ms + mod;
-    }
-    else {
-        if (mod == 0)
-            mod = step_ms;
-        alarm_ms = value_ms - mod + 10;
-        if (alarm_ms >= value_ms)
-            alarm_ms -= step_ms;
-    }
-
-    if (!(alarm_ms == 0 && value_ms == 0))
-        boz_clock_set_alarm(clock, alarm_ms, redraw_delay_clock);
+    boz_clock_set_alarm(clock, alarm_ms, redraw_delay_clock);
 }
 
 static void flag_fall(struct chess_state *state, int which_player) {
@@ -549,7 +462,7 @@ static void flag_fall(struct chess_state *state, int which_player) {
         boz_sound_note(NOTE_G4, 800);
         boz_display_set_cursor(FLAG_ROW, FLAG_RIGHT_COL);
     }
-    boz_display_write_char(FLAG_CHAR);
+    boz_display_write_char(state->flag_char);
 }
 
 static void chess_clock_expired(void *cookie, boz_clock clock) {
@@ -567,9 +480,12 @@ void chess_redraw(struct chess_state *state) {
     char turn;
 
     boz_display_clear();
+    boz_clock_display_invalidate(&state->delay_display);
 
-    for (int i = 0; i < 2; ++i)
+    for (int i = 0; i < 2; ++i) {
+        boz_clock_display_invalidate(&state->clock_displays[i]);
         redraw_clock(state, i);
+    }
 
     turn = state->whose_turn;
     if (turn < 0)
@@ -583,11 +499,11 @@ void chess_redraw(struct chess_state *state) {
 
     if (state->flags[0]) {
         boz_display_set_cursor(FLAG_ROW, FLAG_LEFT_COL);
-        boz_display_write_char(FLAG_CHAR);
+        boz_display_write_char(state->flag_char);
     }
     if (state->flags[1]) {
         boz_display_set_cursor(FLAG_ROW, FLAG_RIGHT_COL);
-        boz_display_write_char(FLAG_CHAR);
+        boz_display_write_char(state->flag_char);
     }
 
     if (turn < 0) {
@@ -596,12 +512,12 @@ void chess_redraw(struct chess_state *state) {
     else if (turn == 0) {
         boz_leds_set(1);
         boz_display_set_cursor(TURN_ROW, TURN_LEFT_COL);
-        boz_display_write_char(TURN_CHAR);
+        boz_display_write_char(state->turn_char);
     }
     else {
         boz_leds_set(8);
         boz_display_set_cursor(TURN_ROW, TURN_RIGHT_COL);
-        boz_display_write_char(TURN_CHAR);
+        boz_display_write_char(state->turn_char);
     }
 
     if (state->whose_turn < 0 && turn >= 0) {
@@ -620,14 +536,16 @@ chess_game_reset(struct chess_state *state) {
         state->clocks[i] = boz_clock_create(state->rules.initial_time_ms, 0);
 
         boz_clock_set_event_cookie(state->clocks[i], state);
+        boz_clock_display_init(&state->clock_displays[i], state->clocks[i],
+                i ? right_clock_formats : left_clock_formats, 0, i ? 8 : 0, 8);
 
         /* If the clock is not allowed to go negative, set 0 as its minimum
            value which makes the flag fall. */
         if (!state->rules.allow_negative)
             boz_clock_set_expiry_min(state->clocks[i], 0, chess_clock_expired);
 
-        /* Alarm which updates the display a few times a second */
-        attach_clock_update_alarm(state->clocks[i], i);
+        /* Alarm which updates the display when the time shown changes */
+        attach_clock_update_alarm(state, i);
         state->flags[i] = 0;
         state->delay_expired[i] = 0;
         state->num_moves[i] = 0;
@@ -647,7 +565,9 @@ chess_game_reset(struct chess_state *state) {
                clock */
             state->delay_clock = boz_clock_create(state->rules.increment_ms, 0);
             boz_clock_set_event_cookie(state->delay_clock, state);
-            attach_delay_update_alarm(state->delay_clock);
+            boz_clock_display_init(&state->delay_display, state->delay_clock,
+                    delay_clock_formats, DELAY_ROW, DELAY_LEFT_COL, 4);
+            attach_delay_update_alarm(state);
             boz_clock_set_expiry_min(state->delay_clock, 0, chess_delay_expired);
             break;
         case CHESS_INC_MODE_BRONSTEIN_DELAY:
@@ -656,6 +576,8 @@ chess_game_reset(struct chess_state *state) {
                onto the player's main time, whichever is smaller */
             state->delay_clock = boz_clock_create(0, 1);
             boz_clock_set_event_cookie(state->delay_clock, state);
+            boz_clock_display_init(&state->delay_display, state->delay_clock,
+                    delay_clock_formats, DELAY_ROW, DELAY_LEFT_COL, 4);
             boz_clock_set_expiry_max(state->delay_clock, state->rules.increment_ms, chess_delay_expired);
             break;
     }
@@ -667,23 +589,28 @@ static void chess_delay_expired(void *cookie, boz_clock clock) {
     struct chess_state *state = (struct chess_state *) cookie;
     int player = state->whose_turn;
     if (player >= 0) {
-        boz_clock_run(state->clocks[player]);
+        /* Start the player's main clock from when the delay ran out, which
+           might have been a little before we got here */
+        boz_clock_run_at(state->clocks[player],
+                boz_clock_time_at_value(clock, boz_clock_value(clock)));
         state->delay_expired[player] = 1;
     }
     chess_redraw(state);
 }
 
-static void start_player_move(struct chess_state *state, int player) {
+/* Start player's move at t, the value of boz_micros() when the other player
+   pressed their button. The other player's clock stops and this player's
+   starts at that same instant, with any increment or delay applied. */
+static void start_player_move(struct chess_state *state, int player, boz_time t) {
     switch (state->rules.increment_mode) {
         case CHESS_INC_MODE_INC:
             boz_clock_add(state->clocks[player], state->rules.increment_ms);
-            attach_clock_update_alarm(state->clocks[player], player);
             state->delay_expired[player] = 1;
             break;
 
         case CHESS_INC_MODE_SIMPLE_DELAY:
         case CHESS_INC_MODE_BRONSTEIN_DELAY:
-            boz_clock_stop(state->delay_clock);
+            boz_clock_stop_at(state->delay_clock, t);
             boz_clock_reset(state->delay_clock);
             if (state->rules.increment_mode == CHESS_INC_MODE_SIMPLE_DELAY)
                 boz_clock_set_expiry_min(state->delay_clock, 0, chess_delay_expired);
@@ -697,33 +624,42 @@ static void start_player_move(struct chess_state *state, int player) {
     }
     state->whose_turn = player;
     state->num_moves[player]++;
-    start_player_clock(state, player);
+
+    /* With a simple delay, the delay clock runs first, then the player's
+       clock. Otherwise the player's clock starts straight away. */
+    if (state->delay_expired[player] || state->rules.increment_mode == CHESS_INC_MODE_BRONSTEIN_DELAY)
+        boz_clock_hand_over(state->clocks[!player], state->clocks[player], t);
+    else
+        boz_clock_hand_over(state->clocks[!player], state->delay_clock, t);
+    start_player_clock(state, player, t);
 }
 
-static void start_player_clock(struct chess_state *state, int player) {
+static void start_player_clock(struct chess_state *state, int player, boz_time t) {
     if (state->delay_expired[player] || state->rules.increment_mode == CHESS_INC_MODE_BRONSTEIN_DELAY) {
-        boz_clock_run(state->clocks[player]);
+        boz_clock_run_at(state->clocks[player], t);
     }
 
     if (!state->delay_expired[player]) {
-        boz_clock_run(state->delay_clock);
+        boz_clock_run_at(state->delay_clock, t);
     }
     state->clocks_have_started = 1;
 }
 
-static void stop_player_clock(struct chess_state *state, int player) {
-    boz_clock_stop(state->clocks[player]);
+static void stop_player_clock(struct chess_state *state, int player, boz_time t) {
+    boz_clock_stop_at(state->clocks[player], t);
     if (state->delay_clock)
-        boz_clock_stop(state->delay_clock);
+        boz_clock_stop_at(state->delay_clock, t);
 }
 
-static void end_player_move(struct chess_state *state, int player) {
+/* End player's move at t. This only credits them with any Bronstein delay:
+   start_player_move() stops their clock. */
+static void end_player_move(struct chess_state *state, int player, boz_time t) {
     /* Only end a move if there's a move to end */
     if (state->num_moves[player] > 0) {
         long ms_to_add = 0;
         switch (state->rules.increment_mode) {
             case CHESS_INC_MODE_BRONSTEIN_DELAY:
-                ms_to_add = boz_clock_value(state->delay_clock);
+                ms_to_add = boz_clock_value_at(state->delay_clock, t);
                 if (ms_to_add > state->rules.increment_ms) {
                     ms_to_add = state->rules.increment_ms;
                 }
@@ -731,24 +667,23 @@ static void end_player_move(struct chess_state *state, int player) {
         }
         if (ms_to_add > 0) {
             boz_clock_add(state->clocks[player], ms_to_add);
-            attach_clock_update_alarm(state->clocks[player], player);
         }
-        stop_player_clock(state, player);
     }
 }
 
 void
 chess_play(void *cookie) {
     struct chess_state *state = (struct chess_state *) cookie;
+    boz_time t = boz_get_event_time();
 
     if (state->whose_turn >= 0) {
         state->whose_turn_before_stopped = state->whose_turn;
         state->whose_turn = -1;
-        stop_player_clock(state, state->whose_turn_before_stopped);
+        stop_player_clock(state, state->whose_turn_before_stopped, t);
     }
     else if (state->whose_turn_before_stopped >= 0) {
         state->whose_turn = state->whose_turn_before_stopped;
-        start_player_clock(state, state->whose_turn);
+        start_player_clock(state, state->whose_turn, t);
     }
     chess_redraw(state);
 }
@@ -757,8 +692,8 @@ void
 chess_reset(void *cookie) {
     struct chess_state *state = (struct chess_state *) cookie;
     if (!state->clocks_have_started) {
-        /* Go back into the preset menu, and then to chess_init_callback */
-        start_preset_menu();
+        /* Go back into the preset menu, and start again from there */
+        chess_pick_preset(NULL);
     }
     else {
         /* Reset the clock to its initial state */
@@ -770,14 +705,15 @@ void
 chess_buzzer(void *cookie, int which_buzzer) {
     struct chess_state *state = (struct chess_state *) cookie;
     int which_player = (which_buzzer == 0) ? 0 : 1;
+    boz_time t = boz_get_event_time();
 
     if (state->whose_turn >= 0 && state->whose_turn != which_player)
         return;
     if (state->whose_turn < 0 && state->whose_turn_before_stopped >= 0 && state->whose_turn_before_stopped != which_player)
         return;
 
-    end_player_move(state, which_player);
-    start_player_move(state, !which_player);
+    end_player_move(state, which_player, t);
+    start_player_move(state, !which_player, t);
     chess_redraw(state);
 }
 
@@ -813,7 +749,7 @@ chess_settings_callback(void *cookie, int rc) {
 
     /* Calling the options app will have reset CGRAM to the defaults, so put
        our own custom characters back */
-    chess_set_cgram();
+    chess_set_cgram(state);
 
     if (rc == 0 && state->clock_settings_menu_context != NULL) {
         long *clock_settings_results = omc->results;
@@ -3,6 +3,16 @@
 #include "boz_sound.h"
 
 const PROGMEM char s_crash_guru[] = "Guru Meditation";
+const PROGMEM char s_crash_stalled[] = "Main loop stuck";
+
+/* When showing a stall from before the last reset, press play or reset to
+   carry on as normal */
+const PROGMEM struct boz_event_handlers crash_stall_handlers = {
+    NULL,               // buzz
+    crash_stall_exit,   // qm_play
+    NULL,               // qm_yellow
+    crash_stall_exit,   // qm_reset
+};
 
 void
 crash_init(void *ptr) {
@@ -10,7 +20,7 @@ crash_init(void *ptr) {
 
     /* Clear the display and write "Guru Meditation" */
     boz_display_clear();
-    boz_display_write_string_P(s_crash_guru);
+    boz_display_write_string_P(ptr && arg->watchdog ? s_crash_stalled : s_crash_guru);
 
     /* Set the LEDs to the lower four bits of arg->pattern, and write that
        number and the address of the crash to the display, which will look
@@ -20,12 +30,31 @@ crash_init(void *ptr) {
         2D30  0009
        
        First number is where we think boz_crash was called from, second number
-       is arg->pattern. */
+       is arg->pattern.
+
+       If the watchdog caught the main loop stuck before the last reset, the
+       first number is where it was stuck, then the BOZ_PHASE_* of the main
+       loop it was in, then the longest pass of the main loop before that in
+       milliseconds:
+
+       Main loop stuck
+        2D30 P09   42ms
+       */
     if (ptr) {
         boz_leds_set(arg->pattern);
         boz_display_set_cursor(1, 0);
         boz_display_write_long((unsigned long) arg->addr, 4, BOZ_DISP_NUM_SPACES | BOZ_DISP_NUM_ZERO_PAD | BOZ_DISP_NUM_HEX);
-        boz_display_write_long(arg->pattern, 4, BOZ_DISP_NUM_SPACES | BOZ_DISP_NUM_ZERO_PAD | BOZ_DISP_NUM_HEX);
+        if (arg->watchdog) {
+            boz_display_write_char('P');
+            boz_display_write_long(arg->pattern, 2, BOZ_DISP_NUM_ZERO_PAD);
+            boz_display_write_long((long) (arg->worst_pass_us / 1000), 5, 0);
+            boz_display_write_char('m');
+            boz_display_write_char('s');
+            boz_set_event_handlers(&crash_stall_handlers);
+        }
+        else {
+            boz_display_write_long(arg->pattern, 4, BOZ_DISP_NUM_SPACES | BOZ_DISP_NUM_ZERO_PAD | BOZ_DISP_NUM_HEX);
+        }
         arg->light_state = 1;
 
         /* Flash the lights on and off according to the given pattern: half
@@ -54,3 +83,8 @@ crash_alarm_handler(void *ptr) {
     }
     boz_set_alarm(500, crash_alarm_handler, ptr);
 }
+
+void
+crash_stall_exit(void *cookie) {
+    boz_app_exit(0);
+}
@@ -5,6 +5,21 @@ const PROGMEM char s_fr_ready_to_exit[] = "Press " BOZ_CHAR_PLAY_S " to exit";
 const PROGMEM char s_fr_confirm[] = "Erase storage?";
 const PROGMEM char s_fr_yes_no[] = " " BOZ_CHAR_PLAY_S " OK  " BOZ_CHAR_RESET_S " Cancel";
 
+const PROGMEM struct boz_event_handlers fr_handlers = {
+    NULL,       // buzz
+    fr_play,    // qm_play
+    NULL,       // qm_yellow
+    fr_exit,    // qm_reset
+};
+
+/* Once the storage is erased, any button but the buzzers exits */
+const PROGMEM struct boz_event_handlers fr_exit_handlers = {
+    NULL,       // buzz
+    fr_exit,    // qm_play
+    fr_exit,    // qm_yellow
+    fr_exit,    // qm_reset
+};
+
 void fr_play(void *cookie) {
     boz_leds_set(15);
     boz_eeprom_global_reset();
@@ -14,8 +29,7 @@ void fr_play(void *cookie) {
     boz_display_write_string_P(s_fr_done);
     boz_display_set_cursor(1, 0);
     boz_display_write_string_P(s_fr_ready_to_exit);
-    boz_set_event_handler_qm_play(fr_exit);
-    boz_set_event_handler_qm_yellow(fr_exit);
+    boz_set_event_handlers(&fr_exit_handlers);
 }
 
 void fr_exit(void *cookie) {
@@ -23,8 +37,7 @@ void fr_exit(void *cookie) {
 }
 
 void factory_reset_init(void *dummy) {
-    boz_set_event_handler_qm_play(fr_play);
-    boz_set_event_handler_qm_reset(fr_exit);
+    boz_set_event_handlers(&fr_handlers);
 
     boz_display_clear();
     boz_display_write_string_P(s_fr_confirm);
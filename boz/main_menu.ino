@@ -13,15 +13,13 @@ struct main_menu_state {
     int mm_app_cursor;
     int mm_first_runnable;
     int mm_last_runnable;
-
-    int last_buzzer_id;
-    int buzzers_locked;
 };
 
 static struct main_menu_state *menu_state;
 
 const PROGMEM char s_mm_help[] = "   select  " BOZ_CHAR_PLAY_S " run";
 const PROGMEM char s_mm_no_loadable_apps[] = "No runnable apps!";
+const PROGMEM char s_mm_battery_low[] = "Bat";
 
 void
 mm_load_app(struct boz_app *dest, int index) {
@@ -47,6 +45,15 @@ mm_redraw_display(int include_help) {
 
         boz_display_set_cursor(1, help_start);
         boz_display_write_string_P(s_mm_help + help_start);
+
+        if (boz_is_battery_low()) {
+            /* Say how many minutes the battery has left, where "select"
+               would be, so the QM knows before starting a long game */
+            boz_display_set_cursor(1, 3);
+            boz_display_write_string_P(s_mm_battery_low);
+            boz_display_write_long(boz_get_battery_minutes_left(), 3, 0);
+            boz_display_write_char('m');
+        }
     }
     boz_display_set_cursor(0, 0);
 
@@ -77,6 +84,23 @@ mm_redraw_display(int include_help) {
     }
 }
 
+const PROGMEM struct boz_event_handlers mm_handlers = {
+    mm_buzz_handler,    // buzz
+    mm_play_handler,    // qm_play
+    mm_unlock_buzzers,  // qm_yellow
+    NULL,               // qm_reset
+    mm_play_handler,    // qm_rotary_press
+    NULL,               // qm_rotary
+    mm_rotary_handler,  // qm_rotary_steps
+};
+
+/* If there are no apps to choose, the buzzers still work */
+const PROGMEM struct boz_event_handlers mm_no_apps_handlers = {
+    mm_buzz_handler,    // buzz
+    NULL,               // qm_play
+    mm_unlock_buzzers,  // qm_yellow
+};
+
 void
 main_menu_init(void *dummy) {
     struct boz_app app;
@@ -89,8 +113,6 @@ main_menu_init(void *dummy) {
     menu_state->mm_first_runnable = -1;
     menu_state->mm_last_runnable = -1;
     menu_state->mm_menu_apps_count = 0;
-    menu_state->last_buzzer_id = -1;
-    menu_state->buzzers_locked = 0;
 
     for (int i = 0; i < menu_state->mm_apps_count; ++i) {
         mm_load_app(&app, i);
@@ -103,44 +125,65 @@ main_menu_init(void *dummy) {
         }
     }
 
+    /* Very simple buzz handling for the main menu, so the user can play
+       with the buzzers even before selecting an app. There are no clocks or
+       options, just simple fixed rules:
+       * Pressing a buzzer makes a noise, illuminates the appropriate LED,
+         and locks out all other buzzers for 3 seconds.
+       * After 3 seconds, or if the yellow button is pressed, buzzers are
+         enabled again and the LEDs go out.
+       The main loop does all that but the noise. */
+    struct boz_arbitration policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.enabled = BOZ_ALL_BUZZERS;
+    policy.lock_on_buzz = BOZ_ALL_BUZZERS;
+    policy.light_on_buzz = BOZ_ALL_BUZZERS;
+    policy.unlock_ms = buzz_lock_timeout_ms;
+    policy.flags = BOZ_ARB_UNLOCK_LEDS_OFF;
+    boz_arbitration_set(&policy);
+    boz_arbitration_reset();
+
     if (menu_state->mm_menu_apps_count <= 0) {
         /* Display "no apps" message and go into infinite sleep */
         boz_display_clear();
         boz_display_write_string_P(s_mm_no_loadable_apps);
+        boz_set_event_handlers(&mm_no_apps_handlers);
     }
     else {
         boz_set_event_cookie(NULL);
-        boz_set_event_handler_qm_rotary(mm_rotary_handler);
-        boz_set_event_handler_qm_rotary_press(mm_play_handler);
-        boz_set_event_handler_qm_play(mm_play_handler);
+        boz_set_event_handlers(&mm_handlers);
 
         menu_state->mm_app_cursor = menu_state->mm_first_runnable;
         mm_redraw_display(1);
     }
-
-    boz_set_event_handler_qm_yellow(mm_unlock_buzzers);
-    boz_set_event_handler_buzz(mm_buzz_handler);
 }
 
 void
-mm_rotary_handler(void *cookie, int clockwise) {
+mm_rotary_handler(void *cookie, int steps) {
     struct boz_app app;
-    int direction = (clockwise ? 1 : -1);
-    int cursor = menu_state->mm_app_cursor;
-
-    /* Find the next (or previous) app in the list with BOZ_APP_MAIN set, and
-       if we hit either end of the list, give up */
-    do {
-        cursor += direction;
-        if (cursor >= 0 && cursor < menu_state->mm_apps_count) {
-            mm_load_app(&app, cursor);
-        }
-    } while (cursor >= 0 && cursor < menu_state->mm_apps_count && (app.flags & BOZ_APP_MAIN) == 0);
-
-    if (cursor >= 0 && cursor < menu_state->mm_apps_count) {
+    int direction = (steps > 0 ? 1 : -1);
+    int moved = 0;
+
+    for (; steps != 0; steps -= direction) {
+        int cursor = menu_state->mm_app_cursor;
+
+        /* Find the next (or previous) app in the list with BOZ_APP_MAIN set,
+           and if we hit either end of the list, give up */
+        do {
+            cursor += direction;
+            if (cursor >= 0 && cursor < menu_state->mm_apps_count) {
+                mm_load_app(&app, cursor);
+            }
+        } while (cursor >= 0 && cursor < menu_state->mm_apps_count && (app.flags & BOZ_APP_MAIN) == 0);
+
+        if (cursor < 0 || cursor >= menu_state->mm_apps_count)
+            break;
         menu_state->mm_app_cursor = cursor;
-        mm_redraw_display(0);
+        moved = 1;
     }
+
+    if (moved)
+        mm_redraw_display(0);
 }
 
 void
@@ -163,27 +206,14 @@ mm_return_callback(void *cookie, int rc) {
 
 void
 mm_unlock_buzzers(void *cookie) {
-    boz_cancel_alarm();
     boz_leds_set(0);
-    menu_state->buzzers_locked = 0;
+    boz_arbitration_unlock();
 }
 
 void
 mm_buzz_handler(void *cookie, int which_buzzer) {
-    /* Very simple buzz handling for the main menu, so the user can play with
-       the buzzers even before selecting an app. There are no clocks or
-       options, just simple fixed rules:
-       * Pressing a buzzer makes a noise, illuminates the appropriate LED,
-         and locks out all other buzzers for 3 seconds.
-       * After 3 seconds, or if the yellow button is pressed, buzzers are
-         enabled again and the LEDs go out.
-    */
-
-    if (!menu_state->buzzers_locked && which_buzzer >= 0 && which_buzzer <= BOZ_NUM_BUZZERS) {
+    /* Only the winner of a buzz gets here, and the main loop has already
+       lit its LED and locked out the others (see main_menu_init()) */
+    if (which_buzzer >= 0 && which_buzzer < BOZ_NUM_BUZZERS)
         boz_sound_square_bell(which_buzzer, buzz_length_tenths_sec);
-        boz_leds_set(1 << which_buzzer);
-        menu_state->last_buzzer_id = which_buzzer;
-        menu_state->buzzers_locked = 1;
-        boz_set_alarm(buzz_lock_timeout_ms, mm_unlock_buzzers, NULL);
-    }
 }
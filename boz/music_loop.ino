@@ -1,4 +1,5 @@
 #include "boz_api.h"
+#include "boz_pt.h"
 
 #include <avr/pgmspace.h>
 
@@ -254,64 +255,110 @@ const PROGMEM byte stave_filled_bottom[] = {
     0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00
 };
 
-void
-ml_set_cgram_char(int address, const byte *data) {
-    boz_display_set_cgram_address(address << 3);
-    for (int i = 0; i < 8; ++i) {
-        boz_display_write_char(pgm_read_byte_near(data + i));
+/* The character codes boz_display_glyph() gave us for our eight
+   characters, in the order ml_set_cgram_char() asks for them: treble clef
+   top and bottom, stave top and bottom, start of stave top and bottom, and
+   filled stave top and bottom. */
+char ml_chars[8];
+
+/* Return 0 if we've got a character code for data, or -1 if the display
+   queue was too full to set it up */
+int
+ml_set_cgram_char(int index, const byte *data) {
+    int code = boz_display_glyph(data);
+
+    if (code < 0)
+        return -1;
+    ml_chars[index] = (char) code;
+    return 0;
+}
+
+/* Get character codes for the first four or the last four of our eight
+   characters. Any we've already got are still there, so asking again
+   doesn't send the display anything. Return -1 if the display queue filled
+   up before we had them all. */
+static int ml_set_cgram_chars(int first) {
+    if (first == 0) {
+        if (ml_set_cgram_char(0, treble_clef_top) ||
+                ml_set_cgram_char(1, treble_clef_bottom) ||
+                ml_set_cgram_char(2, stave_top) ||
+                ml_set_cgram_char(3, stave_bottom))
+            return -1;
     }
+    else {
+        if (ml_set_cgram_char(4, stave_start_top) ||
+                ml_set_cgram_char(5, stave_start_bottom) ||
+                ml_set_cgram_char(6, stave_filled_top) ||
+                ml_set_cgram_char(7, stave_filled_bottom))
+            return -1;
+    }
+    return 0;
 }
 
+const PROGMEM struct boz_event_handlers music_loop_handlers = {
+    NULL,                           // buzz
+    music_loop_play,                // qm_play
+    NULL,                           // qm_yellow
+    music_loop_reset,               // qm_reset
+    NULL,                           // qm_rotary_press
+    NULL,                           // qm_rotary
+    NULL,                           // qm_rotary_steps
+    music_loop_sound_queue_ready,   // sound_queue_not_full
+    NULL,                           // serial_data_available
+    ml_draw_beat,                   // display_queue_space
+};
+
+/* Where music_loop_start() has got to */
+boz_pt ml_start_pt;
+
 void
 music_loop_init(void *dummy) {
     boz_display_clear();
-    boz_set_event_handler_qm_reset(music_loop_reset);
-    boz_set_event_handler_qm_play(music_loop_play);
+    boz_set_event_handlers(&music_loop_handlers);
+    ml_start_pt = 0;
+    music_loop_start(NULL);
+}
 
-    ml_set_cgram_char(0, treble_clef_top);
-    ml_set_cgram_char(1, treble_clef_bottom);
-    ml_set_cgram_char(2, stave_top);
-    ml_set_cgram_char(3, stave_bottom);
+void
+music_loop_start(void *cookie) {
+    BOZ_PT_BEGIN(&ml_start_pt);
 
     /* Do the initialisation in stages with a short wait between, so as not
-       to overfill the display command queue */
-    boz_set_alarm(10, music_loop_init_stage_two, NULL);
-}
+       to overfill the display command queue. If it was too full anyway,
+       wait and try that stage again. */
+    while (ml_set_cgram_chars(0) < 0)
+        BOZ_PT_SLEEP(&ml_start_pt, 10, music_loop_start, NULL);
+    BOZ_PT_SLEEP(&ml_start_pt, 10, music_loop_start, NULL);
 
-void
-music_loop_init_stage_two(void *dummy) {
-    ml_set_cgram_char(4, stave_start_top);
-    ml_set_cgram_char(5, stave_start_bottom);
-    ml_set_cgram_char(6, stave_filled_top);
-    ml_set_cgram_char(7, stave_filled_bottom);
-    boz_set_alarm(10, music_loop_init_stage_three, NULL);
+    while (ml_set_cgram_chars(4) < 0)
+        BOZ_PT_SLEEP(&ml_start_pt, 10, music_loop_start, NULL);
+    BOZ_PT_SLEEP(&ml_start_pt, 10, music_loop_start, NULL);
+
+    music_loop_draw_display_start();
+    ml_melody_pos = 0;
+    ml_beat = 0;
+    music_loop_play(NULL);
+
+    BOZ_PT_END(&ml_start_pt);
 }
 
 void
 music_loop_draw_display_start(void) {
     boz_display_clear();
-    boz_display_write_char(0);
+    boz_display_write_char(ml_chars[0]);
     boz_display_write_long(ml_melody_beats_per_bar, 2, 0);
     boz_display_write_char(' ');
-    boz_display_write_char(4);
+    boz_display_write_char(ml_chars[4]);
     for (int i = 5; i < 16; ++i)
-        boz_display_write_char(2);
+        boz_display_write_char(ml_chars[2]);
 
     boz_display_set_cursor(1, 0);
-    boz_display_write_char(1);
+    boz_display_write_char(ml_chars[1]);
     boz_display_write_long(4, 2, 0);
     boz_display_write_char(' ');
-    boz_display_write_char(5);
+    boz_display_write_char(ml_chars[5]);
     for (int i = 5; i < 16; ++i)
-        boz_display_write_char(3);
-}
-
-void
-music_loop_init_stage_three(void *dummy) {
-    music_loop_draw_display_start();
-    ml_melody_pos = 0;
-    ml_beat = 0;
-    music_loop_play(NULL);
+        boz_display_write_char(ml_chars[3]);
 }
 
 void
@@ -374,7 +421,7 @@ music_loop_sound_queue_ready(void *cookie) {
 
     /* We filled up the queue. Ask the main loop to tell us when the queue
        is unfull again. */
-    boz_set_event_handler_sound_queue_not_full(music_loop_sound_queue_ready);
+    boz_enable_events(BOZ_EVENT_SOUND_QUEUE_NOT_FULL);
 }
 
 void
@@ -383,38 +430,52 @@ music_stop(void) {
     ml_melody_pos = 0;
     ml_beat = 0;
     music_loop_draw_display_start();
-    boz_set_event_handler_sound_queue_not_full(NULL);
+    boz_disable_events(BOZ_EVENT_SOUND_QUEUE_NOT_FULL | BOZ_EVENT_DISPLAY_QUEUE_SPACE);
     boz_cancel_alarm();
 }
 
 void
-ml_beat_handler(void *cookie) {
+ml_draw_beat(void *cookie) {
     /* Display a load of rubbish vaguely in time with the beat */
     int cells_filled;
+
+    if (ml_melody_beats_per_bar <= 1)
+        return;
+
+    /* Two cursor moves and 24 cells. If the queue hasn't room for all of
+       them, draw the bar when it has, rather than drawing half of it. */
+    if (boz_display_reserve(26)) {
+        boz_enable_events(BOZ_EVENT_DISPLAY_QUEUE_SPACE);
+        return;
+    }
+    cells_filled = 12 * ml_beat / (ml_melody_beats_per_bar - 1);
+    for (int row = 0; row < 2; ++row) {
+        boz_display_set_cursor(row, 4);
+        for (int cell = 0; cell < 12; ++cell) {
+            if (cell < cells_filled)
+                boz_display_write_char(ml_chars[row ? 7 : 6]);
+            else if (cell == 0)
+                boz_display_write_char(ml_chars[row ? 5 : 4]);
+            else
+                boz_display_write_char(ml_chars[row ? 3 : 2]);
+        }
+    }
+    boz_display_commit();
+}
+
+void
+ml_beat_handler(void *cookie) {
     ml_beat++;
     if (ml_beat >= ml_melody_beats_per_bar)
         ml_beat = 0;
-    if (ml_melody_beats_per_bar > 1) {
-        cells_filled = 12 * ml_beat / (ml_melody_beats_per_bar - 1);
-        for (int row = 0; row < 2; ++row) {
-            boz_display_set_cursor(row, 4);
-            for (int cell = 0; cell < 12; ++cell) {
-                if (cell < cells_filled)
-                    boz_display_write_char(row ? 7 : 6);
-                else if (cell == 0)
-                    boz_display_write_char(row ? 5 : 4);
-                else
-                    boz_display_write_char(row ? 3 : 2);
-            }
-        }
-    }
+    ml_draw_beat(cookie);
     boz_set_alarm(60000L / ml_melody_bpm, ml_beat_handler, NULL);
 }
 
 void
 music_loop_play(void *cookie) {
     music_stop();
-    boz_set_event_handler_sound_queue_not_full(music_loop_sound_queue_ready);
+    boz_enable_events(BOZ_EVENT_SOUND_QUEUE_NOT_FULL);
     
     /* First alarm is 100ms early, to give time for the display to change */
     long alarm_ms = 60000L / ml_melody_bpm - 100;
@@ -119,6 +119,16 @@ const PROGMEM char s_no[]  = "      No ";
 
 /* cookie must be a pointer to a struct option_menu_context, which describes
    the option pages to show. */
+const PROGMEM struct boz_event_handlers om_handlers = {
+    NULL,               // buzz
+    om_play,            // qm_play
+    om_yellow,          // qm_yellow
+    om_reset,           // qm_reset
+    om_rotary_press,    // qm_rotary_press
+    NULL,               // qm_rotary
+    om_rotary_turn,     // qm_rotary_steps
+};
+
 void
 option_menu_init(void *cookie) {
     struct option_menu_context *context = (struct option_menu_context *) cookie;
@@ -137,11 +147,7 @@ option_menu_init(void *cookie) {
 
     om_load_page(context, first_page);
 
-    boz_set_event_handler_qm_play(om_play);
-    boz_set_event_handler_qm_yellow(om_yellow);
-    boz_set_event_handler_qm_reset(om_reset);
-    boz_set_event_handler_qm_rotary(om_rotary_turn);
-    boz_set_event_handler_qm_rotary_press(om_rotary_press);
+    boz_set_event_handlers(&om_handlers);
     boz_set_event_cookie(context);
     options_state->menu = context;
 
@@ -197,29 +203,39 @@ om_yellow(void *cookie) {
 }
 
 void
-om_rotary_turn(void *cookie, int clockwise) {
+om_rotary_turn(void *cookie, int steps) {
     struct option_menu_context *context = (struct option_menu_context *) cookie;
-    int direction = (clockwise ? 1 : -1);
+    int direction = (steps > 0 ? 1 : -1);
+    int changed = 0;
 
     if (options_state->control_depth == 0) {
-        int next_page;
-
-        /* Find next enabled page in the direction we've been given. */
-        for (next_page = options_state->page_number + direction;
-                next_page >= 0 && next_page <= context->num_pages &&
-                    (context->page_disable_mask & (1 << next_page));
-                    next_page += direction);
-
-        /* We allow page_number to equal context->num_pages - this means
-           we display a "Play to save, Reset to discard" banner. Otherwise,
-           if the next page we've chosen is not a valid page, do nothing. */
-        if (next_page >= 0 && next_page <= context->num_pages) {
+        for (; steps != 0; steps -= direction) {
+            int next_page;
+
+            /* Find next enabled page in the direction we've been given. */
+            for (next_page = options_state->page_number + direction;
+                    next_page >= 0 && next_page <= context->num_pages &&
+                        (context->page_disable_mask & (1 << next_page));
+                        next_page += direction);
+
+            /* We allow page_number to equal context->num_pages - this means
+               we display a "Play to save, Reset to discard" banner.
+               Otherwise, if the next page we've chosen is not a valid page,
+               do nothing. */
+            if (next_page < 0 || next_page > context->num_pages)
+                break;
             om_load_page(context, next_page);
-            om_redraw_display(context);
+            changed = 1;
         }
+        if (changed)
+            om_redraw_display(context);
     }
     else {
-        om_adjust_control(context, direction);
+        /* Make all the adjustments, then redraw the value once */
+        for (; steps != 0; steps -= direction)
+            changed |= om_adjust_control(context, direction);
+        if (changed)
+            om_redraw_option_value(context);
     }
 }
 
@@ -286,14 +302,17 @@ om_load_page(struct option_menu_context *context, int new_page_number) {
     options_state->page_number = new_page_number;
 }
 
-void
+/* Move the selected control one step in the given direction. Returns 1 if
+   the value changed, in which case the caller must redraw it, or 0 if
+   not. */
+int
 om_adjust_control(struct option_menu_context *context, int direction) {
     long hr = 0, mi = 0, sec = 0;
     long old_value, new_value;
     struct option_page *current_page = &options_state->current_page;
 
     if (options_state->page_number >= context->num_pages)
-        return;
+        return 0;
 
     old_value = context->results[options_state->page_number];
 
@@ -349,7 +368,7 @@ om_adjust_control(struct option_menu_context *context, int direction) {
             }
             else {
                 context->results[options_state->page_number] = new_value;
-                om_redraw_option_value(context);
+                return 1;
             }
             break;
 
@@ -377,14 +396,12 @@ om_adjust_control(struct option_menu_context *context, int direction) {
                 }
             }
             context->results[options_state->page_number] = new_value;
-            om_redraw_option_value(context);
-            break;
+            return 1;
 
         case OPTION_TYPE_YES_NO:
             new_value = !old_value;
             context->results[options_state->page_number] = new_value;
-            om_redraw_option_value(context);
-            break;
+            return 1;
 
         case OPTION_TYPE_LIST:
             new_value = old_value + direction;
@@ -393,13 +410,21 @@ om_adjust_control(struct option_menu_context *context, int direction) {
             else if (new_value >= current_page->num_choices)
                 new_value = 0;
             context->results[options_state->page_number] = new_value;
-            om_redraw_option_value(context);
-            break;
+            return 1;
     }
+    return 0;
 }
 
 void
 om_redraw_display(struct option_menu_context *context) {
+    byte type = options_state->current_page.type & OPTION_MAIN_TYPE_MASK;
+
+    /* Turning the knob fast should get through a big range of numbers or
+       times quickly, but it shouldn't skip pages or list items. */
+    boz_set_rotary_acceleration(options_state->control_depth > 0 &&
+            options_state->page_number < context->num_pages &&
+            (type == OPTION_TYPE_NUMBER || type == OPTION_TYPE_CLOCK));
+
     boz_display_clear();
 
     if (options_state->page_number >= context->num_pages) {
@@ -1,8 +1,26 @@
 /* Very much not finished yet, this is a program that responds to commands
    sent to us on the serial port, and tells whatever's on the other end of the
-   serial port when a buzz has occurred. */
+   serial port when a buzz has occurred.
+
+   Each command starts with '$' and ends with a newline. "$R <reg>[n]" reads
+   a register and "$W <reg>[n] <value>" writes one, and we reply with
+   "$R <reg>n <value>" or "$W <reg>n <value>".
+
+   "$D <row> <col> <width> <text>" puts text on the display, filling a
+   rectangle <width> characters wide from its top-left corner at <row>,
+   <col>, a row at a time. So "$D 0 0 16 " followed by 32 characters sends
+   a whole frame. The text can't contain '$', a carriage return or a
+   newline, and a carriage return anywhere in a command is ignored. Only the
+   characters which differ from what's already on the display are written,
+   and once they're on the display queue we reply "$D <n>", n being how many
+   there were. We don't read any more commands until then.
+
+   If the firmware is built with BOZ_DISPLAY_MIRROR, "$M" asks for the whole
+   display to be sent again as display mirror messages (see boz_mirror.ino),
+   and we reply "$M". */
 
 #include "boz_api.h"
+#include "boz_mirror.h"
 
 #ifdef BOZ_SERIAL
 
@@ -34,6 +52,8 @@ const byte REG_BITMASK = 3;
 #define PCC_REG_SUBSCRIPT 4
 #define PCC_PRE_ARG 5
 #define PCC_ARG 6
+#define PCC_FRAME_ARG 7
+#define PCC_FRAME_TEXT 8
 
 /* Register definition: everything we might want to know about a particular
    register, such as how many elements in its array (if it's an array), what
@@ -52,7 +72,6 @@ struct reg_def {
 struct reg_values {
     reg cpb, cpc, cpdr, cpdc, cpdl, cpl, cps;
     reg cpv[2];
-    reg bl;
     reg bc[BOZ_NUM_BUZZERS];
     reg ba[BOZ_NUM_BUZZERS];
     reg bzid;
@@ -81,13 +100,45 @@ void reg_write_ls(struct reg_def *reg_def, int subscript, reg value) {
     boz_leds_set(value);
 }
 
+/* The buzzer control and action settings are our arbitration policy, so
+   the main loop locks out the other buzzers and lights the LED as soon as it
+   sees a buzz, rather than waiting for us to hear about it. */
+static void pcc_update_arbitration(void) {
+    struct boz_arbitration policy;
+
+    memset(&policy, 0, sizeof(policy));
+    for (int i = 0; i < BOZ_NUM_BUZZERS; ++i) {
+        if (reg_vals.bc[i] & BOZ_BC_ENABLED)
+            policy.enabled |= BOZ_BUZZER_BIT(i);
+        if (reg_vals.ba[i] & BOZ_BA_LOCKOUT_ON_BUZZ)
+            policy.lock_on_buzz |= BOZ_BUZZER_BIT(i);
+        if (reg_vals.ba[i] & BOZ_BA_SET_LED_ON_BUZZ)
+            policy.light_on_buzz |= BOZ_BUZZER_BIT(i);
+    }
+    boz_arbitration_set(&policy);
+}
+
+void reg_write_bc(struct reg_def *reg_def, int subscript, reg value) {
+    reg_write_std(reg_def, subscript, value);
+    pcc_update_arbitration();
+}
+
+/* BL, the buzzers which are locked out, is kept by the main loop */
+reg reg_read_bl(struct reg_def *reg_def, int subscript) {
+    return boz_arbitration_locked();
+}
+
+void reg_write_bl(struct reg_def *reg_def, int subscript, reg value) {
+    boz_arbitration_set_locked((boz_buzzer_mask) value);
+}
+
 /* Register definitions. These must be in alphabetical order of register
    name, because we use a binary search to find the one we want.
 */
 struct reg_def reg_defs[] = {
     /* Registers for controlling buzzer behaviour */
-    { "BC", BOZ_NUM_BUZZERS, &reg_vals.bc[0], reg_read_std, reg_write_std },
-    { "BL", 1, &reg_vals.bl, reg_read_std, reg_write_std },
+    { "BC", BOZ_NUM_BUZZERS, &reg_vals.bc[0], reg_read_std, reg_write_bc },
+    { "BL", 1, NULL, reg_read_bl, reg_write_bl },
     { "BZID", 1, &reg_vals.bzid, reg_read_std, reg_write_std },
 
     /* Capabilities: read-only registers so the host can find out what
@@ -115,10 +166,26 @@ struct pcc_cmd {
     int value;
     int value_minus;
     int state;
+
+    /* For the D command: the top-left row and column and the width of the
+       rectangle, how many of those three numbers we've had, whether we've
+       had any digits of the next one, and how many characters of text. */
+    byte frame_args[3];
+    byte frame_argc;
+    byte frame_digits;
+    byte frame_cells;
 };
 
 struct pcc_cmd cmd_state;
 
+/* What we last put on the display, and what the host wants there. The D
+   command changes pcc_frame_wanted, then we write out the differences. */
+char pcc_frame_shown[BOZ_DISPLAY_ROWS][BOZ_DISPLAY_COLUMNS];
+char pcc_frame_wanted[BOZ_DISPLAY_ROWS][BOZ_DISPLAY_COLUMNS];
+
+/* Set if a D command is waiting for room on the display queue */
+byte pcc_frame_waiting = 0;
+
 struct reg_def *pcc_find_reg(char *name) {
     int low, high;
 
@@ -150,7 +217,10 @@ pcc_cmd_feed(struct pcc_cmd *cmd, int c) {
     switch (cmd->state) {
         case PCC_EXPECT_TAG:
             cmd->tag = (char) c;
-            cmd->state = PCC_PRE_REG_NAME;
+            if (c == 'D')
+                cmd->state = PCC_FRAME_ARG;
+            else
+                cmd->state = PCC_PRE_REG_NAME;
             break;
 
         case PCC_PRE_REG_NAME:
@@ -225,6 +295,46 @@ pcc_cmd_feed(struct pcc_cmd *cmd, int c) {
                 goto invalid_command;
             }
             break;
+
+        case PCC_FRAME_ARG:
+            if (c >= '0' && c <= '9' && cmd->value < 100) {
+                cmd->value = cmd->value * 10 + (c - '0');
+                cmd->frame_digits = 1;
+            }
+            else if (c == ' ' && cmd->frame_digits) {
+                /* The rectangle must have its top-left corner on the
+                   display and not go off the right-hand side of it. Check
+                   each number before it goes in a byte, because it could
+                   be as big as 999. */
+                if (cmd->frame_argc == 0 && cmd->value >= BOZ_DISPLAY_ROWS)
+                    goto invalid_command;
+                if (cmd->frame_argc == 1 && cmd->value >= BOZ_DISPLAY_COLUMNS)
+                    goto invalid_command;
+                if (cmd->frame_argc == 2 && (cmd->value == 0 ||
+                            cmd->frame_args[1] + cmd->value > BOZ_DISPLAY_COLUMNS))
+                    goto invalid_command;
+                cmd->frame_args[cmd->frame_argc++] = (byte) cmd->value;
+                cmd->value = 0;
+                cmd->frame_digits = 0;
+                if (cmd->frame_argc == 3)
+                    cmd->state = PCC_FRAME_TEXT;
+            }
+            else if (c != ' ') {
+                goto invalid_command;
+            }
+            break;
+
+        case PCC_FRAME_TEXT: {
+            int row = cmd->frame_args[0] + cmd->frame_cells / cmd->frame_args[2];
+            int col = cmd->frame_args[1] + cmd->frame_cells % cmd->frame_args[2];
+
+            /* Too much text for the display? */
+            if (row >= BOZ_DISPLAY_ROWS)
+                goto invalid_command;
+            pcc_frame_wanted[row][col] = (char) c;
+            cmd->frame_cells++;
+            break;
+        }
     }
 
     return;
@@ -293,6 +403,66 @@ static void pcc_send_rw_result(char tag, char *reg_name, int subscript, reg valu
     boz_serial_enqueue_data_out(msg, msgp);
 }
 
+/* Write the characters in pcc_frame_wanted which aren't already on the
+   display, all at once. Return how many there were, or -1 if there isn't
+   room on the display queue for them yet. */
+static int pcc_frame_draw(void) {
+    int num_commands = 0, num_cells = 0;
+    byte row, col;
+
+    /* Each run of changed characters needs a set_cursor command, and a
+       command for each character */
+    for (row = 0; row < BOZ_DISPLAY_ROWS; ++row) {
+        for (col = 0; col < BOZ_DISPLAY_COLUMNS; ++col) {
+            if (pcc_frame_wanted[row][col] != pcc_frame_shown[row][col]) {
+                if (col == 0 || pcc_frame_wanted[row][col - 1] == pcc_frame_shown[row][col - 1])
+                    num_commands++;
+                num_commands++;
+                num_cells++;
+            }
+        }
+    }
+    if (num_cells == 0)
+        return 0;
+    if (boz_display_reserve(num_commands))
+        return -1;
+
+    for (row = 0; row < BOZ_DISPLAY_ROWS; ++row) {
+        for (col = 0; col < BOZ_DISPLAY_COLUMNS; ++col) {
+            if (pcc_frame_wanted[row][col] != pcc_frame_shown[row][col]) {
+                if (col == 0 || pcc_frame_wanted[row][col - 1] == pcc_frame_shown[row][col - 1])
+                    boz_display_set_cursor(row, col);
+                boz_display_write_char(pcc_frame_wanted[row][col]);
+            }
+        }
+    }
+    boz_display_commit();
+    memcpy(pcc_frame_shown, pcc_frame_wanted, sizeof(pcc_frame_shown));
+    return num_cells;
+}
+
+static void pcc_send_frame_result(int num_cells) {
+    char msg[10] = "$D ";
+    int msgp = 3;
+
+    msgp += str_put_int(msg + msgp, num_cells);
+    msg[msgp++] = '\n';
+    boz_serial_enqueue_data_out(msg, msgp);
+}
+
+/* Display queue space handler: try again to draw the frame the host sent */
+static void pcc_frame_retry(void *cookie) {
+    int num_cells = pcc_frame_draw();
+
+    if (num_cells < 0) {
+        boz_enable_events(BOZ_EVENT_DISPLAY_QUEUE_SPACE);
+    }
+    else {
+        pcc_frame_waiting = 0;
+        pcc_send_frame_result(num_cells);
+    }
+}
+
 static void pcc_send_write_result(char *reg_name, int subscript, reg value) {
     pcc_send_rw_result('W', reg_name, subscript, value);
 }
@@ -303,10 +473,25 @@ static void pcc_send_read_result(char *reg_name, int subscript, reg value) {
 
 void pcc_cmd_execute(struct pcc_cmd *cmd) {
     cmd->reg_name[(int) cmd->reg_name_p] = '\0';
-    if (cmd->state == 0) {
-        /* Couldn't make head or tail of what the host said */
+    if (cmd->state == 0 || (cmd->tag == 'D' && cmd->state != PCC_FRAME_TEXT)) {
+        /* Couldn't make head or tail of what the host said. If it was a D
+           command, forget any of its text we'd taken. */
+        if (cmd->tag == 'D')
+            memcpy(pcc_frame_wanted, pcc_frame_shown, sizeof(pcc_frame_wanted));
         pcc_send_error('?');
     }
+    else if (cmd->tag == 'D') {
+        /* Draw the frame now if we can, otherwise when the display queue
+           has room */
+        pcc_frame_waiting = 1;
+        pcc_frame_retry(cmd);
+    }
+#ifdef BOZ_DISPLAY_MIRROR
+    else if (cmd->tag == 'M') {
+        boz_mirror_resend();
+        boz_serial_enqueue_data_out((char *) "$M\n", 3);
+    }
+#endif
     else if (cmd->tag == 'R' || cmd->tag == 'W') {
         struct reg_def *reg_def = pcc_find_reg(cmd->reg_name);
         if (reg_def == NULL) {
@@ -335,8 +520,10 @@ void pcc_cmd_execute(struct pcc_cmd *cmd) {
 void pcc_data_available(void *arg) {
     struct pcc_cmd *cmd = (struct pcc_cmd *) arg;
 
-    while (Serial.available() > 0) {
-        int c = Serial.read();
+    /* If the frame from a D command hasn't gone on the display yet, leave
+       the next command on the serial port until it has */
+    while (!pcc_frame_waiting && Serial.available() > 0) {
+        int c = boz_serial_read();
 
         switch (c) {
             case '$':
@@ -350,6 +537,10 @@ void pcc_data_available(void *arg) {
                 pcc_cmd_execute(cmd);
                 break;
 
+            case '\r':
+                /* The host might end its lines with CR LF */
+                break;
+
             default:
                 //boz_leds_set(4);
                 if (cmd->state > 0)
@@ -365,15 +556,9 @@ static void buzz_event(int which_buzzer) {
     if (which_buzzer < 0 || which_buzzer >= BOZ_NUM_BUZZERS)
         return;
 
-    reg ba = reg_vals.ba[which_buzzer];
-
+    /* The main loop has already done what BA says to do (see
+       pcc_update_arbitration()) */
     reg_vals.bzid = which_buzzer;
-    if (ba & BOZ_BA_LOCKOUT_ON_BUZZ) {
-        reg_vals.bl |= (1 << (BOZ_NUM_BUZZERS)) - 1;
-    }
-    if (ba & BOZ_BA_SET_LED_ON_BUZZ) {
-        boz_leds_set(1 << which_buzzer);
-    }
 
     /* Send buzz event message */
     msg[0] = '!';
@@ -397,19 +582,29 @@ static void buzz_event(int which_buzzer) {
 }
 
 static void buzz_handler(void *cookie, int which_buzzer) {
-    reg which_bc;
-
-    if (which_buzzer < 0 || which_buzzer >= BOZ_NUM_BUZZERS)
-        return;
-
-    which_bc = reg_vals.bc[which_buzzer];
-    if ((which_bc & BOZ_BC_ENABLED) && !(reg_vals.bl & (1 << which_buzzer))) {
-        buzz_event(which_buzzer);
-    }
+    /* Only a buzzer which was enabled in BC and not locked out in BL can
+       win, and only winners get here */
+    buzz_event(which_buzzer);
 }
 
+const PROGMEM struct boz_event_handlers pcc_handlers = {
+    buzz_handler,       // buzz
+    NULL,               // qm_play
+    NULL,               // qm_yellow
+    NULL,               // qm_reset
+    NULL,               // qm_rotary_press
+    NULL,               // qm_rotary
+    NULL,               // qm_rotary_steps
+    NULL,               // sound_queue_not_full
+    pcc_data_available, // serial_data_available
+    pcc_frame_retry,    // display_queue_space
+};
+
 void pcc_init(void *dummy) {
     boz_display_clear();
+    memset(pcc_frame_shown, ' ', sizeof(pcc_frame_shown));
+    memset(pcc_frame_wanted, ' ', sizeof(pcc_frame_wanted));
+    pcc_frame_waiting = 0;
 
     memset(&reg_vals, 0, sizeof(reg_vals));
     reg_vals.cpb = BOZ_NUM_BUZZERS;
@@ -434,11 +629,10 @@ void pcc_init(void *dummy) {
         */
         reg_vals.ba[i] = BOZ_BA_LOCKOUT_ON_BUZZ | BOZ_BA_SET_LED_ON_BUZZ;
     }
+    pcc_update_arbitration();
 
     boz_set_event_cookie(&cmd_state);
-    boz_set_event_handler_serial_data_available(pcc_data_available);
-
-    boz_set_event_handler_buzz(buzz_handler);
+    boz_set_event_handlers(&pcc_handlers);
 }
 
 #endif
@@ -5,10 +5,17 @@
 const PROGMEM char s_sysinfo_boz_v[] = "Bozzard v";
 const PROGMEM char s_sysinfo_copyright[] = BOZ_CHAR_COPYRIGHT_S " 2019 G.Cole";
 
+const PROGMEM struct boz_event_handlers sysinfo_handlers = {
+    NULL,           // buzz
+    NULL,           // qm_play
+    NULL,           // qm_yellow
+    sysinfo_exit,   // qm_reset
+};
+
 void
 sysinfo_init(void *dummy) {
     /* Press red reset button to exit */
-    boz_set_event_handler_qm_reset(sysinfo_exit);
+    boz_set_event_handlers(&sysinfo_handlers);
 
     /* If buzzer 0 is being held down, crash - this tests the crash routine */
     if (boz_is_button_pressed(FUNC_BUZZER, 0, NULL))
@@ -89,6 +89,15 @@ test_rotary_press(void *cookie) {
     refresh_rotary_value();
 }
 
+const PROGMEM struct boz_event_handlers test_handlers = {
+    test_buzz,          // buzz
+    test_play,          // qm_play
+    NULL,               // qm_yellow
+    test_reset,         // qm_reset
+    test_rotary_press,  // qm_rotary_press
+    test_rotary,        // qm_rotary
+};
+
 void test_init(void *cookie) {
     boz_display_clear();
 
@@ -101,11 +110,7 @@ void test_init(void *cookie) {
     boz_clock_set_alarm(clock, 200, test_clock_alarm);
     boz_clock_set_expiry_max(clock, clock_expiry_ms, test_clock_expired);
 
-    boz_set_event_handler_qm_play(test_play);
-    boz_set_event_handler_qm_reset(test_reset);
-    boz_set_event_handler_qm_rotary(test_rotary);
-    boz_set_event_handler_qm_rotary_press(test_rotary_press);
-    boz_set_event_handler_buzz(test_buzz);
+    boz_set_event_handlers(&test_handlers);
 
     boz_clock_run(clock);
 }
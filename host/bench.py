@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+"""Display benchmarks: how much each app uses the I2C bus to the display.
+
+Each file in bench/ is an input session for replay, whose first line starts
+with "#!" and gives the replay options for it, such as which app to start.
+We run them all and print, for each one, how long the I2C bus was busy per
+second of use and per screen change, whether anything was sent to the
+display while it was still busy with the last instruction, and how long
+after power on the first screen appeared.
+
+    host/bench.py [--no-build] [-i HZ] [--save] [--threshold PERCENT]
+
+The figures are compared with bench/baseline.txt, and if any of them is
+more than the threshold (default 5%) worse, or there are more busy
+violations than before, we say so and exit with status 1. --save writes the
+new figures to bench/baseline.txt instead. Simulated time is deterministic,
+so the figures only change when the firmware or the simulator does.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+BENCH_DIR = os.path.join(HOST_DIR, "bench")
+BASELINE = os.path.join(BENCH_DIR, "baseline.txt")
+REPLAY = os.path.join(HOST_DIR, "build", "replay")
+
+# Figures where more is worse, and which we check against the baseline
+CHECKED = [ "bus_us_per_s", "bus_us_per_change", "first_frame_us" ]
+
+COLUMNS = [ ("bus_us_per_s", "bus us/s"), ("bus_us_per_change", "bus us/change"),
+        ("screen_changes", "changes"), ("lcd_data_writes", "data writes"),
+        ("busy_violations", "busy violations"), ("first_frame_us", "first frame us") ]
+
+def scenarios():
+    return sorted(os.path.splitext(f)[0] for f in os.listdir(BENCH_DIR)
+            if f.endswith(".txt") and f != "baseline.txt")
+
+def run_scenario(name, i2c_hz):
+    path = os.path.join(BENCH_DIR, name + ".txt")
+    with open(path) as f:
+        first = f.readline()
+    options = first[2:].split() if first.startswith("#!") else []
+    if i2c_hz:
+        options += [ "-i", str(i2c_hz) ]
+    result = subprocess.run([ REPLAY, "-q" ] + options + [ path ],
+            stdout=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        raise RuntimeError("replay failed on %s" % path)
+    figures = {}
+    for line in result.stdout.split("\n"):
+        fields = line.split()
+        if len(fields) == 2:
+            figures[fields[0]] = int(fields[1])
+    return figures
+
+def read_baseline():
+    baseline = {}
+    if not os.path.exists(BASELINE):
+        return baseline
+    with open(BASELINE) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) == 3 and not line.startswith("#"):
+                baseline.setdefault(fields[0], {})[fields[1]] = int(fields[2])
+    return baseline
+
+def write_baseline(results):
+    with open(BASELINE, "w") as f:
+        f.write("# Display benchmark figures, written by host/bench.py --save\n")
+        for name in sorted(results):
+            for key in sorted(results[name]):
+                f.write("%s %s %d\n" % (name, key, results[name][key]))
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the display benchmarks.")
+    parser.add_argument("--no-build", action="store_true", help="use the existing host/build/replay")
+    parser.add_argument("-i", dest="i2c_hz", type=int, help="I2C bus clock, in Hz")
+    parser.add_argument("--save", action="store_true", help="save the results as the new baseline")
+    parser.add_argument("--threshold", type=float, default=5.0,
+            help="how much worse than the baseline, in percent, counts as a regression")
+    args = parser.parse_args()
+
+    if not args.no_build:
+        if subprocess.call([ sys.executable, os.path.join(HOST_DIR, "build.py") ],
+                stdout=subprocess.DEVNULL) != 0:
+            return 1
+
+    results = {}
+    for name in scenarios():
+        results[name] = run_scenario(name, args.i2c_hz)
+
+    print("%-12s" % "" + "".join("%16s" % title for key, title in COLUMNS))
+    for name in sorted(results):
+        print("%-12s" % name + "".join("%16d" % results[name].get(key, 0) for key, title in COLUMNS))
+
+    if args.save:
+        write_baseline(results)
+        print("\nSaved to %s" % BASELINE)
+        return 0
+
+    baseline = read_baseline()
+    if args.i2c_hz or not baseline:
+        return 0
+
+    regressions = []
+    for name in sorted(results):
+        old = baseline.get(name)
+        if old is None:
+            continue
+        for key in CHECKED:
+            if key in old and results[name][key] > old[key] * (1 + args.threshold / 100.0):
+                regressions.append("%s: %s was %d, now %d" % (name, key, old[key], results[name][key]))
+        if results[name]["busy_violations"] > old.get("busy_violations", 0):
+            regressions.append("%s: busy_violations was %d, now %d" % (name,
+                    old.get("busy_violations", 0), results[name]["busy_violations"]))
+
+    if regressions:
+        print("\nWorse than the baseline:")
+        for r in regressions:
+            print("    " + r)
+        return 1
+    print("\nNo worse than the baseline.")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+
+"""Build the Bozzard firmware into a program that runs on this computer.
+
+This does what the Arduino IDE does with the sketch - stick all the .ino
+files together, boz.ino first, and declare all the functions at the top -
+then compiles the result with the simulated Arduino core in sim/ and a
+harness such as replay.cpp.
+
+    host/build.py [-D NAME[=VALUE]]... [-o OUTPUT] [HARNESS.cpp]
+
+The default harness is replay.cpp, and the default output is
+host/build/<harness name>. -D options are passed to the compiler, so
+-D BOZ_SERIAL builds the same firmware as uncommenting BOZ_SERIAL in
+boz_hw.h would.
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+SKETCH_DIR = os.path.join(os.path.dirname(HOST_DIR), "boz")
+SIM_DIR = os.path.join(HOST_DIR, "sim")
+
+# Pointers and ints are bigger here than on the AVR, so the structures the
+# firmware allocates from its memory pool are too.
+HOST_DEFINES = [ "BOZ_DYN_ARENA_SIZE=2048" ]
+
+KEYWORDS = { "if", "while", "for", "switch", "return", "else", "do", "sizeof" }
+
+def sketch_files():
+    inos = sorted(f for f in os.listdir(SKETCH_DIR) if f.endswith(".ino"))
+    inos.remove("boz.ino")
+    return [ "boz.ino" ] + inos
+
+def find_prototypes(lines):
+    """Return a declaration for each function defined at the top level of
+    a file. The return type may be on the line before the name, and the
+    parameter list may go on for a few lines."""
+    protos = []
+    depth = 0
+    for i, line in enumerate(lines):
+        if depth == 0 and line.strip() and not line.startswith((" ", "\t", "#", "/", "*", "}")):
+            text = line
+            j = i
+            while "{" not in text and ";" not in text and j + 1 < len(lines) and j - i < 4:
+                j += 1
+                text += " " + lines[j].strip()
+            m = re.match(r"^(.*?)\b([A-Za-z_]\w*)\s*\((.*)\)\s*(const\s*)?\{", text)
+            if m and ";" not in text.split("{")[0] and "=" not in text.split("(")[0] \
+                    and m.group(2) not in KEYWORDS and m.group(2) != "ISR" \
+                    and not text.startswith(("struct ", "enum ", "union ", "class ", "typedef", "template")):
+                ret = m.group(1).strip()
+                if not ret and i > 0:
+                    ret = lines[i - 1].strip()
+                if ret and not ret.endswith((";", "}", "{", "*/")):
+                    protos.append("%s %s(%s);" % (ret, m.group(2), m.group(3)))
+            elif m and text.startswith("struct ") and text.split("(")[0].count(" ") >= 2:
+                # function returning a struct pointer
+                protos.append("%s %s(%s);" % (m.group(1).strip(), m.group(2), m.group(3)))
+        depth += line.count("{") - line.count("}")
+    return protos
+
+def write_sketch(path, cxx, defines):
+    """Write the whole sketch out as one C++ file. Like the Arduino IDE, we
+    find the functions to declare by looking at the preprocessed sketch, so
+    that we don't declare anything that's #ifdef'd out, and so that any
+    macros in the declarations have been expanded."""
+    body = []
+    for name in sketch_files():
+        with open(os.path.join(SKETCH_DIR, name)) as f:
+            lines = f.read().split("\n")
+        body.append('#line 1 "%s"' % os.path.join(SKETCH_DIR, name))
+        body.extend(lines)
+
+    headers = sorted(f for f in os.listdir(SKETCH_DIR) if f.endswith(".h"))
+    top = [ "#include <Arduino.h>" ]
+    top += [ '#include "%s"' % h for h in headers ]
+
+    with open(path, "w") as f:
+        f.write("\n".join(top + body) + "\n")
+    result = subprocess.run([ cxx, "-std=gnu++11", "-E", "-I" + SIM_DIR, "-I" + SKETCH_DIR ] +
+            [ "-D" + d for d in HOST_DEFINES + defines ] + [ path ], stdout=subprocess.PIPE, universal_newlines=True)
+    if result.returncode != 0:
+        return result.returncode
+
+    files = {}
+    current = None
+    for line in result.stdout.split("\n"):
+        m = re.match(r'^# \d+ "(.*)"', line)
+        if m:
+            current = m.group(1)
+            continue
+        if current.endswith(".ino"):
+            files.setdefault(current, []).append(line)
+
+    protos = []
+    for name in sketch_files():
+        protos.extend(find_prototypes(files.get(os.path.join(SKETCH_DIR, name), [])))
+
+    with open(path, "w") as f:
+        f.write("\n".join(top + protos + body) + "\n")
+    return 0
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the firmware to run on this computer.")
+    parser.add_argument("-D", dest="defines", action="append", default=[], metavar="NAME[=VALUE]",
+            help="define a macro when compiling the firmware")
+    parser.add_argument("-o", dest="output", help="output program")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"), help="C++ compiler")
+    parser.add_argument("--cxxflags", default="-O1 -g", help="extra compiler flags")
+    parser.add_argument("harness", nargs="?", default=os.path.join(HOST_DIR, "replay.cpp"),
+            help="the program's main(), default replay.cpp")
+    args = parser.parse_args()
+
+    build_dir = os.path.join(HOST_DIR, "build")
+    os.makedirs(build_dir, exist_ok=True)
+    output = args.output or os.path.join(build_dir,
+            os.path.splitext(os.path.basename(args.harness))[0])
+    sketch = os.path.join(build_dir, "sketch.cpp")
+    if write_sketch(sketch, args.cxx, args.defines) != 0:
+        return 1
+
+    # The firmware is written for avr-gcc with -fpermissive, as the Arduino
+    # IDE uses it, and uses a few things that are only warnings there.
+    cmd = [ args.cxx, "-std=gnu++11", "-fpermissive", "-w" ] + args.cxxflags.split()
+    cmd += [ "-I" + SIM_DIR, "-I" + SKETCH_DIR ]
+    cmd += [ "-D" + d for d in HOST_DEFINES + args.defines ]
+    cmd += [ sketch ] + sorted(os.path.join(SIM_DIR, f) for f in os.listdir(SIM_DIR) if f.endswith(".cpp"))
+    cmd += [ args.harness, "-o", output ]
+    print(" ".join(cmd))
+    return subprocess.call(cmd)
+
+if __name__ == "__main__":
+    sys.exit(main())
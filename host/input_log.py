@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+
+"""Decode a Bozzard input log into the text form that replay reads.
+
+The input is either what the firmware sent to the serial port with
+BOZ_INPUT_LOG defined, captured byte for byte, or the hex dump of the
+EEPROM ring it sends when BOZ_INPUT_LOG_EEPROM is also defined and you hold
+yellow and reset down while switching on. The record format is described at
+the top of boz/boz_input_log.ino.
+
+    host/input_log.py [-s SESSION] [-l] LOGFILE > inputs.txt
+
+A log may contain several sessions, one for each time the firmware started.
+By default we decode the last one.
+"""
+
+import argparse
+import re
+import sys
+
+SWITCH = 0x00
+ROTARY = 0x40
+SERIAL = 0x80
+SYNC = 0xc0
+SYNC_LOST = 0xc1
+BOOT = 0xc2
+END = 0xff
+
+SYNCS = (SYNC, SYNC_LOST, BOOT)
+
+class LogError(Exception):
+    pass
+
+def decode(data, strict):
+    """Decode a stream of records into a list of sessions, each of which is a
+    list of (time_us, text) tuples. If strict, every byte must be part of a
+    valid record, otherwise we skip anything we don't understand up to the
+    next SYNC."""
+    sessions = []
+    events = None
+    now = None
+    pos = 0
+
+    def varint():
+        nonlocal pos
+        value = 0
+        shift = 0
+        while True:
+            if pos >= len(data):
+                raise LogError("log ends in the middle of a record")
+            b = data[pos]
+            pos += 1
+            value |= (b & 0x7f) << shift
+            shift += 7
+            if b < 0x80:
+                return value
+
+    while pos < len(data):
+        start = pos
+        header = data[pos]
+        pos += 1
+        try:
+            if header in SYNCS:
+                if pos + 4 > len(data):
+                    raise LogError("log ends in the middle of a record")
+                value = int.from_bytes(data[pos:pos + 4], "little")
+                pos += 4
+                if header == BOOT or events is None:
+                    events = []
+                    sessions.append(events)
+                    now = value
+                else:
+                    # micros() is 32 bits on the AVR, so it wraps every 71
+                    # minutes. Our times don't.
+                    now += (value - now) & 0xffffffff
+                if header == SYNC_LOST:
+                    events.append((now, "# some inputs before this point were lost"))
+                continue
+
+            if events is None:
+                raise LogError("record before the first SYNC")
+            if header & 0xc0 == SWITCH:
+                text = "switch %d %d" % (header & 0x1f, (header >> 5) & 1)
+            elif header & 0xfc == ROTARY:
+                text = "rotary %d %d" % ((header >> 1) & 1, header & 1)
+            elif header == SERIAL:
+                if pos >= len(data):
+                    raise LogError("log ends in the middle of a record")
+                text = "serial %d" % data[pos]
+                pos += 1
+            else:
+                raise LogError("unknown record type 0x%02x" % header)
+            now += varint()
+            events.append((now, text))
+        except LogError as e:
+            if strict:
+                raise LogError("%s at offset %d" % (e, start))
+            # Skip to the next thing that looks like a SYNC
+            pos = start + 1
+            while pos < len(data) and data[pos] not in SYNCS:
+                pos += 1
+            events = None
+    return sessions
+
+def decode_ring(ring):
+    """Decode the EEPROM ring. The log ends at an END byte, and starts
+    somewhere after it, where the oldest surviving SYNC is. 0xff can appear
+    inside records too, so try every 0xff and keep the one that gives the
+    longest clean decode."""
+    best = None
+    for end in range(len(ring)):
+        if ring[end] != END:
+            continue
+        data = ring[end + 1:] + ring[:end]
+        for start in range(len(data)):
+            if data[start] not in SYNCS:
+                continue
+            if best is not None and len(data) - start <= best[0]:
+                break
+            try:
+                sessions = decode(data[start:], True)
+            except LogError:
+                continue
+            best = (len(data) - start, sessions)
+            break
+    if best is None:
+        raise LogError("can't find the end of the log in the EEPROM dump")
+    return best[1]
+
+def read_log(path):
+    """Return the sessions in the log file at path, which is either a raw
+    capture of the serial port or contains an EEPROM dump."""
+    with open(sys.stdin.fileno() if path == "-" else path, "rb") as f:
+        data = f.read()
+
+    m = re.search(rb"BOZ INPUT LOG\r?\n(.*?)END", data, re.S)
+    if m:
+        ring = bytes(int(x, 16) for x in m.group(1).split())
+        return decode_ring(ring)
+    return decode(data, False)
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a Bozzard input log for host/replay.")
+    parser.add_argument("-s", "--session", type=int, default=-1,
+            help="which session to decode, counting from 1 (default: the last)")
+    parser.add_argument("-l", "--list", action="store_true", help="list the sessions in the log")
+    parser.add_argument("log", help="serial capture or EEPROM dump, or - for stdin")
+    args = parser.parse_args()
+
+    try:
+        sessions = read_log(args.log)
+    except LogError as e:
+        sys.stderr.write("%s: %s\n" % (args.log, e))
+        return 1
+    if not sessions:
+        sys.stderr.write("%s: no sessions in this log\n" % args.log)
+        return 1
+
+    if args.list:
+        for i, events in enumerate(sessions):
+            inputs = [ e for e in events if not e[1].startswith("#") ]
+            if inputs:
+                print("%d: %d inputs, %.6f to %.6f seconds" % (i + 1, len(inputs),
+                        inputs[0][0] / 1e6, inputs[-1][0] / 1e6))
+            else:
+                print("%d: no inputs" % (i + 1))
+        return 0
+
+    index = args.session - 1 if args.session > 0 else len(sessions) + args.session
+    if index < 0 or index >= len(sessions):
+        sys.stderr.write("%s: there are only %d sessions\n" % (args.log, len(sessions)))
+        return 1
+
+    print("# session %d of %d from %s" % (index + 1, len(sessions), args.log))
+    for time_us, text in sessions[index]:
+        if text.startswith("#"):
+            print("%s at %d us" % (text, time_us))
+        else:
+            print("%d %s" % (time_us, text))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
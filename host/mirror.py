@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+
+"""Show what's on a Bozzard's display from its display mirror messages.
+
+Build the firmware with BOZ_SERIAL and BOZ_DISPLAY_MIRROR defined, and it
+sends the parts of the display that change to the serial port. The format
+is described at the top of boz/boz_mirror.ino.
+
+    host/mirror.py [-l] [-g] CAPTURE
+
+This prints the display each time it changes, the same way replay -d does,
+with each user-defined character shown as its number. Lines in the capture
+which aren't mirror messages, such as PC Control replies, are ignored.
+
+With -l, it redraws the display in place instead, so piping the serial port
+into it shows the display as it happens. With -g, it also prints the
+user-defined characters as pixels whenever one of them changes.
+
+To have a Bozzard that's already running send the whole display again, send
+it "$M" followed by a newline while it's in the PC Control app.
+"""
+
+import argparse
+import re
+import sys
+
+ROWS = 2
+COLS = 16
+GLYPHS = 8
+
+class Mirror(object):
+    def __init__(self):
+        self.cells = [ [ 0x20 ] * COLS for row in range(ROWS) ]
+        self.glyphs = [ [ 0 ] * 8 for n in range(GLYPHS) ]
+
+    def cells_message(self, row, col, text):
+        """Apply a !M message. text is the cells as sent, with escapes."""
+        pos = 0
+        while pos < len(text) and col < COLS:
+            if text[pos] == ord("\\") and pos + 2 < len(text):
+                c = int(text[pos + 1:pos + 3], 16)
+                pos += 3
+            else:
+                c = text[pos]
+                pos += 1
+            self.cells[row][col] = c
+            col += 1
+
+    def glyph_message(self, n, hex_rows):
+        """Apply a !G message."""
+        self.glyphs[n] = list(bytes.fromhex(hex_rows.decode("ascii")))
+
+    def row_text(self, row):
+        chars = []
+        for c in self.cells[row]:
+            if c < GLYPHS:
+                chars.append(str(c))
+            elif c < 0x20 or c > 0x7e:
+                chars.append("?")
+            else:
+                chars.append(chr(c))
+        return "".join(chars)
+
+    def frame(self):
+        border = "+" + "-" * COLS + "+"
+        return [ border ] + [ "|" + self.row_text(row) + "|" for row in range(ROWS) ] + [ border ]
+
+    def glyph_lines(self, n):
+        return [ "%d %s" % (n, "".join("#" if bits & (0x10 >> x) else "." for x in range(5)))
+                for bits in self.glyphs[n] ]
+
+MESSAGE = re.compile(rb"!(?:M ([01]) (\d+) (.*)|G ([0-7]) ([0-9a-fA-F]{16}))$")
+
+def messages(f):
+    """Yield each mirror message in the file, as a match object."""
+    for line in f:
+        m = MESSAGE.match(line.rstrip(b"\r\n"))
+        if m:
+            yield m
+
+def main():
+    parser = argparse.ArgumentParser(description="Show what's on a Bozzard's display from its display mirror messages.")
+    parser.add_argument("-l", "--live", action="store_true",
+            help="redraw the display in place rather than printing every frame")
+    parser.add_argument("-g", "--glyphs", action="store_true",
+            help="print user-defined characters as pixels when they change")
+    parser.add_argument("capture", help="serial capture, or - for stdin")
+    args = parser.parse_args()
+
+    mirror = Mirror()
+    last = None
+    drawn = False
+    with open(sys.stdin.fileno() if args.capture == "-" else args.capture, "rb") as f:
+        for m in messages(f):
+            if m.group(4) is not None:
+                n = int(m.group(4))
+                mirror.glyph_message(n, m.group(5))
+                if args.glyphs and not args.live:
+                    print("\n".join(mirror.glyph_lines(n)))
+                continue
+
+            mirror.cells_message(int(m.group(1)), int(m.group(2)), m.group(3))
+            frame = mirror.frame()
+            if frame == last:
+                continue
+            last = frame
+            if args.live:
+                # Move back up over the frame we drew last time
+                if drawn:
+                    sys.stdout.write("\x1b[%dA" % len(frame))
+                sys.stdout.write("\n".join(frame) + "\n")
+                drawn = True
+            else:
+                print("\n".join(frame))
+            sys.stdout.flush()
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,505 @@
+/* Replay a recorded input session into the Bozzard firmware under simulated
+ * time, and report how the main loop got on.
+ *
+ * The input is the text form of an input log, as written by input_log.py:
+ * one input per line, each starting with the time in microseconds since the
+ * firmware started.
+ *
+ *     <us> switch <pin> <1 if closed, 0 if opened>
+ *     <us> rotary <clock level> <data level>
+ *     <us> serial <byte value>
+ *
+ * Pins from 20 are the switches of buzzers beyond the fourth, if the
+ * firmware was built with more buzzers (see boz_input.h). Lines starting
+ * with # are ignored. See README.md.
+ *
+ * As well as the main loop, it reports how much the display used the I2C
+ * bus, which is what bench.py uses to compare display performance between
+ * versions of the firmware. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <deque>
+
+#include "Arduino.h"
+#include "boz_app.h"
+#include "boz_app_inits.h"
+#include "boz_app_list.h"
+#include "lcd.h"
+#include "sim.h"
+
+/* Number of longest passes of loop() to report */
+#define NUM_LONGEST 5
+
+/* Host CPU time histogram buckets: bucket n counts passes which took
+   between 2^n and 2^(n+1) nanoseconds */
+#define NUM_HOST_BUCKETS 40
+
+struct pass_record {
+    uint64_t start_us;
+    uint64_t awake_us;
+};
+
+/* Changes to the display less than this far apart are parts of the same
+   screen change, because the firmware sends a screen a few characters at a
+   time. */
+#define SCREEN_SETTLE_US 20000
+
+/* Apps that -a can start instead of the main menu */
+static const struct {
+    const char *name;
+    void (*init)(void *);
+} start_apps[] = {
+    { "main_menu", main_menu_init },
+    { "buzzer_game", buzzer_game_init },
+    { "conundrum", conundrum_init },
+    { "chess", chess_init },
+    { "music_loop", music_loop_init },
+    { "battery", battery_init },
+    { "sysinfo", sysinfo_init },
+    { "test", test_init },
+#ifdef BOZ_SERIAL
+    { "pc_control", pcc_init },
+#endif
+};
+#define NUM_START_APPS (sizeof(start_apps) / sizeof(start_apps[0]))
+
+/* The firmware's record of the next app to start */
+extern const struct boz_app *app_call_defer;
+extern struct boz_app app_to_call_data;
+
+static int verbose = 0;
+static int show_display = 0;
+static int quiet = 0;
+static void (*start_app_init)(void *) = NULL;
+
+/* When the display was ready, and how much the I2C bus had been used by
+   then, not counting the input expanders. The display benchmarks count from
+   here, so that they don't include setting up the display. */
+static int display_ready = 0;
+static uint64_t ready_us = 0;
+static uint64_t ready_bus_ns = 0;
+static struct sim_lcd_stats ready_lcd_stats;
+static uint64_t screen_changes = 0;
+static uint64_t last_display_change_us = 0;
+static int display_unprinted = 0;
+
+/* When the first screen the firmware drew had finished changing, counting
+   from power on, or 0 if it hasn't drawn anything yet */
+static uint64_t first_frame_us = 0;
+
+/* Inputs which have been applied, and which no pass of loop() has started
+   since, so the firmware can't have seen them yet */
+static std::deque<struct sim_input> unseen;
+
+static uint64_t inputs_applied = 0;
+static uint64_t latency_total_us = 0;
+static uint64_t latency_max_us = 0;
+static uint64_t latency_max_at_us = 0;
+
+static struct pass_record longest[NUM_LONGEST];
+static uint64_t awake_total_us = 0;
+static uint64_t last_slept_us = 0;
+static uint64_t host_total_ns = 0;
+static uint64_t host_buckets[NUM_HOST_BUCKETS];
+
+static void print_time(FILE *f, uint64_t us) {
+    fprintf(f, "%llu.%06llu", (unsigned long long) (us / 1000000),
+            (unsigned long long) (us % 1000000));
+}
+
+static void describe_input(FILE *f, const struct sim_input *in) {
+    switch (in->type) {
+        case SIM_INPUT_SWITCH:
+            fprintf(f, "switch %d %s", in->a, in->b ? "closed" : "opened");
+            break;
+        case SIM_INPUT_ROTARY:
+            fprintf(f, "rotary clock %d data %d", in->a, in->b);
+            break;
+        case SIM_INPUT_SERIAL:
+            fprintf(f, "serial 0x%02x", in->a);
+            break;
+    }
+}
+
+static int display_blank(void) {
+    uint8_t cells[SIM_LCD_ROWS][SIM_LCD_COLUMNS];
+
+    sim_lcd_get_cells(cells);
+    for (int r = 0; r < SIM_LCD_ROWS; ++r) {
+        for (int c = 0; c < SIM_LCD_COLUMNS; ++c) {
+            if (cells[r][c] != ' ')
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* The display has stopped changing for long enough to count as a screen */
+static void screen_settled(void) {
+    if (first_frame_us == 0 && !display_blank())
+        first_frame_us = last_display_change_us;
+    if (show_display)
+        sim_lcd_print(stdout, last_display_change_us);
+    display_unprinted = 0;
+}
+
+static void hook_input(const struct sim_input *in) {
+    inputs_applied++;
+    unseen.push_back(*in);
+}
+
+static void hook_setup(void) {
+    if (start_app_init) {
+        const struct boz_app *list = boz_app_list_get();
+
+        app_to_call_data.init = start_app_init;
+        app_to_call_data.flags = 0;
+
+        /* Flags such as BOZ_APP_NO_SLEEP matter: the simulated serial port
+           doesn't wake the CPU, just as it wouldn't the real one */
+        for (int i = 0; i < boz_app_list_get_length(); ++i) {
+            if (list[i].init == start_app_init)
+                app_to_call_data.flags = list[i].flags;
+        }
+        app_to_call_data.eeprom_start = 0;
+        app_to_call_data.eeprom_length = 0;
+        app_call_defer = &app_to_call_data;
+    }
+}
+
+static void hook_pass(uint64_t start_us, uint64_t end_us, uint64_t host_ns) {
+    uint64_t slept_us = sim_stats.slept_us - last_slept_us;
+    struct pass_record rec;
+    int bucket = 0;
+
+    last_slept_us = sim_stats.slept_us;
+
+    /* Anything that arrived before this pass started has been seen by it */
+    while (!unseen.empty() && unseen.front().time_us <= start_us) {
+        const struct sim_input *in = &unseen.front();
+        uint64_t latency = start_us - in->time_us;
+
+        latency_total_us += latency;
+        if (latency > latency_max_us) {
+            latency_max_us = latency;
+            latency_max_at_us = in->time_us;
+        }
+        if (verbose) {
+            print_time(stdout, in->time_us);
+            printf(" ");
+            describe_input(stdout, in);
+            printf(", loop() saw it %llu us later\n", (unsigned long long) latency);
+        }
+        unseen.pop_front();
+    }
+
+    rec.start_us = start_us;
+    rec.awake_us = end_us - start_us - slept_us;
+    awake_total_us += rec.awake_us;
+    for (int i = 0; i < NUM_LONGEST; ++i) {
+        if (rec.awake_us > longest[i].awake_us) {
+            memmove(&longest[i + 1], &longest[i], (NUM_LONGEST - i - 1) * sizeof(longest[0]));
+            longest[i] = rec;
+            break;
+        }
+    }
+
+    /* loop() initialises the display a step at a time after power on, and
+       we start watching it once that's finished */
+    if (!display_ready && sim_lcd_initialised()) {
+        display_ready = 1;
+        ready_us = end_us;
+        ready_bus_ns = sim_stats.i2c_bus_ns - sim_stats.i2c_read_ns;
+        ready_lcd_stats = sim_lcd_stats;
+        sim_lcd_changed();
+    }
+
+    if (display_ready && sim_lcd_changed()) {
+        if (screen_changes == 0 || end_us - last_display_change_us >= SCREEN_SETTLE_US)
+            screen_changes++;
+        last_display_change_us = end_us;
+        display_unprinted = 1;
+    }
+    else if (display_unprinted && end_us - last_display_change_us >= SCREEN_SETTLE_US) {
+        screen_settled();
+    }
+
+    host_total_ns += host_ns;
+    while (bucket < NUM_HOST_BUCKETS - 1 && (host_ns >> (bucket + 1)) != 0)
+        ++bucket;
+    host_buckets[bucket]++;
+}
+
+static int load_inputs(const char *path, uint64_t *last_us) {
+    FILE *f;
+    char line[200];
+    int line_num = 0;
+    uint64_t prev_us = 0;
+
+    if (!strcmp(path, "-"))
+        f = stdin;
+    else
+        f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long us;
+        char type[20];
+        int a = 0, b = 0;
+        int fields;
+        struct sim_input in;
+
+        ++line_num;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+
+        fields = sscanf(line, "%llu %19s %i %i", &us, type, &a, &b);
+        if (fields < 3) {
+            fprintf(stderr, "%s:%d: can't parse this line\n", path, line_num);
+            return -1;
+        }
+        if (us < prev_us) {
+            fprintf(stderr, "%s:%d: time goes backwards\n", path, line_num);
+            return -1;
+        }
+        in.time_us = prev_us = us;
+        in.a = (uint8_t) a;
+        in.b = (uint8_t) b;
+        if (!strcmp(type, "switch") && fields == 4)
+            in.type = SIM_INPUT_SWITCH;
+        else if (!strcmp(type, "rotary") && fields == 4)
+            in.type = SIM_INPUT_ROTARY;
+        else if (!strcmp(type, "serial"))
+            in.type = SIM_INPUT_SERIAL;
+        else {
+            fprintf(stderr, "%s:%d: unknown input \"%s\"\n", path, line_num, type);
+            return -1;
+        }
+        sim_add_input(&in);
+    }
+    if (f != stdin)
+        fclose(f);
+    *last_us = prev_us;
+    return 0;
+}
+
+/* Print the display benchmark figures as "name value" lines, for bench.py */
+static void print_bench(uint64_t bus_ns, uint64_t bus_us_per_s, uint64_t bus_us_per_change,
+        const struct sim_lcd_stats *lcd) {
+    printf("sim_us %llu\n", (unsigned long long) (sim_now_us - ready_us));
+    printf("bus_us %llu\n", (unsigned long long) (bus_ns / 1000));
+    printf("bus_us_per_s %llu\n", (unsigned long long) bus_us_per_s);
+    printf("screen_changes %llu\n", (unsigned long long) screen_changes);
+    printf("bus_us_per_change %llu\n", (unsigned long long) bus_us_per_change);
+    printf("lcd_instructions %llu\n", (unsigned long long) lcd->instructions);
+    printf("lcd_data_writes %llu\n", (unsigned long long) lcd->data_writes);
+    printf("busy_violations %llu\n", (unsigned long long) sim_lcd_stats.busy_violations);
+    printf("awake_us %llu\n", (unsigned long long) awake_total_us);
+    printf("first_frame_us %llu\n", (unsigned long long) first_frame_us);
+}
+
+static void print_report(void) {
+    uint64_t bus_ns = sim_stats.i2c_bus_ns - sim_stats.i2c_read_ns - ready_bus_ns;
+    uint64_t run_us = sim_now_us - ready_us;
+    uint64_t bus_us_per_s = run_us ? bus_ns / 1000 * 1000000 / run_us : 0;
+    uint64_t bus_us_per_change = screen_changes ? bus_ns / 1000 / screen_changes : 0;
+    struct sim_lcd_stats lcd;
+
+    lcd.instructions = sim_lcd_stats.instructions - ready_lcd_stats.instructions;
+    lcd.data_writes = sim_lcd_stats.data_writes - ready_lcd_stats.data_writes;
+    lcd.clears = sim_lcd_stats.clears - ready_lcd_stats.clears;
+
+    if (quiet) {
+        print_bench(bus_ns, bus_us_per_s, bus_us_per_change, &lcd);
+        return;
+    }
+
+    printf("Simulated time:        ");
+    print_time(stdout, sim_now_us);
+    printf(" s\n");
+    printf("Inputs applied:        %llu\n", (unsigned long long) inputs_applied);
+    if (inputs_applied > 0) {
+        printf("Input latency:         mean %llu us, max %llu us (input at ",
+                (unsigned long long) (latency_total_us / inputs_applied),
+                (unsigned long long) latency_max_us);
+        print_time(stdout, latency_max_at_us);
+        printf(")\n");
+    }
+    printf("Passes of loop():      %llu\n", (unsigned long long) sim_stats.loop_passes);
+    printf("Time awake:            %llu us\n", (unsigned long long) awake_total_us);
+    printf("Time asleep:           %llu us in %llu sleeps\n",
+            (unsigned long long) sim_stats.slept_us, (unsigned long long) sim_stats.sleeps);
+    printf("Timer 1 interrupts:    %llu\n", (unsigned long long) sim_stats.timer1_interrupts);
+    printf("Pin interrupts:        %llu\n", (unsigned long long) sim_stats.pin_interrupts);
+    printf("ADC conversions:       %llu\n", (unsigned long long) sim_stats.adc_conversions);
+    if (sim_stats.watchdog_timeouts) {
+        printf("Watchdog timeouts:     %llu, first at %llu.%06llu\n",
+                (unsigned long long) sim_stats.watchdog_timeouts,
+                (unsigned long long) (sim_stats.first_watchdog_timeout_us / 1000000),
+                (unsigned long long) (sim_stats.first_watchdog_timeout_us % 1000000));
+    }
+    printf("EEPROM:                %llu reads, %llu writes, %llu us waiting\n",
+            (unsigned long long) sim_stats.eeprom_reads,
+            (unsigned long long) sim_stats.eeprom_writes,
+            (unsigned long long) sim_stats.eeprom_wait_us);
+    printf("I2C:                   %llu transmissions, %llu bytes, %llu us busy at %lu Hz\n",
+            (unsigned long long) sim_stats.i2c_transmissions,
+            (unsigned long long) sim_stats.i2c_bytes,
+            (unsigned long long) (sim_stats.i2c_bus_ns / 1000),
+            (unsigned long) sim_i2c_clock_hz);
+    if (sim_stats.i2c_reads)
+        printf("Input expanders:       %llu reads, %llu us of the I2C bus\n",
+                (unsigned long long) sim_stats.i2c_reads,
+                (unsigned long long) (sim_stats.i2c_read_ns / 1000));
+    printf("Serial:                %llu bytes in, %llu bytes out\n",
+            (unsigned long long) sim_stats.serial_bytes_in,
+            (unsigned long long) sim_stats.serial_bytes_out);
+    printf("Tones:                 %llu\n", (unsigned long long) sim_stats.tones);
+
+    printf("\nDisplay, once initialised:\n");
+    if (first_frame_us) {
+        printf("    First screen:      ");
+        print_time(stdout, first_frame_us);
+        printf(" s after power on\n");
+    }
+    printf("    I2C bus busy:      %llu us, %llu us per second\n",
+            (unsigned long long) (bus_ns / 1000), (unsigned long long) bus_us_per_s);
+    printf("    Screen changes:    %llu, %llu us of bus time each\n",
+            (unsigned long long) screen_changes, (unsigned long long) bus_us_per_change);
+    printf("    HD44780:           %llu instructions, %llu data writes, %llu clears\n",
+            (unsigned long long) lcd.instructions,
+            (unsigned long long) lcd.data_writes,
+            (unsigned long long) lcd.clears);
+    if (sim_lcd_stats.busy_violations > 0) {
+        printf("    Sent while busy:   %llu times since power on, first at ",
+                (unsigned long long) sim_lcd_stats.busy_violations);
+        print_time(stdout, sim_lcd_stats.first_busy_violation_us);
+        printf("\n");
+    }
+    printf("\n");
+    sim_lcd_print(stdout, sim_now_us);
+
+    printf("\nLongest passes of loop(), in simulated time awake:\n");
+    for (int i = 0; i < NUM_LONGEST && longest[i].awake_us > 0; ++i) {
+        printf("    %8llu us, starting at ", (unsigned long long) longest[i].awake_us);
+        print_time(stdout, longest[i].start_us);
+        printf("\n");
+    }
+
+    if (sim_stats.loop_passes > 0) {
+        printf("\nHost CPU time per pass: mean %llu ns\n",
+                (unsigned long long) (host_total_ns / sim_stats.loop_passes));
+        for (int i = 0; i < NUM_HOST_BUCKETS; ++i) {
+            if (host_buckets[i])
+                printf("    %10llu ns+ %10llu\n", 1ULL << i, (unsigned long long) host_buckets[i]);
+        }
+    }
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+"Usage: %s [options] <inputs file>\n"
+"Replay an input session into the firmware under simulated time.\n"
+"Options:\n"
+"    -a <app>    start this app instead of the main menu\n"
+"    -b <mv>     battery voltage in millivolts (default %d)\n"
+"    -d          print the display each time it changes\n"
+"    -e <file>   load the EEPROM from this file first\n"
+"    -E <file>   save the EEPROM to this file afterwards\n"
+"    -i <hz>     I2C bus clock (default %lu)\n"
+"    -p <us>     simulated CPU time each pass of loop() takes (default %llu)\n"
+"    -q          print only the display benchmark figures, for bench.py\n"
+"    -s <file>   write what the firmware sends to the serial port here\n"
+"    -t <ms>     keep going this long after the last input (default 2000)\n"
+"    -v          print each input, and how long loop() took to see it\n"
+"Apps for -a:",
+        argv0, sim_battery_mv, (unsigned long) sim_i2c_clock_hz, (unsigned long long) sim_loop_pass_us);
+    for (size_t i = 0; i < NUM_START_APPS; ++i)
+        fprintf(stderr, " %s", start_apps[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+    int c;
+    const char *eeprom_in = NULL, *eeprom_out = NULL, *serial_out = NULL;
+    uint64_t tail_ms = 2000;
+    uint64_t last_us;
+
+    while ((c = getopt(argc, argv, "a:b:de:E:i:p:qs:t:vh")) != -1) {
+        switch (c) {
+            case 'a':
+                for (size_t i = 0; i < NUM_START_APPS; ++i) {
+                    if (!strcmp(optarg, start_apps[i].name))
+                        start_app_init = start_apps[i].init;
+                }
+                if (start_app_init == NULL) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b': sim_battery_mv = atoi(optarg); break;
+            case 'd': show_display = 1; break;
+            case 'e': eeprom_in = optarg; break;
+            case 'E': eeprom_out = optarg; break;
+            case 'i': sim_i2c_clock_hz = strtoul(optarg, NULL, 10); break;
+            case 'p': sim_loop_pass_us = strtoull(optarg, NULL, 10); break;
+            case 'q': quiet = 1; break;
+            case 's': serial_out = optarg; break;
+            case 't': tail_ms = strtoull(optarg, NULL, 10); break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (sim_i2c_clock_hz == 0) {
+        fprintf(stderr, "%s: the I2C bus needs a clock\n", argv[0]);
+        return 1;
+    }
+    if (sim_loop_pass_us == 0) {
+        fprintf(stderr, "%s: a pass of loop() has to take some time\n", argv[0]);
+        return 1;
+    }
+
+    if (load_inputs(argv[optind], &last_us))
+        return 1;
+    if (eeprom_in && sim_eeprom_load(eeprom_in)) {
+        perror(eeprom_in);
+        return 1;
+    }
+    if (serial_out) {
+        sim_serial_out = fopen(serial_out, "wb");
+        if (sim_serial_out == NULL) {
+            perror(serial_out);
+            return 1;
+        }
+    }
+
+    sim_end_us = last_us + tail_ms * 1000;
+    sim_hook_input = hook_input;
+    sim_hook_pass = hook_pass;
+    sim_hook_setup = hook_setup;
+
+    sim_run();
+    if (display_unprinted)
+        screen_settled();
+
+    if (sim_serial_out)
+        fclose(sim_serial_out);
+    if (eeprom_out && sim_eeprom_save(eeprom_out)) {
+        perror(eeprom_out);
+        return 1;
+    }
+
+    print_report();
+    return 0;
+}
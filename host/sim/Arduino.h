@@ -0,0 +1,129 @@
+#ifndef _SIM_ARDUINO_H
+#define _SIM_ARDUINO_H
+
+/* Just enough of the Arduino core for the Bozzard firmware to build and run
+ * on a PC under simulated time. See sim.cpp and host/README.md.
+ *
+ * Note that int is 32 bits and long is 64 bits here, not 16 and 32 as on the
+ * Nano, so anything that relies on overflow of those types behaves
+ * differently. micros() and millis() don't wrap. */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW  0
+
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+/* Interrupt modes */
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define LED_BUILTIN 13
+
+enum { A0 = 14, A1, A2, A3, A4, A5, A6, A7 };
+
+#define F(s) (s)
+#define PSTR(s) (s)
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+void tone(uint8_t pin, unsigned int freq, unsigned long duration_ms = 0);
+void noTone(uint8_t pin);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+void attachInterrupt(uint8_t num, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t num);
+void noInterrupts(void);
+void interrupts(void);
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    int available(void);
+    int peek(void);
+    int read(void);
+    int availableForWrite(void);
+    size_t write(uint8_t c);
+    size_t write(const char *buf, size_t len);
+    size_t write(const uint8_t *buf, size_t len) { return write((const char *) buf, len); }
+    void flush(void);
+    operator bool() { return true; }
+};
+extern HardwareSerial Serial;
+
+/* Timer 1. Writing TCNT1 schedules the overflow interrupt, if the timer is
+ * running and TOIE1 is set in TIMSK1 when the overflow comes round. */
+class SimTimer1Counter {
+public:
+    SimTimer1Counter &operator=(unsigned int value);
+    operator unsigned int() const;
+};
+extern uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern SimTimer1Counter sim_tcnt1;
+#define TCNT1 sim_tcnt1
+
+#define CS10  0
+#define CS11  1
+#define CS12  2
+#define TOIE1 0
+
+/* Input port registers. Reading one reads all its pins at once: port D is
+ * pins 0-7, port B is pins 8-13. */
+uint8_t sim_read_port(int first_pin);
+#define PIND sim_read_port(0)
+#define PINB sim_read_port(8)
+
+/* Watchdog registers, which do nothing: see avr/wdt.h. SP is the stack
+ * pointer, which only the watchdog's interrupt handler reads. */
+extern uint8_t MCUSR, WDTCSR;
+extern uint16_t SP;
+#define WDRF 3
+#define WDIE 6
+
+/* ADC registers. If the ADC is enabled, triggered by timer 0 overflowing
+ * and has its interrupt on, sim.cpp does a conversion on the channel in
+ * ADMUX and calls the interrupt handler every 1024us, which is how often
+ * timer 0 overflows on the real thing. */
+extern uint8_t ADMUX, ADCSRA, ADCSRB;
+extern uint16_t sim_adc;
+#define ADC sim_adc
+#define REFS0 6
+#define ADEN  7
+#define ADATE 5
+#define ADIE  3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+
+/* ISR(X_vect) defines a function sim.cpp calls when interrupt X fires */
+#define ISR(vector, ...) extern "C" void vector(void); extern "C" void vector(void)
+#define TIMER1_OVF_vect sim_vector_timer1_ovf
+#define WDT_vect sim_vector_wdt
+#define ADC_vect sim_vector_adc
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _SIM_EEPROM_H
+#define _SIM_EEPROM_H
+
+#include <stdint.h>
+#include <avr/eeprom.h>
+
+#define SIM_EEPROM_SIZE 1024
+
+class EEPROMClass {
+public:
+    uint8_t read(int idx);
+    void write(int idx, uint8_t value);
+    void update(int idx, uint8_t value);
+    uint16_t length(void) { return SIM_EEPROM_SIZE; }
+};
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _SIM_WIRE_H
+#define _SIM_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* I2C bus. Transmissions take simulated time, and anything sent to the
+   display's address goes to the display model in lcd.h. Reads from the
+   input expanders' addresses come from the expander model in sim.cpp. */
+class TwoWire {
+    uint8_t tx_address;
+    uint8_t tx_buf[32];
+    size_t tx_len;
+    uint8_t rx_buf[32];
+    size_t rx_len, rx_pos;
+
+public:
+    void begin(void);
+    void setClock(uint32_t freq);
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t len);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool stop = true);
+    int available(void);
+    int read(void);
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _SIM_AVR_EEPROM_H
+#define _SIM_AVR_EEPROM_H
+
+/* A write takes 3.4ms of simulated time, during which eeprom_is_ready() is
+ * false. Starting another write before then waits for the first to finish,
+ * as eeprom_write_byte() does. */
+int sim_eeprom_is_ready(void);
+#define eeprom_is_ready() sim_eeprom_is_ready()
+
+#endif
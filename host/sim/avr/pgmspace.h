@@ -0,0 +1,31 @@
+#ifndef _SIM_AVR_PGMSPACE_H
+#define _SIM_AVR_PGMSPACE_H
+
+/* Program memory is ordinary memory on a PC. The word, dword and pointer
+ * reads return the type they're pointed at rather than a fixed-size integer,
+ * because pointers and longs are bigger here than on the AVR. */
+
+#include <string.h>
+#include <stdint.h>
+
+#define PROGMEM
+
+template <typename T> static inline T sim_pgm_read(const T *p) { return *p; }
+static inline uint16_t sim_pgm_read(const void *p) { return *(const uint16_t *) p; }
+
+#define pgm_read_byte(p)       (*(const uint8_t *) (p))
+#define pgm_read_byte_near(p)  pgm_read_byte(p)
+#define pgm_read_word(p)       sim_pgm_read(p)
+#define pgm_read_word_near(p)  sim_pgm_read(p)
+#define pgm_read_dword(p)      sim_pgm_read(p)
+#define pgm_read_dword_near(p) sim_pgm_read(p)
+#define pgm_read_ptr(p)        sim_pgm_read(p)
+#define pgm_read_ptr_near(p)   sim_pgm_read(p)
+
+#define memcpy_P  memcpy
+#define strncpy_P strncpy
+#define strcpy_P  strcpy
+#define strlen_P  strlen
+#define strcmp_P  strcmp
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _SIM_AVR_SLEEP_H
+#define _SIM_AVR_SLEEP_H
+
+/* sleep_cpu() moves simulated time on to the next thing that would cause an
+ * interrupt, and calls its handler. */
+
+#define SLEEP_MODE_IDLE 0
+
+void set_sleep_mode(int mode);
+void sleep_enable(void);
+void sleep_disable(void);
+void sleep_cpu(void);
+
+#endif
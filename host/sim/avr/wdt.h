@@ -0,0 +1,25 @@
+#ifndef _SIM_AVR_WDT_H
+#define _SIM_AVR_WDT_H
+
+/* The watchdog never fires in the simulator, because the firmware's
+ * interrupt handler for it waits for a reset which would never come.
+ * Instead, sim.cpp counts how many times it would have fired: whenever it
+ * is reset or disabled, if it's been longer than its timeout since it was
+ * enabled or last reset. */
+
+#define WDTO_15MS   0
+#define WDTO_30MS   1
+#define WDTO_60MS   2
+#define WDTO_120MS  3
+#define WDTO_250MS  4
+#define WDTO_500MS  5
+#define WDTO_1S     6
+#define WDTO_2S     7
+#define WDTO_4S     8
+#define WDTO_8S     9
+
+void wdt_enable(int timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#endif
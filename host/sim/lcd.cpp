@@ -0,0 +1,291 @@
+/* HD44780 character LCD behind a PCF8574 I2C port expander. See lcd.h.
+ *
+ * The PCF8574's outputs are wired to the display like this, which is what
+ * boz_lcd.ino expects:
+ *     P7-P4: D7-D4
+ *     P3:    backlight
+ *     P2:    E
+ *     P1:    R/W
+ *     P0:    RS
+ * The HD44780 latches D7-D4 and RS when E falls. It starts up in 8-bit mode,
+ * where each nibble is a whole instruction (D3-D0 aren't connected, so read
+ * as zero), until it's told to switch to 4-bit mode, after which it takes
+ * each instruction or data byte as two nibbles, high nibble first. */
+
+#include <string.h>
+
+#include "lcd.h"
+
+#define PCF_RS        (1 << 0)
+#define PCF_RW        (1 << 1)
+#define PCF_E         (1 << 2)
+#define PCF_BACKLIGHT (1 << 3)
+
+/* Execution times from the HD44780 datasheet, with the usual 270kHz
+   oscillator */
+#define EXEC_CLEAR_HOME_US 1520
+#define EXEC_INSTRUCTION_US 37
+#define EXEC_DATA_US 41
+
+/* It's busy initialising itself for this long after power on */
+#define POWER_ON_US 40000
+
+#define LINE_LENGTH 40
+#define LINE2_START 0x40
+
+struct sim_lcd_stats sim_lcd_stats;
+
+struct visible {
+    uint8_t cells[SIM_LCD_ROWS][SIM_LCD_COLUMNS];
+    uint8_t cgram[64];
+    uint8_t backlight;
+};
+
+static struct hd44780 {
+    uint8_t ddram[0x80];
+    uint8_t cgram[64];
+
+    /* Address counter, and whether it points into CGRAM rather than DDRAM */
+    uint8_t ac;
+    uint8_t ac_cgram;
+
+    /* How many places the display has been shifted left */
+    uint8_t shift;
+
+    uint8_t increment, entry_shift;
+    uint8_t display_on, cursor_on, blink_on;
+    uint8_t four_bit, two_lines;
+
+    /* Set once it's been through the whole "initializing by instruction"
+       sequence, which ends with an entry mode set in 4-bit mode */
+    uint8_t initialised;
+
+    /* In 4-bit mode, the first nibble of a byte while we wait for the
+       second */
+    uint8_t have_high_nibble, high_nibble;
+
+    uint64_t busy_until_us;
+} lcd;
+
+static uint8_t pcf_output = 0;
+static struct visible last_visible;
+static int last_visible_valid = 0;
+
+static struct lcd_power_on {
+    lcd_power_on() {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.increment = 1;
+        lcd.busy_until_us = POWER_ON_US;
+    }
+} lcd_power_on;
+
+/* Move the DDRAM address on by one in the given direction, as the HD44780
+   does: in two-line mode, the end of the first line runs on to the start of
+   the second and vice versa. */
+static uint8_t ddram_step(uint8_t ac, int increment) {
+    if (!lcd.two_lines)
+        return (uint8_t) ((ac + (increment ? 1 : 0x4f)) % 0x50);
+    if (increment) {
+        if (ac == LINE_LENGTH - 1)
+            return LINE2_START;
+        if (ac == LINE2_START + LINE_LENGTH - 1)
+            return 0;
+        return ac + 1;
+    }
+    else {
+        if (ac == 0)
+            return LINE2_START + LINE_LENGTH - 1;
+        if (ac == LINE2_START)
+            return LINE_LENGTH - 1;
+        return ac - 1;
+    }
+}
+
+static void shift_display(int left) {
+    if (left)
+        lcd.shift = (lcd.shift + 1) % LINE_LENGTH;
+    else
+        lcd.shift = (lcd.shift + LINE_LENGTH - 1) % LINE_LENGTH;
+}
+
+static void execute_instruction(uint8_t ins, uint64_t now_us) {
+    uint64_t exec_us = EXEC_INSTRUCTION_US;
+
+    sim_lcd_stats.instructions++;
+    if (ins & 0x80) {
+        lcd.ac = ins & 0x7f;
+        lcd.ac_cgram = 0;
+    }
+    else if (ins & 0x40) {
+        lcd.ac = ins & 0x3f;
+        lcd.ac_cgram = 1;
+    }
+    else if (ins & 0x20) {
+        lcd.four_bit = !(ins & 0x10);
+        lcd.two_lines = (ins & 0x08) != 0;
+        lcd.have_high_nibble = 0;
+    }
+    else if (ins & 0x10) {
+        int right = (ins & 0x04) != 0;
+        if (ins & 0x08)
+            shift_display(!right);
+        else if (lcd.ac_cgram)
+            lcd.ac = (lcd.ac + (right ? 1 : 63)) & 63;
+        else
+            lcd.ac = ddram_step(lcd.ac, right);
+    }
+    else if (ins & 0x08) {
+        lcd.display_on = (ins & 0x04) != 0;
+        lcd.cursor_on = (ins & 0x02) != 0;
+        lcd.blink_on = (ins & 0x01) != 0;
+    }
+    else if (ins & 0x04) {
+        lcd.increment = (ins & 0x02) != 0;
+        lcd.entry_shift = (ins & 0x01) != 0;
+        if (lcd.four_bit)
+            lcd.initialised = 1;
+    }
+    else if (ins & 0x02) {
+        lcd.ac = 0;
+        lcd.ac_cgram = 0;
+        lcd.shift = 0;
+        exec_us = EXEC_CLEAR_HOME_US;
+    }
+    else if (ins & 0x01) {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.ac = 0;
+        lcd.ac_cgram = 0;
+        lcd.shift = 0;
+        lcd.increment = 1;
+        exec_us = EXEC_CLEAR_HOME_US;
+        sim_lcd_stats.clears++;
+    }
+    lcd.busy_until_us = now_us + exec_us;
+}
+
+static void execute_data(uint8_t data, uint64_t now_us) {
+    sim_lcd_stats.data_writes++;
+    if (lcd.ac_cgram) {
+        lcd.cgram[lcd.ac & 63] = data & 0x1f;
+        lcd.ac = (lcd.ac + (lcd.increment ? 1 : 63)) & 63;
+    }
+    else {
+        lcd.ddram[lcd.ac & 0x7f] = data;
+        lcd.ac = ddram_step(lcd.ac, lcd.increment);
+        if (lcd.entry_shift)
+            shift_display(lcd.increment);
+    }
+    lcd.busy_until_us = now_us + EXEC_DATA_US;
+}
+
+/* E has just fallen, so the HD44780 reads the data lines */
+static void latch_nibble(uint8_t nibble, int rs, uint64_t now_us) {
+    uint8_t value;
+
+    if (now_us < lcd.busy_until_us) {
+        if (sim_lcd_stats.busy_violations == 0)
+            sim_lcd_stats.first_busy_violation_us = now_us;
+        sim_lcd_stats.busy_violations++;
+    }
+
+    if (!lcd.four_bit) {
+        value = nibble << 4;
+    }
+    else if (!lcd.have_high_nibble) {
+        lcd.high_nibble = nibble;
+        lcd.have_high_nibble = 1;
+        return;
+    }
+    else {
+        value = (lcd.high_nibble << 4) | nibble;
+        lcd.have_high_nibble = 0;
+    }
+
+    if (rs)
+        execute_data(value, now_us);
+    else
+        execute_instruction(value, now_us);
+}
+
+void sim_lcd_pcf8574_write(uint8_t value, uint64_t now_us) {
+    uint8_t falling = pcf_output & ~value;
+
+    pcf_output = value;
+    if ((falling & PCF_E) && !(value & PCF_RW))
+        latch_nibble(value >> 4, (value & PCF_RS) != 0, now_us);
+}
+
+int sim_lcd_initialised(void) {
+    return lcd.initialised;
+}
+
+void sim_lcd_get_cells(uint8_t cells[SIM_LCD_ROWS][SIM_LCD_COLUMNS]) {
+    for (int r = 0; r < SIM_LCD_ROWS; ++r) {
+        for (int c = 0; c < SIM_LCD_COLUMNS; ++c) {
+            uint8_t addr = (r ? LINE2_START : 0) + (c + lcd.shift) % LINE_LENGTH;
+            cells[r][c] = lcd.display_on ? lcd.ddram[addr] : ' ';
+        }
+    }
+}
+
+int sim_lcd_changed(void) {
+    struct visible v;
+
+    memset(&v, 0, sizeof(v));
+    sim_lcd_get_cells(v.cells);
+    memcpy(v.cgram, lcd.cgram, sizeof(v.cgram));
+    v.backlight = (pcf_output & PCF_BACKLIGHT) != 0;
+
+    if (last_visible_valid && !memcmp(&v, &last_visible, sizeof(v)))
+        return 0;
+    last_visible = v;
+    last_visible_valid = 1;
+    return 1;
+}
+
+static char printable(uint8_t c) {
+    if (c < 16)
+        return '0' + (c & 7);
+    if (c == 0x7e)
+        return '>';
+    if (c == 0x7f)
+        return '<';
+    if (c >= 0x20 && c < 0x7e)
+        return c;
+    return '?';
+}
+
+void sim_lcd_print(FILE *f, uint64_t now_us) {
+    uint8_t cells[SIM_LCD_ROWS][SIM_LCD_COLUMNS];
+    char prefix[24];
+
+    sim_lcd_get_cells(cells);
+    snprintf(prefix, sizeof(prefix), "%llu.%06llu ", (unsigned long long) (now_us / 1000000),
+            (unsigned long long) (now_us % 1000000));
+    for (int r = 0; r < SIM_LCD_ROWS; ++r) {
+        int glyphs = 0;
+
+        fprintf(f, "%*s|", (int) strlen(prefix), r == 0 ? prefix : "");
+        for (int c = 0; c < SIM_LCD_COLUMNS; ++c) {
+            fputc(printable(cells[r][c]), f);
+            glyphs |= cells[r][c] < 16;
+        }
+        fprintf(f, "|%s\n", (pcf_output & PCF_BACKLIGHT) || r ? "" : " (backlight off)");
+        if (glyphs) {
+            fprintf(f, "%*s ", (int) strlen(prefix), "");
+            for (int c = 0; c < SIM_LCD_COLUMNS; ++c)
+                fputc(cells[r][c] < 16 ? '^' : ' ', f);
+            fprintf(f, "\n");
+        }
+    }
+}
+
+void sim_lcd_print_glyphs(FILE *f) {
+    for (int row = 0; row < 8; ++row) {
+        for (int g = 0; g < 8; ++g) {
+            for (int bit = 4; bit >= 0; --bit)
+                fputc((lcd.cgram[g * 8 + row] >> bit) & 1 ? '#' : '.', f);
+            fputc(g < 7 ? ' ' : '\n', f);
+        }
+    }
+}
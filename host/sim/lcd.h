@@ -0,0 +1,57 @@
+#ifndef _SIM_LCD_H
+#define _SIM_LCD_H
+
+/* Model of the display on hardware revision 1: an HD44780 character LCD,
+ * 2 rows by 16 columns, driven in 4-bit mode through a PCF8574 I2C port
+ * expander. sim.cpp gives it every byte written to its I2C address, and it
+ * works out what the HD44780 would make of it, including how long each
+ * instruction takes to execute. */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_LCD_I2C_ADDRESS 0x27
+#define SIM_LCD_ROWS 2
+#define SIM_LCD_COLUMNS 16
+
+struct sim_lcd_stats {
+    /* Instructions and data writes the HD44780 has executed */
+    uint64_t instructions;
+    uint64_t data_writes;
+    uint64_t clears;
+
+    /* Number of times a nibble arrived while the HD44780 was still busy
+       executing the last instruction. The real one might ignore it. */
+    uint64_t busy_violations;
+    uint64_t first_busy_violation_us;
+};
+
+extern struct sim_lcd_stats sim_lcd_stats;
+
+/* The PCF8574 has received "value" over I2C, and it's now on its output
+ * pins, at time now_us. */
+void sim_lcd_pcf8574_write(uint8_t value, uint64_t now_us);
+
+/* Returns 1 once the firmware has initialised the display and it will take
+ * commands, 0 before that. */
+int sim_lcd_initialised(void);
+
+/* What's visible on the display, by character code. Codes 0 to 15 are the
+ * user-defined characters, of which there are eight. If the display is off,
+ * everything is a space. */
+void sim_lcd_get_cells(uint8_t cells[SIM_LCD_ROWS][SIM_LCD_COLUMNS]);
+
+/* Returns 1 if what's visible (text, user-defined character patterns,
+ * backlight) has changed since the last call, 0 if not. */
+int sim_lcd_changed(void);
+
+/* Print the display as text, with the time, e.g.
+ *     1.234567 |Buzzer game    |
+ *              |  0:00         |
+ * User-defined characters show as their number, with a ^ underneath. */
+void sim_lcd_print(FILE *f, uint64_t now_us);
+
+/* Print the patterns of the eight user-defined characters, side by side */
+void sim_lcd_print_glyphs(FILE *f);
+
+#endif
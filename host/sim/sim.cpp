@@ -0,0 +1,805 @@
+/* Simulated Arduino Nano, for running the Bozzard firmware on a PC.
+ *
+ * Nothing happens in real time. sim_now_us only moves on when the firmware
+ * calls delay() or delayMicroseconds(), reads a pin, waits for the EEPROM,
+ * or goes to sleep, and each pass of loop() costs sim_loop_pass_us. Inputs and
+ * interrupts happen at the simulated time they're due, in the middle of
+ * whatever the firmware was doing, as they would on the real thing.
+ *
+ * The switches are wired as on the hardware revision in boz_hw.h. On
+ * revision 1, each switch connects its I/O pin to the interrupt pin D2, so a
+ * closed switch reads LOW only while D2 is an output driven LOW, and D2
+ * reads LOW while any closed switch's pin is an output driven LOW. The
+ * rotary encoder's push button pulls its pin to ground directly, and D2 too
+ * unless D2 is an output.
+ *
+ * The display is on the I2C bus at the address in lcd.h, which is where
+ * revision 1 has it, and transmissions take as long as they would on the
+ * real bus at sim_i2c_clock_hz. So are PCF8574 input expanders for any
+ * buzzers beyond the fourth, as described in boz_input.h. Their switches
+ * are the virtual pins from BOZ_INPUT_VIRTUAL_PIN, and an expander pulls
+ * D2 low, if it isn't an output, when any of its switches has changed
+ * since it was last read. */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#include "boz_pins.h"
+#include "boz_input.h"
+#include "lcd.h"
+#include "sim.h"
+
+#define NUM_PINS 22
+
+/* Time taken by an EEPROM write */
+#define EEPROM_WRITE_US 3400
+
+/* Roughly how long digitalRead() takes. It has to take some time, or the
+   firmware could wait forever for a button to be released. */
+#define DIGITAL_READ_US 4
+
+/* Reading a port register is one instruction, but still has to take some
+   time for the same reason */
+#define PORT_READ_US 1
+
+/* Serial transmit buffer size on the real thing, which availableForWrite()
+   always claims is empty */
+#define SERIAL_TX_BUFFER_SIZE 63
+
+void setup(void);
+void loop(void);
+
+/* Defined by the firmware only if it wants them */
+void serialEvent(void) __attribute__((weak));
+extern "C" void sim_vector_timer1_ovf(void) __attribute__((weak));
+extern "C" void sim_vector_adc(void) __attribute__((weak));
+
+uint64_t sim_now_us = 0;
+uint64_t sim_loop_pass_us = 100;
+uint64_t sim_end_us = SIM_TIME_NEVER;
+int sim_battery_mv = 9000;
+uint32_t sim_i2c_clock_hz = 100000;
+struct sim_stats sim_stats;
+FILE *sim_serial_out = NULL;
+void (*sim_hook_input)(const struct sim_input *input) = NULL;
+void (*sim_hook_pass)(uint64_t start_us, uint64_t end_us, uint64_t host_ns) = NULL;
+void (*sim_hook_setup)(void) = NULL;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+TwoWire Wire;
+uint8_t TCCR1A, TCCR1B, TIMSK1;
+uint8_t MCUSR, WDTCSR;
+uint16_t SP;
+uint8_t ADMUX, ADCSRA, ADCSRB;
+uint16_t sim_adc;
+
+/* Watchdog: whether it's enabled, its timeout, and when it was last reset */
+static int wdt_enabled = 0;
+static uint64_t wdt_timeout_us;
+static uint64_t wdt_reset_at_us;
+SimTimer1Counter sim_tcnt1;
+
+/* Thrown to get out of the firmware when the run is over */
+struct sim_finished {};
+
+struct pin_state {
+    uint8_t mode;
+    uint8_t out;
+};
+
+static struct pin_state pins[NUM_PINS];
+static uint8_t switch_closed[NUM_PINS];
+
+/* Input expanders: which of each one's switches are closed, and what its
+   port read as the last time the firmware read it */
+#define NUM_EXPANDERS 2
+static uint8_t expander_closed[NUM_EXPANDERS];
+static uint8_t expander_last_read[NUM_EXPANDERS] = { 0xff, 0xff };
+static uint8_t re_clock = LOW, re_data = HIGH;
+
+static std::vector<struct sim_input> inputs;
+static size_t next_input = 0;
+
+static uint8_t interrupts_enabled = 1;
+static uint8_t sleep_enabled = 0;
+
+/* Set once this pass of loop() has been charged sim_loop_pass_us */
+static uint8_t pass_charged = 0;
+
+struct ext_int {
+    void (*handler)(void);
+    int mode;
+    uint8_t last_level;
+    uint8_t pending;
+};
+static struct ext_int ext_ints[2];
+static const uint8_t ext_int_pins[2] = { PIN_BUTTON_INT, PIN_QM_RE_CLOCK };
+
+/* Timer 1: when it next overflows, or SIM_TIME_NEVER if it isn't running,
+   and whether an overflow interrupt is waiting for interrupts to be
+   enabled. */
+static uint64_t timer1_overflow_us = SIM_TIME_NEVER;
+static unsigned int timer1_start_count;
+static uint64_t timer1_start_us;
+static uint8_t timer1_pending;
+
+static uint8_t eeprom[SIM_EEPROM_SIZE];
+static uint64_t eeprom_busy_until_us = 0;
+
+static std::vector<uint8_t> serial_in;
+static size_t serial_in_pos = 0;
+
+static unsigned long random_state = 1;
+
+/* Fraction of a microsecond the I2C bus is into the current one, so that
+   many short transmissions add up to the right time */
+static uint64_t i2c_carry_ns = 0;
+static uint64_t i2c_end_us = 0;
+
+static void advance_to(uint64_t t);
+
+/******************************************************************************
+ * Pins
+ */
+
+/* Each expander input has a pull-up, and a closed switch pulls it low */
+static uint8_t expander_port(int e) {
+    return (uint8_t) ~expander_closed[e];
+}
+
+static int expander_int_asserted(void) {
+    for (int e = 0; e < NUM_EXPANDERS; ++e) {
+        if (expander_port(e) != expander_last_read[e])
+            return 1;
+    }
+    return 0;
+}
+
+static int pin_level(uint8_t pin) {
+    if (pin >= NUM_PINS)
+        return LOW;
+    if (pin == PIN_QM_RE_CLOCK)
+        return re_clock;
+    if (pin == PIN_QM_RE_DATA)
+        return re_data;
+    if (pins[pin].mode == OUTPUT)
+        return pins[pin].out;
+    if (pin == PIN_QM_RE_KEY)
+        return switch_closed[pin] ? LOW : HIGH;
+
+#if BOZ_HW_REVISION == 0
+    return switch_closed[pin] ? LOW : HIGH;
+#else
+    if (pin == PIN_BUTTON_INT) {
+        if ((switch_closed[PIN_QM_RE_KEY] || expander_int_asserted()) && pins[pin].mode != OUTPUT)
+            return LOW;
+        for (uint8_t p = 0; p < NUM_PINS; ++p) {
+            if (p != PIN_QM_RE_KEY && switch_closed[p] &&
+                    pins[p].mode == OUTPUT && pins[p].out == LOW)
+                return LOW;
+        }
+        return HIGH;
+    }
+    if (switch_closed[pin] && pins[PIN_BUTTON_INT].mode == OUTPUT &&
+            pins[PIN_BUTTON_INT].out == LOW)
+        return LOW;
+    return HIGH;
+#endif
+}
+
+/* Call an interrupt handler. As on the AVR, interrupts are disabled while
+   it runs, so anything that comes up in the meantime waits until it
+   returns. */
+static void run_isr(void (*handler)(void)) {
+    interrupts_enabled = 0;
+    handler();
+    interrupts();
+}
+
+/* Call the handler for any external interrupt whose condition now holds */
+static void check_interrupts(void) {
+    for (int i = 0; i < 2; ++i) {
+        struct ext_int *ei = &ext_ints[i];
+        uint8_t level = pin_level(ext_int_pins[i]);
+        uint8_t fire = 0;
+
+        if (ei->handler == NULL) {
+            ei->last_level = level;
+            continue;
+        }
+        switch (ei->mode) {
+            case LOW: fire = (level == LOW); break;
+            case CHANGE: fire = (level != ei->last_level); break;
+            case FALLING: fire = (level == LOW && ei->last_level == HIGH); break;
+            case RISING: fire = (level == HIGH && ei->last_level == LOW); break;
+        }
+        ei->last_level = level;
+        if (fire || ei->pending) {
+            if (!interrupts_enabled) {
+                ei->pending = 1;
+            }
+            else {
+                ei->pending = 0;
+                sim_stats.pin_interrupts++;
+                run_isr(ei->handler);
+            }
+        }
+    }
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin >= NUM_PINS)
+        return;
+    pins[pin].mode = mode;
+    if (mode == INPUT_PULLUP)
+        pins[pin].out = HIGH;
+    else if (mode == INPUT)
+        pins[pin].out = LOW;
+    check_interrupts();
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin >= NUM_PINS)
+        return;
+    pins[pin].out = value ? HIGH : LOW;
+    check_interrupts();
+}
+
+int digitalRead(uint8_t pin) {
+    advance_to(sim_now_us + DIGITAL_READ_US);
+    return pin_level(pin);
+}
+
+uint8_t sim_read_port(int first_pin) {
+    uint8_t value = 0;
+
+    advance_to(sim_now_us + PORT_READ_US);
+    for (int bit = 0; bit < 8 && first_pin + bit < NUM_PINS; ++bit) {
+        if (pin_level(first_pin + bit))
+            value |= 1 << bit;
+    }
+    return value;
+}
+
+/* What the ADC reads on analogue channel 0-7 */
+static int adc_reading(uint8_t channel) {
+    static unsigned int noise = 1;
+
+    if (channel == A6 - A0)
+        return (int) (sim_battery_mv * 1023L / 10000L);
+
+    /* An unconnected pin reads something around the middle */
+    noise = noise * 1103515245U + 12345U;
+    return 500 + (int) ((noise >> 16) % 25);
+}
+
+int analogRead(uint8_t pin) {
+    return adc_reading(pin - A0);
+}
+
+/* Timer 0 overflows every 1024us, and if the ADC is set up to start a
+   conversion when it does, return when the next one is. The conversion
+   takes about 100us, but we don't bother with that. */
+#define TIMER0_OVERFLOW_US 1024
+static uint64_t adc_next_conversion_us(void) {
+    const uint8_t want = (1 << ADEN) | (1 << ADATE) | (1 << ADIE);
+
+    if ((ADCSRA & want) != want || (ADCSRB & 7) != (1 << ADTS2) || !sim_vector_adc)
+        return SIM_TIME_NEVER;
+    return (sim_now_us / TIMER0_OVERFLOW_US + 1) * TIMER0_OVERFLOW_US;
+}
+
+static void adc_conversion(void) {
+    sim_adc = (uint16_t) adc_reading(ADMUX & 0x0f);
+    sim_stats.adc_conversions++;
+    if (interrupts_enabled)
+        run_isr(sim_vector_adc);
+}
+
+void attachInterrupt(uint8_t num, void (*handler)(void), int mode) {
+    if (num >= 2)
+        return;
+    ext_ints[num].last_level = pin_level(ext_int_pins[num]);
+    ext_ints[num].mode = mode;
+    ext_ints[num].pending = 0;
+    ext_ints[num].handler = handler;
+    check_interrupts();
+}
+
+void detachInterrupt(uint8_t num) {
+    if (num < 2) {
+        ext_ints[num].handler = NULL;
+        ext_ints[num].pending = 0;
+    }
+}
+
+void noInterrupts(void) {
+    interrupts_enabled = 0;
+}
+
+void interrupts(void) {
+    interrupts_enabled = 1;
+    if (timer1_pending) {
+        timer1_pending = 0;
+        sim_stats.timer1_interrupts++;
+        if (sim_vector_timer1_ovf)
+            run_isr(sim_vector_timer1_ovf);
+    }
+    check_interrupts();
+}
+
+/******************************************************************************
+ * Time
+ */
+
+unsigned long millis(void) {
+    return (unsigned long) (sim_now_us / 1000);
+}
+
+unsigned long micros(void) {
+    return (unsigned long) sim_now_us;
+}
+
+void delay(unsigned long ms) {
+    advance_to(sim_now_us + ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    advance_to(sim_now_us + us);
+}
+
+static unsigned int timer1_prescale(void) {
+    switch (TCCR1B & 7) {
+        case 1: return 1;
+        case 2: return 8;
+        case 3: return 64;
+        case 4: return 256;
+        case 5: return 1024;
+        default: return 0;
+    }
+}
+
+SimTimer1Counter &SimTimer1Counter::operator=(unsigned int value) {
+    unsigned int prescale = timer1_prescale();
+
+    timer1_start_count = value & 0xffff;
+    timer1_start_us = sim_now_us;
+    if (prescale == 0)
+        timer1_overflow_us = SIM_TIME_NEVER;
+    else
+        timer1_overflow_us = sim_now_us + ((65536UL - timer1_start_count) * prescale + 15) / 16;
+    return *this;
+}
+
+SimTimer1Counter::operator unsigned int() const {
+    unsigned int prescale = timer1_prescale();
+    if (prescale == 0 || timer1_overflow_us == SIM_TIME_NEVER)
+        return timer1_start_count;
+    return (unsigned int) ((timer1_start_count + (sim_now_us - timer1_start_us) * 16 / prescale) & 0xffff);
+}
+
+static void apply_input(const struct sim_input *in) {
+    switch (in->type) {
+        case SIM_INPUT_SWITCH:
+            if (in->a >= BOZ_INPUT_VIRTUAL_PIN && in->a < BOZ_INPUT_VIRTUAL_PIN + 8 * NUM_EXPANDERS) {
+                int n = in->a - BOZ_INPUT_VIRTUAL_PIN;
+                if (in->b)
+                    expander_closed[n / 8] |= 1 << (n % 8);
+                else
+                    expander_closed[n / 8] &= ~(1 << (n % 8));
+            }
+            else if (in->a < NUM_PINS) {
+                switch_closed[in->a] = in->b;
+            }
+            break;
+        case SIM_INPUT_ROTARY:
+            re_clock = in->a ? HIGH : LOW;
+            re_data = in->b ? HIGH : LOW;
+            break;
+        case SIM_INPUT_SERIAL:
+            serial_in.push_back(in->a);
+            sim_stats.serial_bytes_in++;
+            break;
+    }
+    if (sim_hook_input)
+        sim_hook_input(in);
+    check_interrupts();
+}
+
+static void timer1_overflow(void) {
+    unsigned int prescale = timer1_prescale();
+
+    /* Carry on counting from zero */
+    timer1_start_count = 0;
+    timer1_start_us = timer1_overflow_us;
+    if (prescale == 0)
+        timer1_overflow_us = SIM_TIME_NEVER;
+    else
+        timer1_overflow_us += (65536UL * prescale) / 16;
+
+    if (TIMSK1 & (1 << TOIE1)) {
+        if (interrupts_enabled) {
+            sim_stats.timer1_interrupts++;
+            if (sim_vector_timer1_ovf)
+                run_isr(sim_vector_timer1_ovf);
+        }
+        else {
+            timer1_pending = 1;
+        }
+    }
+}
+
+/* Move simulated time on to t, applying inputs and firing interrupts at the
+   times they're due on the way. */
+static void advance_to(uint64_t t) {
+    for (;;) {
+        uint64_t next_in = sim_next_input_us();
+        uint64_t next_adc = adc_next_conversion_us();
+        uint64_t next = next_in < timer1_overflow_us ? next_in : timer1_overflow_us;
+
+        if (next_adc < next)
+            next = next_adc;
+        if (next > t || next >= sim_end_us)
+            break;
+        if (next > sim_now_us)
+            sim_now_us = next;
+        if (next == next_in)
+            apply_input(&inputs[next_input++]);
+        else if (next == timer1_overflow_us)
+            timer1_overflow();
+        else
+            adc_conversion();
+    }
+    if (t > sim_now_us)
+        sim_now_us = t;
+    if (sim_now_us >= sim_end_us) {
+        sim_now_us = sim_end_us;
+        throw sim_finished();
+    }
+}
+
+void set_sleep_mode(int mode) {
+    (void) mode;
+}
+
+static void wdt_check(void) {
+    if (wdt_enabled && sim_now_us - wdt_reset_at_us > wdt_timeout_us) {
+        if (sim_stats.watchdog_timeouts == 0)
+            sim_stats.first_watchdog_timeout_us = wdt_reset_at_us + wdt_timeout_us;
+        sim_stats.watchdog_timeouts++;
+    }
+}
+
+void wdt_enable(int timeout) {
+    wdt_check();
+    wdt_enabled = 1;
+    wdt_timeout_us = 16000ULL << timeout;
+    wdt_reset_at_us = sim_now_us;
+}
+
+void wdt_disable(void) {
+    wdt_check();
+    wdt_enabled = 0;
+}
+
+void wdt_reset(void) {
+    wdt_check();
+    wdt_reset_at_us = sim_now_us;
+}
+
+void sleep_enable(void) {
+    sleep_enabled = 1;
+}
+
+void sleep_disable(void) {
+    sleep_enabled = 0;
+}
+
+void sleep_cpu(void) {
+    uint64_t wake;
+
+    if (!sleep_enabled)
+        return;
+
+    /* Sleep until the next input or the next timer interrupt. If neither is
+       ever going to happen, nothing will wake us, so that's the end. */
+    wake = sim_next_input_us();
+    if ((TIMSK1 & (1 << TOIE1)) && timer1_overflow_us < wake)
+        wake = timer1_overflow_us;
+    if (wake == SIM_TIME_NEVER)
+        throw sim_finished();
+
+    /* The work this pass of loop() did happened before it went to sleep, so
+       charge for it now rather than after we wake up. */
+    if (!pass_charged) {
+        pass_charged = 1;
+        advance_to(sim_now_us + sim_loop_pass_us);
+        if (!sleep_enabled)
+            return;
+    }
+
+    sim_stats.sleeps++;
+    if (wake > sim_now_us)
+        sim_stats.slept_us += (wake < sim_end_us ? wake : sim_end_us) - sim_now_us;
+    advance_to(wake);
+}
+
+/******************************************************************************
+ * Everything else
+ */
+
+void tone(uint8_t pin, unsigned int freq, unsigned long duration_ms) {
+    (void) pin;
+    (void) freq;
+    (void) duration_ms;
+    sim_stats.tones++;
+}
+
+void noTone(uint8_t pin) {
+    (void) pin;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0)
+        random_state = seed;
+}
+
+long random(long max) {
+    if (max <= 0)
+        return 0;
+    random_state = random_state * 1103515245UL + 12345UL;
+    return (long) ((random_state >> 16) & 0x7fffffff) % max;
+}
+
+long random(long min, long max) {
+    if (min >= max)
+        return min;
+    return min + random(max - min);
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+    (void) baud;
+}
+
+int HardwareSerial::available(void) {
+    return (int) (serial_in.size() - serial_in_pos);
+}
+
+int HardwareSerial::peek(void) {
+    return available() ? serial_in[serial_in_pos] : -1;
+}
+
+int HardwareSerial::read(void) {
+    return available() ? serial_in[serial_in_pos++] : -1;
+}
+
+int HardwareSerial::availableForWrite(void) {
+    return SERIAL_TX_BUFFER_SIZE;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write((const char *) &c, 1);
+}
+
+size_t HardwareSerial::write(const char *buf, size_t len) {
+    if (sim_serial_out)
+        fwrite(buf, 1, len, sim_serial_out);
+    sim_stats.serial_bytes_out += len;
+    return len;
+}
+
+void HardwareSerial::flush(void) {
+}
+
+int sim_eeprom_is_ready(void) {
+    return sim_now_us >= eeprom_busy_until_us;
+}
+
+static void eeprom_wait(void) {
+    if (sim_now_us < eeprom_busy_until_us) {
+        sim_stats.eeprom_wait_us += eeprom_busy_until_us - sim_now_us;
+        advance_to(eeprom_busy_until_us);
+    }
+}
+
+uint8_t EEPROMClass::read(int idx) {
+    eeprom_wait();
+    sim_stats.eeprom_reads++;
+    return eeprom[idx & (SIM_EEPROM_SIZE - 1)];
+}
+
+void EEPROMClass::write(int idx, uint8_t value) {
+    eeprom_wait();
+    sim_stats.eeprom_writes++;
+    eeprom[idx & (SIM_EEPROM_SIZE - 1)] = value;
+    eeprom_busy_until_us = sim_now_us + EEPROM_WRITE_US;
+}
+
+void EEPROMClass::update(int idx, uint8_t value) {
+    if (read(idx) != value)
+        write(idx, value);
+}
+
+int sim_eeprom_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return -1;
+    size_t n = fread(eeprom, 1, sizeof(eeprom), f);
+    fclose(f);
+    memset(eeprom + n, 0xff, sizeof(eeprom) - n);
+    return 0;
+}
+
+int sim_eeprom_save(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return -1;
+    size_t n = fwrite(eeprom, 1, sizeof(eeprom), f);
+    if (fclose(f) != 0 || n != sizeof(eeprom))
+        return -1;
+    return 0;
+}
+
+/* An I2C transmission is a start condition, the address byte, the data bytes
+   and a stop condition, and each byte takes nine clocks including the
+   acknowledge bit. The Wire library waits for the whole thing, so the
+   firmware does too. Each byte reaches the device when it's acknowledged. */
+void TwoWire::begin(void) {
+    tx_len = 0;
+    rx_len = rx_pos = 0;
+}
+
+/* When a transfer starting now starts, in nanoseconds, carrying on from
+   the end of the last one if that was this microsecond */
+static uint64_t i2c_start_ns(void) {
+    return sim_now_us * 1000 + (sim_now_us == i2c_end_us ? i2c_carry_ns : 0);
+}
+
+static void i2c_finish(uint64_t start_ns, uint64_t end_ns) {
+    sim_stats.i2c_bus_ns += end_ns - start_ns;
+    advance_to(end_ns / 1000);
+    i2c_carry_ns = end_ns % 1000;
+    i2c_end_us = sim_now_us;
+}
+
+void TwoWire::setClock(uint32_t freq) {
+    if (freq > 0)
+        sim_i2c_clock_hz = freq;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    tx_address = address;
+    tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (tx_len >= sizeof(tx_buf))
+        return 0;
+    tx_buf[tx_len++] = data;
+    sim_stats.i2c_bytes++;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while (n < len && write(data[n]))
+        ++n;
+    return n;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+    uint64_t start_ns = i2c_start_ns();
+    uint64_t bit_ns = 1000000000ULL / sim_i2c_clock_hz;
+    uint64_t end_ns = start_ns + (1 + 9 * (tx_len + 1) + (stop ? 1 : 0)) * bit_ns;
+
+    sim_stats.i2c_transmissions++;
+    for (size_t i = 0; i < tx_len; ++i) {
+        advance_to((start_ns + (1 + 9 * (i + 2)) * bit_ns) / 1000);
+        if (tx_address == SIM_LCD_I2C_ADDRESS)
+            sim_lcd_pcf8574_write(tx_buf[i], sim_now_us);
+    }
+    i2c_finish(start_ns, end_ns);
+    tx_len = 0;
+    return 0;
+}
+
+/* A read is the same, but the device sends the data bytes. Only the input
+   expanders answer. Reading an expander clears its interrupt. */
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool stop) {
+    uint64_t start_ns = i2c_start_ns();
+    uint64_t bit_ns = 1000000000ULL / sim_i2c_clock_hz;
+    uint64_t end_ns;
+    int e = address - BOZ_INPUT_EXPANDER_ADDRESS;
+
+    rx_len = rx_pos = 0;
+    if (e < 0 || e >= NUM_EXPANDERS)
+        quantity = 0;
+    if (quantity > sizeof(rx_buf))
+        quantity = sizeof(rx_buf);
+
+    sim_stats.i2c_reads++;
+    for (size_t i = 0; i < quantity; ++i) {
+        rx_buf[rx_len++] = expander_port(e);
+        expander_last_read[e] = expander_port(e);
+    }
+    end_ns = start_ns + (1 + 9 * (quantity + 1) + (stop ? 1 : 0)) * bit_ns;
+    sim_stats.i2c_read_ns += end_ns - start_ns;
+    i2c_finish(start_ns, end_ns);
+    return (uint8_t) rx_len;
+}
+
+int TwoWire::available(void) {
+    return (int) (rx_len - rx_pos);
+}
+
+int TwoWire::read(void) {
+    if (rx_pos >= rx_len)
+        return -1;
+    return rx_buf[rx_pos++];
+}
+
+/******************************************************************************
+ * Running the firmware
+ */
+
+void sim_add_input(const struct sim_input *input) {
+    inputs.push_back(*input);
+}
+
+uint64_t sim_next_input_us(void) {
+    if (next_input < inputs.size())
+        return inputs[next_input].time_us;
+    else
+        return SIM_TIME_NEVER;
+}
+
+static uint64_t host_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void sim_run(void) {
+    try {
+        setup();
+        if (sim_hook_setup)
+            sim_hook_setup();
+        for (;;) {
+            uint64_t start_us = sim_now_us;
+            uint64_t start_ns = host_time_ns();
+
+            pass_charged = 0;
+            loop();
+            sim_stats.loop_passes++;
+            if (!pass_charged)
+                advance_to(sim_now_us + sim_loop_pass_us);
+            if (sim_hook_pass)
+                sim_hook_pass(start_us, sim_now_us, host_time_ns() - start_ns);
+
+            /* As the Arduino core does after each pass of loop() */
+            if (serialEvent && Serial.available())
+                serialEvent();
+        }
+    }
+    catch (sim_finished &) {
+    }
+}
+
+/* Power-on state: blank EEPROM, all pins inputs */
+static struct sim_power_on {
+    sim_power_on() {
+        memset(eeprom, 0xff, sizeof(eeprom));
+    }
+} sim_power_on;
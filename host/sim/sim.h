@@ -0,0 +1,113 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+/* The simulator's side of the host harness: simulated time, the switches
+ * and the rotary encoder, and the main loop that calls the firmware's setup()
+ * and loop(). The harness (e.g. replay.cpp) gives it a list of inputs, sets
+ * the hooks it's interested in, and calls sim_run(). */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_TIME_NEVER UINT64_MAX
+
+enum sim_input_type {
+    /* Switch on pin "a" closes (b = 1) or opens (b = 0). Pins from
+     * BOZ_INPUT_VIRTUAL_PIN are the input expanders' switches. */
+    SIM_INPUT_SWITCH,
+
+    /* Rotary encoder's clock pin goes to level a, data pin to level b */
+    SIM_INPUT_ROTARY,
+
+    /* Byte "a" arrives on the serial port */
+    SIM_INPUT_SERIAL
+};
+
+struct sim_input {
+    uint64_t time_us;
+    uint8_t type;
+    uint8_t a, b;
+};
+
+struct sim_stats {
+    uint64_t loop_passes;
+    uint64_t sleeps;
+    uint64_t slept_us;
+    uint64_t timer1_interrupts;
+    uint64_t pin_interrupts;
+    uint64_t adc_conversions;
+    uint64_t eeprom_reads;
+    uint64_t eeprom_writes;
+
+    /* Time spent waiting for the EEPROM to finish a write */
+    uint64_t eeprom_wait_us;
+
+    uint64_t i2c_transmissions;
+    uint64_t i2c_bytes;
+
+
+    /* Time the I2C bus was busy, in nanoseconds */
+    uint64_t i2c_bus_ns;
+
+    /* Reads from the input expanders, and how much of i2c_bus_ns they took */
+    uint64_t i2c_reads;
+    uint64_t i2c_read_ns;
+
+    uint64_t tones;
+
+    /* Times the watchdog would have gone off, and the first time it did */
+    uint64_t watchdog_timeouts;
+    uint64_t first_watchdog_timeout_us;
+
+    uint64_t serial_bytes_in;
+    uint64_t serial_bytes_out;
+};
+
+/* Simulated time, in microseconds since the firmware started */
+extern uint64_t sim_now_us;
+
+/* Simulated CPU time each pass of loop() takes, on top of any delays and
+ * waits it does itself. */
+extern uint64_t sim_loop_pass_us;
+
+/* The run stops when simulated time reaches this */
+extern uint64_t sim_end_us;
+
+/* Battery voltage seen on the sensor pin, in millivolts */
+extern int sim_battery_mv;
+
+/* I2C bus clock, 100kHz by default as with the Wire library. The firmware
+ * can change it with Wire.setClock(). */
+extern uint32_t sim_i2c_clock_hz;
+
+extern struct sim_stats sim_stats;
+
+/* If not NULL, what the firmware writes to the serial port goes here */
+extern FILE *sim_serial_out;
+
+/* Hooks, all optional. sim_hook_input is called as each input is applied.
+ * sim_hook_pass is called after each pass of loop(), with the simulated
+ * times it started and finished and the host CPU time it took.
+ * sim_hook_setup is called once, when setup() returns. */
+extern void (*sim_hook_input)(const struct sim_input *input);
+extern void (*sim_hook_pass)(uint64_t start_us, uint64_t end_us, uint64_t host_ns);
+extern void (*sim_hook_setup)(void);
+
+/* Add an input to happen at input->time_us. Inputs must be added in time
+ * order. */
+void sim_add_input(const struct sim_input *input);
+
+/* Returns the time of the next input that hasn't been applied yet, or
+ * SIM_TIME_NEVER. */
+uint64_t sim_next_input_us(void);
+
+/* Load the EEPROM from a file of up to 1024 bytes, or save it. Return 0 on
+ * success or -1 on failure. */
+int sim_eeprom_load(const char *path);
+int sim_eeprom_save(const char *path);
+
+/* Call setup(), then loop() until simulated time reaches sim_end_us, or
+ * until the firmware goes to sleep with nothing left that could wake it. */
+void sim_run(void);
+
+#endif
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+
+"""Turn a Bozzard trace dump into a timeline.
+
+Build the firmware with BOZ_TRACE defined, capture the serial port, and
+hold yellow and reset down together. The firmware sends the trace ring,
+which holds the last few dozen things the main loop did, as hex. The format
+is described at the top of boz/boz_trace.ino.
+
+    host/trace.py [-b BUZZERS] CAPTURE
+
+For each dump in the capture, this prints one line per record: the time in
+milliseconds since the first record, the time since the record before, and
+what happened. The trace point names come from boz/boz_trace.h.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+TRACE_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "boz", "boz_trace.h")
+
+# Each timestamp is micros() / 16, so one count is 16us, and it wraps round
+# every 65536 counts.
+TICK_US = 16
+WRAP = 65536
+
+# The buttons after the buzzers, in the order given in boz/boz_input.h
+QM_BUTTONS = [ "play", "yellow", "reset", "rotary press" ]
+
+def button_names(num_buzzers):
+    return [ "buzzer %d" % (n + 1) for n in range(num_buzzers) ] + QM_BUTTONS
+
+def read_names(path):
+    """Return a dict mapping each trace point ID to its name, such as
+    "DISP_PUSH", from the #defines in boz_trace.h."""
+    names = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"#define BOZ_TRACE_(\w+)\s+(\d+)", line)
+            if m:
+                names[int(m.group(2))] = m.group(1)
+    return names
+
+def describe(name, arg, buttons):
+    if name == "BUTTON":
+        return buttons[arg] if arg < len(buttons) else "button %d" % arg
+    if name in ("SND_PUSH", "DISP_PUSH"):
+        return "queue full" if arg == 255 else "%d queued" % arg
+    if name in ("SND_POP", "DISP_STEP"):
+        return "%d left" % arg
+    if name == "CLOCK_EXPIRY":
+        return "clock %d %s" % (arg & 0x7f, "max" if arg & 0x80 else "min")
+    if name == "CLOCK_ALARM":
+        return "clock %d" % arg
+    if name == "APP_CALL":
+        return "app %d" % arg
+    if name == "APP_EXIT":
+        return "status %d" % (arg - 256 if arg > 127 else arg)
+    if name == "WAKE" and arg:
+        return "after %d wraps" % arg
+    if name in ("SLEEP", "WAKE"):
+        return ""
+    return "%d" % arg
+
+def decode(ring, names, buttons):
+    """Return a list of (time_us, delta_us, name, description) from the
+    bytes of one dump."""
+    events = []
+    now = None
+    last_t = None
+    for i in range(0, len(ring) - 3, 4):
+        trace_id, arg, t = ring[i], ring[i + 1], ring[i + 2] | (ring[i + 3] << 8)
+        name = names.get(trace_id, "ID %d" % trace_id)
+        if now is None:
+            now = 0
+            delta = 0
+        else:
+            delta = (t - last_t) % WRAP
+            if name == "WAKE":
+                delta += arg * WRAP
+            delta *= TICK_US
+            now += delta
+        last_t = t
+        events.append((now, delta, name, describe(name, arg, buttons)))
+    return events
+
+def main():
+    parser = argparse.ArgumentParser(description="Turn a Bozzard trace dump into a timeline.")
+    parser.add_argument("-b", "--buzzers", type=int, default=4,
+            help="BOZ_NUM_BUZZERS the firmware was built with (default 4)")
+    parser.add_argument("capture", help="serial capture containing the dump, or - for stdin")
+    args = parser.parse_args()
+    buttons = button_names(args.buzzers)
+
+    names = read_names(TRACE_H)
+    with open(sys.stdin.fileno() if args.capture == "-" else args.capture, "rb") as f:
+        data = f.read()
+
+    dumps = re.findall(rb"BOZ TRACE\r?\n(.*?)END", data, re.S)
+    if not dumps:
+        sys.stderr.write("%s: no trace dump found\n" % args.capture)
+        return 1
+
+    for n, dump in enumerate(dumps):
+        ring = bytes(int(x, 16) for x in dump.split())
+        if len(dumps) > 1:
+            print("# dump %d of %d" % (n + 1, len(dumps)))
+        for time_us, delta_us, name, desc in decode(ring, names, buttons):
+            print("%10.3f ms %+9d us  %-12s %s" % (time_us / 1000.0, delta_us, name, desc))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())